@@ -0,0 +1,1355 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "cache.h"
+#include "compact_cache.h"
+#include "numa.h"
+#include "numa_cache.h"
+#include "u64_cache.h"
+#include "list.h"
+#include "hashtable.h"
+#include "concurrent_hashtable.h"
+#include "front_cache.h"
+#include "preload.h"
+#include "free_queue.h"
+#include "shm_cache.h"
+#include "cache_server.h"
+#include "slab.h"
+#include "workload.h"
+#include "trace.h"
+
+
+enum {
+    BENCH_N_KEYS=20000,
+    BENCH_N_ITER=1000000,
+    BENCH_PAGE_SIZE=4096,
+    BENCH_PHASE_LEN=100000,
+    BENCH_BIG_CACHE_SIZE=1000000,
+    BENCH_TLB_CACHE_SIZE=4000000,
+    BENCH_MAX_THREADS=8,
+    BENCH_HOT_KEYS=1000,
+    BENCH_FRONT_SETS=1024,
+    BENCH_PRELOAD_WORKERS=32,
+    BENCH_LARGE_PAGE_SIZE=4 << 20,
+    BENCH_LARGE_N_PAGES=16,
+    BENCH_LARGE_N_PUTS=2000,
+    BENCH_SHM_WORKERS=16,
+    BENCH_SERVER_KEYS=1000,
+    BENCH_SERVER_VALUE=100,
+    BENCH_SERVER_BATCH=16,
+    BENCH_SERVER_ROUNDS=20000,
+    BENCH_HOT_CLIENTS=4,
+    BENCH_HOT_ROUNDS=5000,
+    BENCH_SLAB_BUDGET=64 << 20,
+    BENCH_SLAB_SMALL_PAGE=300,
+    BENCH_SLAB_SMALL_KEYS=400000,
+    BENCH_SLAB_LARGE_PAGE=256 << 10,
+    BENCH_SLAB_LARGE_KEYS=512,
+    BENCH_SLAB_LARGE_ITER=10000,
+    BENCH_YCSB_KEYS=100000,
+    BENCH_YCSB_CACHE_SIZE=10000,
+    BENCH_YCSB_N_OPS=200000,
+    BENCH_TRACE_KEYS=1000000,
+    BENCH_TRACE_CACHE_SIZE=100000,
+    BENCH_WALK_STEP=100,
+};
+#define BENCH_ZIPF_S 0.99
+#define BENCH_SEED 1
+#define BENCH_SCAN_KEY_BASE 1000000000
+
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// Fixed seed keeps runs comparable
+static rng_t rng;
+
+
+static workload_t* create_zipf(size_t n, double s, uint64_t seed) {
+    workload_config_t config = workload_default_config(WORKLOAD_ZIPF, n, seed);
+    config.zipf_s = s;
+    return create_workload(&config);
+}
+
+
+// JSON-like page, compresses several times like real API responses
+static page_t* json_get_page(const char* key) {
+    char data[BENCH_PAGE_SIZE];
+    size_t len = sprintf(data, "{\"key\": \"%s\", \"items\": [", key);
+    unsigned seed = (unsigned) key_hash(key);
+    while (len + 100 < sizeof(data)) {
+        seed = seed * 1103515245u + 12345u;
+        len += sprintf(&data[len], "{\"id\": %u, \"status\": \"active\", \"score\": %u, \"tags\": [\"a\", \"b\"]}, ",
+                       seed >> 16, seed % 1000);
+    }
+    sprintf(&data[len], "{}]}");
+    return create_page(key, data);
+}
+
+
+static void bench_compression(void) {
+    puts("== Value compression: zipf(0.99) over 20k JSON pages, 16 MB budget");
+    printf("%-12s %10s %10s %12s %12s %10s\n", "mode", "hit ratio", "Mops/s", "pages", "MB stored", "decompr");
+
+    workload_t* zipf = create_zipf(BENCH_N_KEYS, BENCH_ZIPF_S, BENCH_SEED);
+    size_t* trace = malloc(sizeof(size_t) * BENCH_N_ITER);
+    if (trace == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        trace[i] = workload_next(zipf);
+    }
+
+    const size_t thresholds[] = {0, 256};
+    for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); ++t) {
+        cache_config_t config = cache_default_config(BENCH_N_KEYS);
+        config.max_bytes = 16 << 20;
+        config.compress_threshold = thresholds[t];
+        lru_cache_t* cache = create_cache_with_config(&config);
+
+        double start = now_sec();
+        for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+            char key[32];
+            sprintf(key, "page%zu", trace[i]);
+            cached_call(cache, key, &json_get_page);
+        }
+        double elapsed = now_sec() - start;
+
+        cache_stats_t stats = cache_stats(cache);
+        printf("%-12s %10.4f %10.3f %12zu %12.2f %10zu\n",
+               thresholds[t] ? "compressed" : "raw",
+               (double) stats.hits / (stats.hits + stats.misses),
+               BENCH_N_ITER / elapsed * 1e-6,
+               cache_length(cache),
+               stats.n_bytes / 1048576.0,
+               stats.decompressions);
+        delete_cache(cache);
+    }
+    free(trace);
+    delete_workload(zipf);
+    puts("");
+}
+
+
+static page_t* empty_get_page(const char* key) {
+    return create_page(key, "");
+}
+
+
+static size_t* alloc_trace(size_t n) {
+    size_t* trace = malloc(sizeof(size_t) * n);
+    if (trace == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return trace;
+}
+
+
+static double run_hit_ratio(cache_policy_t policy, size_t cache_size, const size_t* trace, size_t n) {
+    cache_config_t config = cache_default_config(cache_size);
+    config.policy = policy;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    for (size_t i = 0; i < n; ++i) {
+        char key[32];
+        sprintf(key, "key%zu", trace[i]);
+        cached_call(cache, key, &empty_get_page);
+    }
+    cache_stats_t stats = cache_stats(cache);
+    delete_cache(cache);
+    return (double) stats.hits / (stats.hits + stats.misses);
+}
+
+
+static void print_arc_target(const size_t* trace, size_t n) {
+    cache_config_t config = cache_default_config(1000);
+    config.policy = CACHE_POLICY_ARC;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    printf("ARC target at phase ends:");
+    for (size_t i = 0; i < n; ++i) {
+        char key[32];
+        sprintf(key, "key%zu", trace[i]);
+        cached_call(cache, key, &empty_get_page);
+        if ((i + 1) % BENCH_PHASE_LEN == 0) {
+            printf(" %zu", cache_stats(cache).arc_target);
+        }
+    }
+    puts("");
+    delete_cache(cache);
+}
+
+
+static void bench_policies(void) {
+    puts("== Eviction policies: hit ratio");
+    const char* policy_names[] = {"LRU", "SLRU", "2Q", "ARC"};
+    const cache_policy_t policies[] = {CACHE_POLICY_LRU, CACHE_POLICY_SLRU, CACHE_POLICY_2Q, CACHE_POLICY_ARC};
+    const size_t n_policies = sizeof(policies) / sizeof(policies[0]);
+
+    printf("%-36s", "workload");
+    for (size_t p = 0; p < n_policies; ++p) {
+        printf(" %8s", policy_names[p]);
+    }
+    puts("");
+
+    size_t* trace = alloc_trace(BENCH_N_ITER);
+
+    // Workload of test_cache_randomized2: upper half of keys is three times less likely
+    workload_config_t config = workload_default_config(WORKLOAD_HOTSPOT, 20, BENCH_SEED);
+    config.hot_fraction = 0.5;
+    config.hot_share = 0.75;
+    workload_t* hotspot = create_workload(&config);
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        trace[i] = workload_next(hotspot);
+    }
+    delete_workload(hotspot);
+    printf("%-36s", "randomized2 (20 keys, size 10)");
+    for (size_t p = 0; p < n_policies; ++p) {
+        printf(" %8.4f", run_hit_ratio(policies[p], 10, trace, BENCH_N_ITER));
+    }
+    puts("");
+
+    workload_t* zipf = create_zipf(10000, 0.9, BENCH_SEED);
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        trace[i] = workload_next(zipf);
+    }
+    printf("%-36s", "zipf(0.9) (10k keys, size 1000)");
+    for (size_t p = 0; p < n_policies; ++p) {
+        printf(" %8.4f", run_hit_ratio(policies[p], 1000, trace, BENCH_N_ITER));
+    }
+    puts("");
+
+    // Every 5000 requests a scan of 1000 keys never seen before
+    size_t scan_key = BENCH_SCAN_KEY_BASE;
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        trace[i] = (i % 6000 < 5000) ? workload_next(zipf) : scan_key++;
+    }
+    printf("%-36s", "zipf(0.9) + scans (size 1000)");
+    for (size_t p = 0; p < n_policies; ++p) {
+        printf(" %8.4f", run_hit_ratio(policies[p], 1000, trace, BENCH_N_ITER));
+    }
+    puts("");
+
+    // Recency-friendly zipf phases alternate with loops over 1200 keys
+    size_t loop_key = 0;
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        if ((i / BENCH_PHASE_LEN) % 2 == 0) {
+            trace[i] = workload_next(zipf);
+        } else {
+            trace[i] = BENCH_SCAN_KEY_BASE + loop_key++ % 1200;
+        }
+    }
+    printf("%-36s", "zipf(0.9) / loop phases (size 1000)");
+    for (size_t p = 0; p < n_policies; ++p) {
+        printf(" %8.4f", run_hit_ratio(policies[p], 1000, trace, BENCH_N_ITER));
+    }
+    puts("");
+    print_arc_target(trace, BENCH_N_ITER);
+
+    delete_workload(zipf);
+    free(trace);
+    puts("");
+}
+
+
+// Every tenth key takes 800 ms to regenerate, the rest 2 ms
+static page_t* costly_get_page(const char* key) {
+    page_t* page = create_page(key, "");
+    page->cost = key_hash(key) % 10 == 0 ? 0.8 : 0.002;
+    return page;
+}
+
+
+static void bench_cost(void) {
+    puts("== Cost-aware eviction: zipf(0.9) over 10k keys, 10% keys cost 800 ms, others 2 ms, size 1000");
+    printf("%-8s %10s %14s %14s\n", "policy", "hit ratio", "loader time,s", "saved time,s");
+    const char* policy_names[] = {"LRU", "ARC", "GDSF"};
+    const cache_policy_t policies[] = {CACHE_POLICY_LRU, CACHE_POLICY_ARC, CACHE_POLICY_GDSF};
+
+    workload_t* zipf = create_zipf(10000, 0.9, BENCH_SEED);
+    size_t* trace = alloc_trace(BENCH_N_ITER);
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        trace[i] = workload_next(zipf);
+    }
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        cache_config_t config = cache_default_config(1000);
+        config.policy = policies[p];
+        lru_cache_t* cache = create_cache_with_config(&config);
+        for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+            char key[32];
+            sprintf(key, "key%zu", trace[i]);
+            cached_call(cache, key, &costly_get_page);
+        }
+        cache_stats_t stats = cache_stats(cache);
+        printf("%-8s %10.4f %14.1f %14.1f\n", policy_names[p],
+               (double) stats.hits / (stats.hits + stats.misses),
+               stats.loader_time, stats.saved_loader_time);
+        delete_cache(cache);
+    }
+    free(trace);
+    delete_workload(zipf);
+    puts("");
+}
+
+
+static double rss_mb(void) {
+    long pages_total = 0;
+    long pages_resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == NULL) {
+        return 0.0;
+    }
+    if (fscanf(file, "%ld %ld", &pages_total, &pages_resident) != 2) {
+        pages_resident = 0;
+    }
+    fclose(file);
+    return pages_resident * (double) sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+
+// Runs benchmark in child process, so each variant starts with a clean heap
+static void run_isolated(void (*bench)(void)) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        bench();
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+
+static const page_t* lru_call(void* cache, const char* key) {
+    return cached_call(cache, key, &empty_get_page);
+}
+
+
+static const page_t* compact_call(void* cache, const char* key) {
+    return compact_cached_call(cache, key, &empty_get_page);
+}
+
+
+static void run_big_cache(const char* name, void* cache, const page_t* (*call)(void*, const char*), double rss_before) {
+    char key[32];
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_BIG_CACHE_SIZE; ++i) {
+        sprintf(key, "key%zu", i);
+        call(cache, key);
+    }
+    double fill_time = now_sec() - start;
+    double rss = rss_mb() - rss_before;
+
+    // Half of requests hit, the other half evict from the tail
+    start = now_sec();
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        sprintf(key, "key%zu", (size_t) (rng_next(&rng) % (2 * BENCH_BIG_CACHE_SIZE)));
+        call(cache, key);
+    }
+    double elapsed = now_sec() - start;
+    printf("%-10s %12.1f %12.3f %12.3f\n", name, rss, BENCH_BIG_CACHE_SIZE / fill_time * 1e-6,
+           BENCH_N_ITER / elapsed * 1e-6);
+}
+
+
+static void bench_lru_big(void) {
+    double rss_before = rss_mb();
+    lru_cache_t* cache = create_cache(BENCH_BIG_CACHE_SIZE);
+    run_big_cache("lru", cache, &lru_call, rss_before);
+    delete_cache(cache);
+}
+
+
+static void bench_compact_big(void) {
+    double rss_before = rss_mb();
+    compact_cache_t* cache = create_compact_cache(BENCH_BIG_CACHE_SIZE);
+    run_big_cache("compact", cache, &compact_call, rss_before);
+    delete_compact_cache(cache);
+}
+
+
+static void bench_compact(void) {
+    puts("== Compact index: 1M pages with empty data, uniform requests over 2M keys");
+    printf("%-10s %12s %12s %12s\n", "cache", "RSS MB", "fill Mops/s", "Mops/s");
+    run_isolated(&bench_lru_big);
+    run_isolated(&bench_compact_big);
+    puts("");
+}
+
+
+static void run_tlb_lookups(bool huge_pages) {
+    compact_config_t config = compact_default_config(BENCH_TLB_CACHE_SIZE);
+    config.huge_pages = huge_pages;
+    compact_cache_t* cache = create_compact_cache_with_config(&config);
+    char key[32];
+    for (size_t i = 0; i < BENCH_TLB_CACHE_SIZE; ++i) {
+        sprintf(key, "key%zu", i);
+        compact_cached_call(cache, key, &empty_get_page);
+    }
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        sprintf(key, "key%zu", (size_t) (rng_next(&rng) % BENCH_TLB_CACHE_SIZE));
+        compact_cached_call(cache, key, &empty_get_page);
+    }
+    double elapsed = now_sec() - start;
+    printf("%-10s %12s %12.3f\n", huge_pages ? "huge" : "regular",
+           huge_backing_name(compact_cache_backing(cache)), BENCH_N_ITER / elapsed * 1e-6);
+    delete_compact_cache(cache);
+}
+
+
+static void bench_tlb_regular(void) {
+    run_tlb_lookups(false);
+}
+
+
+static void bench_tlb_huge(void) {
+    run_tlb_lookups(true);
+}
+
+
+static void bench_huge_pages(void) {
+    puts("== Huge pages: random hits in compact cache with 4M entries");
+    printf("%-10s %12s %12s\n", "pages", "backing", "Mops/s");
+    run_isolated(&bench_tlb_regular);
+    run_isolated(&bench_tlb_huge);
+    puts("");
+}
+
+
+// Remote shard is used as given, local one is picked per lookup as callers migrating
+// between nodes would
+static void run_numa_lookups(const char* name, const numa_cache_t* cache, compact_cache_t* remote, size_t node) {
+    char key[32];
+    compact_cache_t* shard = remote != NULL ? remote : numa_local_shard(cache);
+    for (size_t i = 0; i < BENCH_BIG_CACHE_SIZE; ++i) {
+        sprintf(key, "key%zu", i);
+        compact_cached_call(shard, key, &empty_get_page);
+    }
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        sprintf(key, "key%zu", (size_t) (rng_next(&rng) % BENCH_BIG_CACHE_SIZE));
+        shard = remote != NULL ? remote : numa_local_shard(cache);
+        compact_cached_call(shard, key, &empty_get_page);
+    }
+    double elapsed = now_sec() - start;
+    printf("%-10s %12zu %12.3f\n", name, node, BENCH_N_ITER / elapsed * 1e-6);
+}
+
+
+static void bench_numa(void) {
+    size_t n_nodes = numa_node_count();
+    printf("== NUMA: random hits in 1M pages of local vs remote node shard, %zu node(s)\n", n_nodes);
+    printf("%-10s %12s %12s\n", "shard", "node", "Mops/s");
+    numa_cache_t* cache = create_numa_cache(BENCH_BIG_CACHE_SIZE, true);
+    size_t local_node = numa_current_node();
+    run_numa_lookups("local", cache, NULL, local_node);
+    if (n_nodes > 1) {
+        size_t remote_node = (local_node + 1) % n_nodes;
+        run_numa_lookups("remote", cache, numa_shard(cache, remote_node), remote_node);
+    } else {
+        puts("remote     single node, no remote shard");
+    }
+    delete_numa_cache(cache);
+    puts("");
+}
+
+
+static page_t* empty_u64_get_page(uint64_t key) {
+    (void) key;
+    return create_page("", "");
+}
+
+
+static void bench_u64_string(void) {
+    double rss_before = rss_mb();
+    lru_cache_t* cache = create_cache(BENCH_BIG_CACHE_SIZE);
+    run_big_cache("string", cache, &lru_call, rss_before);
+    delete_cache(cache);
+}
+
+
+static void bench_u64_inline(void) {
+    double rss_before = rss_mb();
+    u64_cache_t* cache = create_u64_cache(BENCH_BIG_CACHE_SIZE);
+    double start = now_sec();
+    for (uint64_t i = 0; i < BENCH_BIG_CACHE_SIZE; ++i) {
+        u64_cached_call(cache, i, &empty_u64_get_page);
+    }
+    double fill_time = now_sec() - start;
+    double rss = rss_mb() - rss_before;
+
+    start = now_sec();
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        u64_cached_call(cache, rng_next(&rng) % (2 * BENCH_BIG_CACHE_SIZE), &empty_u64_get_page);
+    }
+    double elapsed = now_sec() - start;
+    printf("%-10s %12.1f %12.3f %12.3f\n", "u64", rss, BENCH_BIG_CACHE_SIZE / fill_time * 1e-6,
+           BENCH_N_ITER / elapsed * 1e-6);
+    delete_u64_cache(cache);
+}
+
+
+static void bench_u64(void) {
+    puts("== Integer keys: 1M pages, uniform requests over 2M ids, string path formats ids with sprintf");
+    printf("%-10s %12s %12s %12s\n", "keys", "RSS MB", "fill Mops/s", "Mops/s");
+    run_isolated(&bench_u64_string);
+    run_isolated(&bench_u64_inline);
+    puts("");
+}
+
+
+typedef struct lookup_worker_t {
+    hashtable_t* htable;
+    pthread_mutex_t* mutex;
+    chashtable_t* chtable;
+    char (*keys)[32];
+    uint64_t seed;
+    size_t n_found;
+} lookup_worker_t;
+
+
+static void* lookup_worker(void* arg) {
+    lookup_worker_t* worker = arg;
+    uint64_t state = worker->seed;
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        const char* key = worker->keys[(state * 2685821657736338717ull >> 32) % BENCH_N_KEYS];
+        if (worker->chtable != NULL) {
+            worker->n_found += chashtable_get(worker->chtable, key) != NULL;
+        } else {
+            pthread_mutex_lock(worker->mutex);
+            worker->n_found += hashtable_get(worker->htable, key) != NULL;
+            pthread_mutex_unlock(worker->mutex);
+        }
+    }
+    return NULL;
+}
+
+
+static double run_lookups(hashtable_t* htable, pthread_mutex_t* mutex, chashtable_t* chtable,
+                          char (*keys)[32], size_t n_threads) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    lookup_worker_t workers[BENCH_MAX_THREADS];
+    double start = now_sec();
+    for (size_t i = 0; i < n_threads; ++i) {
+        workers[i] = (lookup_worker_t) {htable, mutex, chtable, keys, rng_next(&rng) | 1, 0};
+        pthread_create(&threads[i], NULL, &lookup_worker, &workers[i]);
+    }
+    for (size_t i = 0; i < n_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    return n_threads * BENCH_N_ITER / (now_sec() - start) * 1e-6;
+}
+
+
+static void bench_concurrent(void) {
+    puts("== Concurrent lookups: 20000 keys, 1M gets per thread, total Mops/s");
+    char (*keys)[32] = malloc(sizeof(*keys) * BENCH_N_KEYS);
+    list_t* nodes = create_list();
+    hashtable_t* htable = create_hashtable();
+    chashtable_t* chtable = create_chashtable();
+    pthread_mutex_t mutex;
+    pthread_mutex_init(&mutex, NULL);
+    for (size_t i = 0; i < BENCH_N_KEYS; ++i) {
+        sprintf(keys[i], "key %zu", i);
+        list_node_t* node = list_push_front(nodes, NULL);
+        hashtable_put(htable, keys[i], node);
+        chashtable_put(chtable, keys[i], node);
+    }
+
+    printf("%-10s %12s %12s\n", "threads", "mutex", "lock-free");
+    for (size_t n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2) {
+        double locked = run_lookups(htable, &mutex, NULL, keys, n_threads);
+        double lock_free = run_lookups(NULL, NULL, chtable, keys, n_threads);
+        printf("%-10zu %12.2f %12.2f\n", n_threads, locked, lock_free);
+    }
+    puts("");
+
+    pthread_mutex_destroy(&mutex);
+    delete_chashtable(chtable);
+    delete_hashtable(htable);
+    delete_list(nodes);
+    free(keys);
+}
+
+
+typedef struct front_worker_t {
+    shared_cache_t* shared;
+    char (*keys)[32];
+    bool use_front;
+    uint64_t seed;
+} front_worker_t;
+
+
+static void* front_worker(void* arg) {
+    front_worker_t* worker = arg;
+    front_cache_t* front = create_front_cache(worker->shared, BENCH_FRONT_SETS);
+    ebr_t* ebr = shared_cache_ebr(worker->shared);
+    uint64_t state = worker->seed;
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        const char* key = worker->keys[(state * 2685821657736338717ull >> 32) % BENCH_HOT_KEYS];
+        if (worker->use_front) {
+            front_cached_call(front, key, &empty_get_page);
+        } else {
+            ebr_enter(ebr);
+            shared_cached_call(worker->shared, key, &empty_get_page);
+            ebr_exit(ebr);
+        }
+    }
+    delete_front_cache(front);
+    return NULL;
+}
+
+
+static double run_front(shared_cache_t* shared, char (*keys)[32], bool use_front, size_t n_threads) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    front_worker_t workers[BENCH_MAX_THREADS];
+    double start = now_sec();
+    for (size_t i = 0; i < n_threads; ++i) {
+        workers[i] = (front_worker_t) {shared, keys, use_front, rng_next(&rng) | 1};
+        pthread_create(&threads[i], NULL, &front_worker, &workers[i]);
+    }
+    for (size_t i = 0; i < n_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    return n_threads * BENCH_N_ITER / (now_sec() - start) * 1e-6;
+}
+
+
+static void bench_front(void) {
+    puts("== Front cache: 1000 hot keys, 1M calls per thread, total Mops/s");
+    char (*keys)[32] = malloc(sizeof(*keys) * BENCH_HOT_KEYS);
+    for (size_t i = 0; i < BENCH_HOT_KEYS; ++i) {
+        sprintf(keys[i], "key %zu", i);
+    }
+    cache_config_t config = cache_default_config(BENCH_N_KEYS);
+    shared_cache_t* shared = create_shared_cache(&config);
+
+    printf("%-10s %12s %12s\n", "threads", "shared", "front");
+    for (size_t n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2) {
+        double locked = run_front(shared, keys, false, n_threads);
+        double front = run_front(shared, keys, true, n_threads);
+        printf("%-10zu %12.1f %12.1f\n", n_threads, locked, front);
+    }
+    puts("");
+
+    delete_shared_cache(shared);
+    free(keys);
+}
+
+
+// Worst single call while cache grows from small capacity to 1M pages
+static void bench_resize(void) {
+    puts("== Resize: capacity grows 1K -> 1M while filling, then shrinks back");
+    lru_cache_t* cache = create_cache(1000);
+    char key[32];
+    double max_put = 0.0;
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_BIG_CACHE_SIZE; ++i) {
+        if (i % 1000 == 0) {
+            cache_resize(cache, i + 1000, 0);
+        }
+        sprintf(key, "key%zu", i);
+        double put_start = now_sec();
+        cached_call(cache, key, &empty_get_page);
+        double put_time = now_sec() - put_start;
+        max_put = put_time > max_put ? put_time : max_put;
+    }
+    double fill_time = now_sec() - start;
+
+    double max_resize = 0.0;
+    size_t n_calls = 0;
+    start = now_sec();
+    cache_resize(cache, 1000, 0);
+    while (true) {
+        double resize_start = now_sec();
+        bool done = cache_resize(cache, 1000, 0);
+        double resize_time = now_sec() - resize_start;
+        max_resize = resize_time > max_resize ? resize_time : max_resize;
+        ++n_calls;
+        if (done) {
+            break;
+        }
+    }
+    printf("fill %.3f s, max put %.1f us; shrink %.3f s in %zu calls, max call %.1f us\n\n",
+           fill_time, max_put * 1e6, now_sec() - start, n_calls, max_resize * 1e6);
+    delete_cache(cache);
+}
+
+
+// Loader waiting on a backend, as network or disk would
+static page_t* remote_get_page(const char* key) {
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 100000};
+    nanosleep(&delay, NULL);
+    return create_page(key, "");
+}
+
+
+static void bench_preload(void) {
+    puts("== Preload: 20000 keys, loader waits 100 us");
+    char (*keys_buf)[32] = malloc(sizeof(*keys_buf) * BENCH_N_KEYS);
+    const char** keys = malloc(sizeof(const char*) * BENCH_N_KEYS);
+    for (size_t i = 0; i < BENCH_N_KEYS; ++i) {
+        sprintf(keys_buf[i], "key %zu", i);
+        keys[i] = keys_buf[i];
+    }
+
+    lru_cache_t* cache = create_cache(BENCH_N_KEYS);
+    double start = now_sec();
+    for (size_t i = BENCH_N_KEYS; i > 0; --i) {
+        cached_call(cache, keys[i - 1], &remote_get_page);
+    }
+    printf("%-24s %8.3f s\n", "serial cached_call", now_sec() - start);
+    delete_cache(cache);
+
+    cache = create_cache(BENCH_N_KEYS);
+    start = now_sec();
+    cache_preload(cache, keys, BENCH_N_KEYS, &remote_get_page, BENCH_PRELOAD_WORKERS);
+    printf("%-24s %8.3f s\n", "preload, 32 workers", now_sec() - start);
+    delete_cache(cache);
+    puts("");
+
+    free(keys);
+    free(keys_buf);
+}
+
+
+static int compare_doubles(const void* lhs, const void* rhs) {
+    double diff = *(const double*) lhs - *(const double*) rhs;
+    return (diff > 0) - (diff < 0);
+}
+
+
+// Latency of puts that evict large pages, loading is not timed
+static void run_large_puts(const char* name, free_queue_t* queue) {
+    cache_config_t config = cache_default_config(BENCH_LARGE_N_PAGES);
+    if (queue != NULL) {
+        config.release_page = &free_queue_release;
+        config.release_arg = queue;
+    }
+    lru_cache_t* cache = create_cache_with_config(&config);
+    char* data = malloc(BENCH_LARGE_PAGE_SIZE);
+    memset(data, 'x', BENCH_LARGE_PAGE_SIZE - 1);
+    data[BENCH_LARGE_PAGE_SIZE - 1] = '\0';
+    double* latencies = malloc(sizeof(double) * BENCH_LARGE_N_PUTS);
+    char key[32];
+    for (size_t i = 0; i < BENCH_LARGE_N_PUTS; ++i) {
+        sprintf(key, "key%zu", i);
+        page_t* page = create_page(key, data);
+        double start = now_sec();
+        cache_put(cache, key, page);
+        latencies[i] = now_sec() - start;
+    }
+    qsort(latencies, BENCH_LARGE_N_PUTS, sizeof(double), &compare_doubles);
+    printf("%-12s %10.1f %10.1f %10.1f\n", name, latencies[BENCH_LARGE_N_PUTS / 2] * 1e6,
+           latencies[BENCH_LARGE_N_PUTS * 99 / 100] * 1e6, latencies[BENCH_LARGE_N_PUTS - 1] * 1e6);
+    delete_cache(cache);
+    free(latencies);
+    free(data);
+}
+
+
+static void bench_deferred_free(void) {
+    puts("== Deferred free: puts evicting 4 MB pages, us (background thread needs a spare core)");
+    printf("%-12s %10s %10s %10s\n", "release", "p50", "p99", "max");
+    run_large_puts("inline", NULL);
+    free_queue_t* queue = create_free_queue(true, BENCH_LARGE_N_PAGES);
+    run_large_puts("background", queue);
+    delete_free_queue(queue);
+    puts("");
+}
+
+
+static size_t n_backend_calls;
+
+
+// Backend has only even keys
+static page_t* sparse_get_page(const char* key) {
+    ++n_backend_calls;
+    return atoi(key) % 2 == 0 ? create_page(key, "") : NULL;
+}
+
+
+static void run_negative(const char* name, size_t max_negative, bool filter) {
+    cache_config_t config = cache_default_config(BENCH_N_KEYS);
+    config.max_negative = max_negative;
+    config.negative_filter = filter;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    n_backend_calls = 0;
+    char key[32];
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        sprintf(key, "%zu", (size_t) (rng_next(&rng) % BENCH_N_KEYS));
+        cached_call(cache, key, &sparse_get_page);
+    }
+    printf("%-22s %12zu %10.1f\n", name, n_backend_calls, (now_sec() - start) * 1e9 / BENCH_N_ITER);
+    delete_cache(cache);
+}
+
+
+static void bench_negative(void) {
+    puts("== Negative caching: uniform keys, half of them missing upstream");
+    printf("%-22s %12s %10s\n", "config", "backend", "ns/call");
+    run_negative("misses not cached", 0, false);
+    run_negative("tombstones", BENCH_N_KEYS, false);
+    run_negative("tombstones + filter", BENCH_N_KEYS, true);
+    puts("");
+}
+
+
+// Lookup latency of a full cache, keys are prepared beforehand
+static void run_key_filter(const char* name, bool key_filter, char (*keys)[32]) {
+    cache_config_t config = cache_default_config(BENCH_BIG_CACHE_SIZE);
+    config.key_filter = key_filter;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    for (size_t i = 0; i < BENCH_BIG_CACHE_SIZE; ++i) {
+        cached_call(cache, keys[i], &empty_get_page);
+    }
+    const page_t* page;
+    double times[2];
+    // Cached keys are in first half of array, never seen ones in second
+    for (size_t half = 0; half < 2; ++half) {
+        double start = now_sec();
+        for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+            cache_lookup(cache, keys[half * BENCH_BIG_CACHE_SIZE + rng_next(&rng) % BENCH_BIG_CACHE_SIZE], &page);
+        }
+        times[half] = (now_sec() - start) * 1e9 / BENCH_N_ITER;
+    }
+    printf("%-12s %10.1f %10.1f\n", name, times[0], times[1]);
+    delete_cache(cache);
+}
+
+
+static void bench_key_filter(void) {
+    puts("== Key filter: lookups in cache of 1M pages, ns");
+    char (*keys)[32] = malloc(sizeof(*keys) * BENCH_BIG_CACHE_SIZE * 2);
+    for (size_t i = 0; i < BENCH_BIG_CACHE_SIZE * 2; ++i) {
+        sprintf(keys[i], "key%zu", i);
+    }
+    printf("%-12s %10s %10s\n", "filter", "hit", "miss");
+    run_key_filter("none", false, keys);
+    run_key_filter("cuckoo", true, keys);
+    puts("");
+    free(keys);
+}
+
+
+// Loads by all worker processes, counter lives in shared mapping
+static atomic_size_t* shared_backend_loads;
+
+
+static page_t* counted_get_page(const char* key) {
+    atomic_fetch_add(shared_backend_loads, 1);
+    return create_page(key, "");
+}
+
+
+// Forks workers running zipf traces, each on its own lru_cache_t or on shared one
+static void run_shm_workers(const char* name, size_t private_size, shm_cache_t* shared) {
+    atomic_store(shared_backend_loads, 0);
+    double start = now_sec();
+    for (size_t worker = 0; worker < BENCH_SHM_WORKERS; ++worker) {
+        if (fork() == 0) {
+            workload_t* zipf = create_zipf(BENCH_N_KEYS, BENCH_ZIPF_S, BENCH_SEED + worker);
+            lru_cache_t* cache = shared == NULL ? create_cache(private_size) : NULL;
+            char key[32];
+            for (size_t i = 0; i < BENCH_N_ITER / BENCH_SHM_WORKERS; ++i) {
+                sprintf(key, "key%zu", workload_next(zipf));
+                if (shared != NULL) {
+                    shm_cached_call(shared, key, &counted_get_page);
+                } else {
+                    cached_call(cache, key, &counted_get_page);
+                }
+            }
+            _exit(EXIT_SUCCESS);
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+    printf("%-30s %12zu %10.3f\n", name, atomic_load(shared_backend_loads), now_sec() - start);
+}
+
+
+static void bench_shm(void) {
+    puts("== Shared memory cache: 16 worker processes, zipf(0.99) over 20k keys");
+    shared_backend_loads = mmap(NULL, sizeof(atomic_size_t), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    printf("%-30s %12s %10s\n", "cache", "backend", "s");
+    run_shm_workers("private, 1000 pages each", 1000, NULL);
+    shm_config_t config = shm_default_config(NULL, 1000);
+    shm_cache_t* shared = create_shm_cache(&config);
+    run_shm_workers("shared, 1000 pages", 0, shared);
+    delete_shm_cache(shared);
+    config.max_size = 1000 * BENCH_SHM_WORKERS;
+    shared = create_shm_cache(&config);
+    run_shm_workers("shared, 16000 pages", 0, shared);
+    delete_shm_cache(shared);
+    munmap(shared_backend_loads, sizeof(atomic_size_t));
+    puts("");
+}
+
+
+static void send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n_sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (n_sent <= 0) {
+            puts("send failed");
+            exit(EXIT_FAILURE);
+        }
+        data += n_sent;
+        len -= n_sent;
+    }
+}
+
+
+static void recv_all(int fd, char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n_read = recv(fd, buf, len, 0);
+        if (n_read <= 0) {
+            puts("recv failed");
+            exit(EXIT_FAILURE);
+        }
+        buf += n_read;
+        len -= n_read;
+    }
+}
+
+
+// Client sends rounds of batch keys, every key is a hit of BENCH_SERVER_VALUE bytes
+static void run_server(const char* name, int fd, size_t batch, bool multi_get) {
+    static char request[BENCH_SERVER_BATCH * 32];
+    static char response[BENCH_SERVER_BATCH * (BENCH_SERVER_VALUE + 64)];
+    size_t response_len = batch * (sizeof("VALUE key00000 0 100\r\n") - 1 + BENCH_SERVER_VALUE + 2)
+        + (multi_get ? 1 : batch) * (sizeof("END\r\n") - 1);
+    double start = now_sec();
+    for (size_t round = 0; round < BENCH_SERVER_ROUNDS; ++round) {
+        size_t len = multi_get ? (size_t) sprintf(request, "get") : 0;
+        for (size_t i = 0; i < batch; ++i) {
+            size_t key = rng_next(&rng) % BENCH_SERVER_KEYS;
+            len += multi_get ? sprintf(request + len, " key%05zu", key) : sprintf(request + len, "get key%05zu\r\n", key);
+        }
+        if (multi_get) {
+            len += sprintf(request + len, "\r\n");
+        }
+        send_all(fd, request, len);
+        recv_all(fd, response, response_len);
+    }
+    double elapsed = now_sec() - start;
+    printf("%-26s %12.0f %12.1f\n", name, BENCH_SERVER_ROUNDS * batch / elapsed, elapsed * 1e6 / BENCH_SERVER_ROUNDS);
+}
+
+
+static void bench_server(void) {
+    puts("== Cache server: memcached text protocol over loopback, 100 byte hits");
+    char dir[] = "/tmp/lru_cache_bench_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        puts("mkdtemp failed");
+        exit(EXIT_FAILURE);
+    }
+    char path[64];
+    sprintf(path, "%s/mc.sock", dir);
+    // Shards are filled unevenly, spare room keeps every key cached
+    server_config_t config = server_default_config(2 * BENCH_SERVER_KEYS);
+    config.port = 0;
+    config.unix_path = path;
+    config.n_threads = 1;
+    cache_server_t* server = create_cache_server(&config);
+    if (server == NULL) {
+        puts("server failed to listen");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_in tcp_addr = {.sin_family = AF_INET, .sin_port = htons(cache_server_port(server))};
+    inet_pton(AF_INET, "127.0.0.1", &tcp_addr.sin_addr);
+    struct sockaddr_un unix_addr = {.sun_family = AF_UNIX};
+    strcpy(unix_addr.sun_path, path);
+    int tcp = socket(AF_INET, SOCK_STREAM, 0);
+    int local = socket(AF_UNIX, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(tcp, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(tcp, (struct sockaddr*) &tcp_addr, sizeof(tcp_addr)) != 0
+        || connect(local, (struct sockaddr*) &unix_addr, sizeof(unix_addr)) != 0) {
+        puts("connect failed");
+        exit(EXIT_FAILURE);
+    }
+    char value[BENCH_SERVER_VALUE];
+    memset(value, 'v', sizeof(value));
+    for (size_t i = 0; i < BENCH_SERVER_KEYS; ++i) {
+        char header[64];
+        char stored[sizeof("STORED\r\n") - 1];
+        send_all(tcp, header, sprintf(header, "set key%05zu 0 0 %d\r\n", i, BENCH_SERVER_VALUE));
+        send_all(tcp, value, sizeof(value));
+        send_all(tcp, "\r\n", 2);
+        recv_all(tcp, stored, sizeof(stored));
+    }
+
+    printf("%-26s %12s %12s\n", "client", "keys/s", "us/round");
+    run_server("tcp, get per round trip", tcp, 1, false);
+    run_server("unix, get per round trip", local, 1, false);
+    run_server("tcp, 16 pipelined gets", tcp, BENCH_SERVER_BATCH, false);
+    run_server("tcp, get of 16 keys", tcp, BENCH_SERVER_BATCH, true);
+    run_server("unix, get of 16 keys", local, BENCH_SERVER_BATCH, true);
+    close(tcp);
+    close(local);
+    delete_cache_server(server);
+    rmdir(dir);
+    puts("");
+}
+
+
+typedef struct hot_client_t {
+    const char* path;
+    pthread_t thread;
+} hot_client_t;
+
+
+// Rounds of pipelined gets of the one hot key
+static void* run_hot_client(void* arg) {
+    hot_client_t* client = arg;
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, client->path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        puts("connect failed");
+        exit(EXIT_FAILURE);
+    }
+    char request[BENCH_SERVER_BATCH * sizeof("get hot\r\n")];
+    size_t len = 0;
+    for (size_t i = 0; i < BENCH_SERVER_BATCH; ++i) {
+        len += sprintf(request + len, "get hot\r\n");
+    }
+    static const size_t response_len = sizeof("VALUE hot 0 100\r\n") - 1 + BENCH_SERVER_VALUE + 2 + sizeof("END\r\n") - 1;
+    char response[BENCH_SERVER_BATCH * response_len];
+    for (size_t round = 0; round < BENCH_HOT_ROUNDS; ++round) {
+        send_all(fd, request, len);
+        recv_all(fd, response, sizeof(response));
+    }
+    close(fd);
+    return NULL;
+}
+
+
+static void run_hot_key(const char* name, size_t n_replicas) {
+    char dir[] = "/tmp/lru_cache_bench_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        puts("mkdtemp failed");
+        exit(EXIT_FAILURE);
+    }
+    char path[64];
+    sprintf(path, "%s/mc.sock", dir);
+    server_config_t config = server_default_config(BENCH_SERVER_KEYS);
+    config.host = NULL;
+    config.unix_path = path;
+    config.n_threads = BENCH_HOT_CLIENTS;
+    config.n_replicas = n_replicas;
+    cache_server_t* server = create_cache_server(&config);
+    if (server == NULL) {
+        puts("server failed to listen");
+        exit(EXIT_FAILURE);
+    }
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        puts("connect failed");
+        exit(EXIT_FAILURE);
+    }
+    char value[BENCH_SERVER_VALUE];
+    memset(value, 'v', sizeof(value));
+    char header[64];
+    char stored[sizeof("STORED\r\n") - 1];
+    send_all(fd, header, sprintf(header, "set hot 0 0 %d\r\n", BENCH_SERVER_VALUE));
+    send_all(fd, value, sizeof(value));
+    send_all(fd, "\r\n", 2);
+    recv_all(fd, stored, sizeof(stored));
+    close(fd);
+
+    hot_client_t clients[BENCH_HOT_CLIENTS];
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_HOT_CLIENTS; ++i) {
+        clients[i].path = path;
+        pthread_create(&clients[i].thread, NULL, &run_hot_client, &clients[i]);
+    }
+    for (size_t i = 0; i < BENCH_HOT_CLIENTS; ++i) {
+        pthread_join(clients[i].thread, NULL);
+    }
+    double elapsed = now_sec() - start;
+    size_t n_gets = BENCH_HOT_CLIENTS * BENCH_HOT_ROUNDS * BENCH_SERVER_BATCH;
+    printf("%-14s %12.0f %12.3f\n", name, n_gets / elapsed, (double) cache_server_replica_hits(server) / n_gets);
+    delete_cache_server(server);
+    rmdir(dir);
+}
+
+
+static void bench_hot_key(void) {
+    puts("== Hot key: 4 unix socket clients, 16 pipelined gets of one key, 4 server threads");
+    printf("%-14s %12s %12s\n", "replicas", "gets/s", "from copies");
+    run_hot_key("none", 0);
+    run_hot_key("256 slots", 256);
+    puts("");
+}
+
+
+static size_t rss_bytes(void) {
+    size_t size = 0;
+    size_t resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file != NULL) {
+        if (fscanf(file, "%zu %zu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(file);
+    }
+    return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+
+// Keys starting with 'l' get large pages, others small ones
+static page_t* slab_bench_get_page(const char* key) {
+    static char data[BENCH_SLAB_LARGE_PAGE];
+    size_t size = key[0] == 'l' ? BENCH_SLAB_LARGE_PAGE : BENCH_SLAB_SMALL_PAGE;
+    memset(data, key[1], size);
+    return create_page_sized(key, data, size);
+}
+
+
+static void run_slab_phase(lru_cache_t* cache, const char* phase, double large_share, size_t n_iter) {
+    cache_stats_t before = cache_stats(cache);
+    char key[32];
+    for (size_t i = 0; i < n_iter; ++i) {
+        if (rng_uniform(&rng) < large_share) {
+            sprintf(key, "l%zu", (size_t) (rng_next(&rng) % BENCH_SLAB_LARGE_KEYS));
+        } else {
+            sprintf(key, "s%zu", (size_t) (rng_next(&rng) % BENCH_SLAB_SMALL_KEYS));
+        }
+        cached_call(cache, key, &slab_bench_get_page);
+    }
+    cache_stats_t stats = cache_stats(cache);
+    printf("%-8s %-12s %10.1f %10.1f %10.1f %8.3f\n", stats.n_slab_bytes != 0 ? "slabs" : "malloc",
+           phase, stats.n_bytes / 1048576.0, rss_bytes() / 1048576.0, stats.n_slab_bytes / 1048576.0,
+           (double) (stats.hits - before.hits) / n_iter);
+}
+
+
+// Runs in its own process, so RSS is not shared with other runs
+static void run_slabs(size_t slab_size) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        cache_config_t config = cache_default_config(BENCH_SLAB_SMALL_KEYS);
+        config.max_bytes = BENCH_SLAB_BUDGET;
+        config.slab_size = slab_size;
+        lru_cache_t* cache = create_cache_with_config(&config);
+        run_slab_phase(cache, "small", 0.0, BENCH_N_ITER);
+        run_slab_phase(cache, "large", 1.0, BENCH_SLAB_LARGE_ITER);
+        run_slab_phase(cache, "small again", 0.0, BENCH_N_ITER);
+        run_slab_phase(cache, "mixed", 0.01, BENCH_N_ITER);
+        delete_cache(cache);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+
+static void count_page(const char* key, const page_t* page, void* arg) {
+    (void)key;
+    (void)page;
+    ++*(size_t*) arg;
+}
+
+
+static void run_walk(lru_cache_t* cache, const char* name, size_t step) {
+    size_t n_pages = 0;
+    size_t n_steps = 0;
+    size_t cursor = 0;
+    double max_step = 0.0;
+    double start = now_sec();
+    do {
+        double step_start = now_sec();
+        cursor = cache_scan(cache, cursor, step, &count_page, &n_pages);
+        double step_time = now_sec() - step_start;
+        max_step = step_time > max_step ? step_time : max_step;
+        ++n_steps;
+    } while (cursor != 0);
+    printf("%-14s %10zu %10zu %10.3f %12.1f\n", name, n_pages, n_steps, now_sec() - start, max_step * 1e6);
+}
+
+
+static void bench_walk(void) {
+    puts("== Walk: cursor scan of 1M cached pages, whole table at once vs short steps");
+    lru_cache_t* cache = create_cache(BENCH_BIG_CACHE_SIZE);
+    char key[32];
+    for (size_t i = 0; i < BENCH_BIG_CACHE_SIZE; ++i) {
+        sprintf(key, "key%zu", i);
+        cached_call(cache, key, &empty_get_page);
+    }
+    printf("%-14s %10s %10s %10s %12s\n", "step", "pages", "calls", "total s", "max call us");
+    run_walk(cache, "whole table", SIZE_MAX);
+    run_walk(cache, "100 pages", BENCH_WALK_STEP);
+    puts("");
+    delete_cache(cache);
+}
+
+
+static void bench_slabs(void) {
+    puts("== Slab allocator: 64 MB budget, phases of 300 B and 256 KB pages, then 1% of 256 KB ones");
+    printf("%-8s %-12s %10s %10s %10s %8s\n", "storage", "phase", "data MB", "RSS MB", "slabs MB", "hits");
+    run_slabs(0);
+    run_slabs(SLAB_DEFAULT_SIZE);
+    puts("");
+}
+
+
+// Reads go through cached_call, writes update cache like a write-through store would
+static void run_ycsb(char workload, cache_policy_t policy, double* hit_ratio, double* mops) {
+    ycsb_t* ycsb = create_ycsb(workload, BENCH_YCSB_KEYS, BENCH_SEED);
+    cache_config_t config = cache_default_config(BENCH_YCSB_CACHE_SIZE);
+    config.policy = policy;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    char key[32];
+    double start = now_sec();
+    for (size_t i = 0; i < BENCH_YCSB_N_OPS; ++i) {
+        ycsb_request_t request = ycsb_next(ycsb);
+        sprintf(key, "user%zu", request.key);
+        switch (request.op) {
+        case YCSB_READ:
+            cached_call(cache, key, &empty_get_page);
+            break;
+        case YCSB_UPDATE:
+        case YCSB_INSERT:
+            cache_put(cache, key, create_page(key, ""));
+            break;
+        case YCSB_SCAN:
+            for (size_t k = 0; k < request.scan_len; ++k) {
+                sprintf(key, "user%zu", request.key + k);
+                cached_call(cache, key, &empty_get_page);
+            }
+            break;
+        case YCSB_READ_MODIFY_WRITE:
+            cached_call(cache, key, &empty_get_page);
+            cache_put(cache, key, create_page(key, ""));
+            break;
+        }
+    }
+    double elapsed = now_sec() - start;
+    cache_stats_t stats = cache_stats(cache);
+    *hit_ratio = (double) stats.hits / (stats.hits + stats.misses);
+    *mops = BENCH_YCSB_N_OPS / elapsed * 1e-6;
+    delete_cache(cache);
+    delete_ycsb(ycsb);
+}
+
+
+static void bench_ycsb(void) {
+    puts("== YCSB core workloads: 100k keys, size 10k, read hit ratio / Mops/s (scan counts as one op)");
+    const char* policy_names[] = {"LRU", "SLRU", "2Q", "ARC", "GDSF"};
+    const cache_policy_t policies[] = {CACHE_POLICY_LRU, CACHE_POLICY_SLRU, CACHE_POLICY_2Q,
+                                       CACHE_POLICY_ARC, CACHE_POLICY_GDSF};
+    const size_t n_policies = sizeof(policies) / sizeof(policies[0]);
+    printf("%-8s", "workload");
+    for (size_t p = 0; p < n_policies; ++p) {
+        printf(" %15s", policy_names[p]);
+    }
+    puts("");
+    for (const char* workload = "ABCDEF"; *workload != '\0'; ++workload) {
+        printf("%-8c", *workload);
+        for (size_t p = 0; p < n_policies; ++p) {
+            double hit_ratio, mops;
+            run_ycsb(*workload, policies[p], &hit_ratio, &mops);
+            printf("   %.4f / %5.2f", hit_ratio, mops);
+        }
+        puts("");
+    }
+    puts("");
+}
+
+
+static void bench_trace(void) {
+    puts("== Phase breakdown of cached_call: zipf(0.99) over 1M keys, size 100k");
+    if (!trace_enabled()) {
+        puts("tracing is compiled out, run make clean && make TRACE=1 bench");
+        puts("");
+        return;
+    }
+    workload_t* zipf = create_zipf(BENCH_TRACE_KEYS, BENCH_ZIPF_S, BENCH_SEED);
+    lru_cache_t* cache = create_cache(BENCH_TRACE_CACHE_SIZE);
+    trace_reset();
+    char key[32];
+    for (size_t i = 0; i < BENCH_N_ITER; ++i) {
+        sprintf(key, "key%zu", workload_next(zipf));
+        cached_call(cache, key, &empty_get_page);
+    }
+    trace_phase_stats_t stats[TRACE_N_PHASES];
+    trace_snapshot(stats);
+    printf("%-14s %10s %10s %10s %10s %10s %12s\n", "phase", "count", "mean ns", "p50 ns", "p99 ns", "max ns", "total ms");
+    for (size_t phase = 0; phase < TRACE_N_PHASES; ++phase) {
+        if (stats[phase].count == 0) {
+            continue;
+        }
+        printf("%-14s %10zu %10.1f %10.0f %10.0f %10.0f %12.1f\n", trace_phase_name(phase), stats[phase].count,
+               stats[phase].total_ns / stats[phase].count, stats[phase].p50_ns, stats[phase].p99_ns,
+               stats[phase].max_ns, stats[phase].total_ns * 1e-6);
+    }
+    delete_cache(cache);
+    delete_workload(zipf);
+    puts("");
+}
+
+
+int main(void) {
+    rng_seed(&rng, BENCH_SEED);
+    bench_compression();
+    bench_policies();
+    bench_cost();
+    bench_compact();
+    bench_huge_pages();
+    bench_numa();
+    bench_u64();
+    bench_concurrent();
+    bench_front();
+    bench_resize();
+    bench_preload();
+    bench_deferred_free();
+    bench_negative();
+    bench_key_filter();
+    bench_shm();
+    bench_server();
+    bench_slabs();
+    bench_ycsb();
+    bench_trace();
+    bench_hot_key();
+    bench_walk();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache_server.h"
+
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-l host] [-p port] [-s unix_path] [-t threads] [-c pages] [-m megabytes] [-r replicas]\n"
+            "  -l  TCP address, default 127.0.0.1, \"none\" - no TCP\n"
+            "  -p  TCP port, default 11211\n"
+            "  -s  unix socket path\n"
+            "  -t  worker threads, default one per core\n"
+            "  -c  max number of cached pages, default 1000000\n"
+            "  -m  max megabytes of keys and values, default no limit\n"
+            "  -r  copies of hot keys served without shard lock, default 256, 0 - none\n",
+            name);
+}
+
+
+int main(int argc, char** argv) {
+    server_config_t config = server_default_config(1000000);
+    int opt;
+    while ((opt = getopt(argc, argv, "l:p:s:t:c:m:r:h")) != -1) {
+        switch (opt) {
+        case 'l':
+            config.host = strcmp(optarg, "none") ? optarg : NULL;
+            break;
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 's':
+            config.unix_path = optarg;
+            break;
+        case 't':
+            config.n_threads = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            config.cache.max_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            config.cache.max_bytes = strtoul(optarg, NULL, 10) << 20;
+            break;
+        case 'r':
+            config.n_replicas = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Workers inherit the mask, so only this thread receives the signals
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    cache_server_t* server = create_cache_server(&config);
+    if (server == NULL) {
+        fprintf(stderr, "failed to listen\n");
+        return EXIT_FAILURE;
+    }
+    if (config.host != NULL) {
+        printf("listening on %s:%d\n", config.host, cache_server_port(server));
+    }
+    if (config.unix_path != NULL) {
+        printf("listening on %s\n", config.unix_path);
+    }
+    fflush(stdout);
+
+    int received;
+    sigwait(&signals, &received);
+    delete_cache_server(server);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "async_cache.h"
+#include "util.h"
+
+
+#define N_PENDING_BUCKETS 256
+
+
+typedef struct waiter_t waiter_t;
+struct waiter_t {
+    async_callback_t callback;
+    void* arg;
+    waiter_t* next;
+};
+
+
+typedef struct pending_load_t pending_load_t;
+struct pending_load_t {
+    char* key;
+    waiter_t* waiters;
+    page_t* page;
+    pending_load_t* next_pending;  // chain in pending table
+    pending_load_t* next_queued;   // job or completion queue
+};
+
+
+struct async_cache_t {
+    lru_cache_t* cache;
+    page_t* (*get_page_slow)(const char*);
+    int event_fd;
+
+    // Owned by the loop thread
+    pending_load_t* pending[N_PENDING_BUCKETS];
+    size_t n_pending;
+
+    // Shared with workers, protected by mutex
+    pthread_mutex_t mutex;
+    pthread_cond_t has_jobs;
+    pending_load_t* jobs_head;
+    pending_load_t* jobs_tail;
+    pending_load_t* completed;
+    bool stopping;
+
+    pthread_t* workers;
+    size_t n_workers;
+};
+
+
+static void signal_completion(async_cache_t* async) {
+    uint64_t one = 1;
+    if (write(async->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        // Counter overflow is the only failure, then fd is readable anyway
+    }
+}
+
+
+static void* worker_loop(void* arg) {
+    async_cache_t* async = arg;
+    pthread_mutex_lock(&async->mutex);
+    while (true) {
+        while (async->jobs_head == NULL && !async->stopping) {
+            pthread_cond_wait(&async->has_jobs, &async->mutex);
+        }
+        if (async->stopping) {
+            break;
+        }
+        pending_load_t* load = async->jobs_head;
+        async->jobs_head = load->next_queued;
+        if (async->jobs_head == NULL) {
+            async->jobs_tail = NULL;
+        }
+        pthread_mutex_unlock(&async->mutex);
+
+        double start = now_sec();
+        page_t* page = async->get_page_slow(load->key);
+        if (page != NULL && page->cost <= 0.0) {
+            page->cost = now_sec() - start;
+        }
+
+        pthread_mutex_lock(&async->mutex);
+        load->page = page;
+        load->next_queued = async->completed;
+        async->completed = load;
+        signal_completion(async);
+    }
+    pthread_mutex_unlock(&async->mutex);
+    return NULL;
+}
+
+
+async_cache_t* create_async_cache(lru_cache_t* cache, size_t n_workers, page_t* (*get_page_slow)(const char*)) {
+    if (cache == NULL) {
+        return NULL;
+    }
+    async_cache_t* async = calloc(1, sizeof(async_cache_t));
+    if (async == NULL) {
+        puts("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    async->cache = cache;
+    async->get_page_slow = get_page_slow;
+    async->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (async->event_fd < 0) {
+        puts("eventfd failed");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&async->mutex, NULL);
+    pthread_cond_init(&async->has_jobs, NULL);
+
+    async->workers = malloc(sizeof(pthread_t) * (n_workers > 0 ? n_workers : 1));
+    if (async->workers == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n_workers; ++i) {
+        if (pthread_create(&async->workers[i], NULL, &worker_loop, async) != 0) {
+            puts("pthread_create failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    async->n_workers = n_workers;
+    return async;
+}
+
+
+static void delete_pending_load(pending_load_t* load) {
+    while (load->waiters != NULL) {
+        waiter_t* waiter = load->waiters;
+        load->waiters = waiter->next;
+        free(waiter);
+    }
+    free(load->key);
+    free(load);
+}
+
+
+void delete_async_cache(async_cache_t* async) {
+    if (async == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&async->mutex);
+    async->stopping = true;
+    pthread_cond_broadcast(&async->has_jobs);
+    pthread_mutex_unlock(&async->mutex);
+    for (size_t i = 0; i < async->n_workers; ++i) {
+        pthread_join(async->workers[i], NULL);
+    }
+
+    // Every load is in pending table, loaded pages are not in cache yet
+    for (size_t buck = 0; buck < N_PENDING_BUCKETS; ++buck) {
+        pending_load_t* load = async->pending[buck];
+        while (load != NULL) {
+            pending_load_t* next = load->next_pending;
+            delete_page(load->page);
+            delete_pending_load(load);
+            load = next;
+        }
+    }
+    pthread_mutex_destroy(&async->mutex);
+    pthread_cond_destroy(&async->has_jobs);
+    close(async->event_fd);
+    free(async->workers);
+    delete_cache(async->cache);
+    free(async);
+}
+
+
+static pending_load_t** find_pending(async_cache_t* async, const char* key) {
+    pending_load_t** link = &async->pending[key_hash(key) % N_PENDING_BUCKETS];
+    while (*link != NULL && !key_equal((*link)->key, key)) {
+        link = &(*link)->next_pending;
+    }
+    return link;
+}
+
+
+static void add_waiter(pending_load_t* load, async_callback_t callback, void* arg) {
+    waiter_t* waiter = malloc(sizeof(waiter_t));
+    if (waiter == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    waiter->callback = callback;
+    waiter->arg = arg;
+    waiter->next = load->waiters;
+    load->waiters = waiter;
+}
+
+
+bool async_cached_call(async_cache_t* async, const char* key, async_callback_t callback, void* arg) {
+    const page_t* page;
+    pending_load_t** link = find_pending(async, key);
+    if (*link != NULL) {
+        add_waiter(*link, callback, arg);
+        return false;
+    }
+    if (cache_lookup(async->cache, key, &page)) {
+        callback(key, page, arg);
+        return true;
+    }
+
+    pending_load_t* load = calloc(1, sizeof(pending_load_t));
+    if (load == NULL) {
+        puts("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    load->key = string_dup(key);
+    add_waiter(load, callback, arg);
+    *link = load;
+    ++async->n_pending;
+
+    if (async->n_workers > 0) {
+        pthread_mutex_lock(&async->mutex);
+        if (async->jobs_tail != NULL) {
+            async->jobs_tail->next_queued = load;
+        } else {
+            async->jobs_head = load;
+        }
+        async->jobs_tail = load;
+        pthread_cond_signal(&async->has_jobs);
+        pthread_mutex_unlock(&async->mutex);
+    }
+    return false;
+}
+
+
+// Inserts loaded page and notifies waiters, load should be unlinked from pending table
+static void finish_load(async_cache_t* async, pending_load_t* load) {
+    const page_t* cached = cache_put(async->cache, load->key, load->page);
+    load->page = NULL;
+    // Callbacks may touch the cache and evict cached page, waiters share a private copy
+    page_t* page = NULL;
+    if (cached != NULL) {
+        page = copy_page(cached);
+        page->cost = cached->cost;
+        page->version = cached->version;
+        page->user_flags = cached->user_flags;
+    }
+    // Waiters were prepended, call them in request order
+    waiter_t* reversed = NULL;
+    while (load->waiters != NULL) {
+        waiter_t* waiter = load->waiters;
+        load->waiters = waiter->next;
+        waiter->next = reversed;
+        reversed = waiter;
+    }
+    load->waiters = reversed;
+    for (waiter_t* waiter = load->waiters; waiter != NULL; waiter = waiter->next) {
+        waiter->callback(load->key, page, waiter->arg);
+    }
+    delete_page(page);
+    delete_pending_load(load);
+}
+
+
+bool async_cache_complete(async_cache_t* async, const char* key, page_t* page) {
+    pending_load_t** link = find_pending(async, key);
+    pending_load_t* load = *link;
+    if (load == NULL || async->n_workers > 0) {
+        // With workers pending load may be running, it is completed by worker
+        return false;
+    }
+    *link = load->next_pending;
+    --async->n_pending;
+    load->page = page;
+    finish_load(async, load);
+    return true;
+}
+
+
+size_t async_cache_dispatch(async_cache_t* async) {
+    uint64_t counter;
+    if (read(async->event_fd, &counter, sizeof(counter)) != sizeof(counter)) {
+        // Nothing signalled yet, completed list is checked anyway
+    }
+
+    pthread_mutex_lock(&async->mutex);
+    pending_load_t* completed = async->completed;
+    async->completed = NULL;
+    pthread_mutex_unlock(&async->mutex);
+
+    size_t n_completed = 0;
+    while (completed != NULL) {
+        pending_load_t* load = completed;
+        completed = load->next_queued;
+        pending_load_t** link = find_pending(async, load->key);
+        *link = load->next_pending;
+        --async->n_pending;
+        finish_load(async, load);
+        ++n_completed;
+    }
+    return n_completed;
+}
+
+
+int async_cache_fd(const async_cache_t* async) {
+    return async->event_fd;
+}
+
+
+size_t async_cache_n_pending(const async_cache_t* async) {
+    return async->n_pending;
+}
+
+
+lru_cache_t* async_cache_get_cache(async_cache_t* async) {
+    return async->cache;
+}
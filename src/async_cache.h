@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include "cache.h"
+
+// Non-blocking front end of lru_cache_t for event loops.
+// Hits complete inline. On miss the key is loaded by a worker thread (or completed by
+// caller with async_cache_complete), concurrent requests for the same key share one load.
+// Finished loads are signalled through an eventfd: register async_cache_fd() with epoll
+// and call async_cache_dispatch() when it is readable, it inserts pages into cache and
+// runs completion callbacks.
+// Except for loaders, everything runs on the thread calling async functions, so cache
+// itself needs no locking. All async functions should be called from that one thread.
+typedef struct async_cache_t async_cache_t;
+
+// Page is valid only during the callback
+typedef void (*async_callback_t)(const char*, const page_t*, void*);
+
+// Takes ownership of cache. With zero workers loads are completed by caller only.
+async_cache_t* create_async_cache(lru_cache_t*, size_t n_workers, page_t* (*)(const char*));
+// Pending callbacks are not called
+void delete_async_cache(async_cache_t*);
+
+// Returns true if page was cached and callback is already called
+bool async_cached_call(async_cache_t*, const char*, async_callback_t, void*);
+// Completes pending load with page loaded by caller. Returns false if key is not pending
+// or workers load it, page then stays owned by caller.
+bool async_cache_complete(async_cache_t*, const char*, page_t*);
+// Processes finished loads, returns number of completed keys
+size_t async_cache_dispatch(async_cache_t*);
+
+int async_cache_fd(const async_cache_t*);
+size_t async_cache_n_pending(const async_cache_t*);
+lru_cache_t* async_cache_get_cache(async_cache_t*);
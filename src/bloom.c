@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bloom.h"
+#include "util.h"
+
+
+#define N_PROBES 4
+
+
+struct bloom_t {
+    uint64_t* words;
+    size_t n_words;
+    size_t n_bits;
+    size_t n_added;
+};
+
+
+bloom_t* create_bloom(size_t capacity, size_t bits_per_item) {
+    bloom_t* bloom = malloc(sizeof(bloom_t));
+    if (bloom == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t n_bits = capacity * (bits_per_item > 0 ? bits_per_item : 1);
+    bloom->n_words = n_bits / 64 + 1;
+    bloom->n_bits = bloom->n_words * 64;
+    bloom->words = calloc(bloom->n_words, sizeof(uint64_t));
+    if (bloom->words == NULL) {
+        puts("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    bloom->n_added = 0;
+    return bloom;
+}
+
+
+void delete_bloom(bloom_t* bloom) {
+    if (bloom != NULL) {
+        free(bloom->words);
+    }
+    free(bloom);
+}
+
+
+// Probes are derived from two halves of a mixed hash (Kirsch-Mitzenmacher)
+void bloom_add(bloom_t* bloom, unsigned long hash) {
+    uint64_t mixed = hash_mix(hash);
+    uint32_t h1 = (uint32_t) mixed;
+    uint32_t h2 = (uint32_t) (mixed >> 32) | 1;
+    for (uint32_t i = 0; i < N_PROBES; ++i) {
+        size_t bit = (h1 + i * h2) % bloom->n_bits;
+        bloom->words[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    }
+    ++bloom->n_added;
+}
+
+
+bool bloom_maybe_contains(const bloom_t* bloom, unsigned long hash) {
+    uint64_t mixed = hash_mix(hash);
+    uint32_t h1 = (uint32_t) mixed;
+    uint32_t h2 = (uint32_t) (mixed >> 32) | 1;
+    for (uint32_t i = 0; i < N_PROBES; ++i) {
+        size_t bit = (h1 + i * h2) % bloom->n_bits;
+        if (!(bloom->words[bit / 64] & ((uint64_t) 1 << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void bloom_clear(bloom_t* bloom) {
+    memset(bloom->words, 0, sizeof(uint64_t) * bloom->n_words);
+    bloom->n_added = 0;
+}
+
+
+size_t bloom_n_added(const bloom_t* bloom) {
+    return bloom->n_added;
+}
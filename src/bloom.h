@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bloom filter over key hashes. Answers "maybe present" or "surely absent",
+// items cannot be removed, only the whole filter can be cleared.
+typedef struct bloom_t bloom_t;
+
+// bits_per_item 10 gives about 1% false positives at capacity
+bloom_t* create_bloom(size_t capacity, size_t bits_per_item);
+void delete_bloom(bloom_t*);
+void bloom_add(bloom_t*, unsigned long);
+bool bloom_maybe_contains(const bloom_t*, unsigned long);
+void bloom_clear(bloom_t*);
+// Number of additions since last clear
+size_t bloom_n_added(const bloom_t*);
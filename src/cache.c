@@ -1,21 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "cache.h"
+#include "util.h"
 #include "list.h"
 #include "hashtable.h"
+#include "policy.h"
+#include "lz.h"
+#include "negative.h"
+#include "cuckoo.h"
+#include "slab.h"
+#include "trace.h"
+
+
+#define DEFAULT_HOT_SET_SIZE 8
+#define DEFAULT_NEGATIVE_TTL 10.0
+#define REBALANCE_WINDOW 64  // slab evictions between rebalances
+
+
+// Decompressed copy of a compressed page
+typedef struct hot_page_t {
+    const page_t* stored;
+    page_t* plain;
+} hot_page_t;
 
 
 struct lru_cache_t {
     hashtable_t* htable;
-    list_t* list;
+    policy_t* policy;
     size_t max_size;
+    size_t max_bytes;
+    size_t compress_threshold;
+    hot_page_t* hot_set;  // most recently used first
+    size_t hot_set_size;
+    size_t hot_set_len;
+    page_release_t release_page;
+    void* release_arg;
+    evict_listener_t on_evict;
+    void* on_evict_arg;
+    negative_cache_t* negative;  // NULL if negative caching is disabled
+    cuckoo_t* key_filter;        // cached keys, NULL if disabled
+    slab_allocator_t* slabs;     // NULL if pages are not copied into slabs
+    size_t window_evictions;     // slab evictions since last rebalance
+    page_t* uncached;            // page too large for slabs returned by last put
+    cache_stats_t stats;
 };
 
 
+cache_config_t cache_default_config(size_t size) {
+    cache_config_t config = {
+        .max_size = size,
+        .max_bytes = 0,
+        .compress_threshold = 0,
+        .hot_set_size = DEFAULT_HOT_SET_SIZE,
+        .policy = CACHE_POLICY_LRU,
+        .huge_pages = false,
+        .release_page = NULL,
+        .release_arg = NULL,
+        .on_evict = NULL,
+        .on_evict_arg = NULL,
+        .max_negative = 0,
+        .negative_ttl = DEFAULT_NEGATIVE_TTL,
+        .negative_filter = false,
+        .key_filter = false,
+        .slab_size = 0,
+    };
+    return config;
+}
+
+
 lru_cache_t* create_cache(size_t size) {
-    if (size == 0) {
+    cache_config_t config = cache_default_config(size);
+    return create_cache_with_config(&config);
+}
+
+
+lru_cache_t* create_cache_with_config(const cache_config_t* config) {
+    if (config->max_size == 0) {
+        return NULL;
+    }
+    // Slab chunks are freed only by the cache, release hook could not free them
+    if (config->slab_size != 0 && (config->max_bytes == 0 || config->release_page != NULL)) {
         return NULL;
     }
     lru_cache_t* cache_ptr = malloc(sizeof(lru_cache_t));
@@ -24,48 +93,722 @@ lru_cache_t* create_cache(size_t size) {
         exit(EXIT_FAILURE);
     }
     cache_ptr->htable = create_hashtable();
-    cache_ptr->list = create_list();
-    cache_ptr->max_size = size;
+    hashtable_use_huge_pages(cache_ptr->htable, config->huge_pages);
+    cache_ptr->policy = create_policy(config->policy, config->max_size);
+    cache_ptr->max_size = config->max_size;
+    cache_ptr->max_bytes = config->max_bytes;
+    cache_ptr->compress_threshold = config->compress_threshold;
+    cache_ptr->hot_set = NULL;
+    cache_ptr->hot_set_size = 0;
+    cache_ptr->hot_set_len = 0;
+    cache_ptr->release_page = config->release_page;
+    cache_ptr->release_arg = config->release_arg;
+    cache_ptr->on_evict = config->on_evict;
+    cache_ptr->on_evict_arg = config->on_evict_arg;
+    cache_ptr->negative = NULL;
+    if (config->max_negative != 0) {
+        cache_ptr->negative = create_negative_cache(config->max_negative, config->negative_ttl,
+                                                    config->negative_filter);
+    }
+    cache_ptr->key_filter = config->key_filter ? create_cuckoo(config->max_size) : NULL;
+    cache_ptr->slabs = NULL;
+    if (config->slab_size != 0) {
+        cache_ptr->slabs = create_slab_allocator(config->max_bytes, config->slab_size);
+    }
+    cache_ptr->window_evictions = 0;
+    cache_ptr->uncached = NULL;
+    if (config->compress_threshold != 0) {
+        // At least one slot is needed to hand out decompressed page
+        cache_ptr->hot_set_size = config->hot_set_size > 0 ? config->hot_set_size : 1;
+        cache_ptr->hot_set = malloc(sizeof(hot_page_t) * cache_ptr->hot_set_size);
+        if (cache_ptr->hot_set == NULL) {
+            puts("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memset(&cache_ptr->stats, 0, sizeof(cache_stats_t));
     return cache_ptr;
 }
 
 
+static void release_page(lru_cache_t* cache, page_t* page) {
+    if (page == NULL) {
+        return;
+    }
+    TRACE_BEGIN(start);
+    if (page->inline_flags & PAGE_SLAB) {
+        slab_free(cache->slabs, page);
+    } else if (cache->release_page != NULL) {
+        cache->release_page(page, cache->release_arg);
+    } else {
+        delete_page(page);
+    }
+    TRACE_END(TRACE_DELETE_PAGE, start);
+}
+
+
+// Heap copy of page as stored, compressed data stays compressed
+static page_t* clone_stored_page(const page_t* page) {
+    size_t data_size = page->compressed_size != 0 ? page->compressed_size : page->size;
+    page_t* clone = create_page_sized(page->key, page->data, data_size);
+    clone->size = page->size;
+    clone->compressed_size = page->compressed_size;
+    clone->cost = page->cost;
+    clone->version = page->version;
+    clone->user_flags = page->user_flags;
+    return clone;
+}
+
+
+// Hands removed page to listener, releases it unless listener keeps it
+static void drop_page(lru_cache_t* cache, page_t* page, cache_removal_t reason) {
+    if (cache->on_evict != NULL && page != NULL) {
+        if (page->inline_flags & PAGE_SLAB) {
+            // Chunk is reused right away, listener gets a copy
+            page_t* copy = clone_stored_page(page);
+            release_page(cache, page);
+            page = copy;
+        }
+        if (cache->on_evict(page, reason, cache->on_evict_arg)) {
+            return;
+        }
+    }
+    release_page(cache, page);
+}
+
+
 void delete_cache(lru_cache_t* cache) {
     if (cache != NULL) {
         delete_hashtable(cache->htable);
-        while (!is_list_empty(cache->list)) {
-            page_t* page = list_back(cache->list);
-            delete_page(page);
-            list_pop_back(cache->list);
+        while (policy_length(cache->policy) != 0) {
+            release_page(cache, policy_evict(cache->policy));
         }
-        delete_list(cache->list);
+        delete_policy(cache->policy);
+        for (size_t i = 0; i < cache->hot_set_len; ++i) {
+            release_page(cache, cache->hot_set[i].plain);
+        }
+        free(cache->hot_set);
+        release_page(cache, cache->uncached);
+        delete_negative_cache(cache->negative);
+        delete_cuckoo(cache->key_filter);
+        delete_slab_allocator(cache->slabs);
     }
     free(cache);
 }
 
 
-const page_t* cached_call(lru_cache_t* cache, const char* key, page_t* (*get_page_slow)(const char*)) {
-    list_node_t* node = hashtable_get(cache->htable, key);
-    page_t* page;
-    if (node == NULL) {
-        page = get_page_slow(key);
-        if (list_length(cache->list) == cache->max_size) {
-            page_t* del_page = list_back(cache->list);
-            list_pop_back(cache->list);
-            hashtable_delete_entry(cache->htable, del_page->key);
-            delete_page(del_page);
-        }
-        list_node_t* new_node = list_push_front(cache->list, page);
-        hashtable_put(cache->htable, key, new_node);
+static size_t raw_bytes(const page_t* page) {
+    if (page == NULL) {
+        return 0;
+    }
+    return strlen(page->key) + page->size;
+}
+
+
+// Returns compressed copy of the page or NULL if compression does not pay off
+static page_t* compress_page(const page_t* page) {
+    char* data = malloc(page->size);
+    if (data == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t compressed_size = lz_compress(page->data, page->size, data, page->size - 1);
+    if (compressed_size == 0) {
+        free(data);
+        return NULL;
+    }
+
+    page_t* stored = malloc(sizeof(page_t));
+    if (stored == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    char* shrunk_data = realloc(data, compressed_size);
+    stored->key = string_dup(page->key);
+    stored->data = shrunk_data != NULL ? shrunk_data : data;
+    stored->size = page->size;
+    stored->compressed_size = compressed_size;
+    stored->cost = page->cost;
+    stored->version = page->version;
+    stored->user_flags = page->user_flags;
+    stored->inline_flags = 0;
+    return stored;
+}
+
+
+static page_t* decompress_page(const page_t* stored) {
+    page_t* page = malloc(sizeof(page_t));
+    char* data = malloc(stored->size + 1);
+    if (page == NULL || data == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t size = lz_decompress(stored->data, stored->compressed_size, data, stored->size);
+    if (size != stored->size) {
+        puts("corrupted compressed page");
+        exit(EXIT_FAILURE);
+    }
+    data[size] = '\0';
+    page->key = string_dup(stored->key);
+    page->data = data;
+    page->size = size;
+    page->compressed_size = 0;
+    page->cost = stored->cost;
+    page->version = stored->version;
+    page->user_flags = stored->user_flags;
+    page->inline_flags = 0;
+    return page;
+}
+
+
+static void hot_set_add(lru_cache_t* cache, const page_t* stored, page_t* plain) {
+    if (cache->hot_set_len == cache->hot_set_size) {
+        --cache->hot_set_len;
+        release_page(cache, cache->hot_set[cache->hot_set_len].plain);
+    }
+    memmove(&cache->hot_set[1], &cache->hot_set[0], sizeof(hot_page_t) * cache->hot_set_len);
+    cache->hot_set[0].stored = stored;
+    cache->hot_set[0].plain = plain;
+    ++cache->hot_set_len;
+}
+
+
+static page_t* hot_set_get(lru_cache_t* cache, const page_t* stored) {
+    for (size_t i = 0; i < cache->hot_set_len; ++i) {
+        if (cache->hot_set[i].stored == stored) {
+            hot_page_t hot_page = cache->hot_set[i];
+            memmove(&cache->hot_set[1], &cache->hot_set[0], sizeof(hot_page_t) * i);
+            cache->hot_set[0] = hot_page;
+            return hot_page.plain;
+        }
+    }
+    ++cache->stats.decompressions;
+    page_t* plain = decompress_page(stored);
+    hot_set_add(cache, stored, plain);
+    return plain;
+}
+
+
+static void hot_set_drop(lru_cache_t* cache, const page_t* stored) {
+    for (size_t i = 0; i < cache->hot_set_len; ++i) {
+        if (cache->hot_set[i].stored == stored) {
+            release_page(cache, cache->hot_set[i].plain);
+            --cache->hot_set_len;
+            memmove(&cache->hot_set[i], &cache->hot_set[i + 1], sizeof(hot_page_t) * (cache->hot_set_len - i));
+            return;
+        }
+    }
+}
+
+
+static void account_page(lru_cache_t* cache, const page_t* page) {
+    cache->stats.n_bytes += page_stored_size(page);
+    cache->stats.n_raw_bytes += raw_bytes(page);
+    if (page != NULL && page->compressed_size != 0) {
+        ++cache->stats.n_compressed;
+    }
+}
+
+
+static void unaccount_page(lru_cache_t* cache, const page_t* page) {
+    cache->stats.n_bytes -= page_stored_size(page);
+    cache->stats.n_raw_bytes -= raw_bytes(page);
+    if (page != NULL && page->compressed_size != 0) {
+        --cache->stats.n_compressed;
+    }
+}
+
+
+typedef struct filter_rebuild_t {
+    cuckoo_t* filter;
+    bool failed;
+} filter_rebuild_t;
+
+
+static void add_filter_key(const char* key, list_node_t* node, void* arg) {
+    (void)node;
+    filter_rebuild_t* rebuild = arg;
+    rebuild->failed |= !cuckoo_add(rebuild->filter, key_hash(key));
+}
+
+
+static void rebuild_key_filter(lru_cache_t* cache, size_t capacity) {
+    filter_rebuild_t rebuild = {NULL, true};
+    for (; rebuild.failed; capacity *= 2) {
+        delete_cuckoo(rebuild.filter);
+        rebuild.filter = create_cuckoo(capacity);
+        rebuild.failed = false;
+        hashtable_for_each(cache->htable, &add_filter_key, &rebuild);
+    }
+    delete_cuckoo(cache->key_filter);
+    cache->key_filter = rebuild.filter;
+}
+
+
+// Call after key is put into table
+static void key_filter_add(lru_cache_t* cache, const char* key) {
+    if (cache->key_filter != NULL && !cuckoo_add(cache->key_filter, key_hash(key))) {
+        rebuild_key_filter(cache, cuckoo_capacity(cache->key_filter) * 2);
+    }
+}
+
+
+static void key_filter_remove(lru_cache_t* cache, const char* key) {
+    if (cache->key_filter != NULL) {
+        cuckoo_remove(cache->key_filter, key_hash(key));
+    }
+}
+
+
+static bool surely_absent(const lru_cache_t* cache, const char* key) {
+    return cache->key_filter != NULL && !cuckoo_maybe_contains(cache->key_filter, key_hash(key));
+}
+
+
+// Completes eviction of page already taken out of policy
+static void forget_evicted(lru_cache_t* cache, page_t* del_page) {
+    hashtable_delete_entry(cache->htable, del_page->key);
+    key_filter_remove(cache, del_page->key);
+    unaccount_page(cache, del_page);
+    if (del_page->compressed_size != 0) {
+        hot_set_drop(cache, del_page);
+    }
+    ++cache->stats.evictions;
+    drop_page(cache, del_page, CACHE_EVICTED);
+}
+
+
+static void evict_page(lru_cache_t* cache) {
+    TRACE_BEGIN(start);
+    forget_evicted(cache, policy_evict(cache->policy));
+    TRACE_END(TRACE_EVICT, start);
+}
+
+
+// Evicts page of slab chunk, slab_evict_t for slabs taken away from their class
+static void evict_chunk(void* chunk, void* arg) {
+    lru_cache_t* cache = arg;
+    page_t* page = chunk;
+    policy_remove(cache->policy, hashtable_get(cache->htable, page->key));
+    forget_evicted(cache, page);
+}
+
+
+// Copy of page in slab chunk, NULL if page is larger than any chunk. Room is made in
+// size class of the page: its least recently used page is evicted, or the class gets
+// a slab from another one if it has none.
+static page_t* store_in_slab(lru_cache_t* cache, const page_t* page) {
+    size_t key_len = strlen(page->key);
+    size_t data_len = page->compressed_size != 0 ? page->compressed_size : page->size;
+    size_t size = sizeof(page_t) + key_len + data_len + 2;
+    if (size > slab_max_alloc(cache->slabs)) {
+        return NULL;
+    }
+    page_t* stored;
+    while ((stored = slab_alloc(cache->slabs, size)) == NULL) {
+        void* victim = slab_victim(cache->slabs, size);
+        if (victim == NULL) {
+            if (!slab_move_to(cache->slabs, size, &evict_chunk, cache)) {
+                return NULL;
+            }
+            continue;
+        }
+        evict_chunk(victim, cache);
+        if (++cache->window_evictions == REBALANCE_WINDOW) {
+            cache->window_evictions = 0;
+            slab_rebalance(cache->slabs, &evict_chunk, cache);
+        }
+    }
+    *stored = *page;
+    stored->key = stored->inline_buf;
+    memcpy(stored->key, page->key, key_len + 1);
+    stored->data = stored->inline_buf + key_len + 1;
+    memcpy(stored->data, page->data, data_len);
+    stored->data[data_len] = '\0';
+    stored->inline_flags = PAGE_KEY_INLINE | PAGE_DATA_INLINE | PAGE_SLAB;
+    return stored;
+}
+
+
+static bool is_full(const lru_cache_t* cache, size_t n_new_bytes) {
+    if (policy_length(cache->policy) >= cache->max_size) {
+        return true;
+    }
+    // Slabs make room for bytes within size class of the page
+    return cache->max_bytes != 0 && cache->slabs == NULL && cache->stats.n_bytes + n_new_bytes > cache->max_bytes;
+}
+
+
+// True when cache holds more than its capacity, possible after it was shrunk
+static bool is_over_capacity(const lru_cache_t* cache) {
+    if (policy_length(cache->policy) > cache->max_size) {
+        return true;
+    }
+    if (cache->slabs != NULL) {
+        return slab_over_budget(cache->slabs);
+    }
+    return cache->max_bytes != 0 && cache->stats.n_bytes > cache->max_bytes;
+}
+
+
+// Evicts up to n pages exceeding capacity, returns true when cache fits
+static bool trim(lru_cache_t* cache, size_t n) {
+    for (size_t i = 0; i < n && is_over_capacity(cache); ++i) {
+        if (cache->slabs != NULL && policy_length(cache->policy) <= cache->max_size) {
+            slab_shrink(cache->slabs, &evict_chunk, cache);
+        } else {
+            evict_page(cache);
+        }
+    }
+    return !is_over_capacity(cache);
+}
+
+
+// Removes page from cache without counting it as eviction
+static void remove_node(lru_cache_t* cache, list_node_t* node) {
+    page_t* page = list_node_get_page(node);
+    policy_remove(cache->policy, node);
+    hashtable_delete_entry(cache->htable, page->key);
+    key_filter_remove(cache, page->key);
+    unaccount_page(cache, page);
+    if (page->compressed_size != 0) {
+        hot_set_drop(cache, page);
+    }
+    drop_page(cache, page, CACHE_REPLACED);
+}
+
+
+static bool has_tombstone(const lru_cache_t* cache, const char* key) {
+    double expires;
+    return negative_cache_find(cache->negative, key, &expires) && expires > now_sec();
+}
+
+
+// Misses rejected by key filter skip the table
+static list_node_t* find_node(lru_cache_t* cache, const char* key) {
+    if (surely_absent(cache, key)) {
+        ++cache->stats.filtered_misses;
+        return NULL;
+    }
+    return hashtable_get(cache->htable, key);
+}
+
+
+static bool negative_hit(lru_cache_t* cache, const page_t** page_ptr) {
+    ++cache->stats.hits;
+    ++cache->stats.negative_hits;
+    *page_ptr = NULL;
+    return true;
+}
+
+
+static bool node_hit(lru_cache_t* cache, list_node_t* node, const page_t** page_ptr) {
+    ++cache->stats.hits;
+    page_t* page = list_node_get_page(node);
+    TRACE_BEGIN(splice_start);
+    policy_touch(cache->policy, node);
+    TRACE_END(TRACE_SPLICE, splice_start);
+    if (page != NULL) {
+        cache->stats.saved_loader_time += page->cost;
+    }
+    if (cache->slabs != NULL) {
+        slab_touch(cache->slabs, page);
+    }
+    if (page != NULL && page->compressed_size != 0) {
+        page = hot_set_get(cache, page);
+    }
+    *page_ptr = page;
+    return true;
+}
+
+
+bool cache_lookup(lru_cache_t* cache, const char* key, const page_t** page_ptr) {
+    // Key is never both cached and tombstoned. Filter is cheap enough to go first,
+    // without it tombstones are checked only after table miss.
+    list_node_t* node;
+    if (cache->negative != NULL && negative_cache_has_filter(cache->negative)) {
+        if (has_tombstone(cache, key)) {
+            return negative_hit(cache, page_ptr);
+        }
+        node = find_node(cache, key);
     } else {
-        page = list_node_get_page(node);
-        list_move_upfront(cache->list, node);
+        node = find_node(cache, key);
+        if (node == NULL && cache->negative != NULL && has_tombstone(cache, key)) {
+            return negative_hit(cache, page_ptr);
+        }
+    }
+    if (node == NULL) {
+        ++cache->stats.misses;
+        return false;
+    }
+    return node_hit(cache, node, page_ptr);
+}
+
+
+// Cached node of key without touching stats, NULL if key is not cached
+static list_node_t* peek_node(const lru_cache_t* cache, const char* key) {
+    return surely_absent(cache, key) ? NULL : hashtable_get(cache->htable, key);
+}
+
+
+// Put with node of key already looked up, NULL if key is not cached
+static const page_t* put_page(lru_cache_t* cache, const char* key, list_node_t* node, page_t* page) {
+    release_page(cache, cache->uncached);
+    cache->uncached = NULL;
+    if (node != NULL) {
+        remove_node(cache, node);
+    }
+    if (page == NULL) {
+        // Tombstones live apart from pages, so they can not push pages out
+        if (cache->negative != NULL) {
+            negative_cache_add(cache->negative, key, now_sec());
+        }
+        return NULL;
+    }
+    if (cache->negative != NULL) {
+        negative_cache_remove(cache->negative, key);
+    }
+    policy_miss(cache->policy, key);
+    cache->stats.loader_time += page->cost;
+
+    page_t* stored = page;
+    if (cache->compress_threshold != 0 && page->size > cache->compress_threshold) {
+        page_t* compressed = compress_page(page);
+        if (compressed != NULL) {
+            stored = compressed;
+        }
+    }
+
+    // Excess left by shrinking is evicted gradually, not on a single put
+    size_t n_bytes = page_stored_size(stored);
+    trim(cache, CACHE_RESIZE_STEP);
+    while (policy_length(cache->policy) != 0 && is_full(cache, n_bytes) && !is_over_capacity(cache)) {
+        evict_page(cache);
+    }
+    if (cache->slabs != NULL) {
+        page_t* slab_page = store_in_slab(cache, stored);
+        if (stored != page) {
+            delete_page(stored);
+        }
+        if (slab_page == NULL) {
+            // Returned page has to stay valid until the next call
+            ++cache->stats.too_large;
+            cache->uncached = page;
+            return page;
+        }
+        if (stored == page) {
+            release_page(cache, page);
+            page = slab_page;
+        }
+        stored = slab_page;
+    }
+    list_node_t* new_node = policy_insert(cache->policy, key, stored);
+    hashtable_put(cache->htable, key, new_node);
+    key_filter_add(cache, key);
+    account_page(cache, stored);
+    if (stored != page) {
+        // Loader result is already decompressed, keep it for the next access
+        hot_set_add(cache, stored, page);
+    }
+    return page;
+}
+
+
+const page_t* cache_put(lru_cache_t* cache, const char* key, page_t* page) {
+    return put_page(cache, key, peek_node(cache, key), page);
+}
+
+
+const page_t* cached_call(lru_cache_t* cache, const char* key, page_t* (*get_page_slow)(const char*)) {
+    TRACE_BEGIN(call_start);
+    const page_t* page;
+    if (cache_lookup(cache, key, &page)) {
+        TRACE_END(TRACE_CALL, call_start);
+        return page;
     }
+    double start = now_sec();
+    TRACE_BEGIN(loader_start);
+    page_t* loaded_page = get_page_slow(key);
+    TRACE_END(TRACE_LOADER, loader_start);
+    if (loaded_page != NULL && loaded_page->cost <= 0.0) {
+        loaded_page->cost = now_sec() - start;
+    }
+    page = cache_put(cache, key, loaded_page);
+    TRACE_END(TRACE_CALL, call_start);
     return page;
-    
+}
+
+
+// Version of cached page, 0 if key is not cached
+static unsigned long node_version(list_node_t* node) {
+    return node != NULL ? list_node_get_page(node)->version : 0;
+}
+
+
+static bool reject_put(lru_cache_t* cache, page_t* page) {
+    ++cache->stats.rejected_puts;
+    release_page(cache, page);
+    return false;
+}
+
+
+bool cache_put_if_version(lru_cache_t* cache, const char* key, page_t* page) {
+    list_node_t* node = peek_node(cache, key);
+    if (page != NULL && node != NULL && page->version <= node_version(node)) {
+        return reject_put(cache, page);
+    }
+    put_page(cache, key, node, page);
+    return true;
+}
+
+
+bool cache_cas(lru_cache_t* cache, const char* key, unsigned long expected, page_t* page) {
+    list_node_t* node = peek_node(cache, key);
+    if (node_version(node) != expected) {
+        return reject_put(cache, page);
+    }
+    put_page(cache, key, node, page);
+    return true;
+}
+
+
+const page_t* cache_revalidate(lru_cache_t* cache, const char* key, revalidate_t revalidate) {
+    list_node_t* node = peek_node(cache, key);
+    page_t* page = NULL;
+    double start = now_sec();
+    if (!revalidate(key, node_version(node), &page)) {
+        const page_t* cached = NULL;
+        if (node != NULL) {
+            ++cache->stats.not_modified;
+            node_hit(cache, node, &cached);
+        } else if (cache->negative != NULL && has_tombstone(cache, key)) {
+            negative_hit(cache, &cached);
+        } else {
+            ++cache->stats.misses;
+        }
+        return cached;
+    }
+    if (page != NULL && page->cost <= 0.0) {
+        page->cost = now_sec() - start;
+    }
+    return put_page(cache, key, node, page);
+}
+
+
+bool cache_resize(lru_cache_t* cache, size_t max_size, size_t max_bytes) {
+    if (max_size == 0) {
+        max_size = 1;
+    }
+    if (max_size != cache->max_size) {
+        policy_resize(cache->policy, max_size);
+    }
+    if (max_size < cache->max_size) {
+        // Table sized for the old capacity shrinks as excess pages are evicted
+        hashtable_limit_reserve(cache->htable, max_size);
+    }
+    cache->max_size = max_size;
+    cache->max_bytes = max_bytes;
+    if (cache->slabs != NULL) {
+        slab_set_max_bytes(cache->slabs, max_bytes);
+    }
+    if (cache->key_filter != NULL && max_size > cuckoo_capacity(cache->key_filter)) {
+        rebuild_key_filter(cache, max_size);
+    }
+    return trim(cache, CACHE_RESIZE_STEP);
+}
+
+
+void cache_reserve(lru_cache_t* cache, size_t n_pages) {
+    hashtable_reserve(cache->htable, n_pages);
+}
+
+
+bool cache_contains(const lru_cache_t* cache, const char* key) {
+    return peek_node(cache, key) != NULL;
+}
+
+
+bool cache_touch(lru_cache_t* cache, const char* key) {
+    list_node_t* node = peek_node(cache, key);
+    if (node == NULL) {
+        return false;
+    }
+    policy_touch(cache->policy, node);
+    if (cache->slabs != NULL) {
+        slab_touch(cache->slabs, list_node_get_page(node));
+    }
+    return true;
+}
+
+
+void cache_stats_add(cache_stats_t* total, const cache_stats_t* stats) {
+    total->hits += stats->hits;
+    total->misses += stats->misses;
+    total->evictions += stats->evictions;
+    total->n_bytes += stats->n_bytes;
+    total->n_raw_bytes += stats->n_raw_bytes;
+    total->n_compressed += stats->n_compressed;
+    total->decompressions += stats->decompressions;
+    total->arc_target += stats->arc_target;
+    total->loader_time += stats->loader_time;
+    total->saved_loader_time += stats->saved_loader_time;
+    total->negative_hits += stats->negative_hits;
+    total->n_negative += stats->n_negative;
+    total->filtered_misses += stats->filtered_misses;
+    total->rejected_puts += stats->rejected_puts;
+    total->not_modified += stats->not_modified;
+    total->n_slab_bytes += stats->n_slab_bytes;
+    total->n_chunk_bytes += stats->n_chunk_bytes;
+    total->slab_moves += stats->slab_moves;
+    total->too_large += stats->too_large;
+}
+
+
+typedef struct scan_call_t {
+    cache_scan_t func;
+    void* arg;
+} scan_call_t;
+
+
+static void scan_node(const char* key, list_node_t* node, void* arg) {
+    scan_call_t* call = arg;
+    const page_t* page = list_node_get_page(node);
+    if (page != NULL) {
+        call->func(key, page, call->arg);
+    }
+}
+
+
+size_t cache_scan(const lru_cache_t* cache, size_t cursor, size_t count, cache_scan_t func, void* arg) {
+    scan_call_t call = {func, arg};
+    return hashtable_scan(cache->htable, cursor, count, &scan_node, &call);
+}
+
+
+size_t cache_max_size(const lru_cache_t* cache) {
+    return cache->max_size;
+}
+
+
+size_t cache_max_bytes(const lru_cache_t* cache) {
+    return cache->max_bytes;
 }
 
 
 size_t cache_length(const lru_cache_t* cache) {
-    return list_length(cache->list);
+    return policy_length(cache->policy);
+}
+
+
+cache_stats_t cache_stats(const lru_cache_t* cache) {
+    cache_stats_t stats = cache->stats;
+    stats.arc_target = policy_target(cache->policy);
+    stats.n_negative = cache->negative != NULL ? negative_cache_length(cache->negative) : 0;
+    if (cache->slabs != NULL) {
+        slab_stats_t slab = slab_stats(cache->slabs);
+        stats.n_slab_bytes = slab.n_slab_bytes;
+        stats.n_chunk_bytes = slab.n_chunk_bytes;
+        stats.slab_moves = slab.n_moves;
+    }
+    return stats;
 }
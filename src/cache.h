@@ -4,9 +4,118 @@
 
 typedef struct lru_cache_t lru_cache_t;
 
+#define CACHE_RESIZE_STEP 64
+
+typedef enum cache_policy_t {
+    CACHE_POLICY_LRU,
+    CACHE_POLICY_SLRU,  // segmented LRU: probationary and protected segments
+    CACHE_POLICY_2Q,    // FIFO for new pages, LRU for pages seen again after eviction
+    CACHE_POLICY_ARC,   // adaptive replacement cache, balances recency and frequency
+    CACHE_POLICY_GDSF,  // greedy dual size frequency, keeps pages expensive to load
+} cache_policy_t;
+
+// Receives every page cache lets go of instead of delete_page, must free it eventually
+typedef void (*page_release_t)(page_t*, void*);
+
+typedef enum cache_removal_t {
+    CACHE_EVICTED,   // to make room for another page
+    CACHE_REPLACED,  // cache_put with the same key
+} cache_removal_t;
+
+// Called with page just removed from cache, as stored (compressed if compressed_size != 0).
+// Returns true to take ownership of page, otherwise page is released. Not called by delete_cache.
+typedef bool (*evict_listener_t)(page_t*, cache_removal_t, void*);
+
+typedef struct cache_config_t {
+    size_t max_size;            // max number of cached pages
+    size_t max_bytes;           // max accounted bytes (key + stored data), 0 - no limit
+    size_t compress_threshold;  // data longer than this is stored compressed, 0 - no compression
+    size_t hot_set_size;        // number of decompressed pages kept for repeated access
+    cache_policy_t policy;
+    bool huge_pages;            // back hash table buckets with 2 MB pages when possible
+    page_release_t release_page;  // NULL - pages are deleted right away
+    void* release_arg;
+    evict_listener_t on_evict;    // NULL - no listener
+    void* on_evict_arg;
+    // Loader returning NULL leaves tombstone, later calls return NULL without loading
+    size_t max_negative;          // max number of tombstones, 0 - NULL results are not cached
+    double negative_ttl;          // seconds
+    bool negative_filter;         // Bloom filter in front of tombstones
+    bool key_filter;              // cuckoo filter of cached keys, most misses skip the table
+    // Pages are copied into slabs of this size, max_bytes then limits memory of slabs.
+    // 0 - pages stay where loader allocated them. Needs max_bytes and no release_page.
+    size_t slab_size;
+} cache_config_t;
+
+typedef struct cache_stats_t {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t n_bytes;          // accounted bytes of cached pages
+    size_t n_raw_bytes;      // same pages, as if stored uncompressed
+    size_t n_compressed;     // pages stored compressed
+    size_t decompressions;   // hot set misses on compressed pages
+    size_t arc_target;       // ARC adaptive target for number of recently used pages
+    double loader_time;      // seconds spent in loader (sum of costs of loaded pages)
+    double saved_loader_time;  // seconds saved by hits (sum of costs of hit pages)
+    size_t negative_hits;    // hits on tombstones, included in hits
+    size_t n_negative;       // tombstones, expired ones are counted until reclaimed
+    size_t filtered_misses;  // misses answered by key filter, included in misses
+    size_t rejected_puts;    // conditional puts lost to version of cached page
+    size_t not_modified;     // revalidations that kept cached page
+    size_t n_slab_bytes;     // memory taken for slabs, n_bytes is logical size of what it holds
+    size_t n_chunk_bytes;    // slab chunks holding pages, excess over n_bytes is page headers and rounding
+    size_t slab_moves;       // slabs moved between size classes
+    size_t too_large;        // pages larger than slab chunk, returned but not cached
+} cache_stats_t;
+
+cache_config_t cache_default_config(size_t size);
+
 lru_cache_t* create_cache(size_t size);
+lru_cache_t* create_cache_with_config(const cache_config_t*);
 void delete_cache(lru_cache_t*);
+// Returned page is valid until the next call on the same cache
 const page_t* cached_call(lru_cache_t*, const char*, page_t* (*)(const char*));
+// Lower level parts of cached_call for callers loading pages themselves.
+// Lookup returns false on miss, put takes ownership of page and replaces cached one.
+// NULL page is cached as tombstone if negative caching is enabled, otherwise only
+// removes cached page.
+bool cache_lookup(lru_cache_t*, const char*, const page_t**);
+const page_t* cache_put(lru_cache_t*, const char*, page_t*);
+// Versioned updates, page versions come from page_t.version and absent key has version 0.
+// Both take ownership of page and return true if it was stored, NULL page removes the key
+// (put regardless of cached version, cas only if it matches). Put stores page only if
+// it is newer than cached one, so racing refreshes keep the newest.
+bool cache_put_if_version(lru_cache_t*, const char*, page_t*);
+// Stores page only if cached version equals expected
+bool cache_cas(lru_cache_t*, const char*, unsigned long expected, page_t*);
+// Conditional loader, gets version of cached page (0 - not cached). Returns false if that
+// version is still current, otherwise sets page to the new one (NULL - key does not exist).
+// It must not call the cache.
+typedef bool (*revalidate_t)(const char*, unsigned long, page_t**);
+// Calls loader even for cached key, unchanged page is kept without transferring it again
+const page_t* cache_revalidate(lru_cache_t*, const char*, revalidate_t);
+// Changes capacity at runtime, max_bytes 0 - no limit. Shrinking evicts at most
+// CACHE_RESIZE_STEP pages per call, puts and further calls evict the rest in steps
+// of the same size. Returns true when cache fits new capacity.
+bool cache_resize(lru_cache_t*, size_t max_size, size_t max_bytes);
+// Sizes hash table for n pages at once instead of growing it page by page
+void cache_reserve(lru_cache_t*, size_t);
+// Cursor-based walk over cached pages, like Redis SCAN: start with cursor 0 and pass
+// returned cursor to the next call until it returns 0. Each call sees about count pages,
+// so cache operations may run between short steps. Pages cached for the whole walk are
+// seen at least once, pages moved by table resize in between may be seen twice. Pages
+// are passed as stored (compressed if compressed_size != 0), recency and stats are not
+// touched, and the callback must not modify the cache.
+typedef void (*cache_scan_t)(const char*, const page_t*, void*);
+size_t cache_scan(const lru_cache_t*, size_t cursor, size_t count, cache_scan_t, void*);
+// Checks presence without touching recency or stats
+bool cache_contains(const lru_cache_t*, const char*);
+// Marks cached key most recently used without counting a hit, false if not cached
+bool cache_touch(lru_cache_t*, const char*);
+size_t cache_max_size(const lru_cache_t*);
+size_t cache_max_bytes(const lru_cache_t*);
 size_t cache_length(const lru_cache_t*);
-
-
+cache_stats_t cache_stats(const lru_cache_t*);
+// Adds stats of one cache to a total over several, e.g. shards
+void cache_stats_add(cache_stats_t* total, const cache_stats_t*);
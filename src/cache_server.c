@@ -0,0 +1,706 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "cache_server.h"
+#include "util.h"
+#include "ebr.h"
+#include "hot_keys.h"
+#include "mc_protocol.h"
+
+
+#define MAX_EVENTS 64
+#define SHARDS_PER_THREAD 4
+#define DEFAULT_REPLICAS 256
+#define HOT_KEY_WIDTH 4096     // counters per sketch row
+#define HOT_KEY_WINDOW 16384   // gets of a worker between halvings of its sketch
+#define HOT_KEY_SHARE 0.01     // of gets of a worker, makes key hot
+#define REPLICA_REFRESH 64     // every so many gets of a copy go to the original instead
+#define INITIAL_BUFFER_SIZE 16384
+#define MAX_IN_BUFFER_SIZE (MC_MAX_LINE + MC_MAX_VALUE + 2)
+#define MAX_IOV 64
+#define SCRATCH_SIZE 8192
+#define MAX_HEADER_LEN (MC_MAX_KEY_LEN + 64)  // "VALUE <key> <flags> <bytes> <cas>\r\n"
+
+static const char CRLF[] = "\r\n";
+static const char END[] = "END\r\n";
+static const char STORED[] = "STORED\r\n";
+static const char NOT_STORED[] = "NOT_STORED\r\n";
+static const char EXISTS[] = "EXISTS\r\n";
+static const char NOT_FOUND[] = "NOT_FOUND\r\n";
+static const char DELETED[] = "DELETED\r\n";
+static const char VERSION[] = "VERSION lru_cache 1.0\r\n";
+
+
+// First member of everything registered in epoll, tells what event is about
+typedef enum socket_kind_t {
+    SOCKET_LISTENER,
+    SOCKET_CONNECTION,
+    SOCKET_STOP,
+} socket_kind_t;
+
+
+typedef struct listener_t {
+    socket_kind_t kind;
+    int fd;
+} listener_t;
+
+
+typedef struct connection_t connection_t;
+
+struct connection_t {
+    socket_kind_t kind;
+    int fd;
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+    char* out;         // response bytes socket did not take yet
+    size_t out_pos;
+    size_t out_len;
+    size_t out_cap;
+    bool want_write;   // registered for EPOLLOUT
+    bool closing;      // close once out is written
+    connection_t* prev;
+    connection_t* next;
+};
+
+
+typedef struct shard_t {
+    pthread_mutex_t mutex;
+    lru_cache_t* cache;
+} shard_t;
+
+
+typedef struct worker_t {
+    cache_server_t* server;
+    pthread_t thread;
+    int epoll_fd;
+    listener_t stop;  // eventfd
+    connection_t* connections;
+    // Responses of current connection not written yet, headers are kept in scratch
+    struct iovec iov[MAX_IOV];
+    size_t n_iov;
+    char scratch[SCRATCH_SIZE];
+    size_t scratch_len;
+    hot_key_sketch_t* hot_keys;
+    size_t n_replica_found;
+    atomic_size_t replica_hits;  // written by worker only
+} worker_t;
+
+
+struct cache_server_t {
+    listener_t listeners[2];
+    size_t n_listeners;
+    int port;
+    char* unix_path;
+    shard_t* shards;
+    size_t n_shards;
+    worker_t* workers;
+    size_t n_workers;
+    ebr_t* ebr;
+    replica_table_t* replicas;  // NULL - no replication
+    atomic_ulong last_cas;
+};
+
+
+server_config_t server_default_config(size_t max_size) {
+    server_config_t config = {
+        .host = "127.0.0.1",
+        .port = 11211,
+        .unix_path = NULL,
+        .n_threads = 0,
+        .n_shards = 0,
+        .n_replicas = DEFAULT_REPLICAS,
+        .cache = cache_default_config(max_size),
+    };
+    return config;
+}
+
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL) {
+        puts("realloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return new_ptr;
+}
+
+
+static void delete_page_arg(void* page) {
+    delete_page(page);
+}
+
+
+// Pages may still be written to sockets by other workers
+static void retire_page(page_t* page, void* arg) {
+    cache_server_t* server = arg;
+    ebr_retire(server->ebr, page, &delete_page_arg);
+}
+
+
+// Copy of hot key goes away with the original, whether it is replaced, deleted or evicted
+static bool invalidate_replica(page_t* page, cache_removal_t reason, void* arg) {
+    (void) reason;
+    cache_server_t* server = arg;
+    replica_invalidate(server->replicas, key_hash(page->key), page->key);
+    return false;
+}
+
+
+static shard_t* get_shard(const cache_server_t* server, uint64_t hash) {
+    return &server->shards[hash_mix(hash) % server->n_shards];
+}
+
+
+static void append_out(connection_t* conn, const void* data, size_t size) {
+    if (conn->out_len + size > conn->out_cap) {
+        if (conn->out_pos != 0) {
+            memmove(conn->out, conn->out + conn->out_pos, conn->out_len - conn->out_pos);
+            conn->out_len -= conn->out_pos;
+            conn->out_pos = 0;
+        }
+        while (conn->out_len + size > conn->out_cap) {
+            conn->out_cap = conn->out_cap != 0 ? conn->out_cap * 2 : INITIAL_BUFFER_SIZE;
+        }
+        conn->out = checked_realloc(conn->out, conn->out_cap);
+    }
+    memcpy(conn->out + conn->out_len, data, size);
+    conn->out_len += size;
+}
+
+
+static void set_want_write(worker_t* worker, connection_t* conn, bool want_write) {
+    if (conn->want_write != want_write) {
+        struct epoll_event event = {.events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.ptr = conn};
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+        conn->want_write = want_write;
+    }
+}
+
+
+// Writes collected responses straight from pages, what socket does not take is copied
+static void flush(worker_t* worker, connection_t* conn) {
+    struct iovec* iov = worker->iov;
+    size_t n_iov = worker->n_iov;
+    if (conn->out_pos == conn->out_len && n_iov != 0) {
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = n_iov};
+        ssize_t n_sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n_sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            conn->closing = true;
+            n_iov = 0;
+        }
+        size_t sent = n_sent > 0 ? (size_t) n_sent : 0;
+        while (n_iov != 0 && sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            ++iov;
+            --n_iov;
+        }
+        if (n_iov != 0) {
+            iov->iov_base = (char*) iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    for (size_t i = 0; i < n_iov; ++i) {
+        append_out(conn, iov[i].iov_base, iov[i].iov_len);
+    }
+    worker->n_iov = 0;
+    worker->scratch_len = 0;
+}
+
+
+static void respond(worker_t* worker, connection_t* conn, const char* data, size_t size) {
+    if (worker->n_iov == MAX_IOV) {
+        flush(worker, conn);
+    }
+    worker->iov[worker->n_iov].iov_base = (void*) data;
+    worker->iov[worker->n_iov].iov_len = size;
+    ++worker->n_iov;
+}
+
+
+static void respond_line(worker_t* worker, connection_t* conn, const char* line) {
+    respond(worker, conn, line, strlen(line));
+}
+
+
+static void respond_value(worker_t* worker, connection_t* conn, const char* key, const page_t* page, bool with_cas) {
+    if (worker->n_iov + 3 > MAX_IOV || worker->scratch_len + MAX_HEADER_LEN > SCRATCH_SIZE) {
+        flush(worker, conn);
+    }
+    char* header = worker->scratch + worker->scratch_len;
+    int len = with_cas
+        ? sprintf(header, "VALUE %s %u %zu %lu\r\n", key, page->user_flags, page->size, page->version)
+        : sprintf(header, "VALUE %s %u %zu\r\n", key, page->user_flags, page->size);
+    worker->scratch_len += len;
+    respond(worker, conn, header, len);
+    respond(worker, conn, page->data, page->size);
+    respond(worker, conn, CRLF, sizeof(CRLF) - 1);
+}
+
+
+// Copy of the page is served if key is hot, without taking shard lock. Now and then
+// the original is looked up instead, so shard LRU does not evict the hottest keys.
+static const page_t* lookup_replica(worker_t* worker, unsigned long hash, const char* key) {
+    const page_t* page = replica_get(worker->server->replicas, hash, key);
+    if (page == NULL || ++worker->n_replica_found % REPLICA_REFRESH == 0) {
+        return NULL;
+    }
+    atomic_store_explicit(&worker->replica_hits,
+                          atomic_load_explicit(&worker->replica_hits, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    return page;
+}
+
+
+static void execute_get(worker_t* worker, connection_t* conn, const mc_request_t* request) {
+    cache_server_t* server = worker->server;
+    for (size_t i = 0; i < request->n_keys; ++i) {
+        const char* key = request->keys[i];
+        unsigned long hash = key_hash(key);
+        const page_t* page = server->replicas != NULL ? lookup_replica(worker, hash, key) : NULL;
+        if (page == NULL) {
+            bool is_hot = server->replicas != NULL && hot_key_sketch_add(worker->hot_keys, hash);
+            shard_t* shard = get_shard(server, hash);
+            pthread_mutex_lock(&shard->mutex);
+            cache_lookup(shard->cache, key, &page);
+            // Under shard lock, so replacement of the page can not slip in before copy is published
+            if (page != NULL && is_hot && replica_get(server->replicas, hash, key) == NULL) {
+                replica_publish(server->replicas, hash, page);
+            }
+            pthread_mutex_unlock(&shard->mutex);
+        }
+        // Evicted page stays valid, worker is inside ebr critical section
+        if (page != NULL) {
+            respond_value(worker, conn, request->keys[i], page, request->command == MC_GETS);
+        }
+    }
+    respond(worker, conn, END, sizeof(END) - 1);
+}
+
+
+static const char* execute_store(cache_server_t* server, const mc_request_t* request) {
+    const char* key = request->keys[0];
+    page_t* page = create_page_sized(key, request->data, request->n_bytes);
+    page->user_flags = request->flags;
+    page->version = atomic_fetch_add(&server->last_cas, 1) + 1;
+    shard_t* shard = get_shard(server, key_hash(key));
+    const char* result = STORED;
+    pthread_mutex_lock(&shard->mutex);
+    bool is_cached = cache_contains(shard->cache, key);
+    if (request->command == MC_CAS) {
+        if (!is_cached) {
+            result = NOT_FOUND;
+            delete_page(page);
+        } else if (!cache_cas(shard->cache, key, request->cas, page)) {
+            result = EXISTS;
+        }
+    } else if ((request->command == MC_ADD && is_cached) || (request->command == MC_REPLACE && !is_cached)) {
+        result = NOT_STORED;
+        delete_page(page);
+    } else {
+        cache_put(shard->cache, key, page);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return result;
+}
+
+
+static const char* execute_delete(cache_server_t* server, const mc_request_t* request) {
+    shard_t* shard = get_shard(server, key_hash(request->keys[0]));
+    pthread_mutex_lock(&shard->mutex);
+    bool is_cached = cache_contains(shard->cache, request->keys[0]);
+    if (is_cached) {
+        cache_put(shard->cache, request->keys[0], NULL);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return is_cached ? DELETED : NOT_FOUND;
+}
+
+
+static void execute(worker_t* worker, connection_t* conn, const mc_request_t* request) {
+    const char* result = NULL;
+    switch (request->command) {
+    case MC_GET:
+    case MC_GETS:
+        execute_get(worker, conn, request);
+        break;
+    case MC_SET:
+    case MC_ADD:
+    case MC_REPLACE:
+    case MC_CAS:
+        result = execute_store(worker->server, request);
+        break;
+    case MC_DELETE:
+        result = execute_delete(worker->server, request);
+        break;
+    case MC_VERSION:
+        result = VERSION;
+        break;
+    case MC_QUIT:
+        conn->closing = true;
+        break;
+    }
+    if (result != NULL && !request->noreply) {
+        respond_line(worker, conn, result);
+    }
+}
+
+
+// Handles all complete requests in input buffer, pipelined responses go out in one writev
+static void process_requests(worker_t* worker, connection_t* conn) {
+    size_t pos = 0;
+    while (!conn->closing && pos < conn->in_len) {
+        mc_request_t request;
+        mc_parse_t result = mc_parse_request(conn->in + pos, conn->in_len - pos, &request);
+        if (result == MC_PARSE_INCOMPLETE) {
+            break;
+        }
+        if (result == MC_PARSE_ERROR) {
+            respond_line(worker, conn, request.error);
+            conn->closing = request.length == 0;
+        } else {
+            execute(worker, conn, &request);
+        }
+        pos += request.length;
+    }
+    flush(worker, conn);
+    memmove(conn->in, conn->in + pos, conn->in_len - pos);
+    conn->in_len -= pos;
+}
+
+
+static void handle_readable(worker_t* worker, connection_t* conn) {
+    while (!conn->closing) {
+        if (conn->in_len == conn->in_cap) {
+            if (conn->in_cap == MAX_IN_BUFFER_SIZE) {
+                break;
+            }
+            conn->in_cap = conn->in_cap * 2 < MAX_IN_BUFFER_SIZE ? conn->in_cap * 2 : MAX_IN_BUFFER_SIZE;
+            conn->in = checked_realloc(conn->in, conn->in_cap);
+        }
+        ssize_t n_read = recv(conn->fd, conn->in + conn->in_len, conn->in_cap - conn->in_len, 0);
+        if (n_read > 0) {
+            conn->in_len += n_read;
+        } else if (n_read == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            // Peer is gone, requests it sent before closing are still answered
+            conn->closing = true;
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+    process_requests(worker, conn);
+    if (conn->in_len == 0 && conn->in_cap > INITIAL_BUFFER_SIZE) {
+        conn->in_cap = INITIAL_BUFFER_SIZE;
+        conn->in = checked_realloc(conn->in, conn->in_cap);
+    }
+}
+
+
+static void handle_writable(connection_t* conn) {
+    while (conn->out_pos < conn->out_len) {
+        ssize_t n_sent = send(conn->fd, conn->out + conn->out_pos, conn->out_len - conn->out_pos, MSG_NOSIGNAL);
+        if (n_sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                conn->closing = true;
+                conn->out_pos = conn->out_len;
+            }
+            break;
+        }
+        conn->out_pos += n_sent;
+    }
+    if (conn->out_pos == conn->out_len) {
+        conn->out_pos = 0;
+        conn->out_len = 0;
+    }
+}
+
+
+static void close_connection(worker_t* worker, connection_t* conn) {
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        worker->connections = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    free(conn->in);
+    free(conn->out);
+    free(conn);
+}
+
+
+static void accept_connections(worker_t* worker, const listener_t* listener) {
+    int fd;
+    while ((fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails on unix sockets
+        connection_t* conn = calloc(1, sizeof(connection_t));
+        if (conn == NULL) {
+            puts("calloc failed");
+            exit(EXIT_FAILURE);
+        }
+        conn->kind = SOCKET_CONNECTION;
+        conn->fd = fd;
+        conn->in_cap = INITIAL_BUFFER_SIZE;
+        conn->in = checked_realloc(NULL, conn->in_cap);
+        conn->next = worker->connections;
+        if (worker->connections != NULL) {
+            worker->connections->prev = conn;
+        }
+        worker->connections = conn;
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = conn};
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+
+static void* worker_loop(void* arg) {
+    worker_t* worker = arg;
+    ebr_t* ebr = worker->server->ebr;
+    struct epoll_event events[MAX_EVENTS];
+    bool running = true;
+    while (running) {
+        int n_events = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, -1);
+        ebr_enter(ebr);
+        for (int i = 0; i < n_events; ++i) {
+            socket_kind_t kind = *(socket_kind_t*) events[i].data.ptr;
+            if (kind == SOCKET_STOP) {
+                running = false;
+            } else if (kind == SOCKET_LISTENER) {
+                accept_connections(worker, events[i].data.ptr);
+            } else {
+                connection_t* conn = events[i].data.ptr;
+                if (events[i].events & EPOLLOUT) {
+                    handle_writable(conn);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    handle_readable(worker, conn);
+                }
+                if (conn->out_pos == conn->out_len && conn->closing) {
+                    close_connection(worker, conn);
+                } else {
+                    set_want_write(worker, conn, conn->out_pos != conn->out_len);
+                }
+            }
+        }
+        ebr_exit(ebr);
+    }
+    return NULL;
+}
+
+
+static bool listen_tcp(cache_server_t* server, const char* host, int port) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE};
+    struct addrinfo* addrs;
+    char port_str[16];
+    sprintf(port_str, "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &addrs) != 0) {
+        return false;
+    }
+    int fd = socket(addrs->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    bool ok = fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0
+        && bind(fd, addrs->ai_addr, addrs->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0;
+    freeaddrinfo(addrs);
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    if (ok && getsockname(fd, (struct sockaddr*) &addr, &addr_len) == 0) {
+        server->port = ntohs(addr.ss_family == AF_INET6 ? ((struct sockaddr_in6*) &addr)->sin6_port
+                                                        : ((struct sockaddr_in*) &addr)->sin_port);
+    }
+    if (!ok) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    server->listeners[server->n_listeners++] = (listener_t) {SOCKET_LISTENER, fd};
+    return true;
+}
+
+
+static bool listen_unix(cache_server_t* server, const char* path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    server->unix_path = string_dup(path);
+    server->listeners[server->n_listeners++] = (listener_t) {SOCKET_LISTENER, fd};
+    return true;
+}
+
+
+static void close_listeners(cache_server_t* server) {
+    for (size_t i = 0; i < server->n_listeners; ++i) {
+        close(server->listeners[i].fd);
+    }
+    if (server->unix_path != NULL) {
+        unlink(server->unix_path);
+        free(server->unix_path);
+    }
+}
+
+
+static void start_worker(cache_server_t* server, worker_t* worker) {
+    worker->server = server;
+    worker->connections = NULL;
+    worker->n_iov = 0;
+    worker->scratch_len = 0;
+    worker->hot_keys = server->replicas != NULL
+        ? create_hot_key_sketch(HOT_KEY_WIDTH, HOT_KEY_WINDOW, HOT_KEY_SHARE) : NULL;
+    worker->n_replica_found = 0;
+    atomic_init(&worker->replica_hits, 0);
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    worker->stop.kind = SOCKET_STOP;
+    worker->stop.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (worker->epoll_fd < 0 || worker->stop.fd < 0) {
+        puts("epoll setup failed");
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = &worker->stop};
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->stop.fd, &event);
+    for (size_t i = 0; i < server->n_listeners; ++i) {
+        // Only one worker is woken for a new connection
+        event = (struct epoll_event) {.events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = &server->listeners[i]};
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, server->listeners[i].fd, &event);
+    }
+    if (pthread_create(&worker->thread, NULL, &worker_loop, worker) != 0) {
+        puts("pthread_create failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+cache_server_t* create_cache_server(const server_config_t* config) {
+    cache_server_t* server = malloc(sizeof(cache_server_t));
+    if (server == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    server->n_listeners = 0;
+    server->port = 0;
+    server->unix_path = NULL;
+    if ((config->host != NULL && !listen_tcp(server, config->host, config->port))
+        || (config->unix_path != NULL && !listen_unix(server, config->unix_path))
+        || server->n_listeners == 0 || config->cache.max_size == 0) {
+        close_listeners(server);
+        free(server);
+        return NULL;
+    }
+
+    long n_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    server->n_workers = config->n_threads != 0 ? config->n_threads : (n_cores > 0 ? (size_t) n_cores : 1);
+    server->n_shards = config->n_shards != 0 ? config->n_shards : server->n_workers * SHARDS_PER_THREAD;
+    server->ebr = create_ebr();
+    server->replicas = config->n_replicas != 0 ? create_replica_table(config->n_replicas, server->ebr) : NULL;
+    atomic_init(&server->last_cas, 0);
+    server->shards = malloc(sizeof(shard_t) * server->n_shards);
+    server->workers = malloc(sizeof(worker_t) * server->n_workers);
+    if (server->shards == NULL || server->workers == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache_config_t cache_config = config->cache;
+    cache_config.max_size = (config->cache.max_size + server->n_shards - 1) / server->n_shards;
+    cache_config.max_bytes = (config->cache.max_bytes + server->n_shards - 1) / server->n_shards;
+    cache_config.release_page = &retire_page;
+    cache_config.release_arg = server;
+    cache_config.on_evict = server->replicas != NULL ? &invalidate_replica : NULL;
+    cache_config.on_evict_arg = server;
+    for (size_t i = 0; i < server->n_shards; ++i) {
+        pthread_mutex_init(&server->shards[i].mutex, NULL);
+        server->shards[i].cache = create_cache_with_config(&cache_config);
+    }
+    for (size_t i = 0; i < server->n_workers; ++i) {
+        start_worker(server, &server->workers[i]);
+    }
+    return server;
+}
+
+
+void delete_cache_server(cache_server_t* server) {
+    if (server == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < server->n_workers; ++i) {
+        uint64_t one = 1;
+        if (write(server->workers[i].stop.fd, &one, sizeof(one)) != sizeof(one)) {
+            puts("eventfd write failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < server->n_workers; ++i) {
+        worker_t* worker = &server->workers[i];
+        pthread_join(worker->thread, NULL);
+        while (worker->connections != NULL) {
+            close_connection(worker, worker->connections);
+        }
+        close(worker->stop.fd);
+        close(worker->epoll_fd);
+        delete_hot_key_sketch(worker->hot_keys);
+    }
+    close_listeners(server);
+    for (size_t i = 0; i < server->n_shards; ++i) {
+        delete_cache(server->shards[i].cache);
+        pthread_mutex_destroy(&server->shards[i].mutex);
+    }
+    delete_replica_table(server->replicas);
+    delete_ebr(server->ebr);
+    free(server->shards);
+    free(server->workers);
+    free(server);
+}
+
+
+int cache_server_port(const cache_server_t* server) {
+    return server->port;
+}
+
+
+cache_stats_t cache_server_stats(cache_server_t* server) {
+    cache_stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (size_t i = 0; i < server->n_shards; ++i) {
+        pthread_mutex_lock(&server->shards[i].mutex);
+        cache_stats_t stats = cache_stats(server->shards[i].cache);
+        pthread_mutex_unlock(&server->shards[i].mutex);
+        cache_stats_add(&total, &stats);
+    }
+    return total;
+}
+
+
+size_t cache_server_replica_hits(cache_server_t* server) {
+    size_t hits = 0;
+    for (size_t i = 0; i < server->n_workers; ++i) {
+        hits += atomic_load_explicit(&server->workers[i].replica_hits, memory_order_relaxed);
+    }
+    return hits;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "cache.h"
+
+// Server speaking memcached text protocol (get, gets, set, add, replace, cas, delete)
+// over TCP and unix sockets. Each worker thread runs its own epoll loop over the
+// connections it accepted. Keys are spread over shards, each an lru_cache_t behind
+// its own mutex. Pages are freed through epoch-based reclamation, so responses are
+// written with writev straight from cached pages after shard lock is released.
+// Every worker spots hot keys of its gets with a count-min sketch, copies of their
+// pages are then served to all workers without shard lock until the original changes.
+typedef struct cache_server_t cache_server_t;
+
+typedef struct server_config_t {
+    const char* host;       // TCP address to listen on, NULL - no TCP
+    int port;               // 0 - any free port, see cache_server_port
+    const char* unix_path;  // NULL - no unix socket
+    size_t n_threads;       // 0 - one per online core
+    size_t n_shards;        // 0 - four per thread
+    size_t n_replicas;      // slots for copies of hot keys, 0 - no replication
+    cache_config_t cache;   // capacity of all shards together, release_page and on_evict are taken by server
+} server_config_t;
+
+server_config_t server_default_config(size_t max_size);
+
+// Starts listening and worker threads, NULL if sockets can not be set up
+cache_server_t* create_cache_server(const server_config_t*);
+// Stops threads and closes connections
+void delete_cache_server(cache_server_t*);
+int cache_server_port(const cache_server_t*);
+// Sum over shards, gets served from copies of hot keys are not included
+cache_stats_t cache_server_stats(cache_server_t*);
+size_t cache_server_replica_hits(cache_server_t*);
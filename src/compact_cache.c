@@ -0,0 +1,257 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "compact_cache.h"
+#include "numa.h"
+
+
+#define NIL UINT32_MAX
+
+
+typedef struct compact_entry_t {
+    page_t* page;
+    uint32_t hash;   // lower bits of key hash, checked before key comparison
+    uint32_t prev;   // more recently used entry
+    uint32_t next;   // less recently used entry
+    uint32_t chain;  // next entry in bucket, also links free entries
+} compact_entry_t;
+
+
+struct compact_cache_t {
+    compact_entry_t* entries;
+    uint32_t* buckets;
+    size_t n_buckets;  // power of 2
+    size_t max_size;
+    size_t length;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t free;
+    bool huge_pages;
+    huge_backing_t backing;
+    int numa_node;
+    bool numa_bound;  // every array was bound to numa_node
+};
+
+
+compact_config_t compact_default_config(size_t size) {
+    compact_config_t config = {
+        .max_size = size,
+        .huge_pages = false,
+        .numa_node = -1,
+    };
+    return config;
+}
+
+
+compact_cache_t* create_compact_cache(size_t size) {
+    compact_config_t config = compact_default_config(size);
+    return create_compact_cache_with_config(&config);
+}
+
+
+// Memory bound to a node must be page-aligned and not touched yet, so it is mapped
+// directly unless huge_alloc maps it anyway
+static bool is_mapped(const compact_cache_t* cache, size_t size) {
+    return cache->numa_node >= 0 && (!cache->huge_pages || size < HUGE_PAGE_SIZE);
+}
+
+
+static void* alloc_array(compact_cache_t* cache, size_t size) {
+    void* ptr;
+    if (is_mapped(cache, size)) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            puts("mmap failed");
+            exit(EXIT_FAILURE);
+        }
+        cache->backing = HUGE_BACKING_REGULAR;
+    } else if (cache->huge_pages) {
+        ptr = huge_alloc(size, &cache->backing);
+    } else {
+        ptr = malloc(size);
+        if (ptr == NULL) {
+            puts("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (cache->numa_node >= 0) {
+        // Pages are not touched yet, so they will be allocated on the node
+        cache->numa_bound &= numa_bind(ptr, size, (size_t) cache->numa_node);
+    }
+    return ptr;
+}
+
+
+static void free_array(const compact_cache_t* cache, void* ptr, size_t size) {
+    if (is_mapped(cache, size)) {
+        munmap(ptr, size);
+    } else if (cache->huge_pages) {
+        huge_free(ptr, size);
+    } else {
+        free(ptr);
+    }
+}
+
+
+compact_cache_t* create_compact_cache_with_config(const compact_config_t* config) {
+    size_t size = config->max_size;
+    if (size == 0 || size >= NIL) {
+        return NULL;
+    }
+    compact_cache_t* cache = malloc(sizeof(compact_cache_t));
+    if (cache == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache->n_buckets = 1;
+    while (cache->n_buckets < size) {
+        cache->n_buckets *= 2;
+    }
+    cache->huge_pages = config->huge_pages;
+    cache->backing = HUGE_BACKING_HEAP;
+    cache->numa_node = config->numa_node;
+    cache->numa_bound = config->numa_node >= 0;
+    cache->buckets = alloc_array(cache, sizeof(uint32_t) * cache->n_buckets);
+    cache->entries = alloc_array(cache, sizeof(compact_entry_t) * size);
+    for (size_t i = 0; i < cache->n_buckets; ++i) {
+        cache->buckets[i] = NIL;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        cache->entries[i].chain = i + 1 < size ? (uint32_t) (i + 1) : NIL;
+    }
+    cache->max_size = size;
+    cache->length = 0;
+    cache->head = NIL;
+    cache->tail = NIL;
+    cache->free = 0;
+    return cache;
+}
+
+
+void delete_compact_cache(compact_cache_t* cache) {
+    if (cache != NULL) {
+        for (uint32_t idx = cache->head; idx != NIL; idx = cache->entries[idx].next) {
+            delete_page(cache->entries[idx].page);
+        }
+        free_array(cache, cache->entries, sizeof(compact_entry_t) * cache->max_size);
+        free_array(cache, cache->buckets, sizeof(uint32_t) * cache->n_buckets);
+    }
+    free(cache);
+}
+
+
+static uint32_t* get_bucket(const compact_cache_t* cache, unsigned long hash) {
+    return &cache->buckets[hash & (cache->n_buckets - 1)];
+}
+
+
+static uint32_t find_entry(const compact_cache_t* cache, const char* key, unsigned long hash) {
+    uint32_t idx = *get_bucket(cache, hash);
+    while (idx != NIL) {
+        const compact_entry_t* entry = &cache->entries[idx];
+        if (entry->hash == (uint32_t) hash && key_equal(entry->page->key, key)) {
+            break;
+        }
+        idx = entry->chain;
+    }
+    return idx;
+}
+
+
+static void lru_unlink(compact_cache_t* cache, uint32_t idx) {
+    compact_entry_t* entry = &cache->entries[idx];
+    if (entry->prev != NIL) {
+        cache->entries[entry->prev].next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next != NIL) {
+        cache->entries[entry->next].prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+}
+
+
+static void lru_push_front(compact_cache_t* cache, uint32_t idx) {
+    compact_entry_t* entry = &cache->entries[idx];
+    entry->prev = NIL;
+    entry->next = cache->head;
+    if (cache->head != NIL) {
+        cache->entries[cache->head].prev = idx;
+    } else {
+        cache->tail = idx;
+    }
+    cache->head = idx;
+}
+
+
+static void evict_back(compact_cache_t* cache) {
+    uint32_t idx = cache->tail;
+    compact_entry_t* entry = &cache->entries[idx];
+    lru_unlink(cache, idx);
+
+    uint32_t* link = get_bucket(cache, entry->hash);
+    while (*link != idx) {  // should exist
+        link = &cache->entries[*link].chain;
+    }
+    *link = entry->chain;
+
+    delete_page(entry->page);
+    entry->chain = cache->free;
+    cache->free = idx;
+    --cache->length;
+}
+
+
+const page_t* compact_cached_call(compact_cache_t* cache, const char* key, page_t* (*get_page_slow)(const char*)) {
+    unsigned long hash = key_hash(key);
+    uint32_t idx = find_entry(cache, key, hash);
+    if (idx != NIL) {
+        if (idx != cache->head) {
+            lru_unlink(cache, idx);
+            lru_push_front(cache, idx);
+        }
+        return cache->entries[idx].page;
+    }
+
+    page_t* page = get_page_slow(key);
+    if (page == NULL) {
+        return NULL;
+    }
+    if (cache->length == cache->max_size) {
+        evict_back(cache);
+    }
+
+    idx = cache->free;
+    compact_entry_t* entry = &cache->entries[idx];
+    cache->free = entry->chain;
+    entry->page = page;
+    entry->hash = (uint32_t) hash;
+
+    uint32_t* bucket = get_bucket(cache, hash);
+    entry->chain = *bucket;
+    *bucket = idx;
+    lru_push_front(cache, idx);
+    ++cache->length;
+    return page;
+}
+
+
+size_t compact_cache_length(const compact_cache_t* cache) {
+    return cache->length;
+}
+
+
+huge_backing_t compact_cache_backing(const compact_cache_t* cache) {
+    return cache->backing;
+}
+
+
+bool compact_cache_numa_bound(const compact_cache_t* cache) {
+    return cache->numa_bound;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "page.h"
+#include "hugemem.h"
+
+// LRU cache keeping all entries in one preallocated array.
+// LRU order and hash chains are 32-bit indices into the array and keys are not copied,
+// so metadata is about 28 bytes per page without separate allocations.
+// Eviction is plain LRU by number of pages. Loader should return page with requested key,
+// pages equal to NULL are not cached.
+typedef struct compact_cache_t compact_cache_t;
+
+typedef struct compact_config_t {
+    size_t max_size;
+    bool huge_pages;  // back entry array and buckets with 2 MB pages when possible
+    int numa_node;    // NUMA node for entry array and buckets, -1 - no preference
+} compact_config_t;
+
+compact_config_t compact_default_config(size_t size);
+
+compact_cache_t* create_compact_cache(size_t size);
+compact_cache_t* create_compact_cache_with_config(const compact_config_t*);
+void delete_compact_cache(compact_cache_t*);
+const page_t* compact_cached_call(compact_cache_t*, const char*, page_t* (*)(const char*));
+size_t compact_cache_length(const compact_cache_t*);
+// How entry array is backed, see hugemem.h
+huge_backing_t compact_cache_backing(const compact_cache_t*);
+// True if arrays were placed on numa_node, false without node or when kernel refused
+bool compact_cache_numa_bound(const compact_cache_t*);
@@ -0,0 +1,302 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "concurrent_hashtable.h"
+#include "util.h"
+#include "page.h"
+
+
+#define N_STRIPES 64  // power of two, table never has fewer buckets
+#define MAX_LOAD_FACTOR 1
+
+
+typedef struct centry_t centry_t;
+struct centry_t {
+    _Atomic(centry_t*) next;
+    unsigned long hash;
+    void* value;
+    char key[];
+};
+
+
+// Bucket i belongs to stripe i % N_STRIPES. When table doubles, bucket i is split
+// into i and i + n_buckets of the same stripe, so a stripe lock covers both tables.
+typedef struct ctable_t ctable_t;
+struct ctable_t {
+    size_t n_buckets;
+    _Atomic(ctable_t*) next;  // table being migrated to
+    atomic_bool migrated[N_STRIPES];
+    _Atomic(centry_t*) buckets[];
+};
+
+
+typedef struct stripe_lock_t {
+    _Alignas(64) pthread_mutex_t mutex;
+} stripe_lock_t;
+
+
+struct chashtable_t {
+    _Atomic(ctable_t*) table;
+    atomic_size_t n_entries;
+    ebr_t* ebr;
+    stripe_lock_t locks[N_STRIPES];
+};
+
+
+// djb2 has weak low bits, which select both bucket and stripe
+static unsigned long mix_hash(const char* key) {
+    return (unsigned long) hash_mix(key_hash(key));
+}
+
+
+static centry_t* create_centry(const char* key, unsigned long hash, void* value, centry_t* next) {
+    size_t key_size = strlen(key) + 1;
+    centry_t* entry = malloc(sizeof(centry_t) + key_size);
+    if (entry == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&entry->next, next);
+    entry->hash = hash;
+    entry->value = value;
+    memcpy(entry->key, key, key_size);
+    return entry;
+}
+
+
+static ctable_t* create_ctable(size_t n_buckets) {
+    ctable_t* table = malloc(sizeof(ctable_t) + sizeof(_Atomic(centry_t*)) * n_buckets);
+    if (table == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    table->n_buckets = n_buckets;
+    atomic_init(&table->next, NULL);
+    for (size_t i = 0; i < N_STRIPES; ++i) {
+        atomic_init(&table->migrated[i], false);
+    }
+    for (size_t i = 0; i < n_buckets; ++i) {
+        atomic_init(&table->buckets[i], NULL);
+    }
+    return table;
+}
+
+
+// Frees table with entries still linked, entries removed earlier were retired separately
+static void delete_ctable(void* arg) {
+    ctable_t* table = arg;
+    for (size_t i = 0; i < table->n_buckets; ++i) {
+        centry_t* entry = atomic_load_explicit(&table->buckets[i], memory_order_relaxed);
+        while (entry != NULL) {
+            centry_t* next = atomic_load_explicit(&entry->next, memory_order_relaxed);
+            free(entry);
+            entry = next;
+        }
+    }
+    free(table);
+}
+
+
+chashtable_t* create_chashtable(void) {
+    chashtable_t* htable = aligned_alloc(_Alignof(chashtable_t), sizeof(chashtable_t));
+    if (htable == NULL) {
+        puts("aligned_alloc failed");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&htable->table, create_ctable(N_STRIPES));
+    atomic_init(&htable->n_entries, 0);
+    htable->ebr = create_ebr();
+    for (size_t i = 0; i < N_STRIPES; ++i) {
+        pthread_mutex_init(&htable->locks[i].mutex, NULL);
+    }
+    return htable;
+}
+
+
+void delete_chashtable(chashtable_t* htable) {
+    if (htable == NULL) {
+        return;
+    }
+    // Resizes complete inside a call, so there is a single table at rest
+    delete_ctable(atomic_load(&htable->table));
+    delete_ebr(htable->ebr);
+    for (size_t i = 0; i < N_STRIPES; ++i) {
+        pthread_mutex_destroy(&htable->locks[i].mutex);
+    }
+    free(htable);
+}
+
+
+size_t chashtable_length(const chashtable_t* htable) {
+    return atomic_load_explicit(&htable->n_entries, memory_order_relaxed);
+}
+
+
+size_t chashtable_n_buckets(const chashtable_t* htable) {
+    return atomic_load_explicit(&htable->table, memory_order_acquire)->n_buckets;
+}
+
+
+ebr_t* chashtable_ebr(const chashtable_t* htable) {
+    return htable->ebr;
+}
+
+
+// Latest table that holds the stripe, caller is pinned
+static ctable_t* stripe_table(ctable_t* table, size_t stripe) {
+    while (atomic_load_explicit(&table->migrated[stripe], memory_order_acquire)) {
+        table = atomic_load_explicit(&table->next, memory_order_acquire);
+    }
+    return table;
+}
+
+
+void* chashtable_get(const chashtable_t* htable, const char* key) {
+    unsigned long hash = mix_hash(key);
+    void* value = NULL;
+    ebr_enter(htable->ebr);
+    ctable_t* table = atomic_load_explicit(&htable->table, memory_order_acquire);
+    table = stripe_table(table, hash % N_STRIPES);
+    centry_t* entry = atomic_load_explicit(&table->buckets[hash & (table->n_buckets - 1)], memory_order_acquire);
+    while (entry != NULL) {
+        if (entry->hash == hash && !strcmp(entry->key, key)) {
+            value = entry->value;
+            break;
+        }
+        entry = atomic_load_explicit(&entry->next, memory_order_acquire);
+    }
+    ebr_exit(htable->ebr);
+    return value;
+}
+
+
+// Copies stripe entries to the next table, caller holds stripe lock.
+// Old chains are left intact for readers still walking them.
+static void migrate_stripe(ctable_t* table, size_t stripe) {
+    ctable_t* next_table = atomic_load_explicit(&table->next, memory_order_acquire);
+    size_t mask = next_table->n_buckets - 1;
+    for (size_t i = stripe; i < table->n_buckets; i += N_STRIPES) {
+        centry_t* entry = atomic_load_explicit(&table->buckets[i], memory_order_relaxed);
+        while (entry != NULL) {
+            _Atomic(centry_t*)* bucket = &next_table->buckets[entry->hash & mask];
+            centry_t* copy = create_centry(entry->key, entry->hash, entry->value,
+                                           atomic_load_explicit(bucket, memory_order_relaxed));
+            atomic_store_explicit(bucket, copy, memory_order_relaxed);
+            entry = atomic_load_explicit(&entry->next, memory_order_relaxed);
+        }
+    }
+    // Publishes copied chains to readers
+    atomic_store_explicit(&table->migrated[stripe], true, memory_order_release);
+}
+
+
+// Locks stripe and returns table to modify, helping resize in progress
+static ctable_t* lock_stripe(chashtable_t* htable, size_t stripe) {
+    pthread_mutex_lock(&htable->locks[stripe].mutex);
+    ctable_t* table = stripe_table(atomic_load_explicit(&htable->table, memory_order_acquire), stripe);
+    while (atomic_load_explicit(&table->next, memory_order_acquire) != NULL) {
+        migrate_stripe(table, stripe);
+        table = atomic_load_explicit(&table->next, memory_order_acquire);
+    }
+    return table;
+}
+
+
+static void free_centry(void* entry) {
+    free(entry);
+}
+
+
+static void resize(chashtable_t* htable) {
+    ctable_t* table = atomic_load_explicit(&htable->table, memory_order_acquire);
+    if (atomic_load(&htable->n_entries) <= table->n_buckets * MAX_LOAD_FACTOR) {
+        return;
+    }
+    ctable_t* next_table = create_ctable(table->n_buckets * 2);
+    ctable_t* expected = NULL;
+    if (!atomic_compare_exchange_strong(&table->next, &expected, next_table)) {
+        // Another thread is resizing
+        delete_ctable(next_table);
+        return;
+    }
+    for (size_t stripe = 0; stripe < N_STRIPES; ++stripe) {
+        pthread_mutex_lock(&htable->locks[stripe].mutex);
+        if (!atomic_load_explicit(&table->migrated[stripe], memory_order_relaxed)) {
+            migrate_stripe(table, stripe);
+        }
+        pthread_mutex_unlock(&htable->locks[stripe].mutex);
+    }
+    atomic_store_explicit(&htable->table, next_table, memory_order_release);
+    ebr_retire(htable->ebr, table, &delete_ctable);
+}
+
+
+void* chashtable_put(chashtable_t* htable, const char* key, void* value) {
+    unsigned long hash = mix_hash(key);
+    size_t stripe = hash % N_STRIPES;
+    void* old_value = NULL;
+    bool inserted = true;
+    ebr_enter(htable->ebr);
+    ctable_t* table = lock_stripe(htable, stripe);
+
+    _Atomic(centry_t*)* link = &table->buckets[hash & (table->n_buckets - 1)];
+    centry_t* entry;
+    while ((entry = atomic_load_explicit(link, memory_order_relaxed)) != NULL) {
+        if (entry->hash == hash && !strcmp(entry->key, key)) {
+            break;
+        }
+        link = &entry->next;
+    }
+    if (entry != NULL) {
+        // Entries are immutable for readers, so replace it
+        old_value = entry->value;
+        inserted = false;
+        centry_t* next = atomic_load_explicit(&entry->next, memory_order_relaxed);
+        atomic_store_explicit(link, create_centry(key, hash, value, next), memory_order_release);
+        ebr_retire(htable->ebr, entry, &free_centry);
+    } else {
+        _Atomic(centry_t*)* bucket = &table->buckets[hash & (table->n_buckets - 1)];
+        centry_t* head = atomic_load_explicit(bucket, memory_order_relaxed);
+        atomic_store_explicit(bucket, create_centry(key, hash, value, head), memory_order_release);
+        atomic_fetch_add(&htable->n_entries, 1);
+    }
+    pthread_mutex_unlock(&htable->locks[stripe].mutex);
+
+    if (inserted && atomic_load(&htable->n_entries) > table->n_buckets * MAX_LOAD_FACTOR) {
+        resize(htable);
+    }
+    ebr_exit(htable->ebr);
+    return old_value;
+}
+
+
+void* chashtable_delete_entry(chashtable_t* htable, const char* key) {
+    unsigned long hash = mix_hash(key);
+    size_t stripe = hash % N_STRIPES;
+    void* value = NULL;
+    ebr_enter(htable->ebr);
+    ctable_t* table = lock_stripe(htable, stripe);
+
+    _Atomic(centry_t*)* link = &table->buckets[hash & (table->n_buckets - 1)];
+    centry_t* entry;
+    while ((entry = atomic_load_explicit(link, memory_order_relaxed)) != NULL) {
+        if (entry->hash == hash && !strcmp(entry->key, key)) {
+            // Readers on the entry still reach rest of the chain through it
+            atomic_store_explicit(link, atomic_load_explicit(&entry->next, memory_order_relaxed),
+                                  memory_order_release);
+            atomic_fetch_sub(&htable->n_entries, 1);
+            value = entry->value;
+            ebr_retire(htable->ebr, entry, &free_centry);
+            break;
+        }
+        link = &entry->next;
+    }
+    pthread_mutex_unlock(&htable->locks[stripe].mutex);
+    ebr_exit(htable->ebr);
+    return value;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ebr.h"
+
+// Thread-safe string-keyed hash table.
+// Lookups take no locks: chains are published with release stores and readers are
+// protected by epoch-based reclamation. Writers lock one of a fixed set of bucket
+// stripes. Table doubles concurrently: every stripe is migrated separately under
+// its lock, by resizing thread or by any writer touching it first, while readers
+// follow per-stripe migrated flags to the new table.
+// Values are not owned by the table. To keep using a value after lookup pin the
+// table's ebr with ebr_enter/ebr_exit around lookup and use, and retire deleted
+// values with ebr_retire.
+typedef struct chashtable_t chashtable_t;
+
+chashtable_t* create_chashtable(void);
+// No thread may use table concurrently
+void delete_chashtable(chashtable_t*);
+size_t chashtable_length(const chashtable_t*);
+size_t chashtable_n_buckets(const chashtable_t*);
+// Returns NULL if key is missing
+void* chashtable_get(const chashtable_t*, const char*);
+// Returns previous value or NULL
+void* chashtable_put(chashtable_t*, const char*, void*);
+// Returns deleted value or NULL
+void* chashtable_delete_entry(chashtable_t*, const char*);
+ebr_t* chashtable_ebr(const chashtable_t*);
@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "cuckoo.h"
+#include "util.h"
+
+
+#define SLOTS_PER_BUCKET 4
+#define MAX_LOAD 0.9
+#define MAX_KICKS 500
+#define LANES_LOW 0x0001000100010001ULL   // lowest bit of each 16-bit lane
+#define LANES_HIGH 0x8000800080008000ULL  // highest bit of each 16-bit lane
+
+
+// Fingerprint 0 marks empty slot
+struct cuckoo_t {
+    uint64_t* buckets;
+    size_t n_buckets;  // power of two
+    size_t capacity;
+    size_t n_items;
+    uint64_t kick_state;  // picks slot to kick out
+};
+
+
+cuckoo_t* create_cuckoo(size_t capacity) {
+    cuckoo_t* cuckoo = malloc(sizeof(cuckoo_t));
+    if (cuckoo == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t min_buckets = (size_t) (capacity / (SLOTS_PER_BUCKET * MAX_LOAD)) + 1;
+    cuckoo->n_buckets = 2;
+    while (cuckoo->n_buckets < min_buckets) {
+        cuckoo->n_buckets *= 2;
+    }
+    cuckoo->buckets = calloc(cuckoo->n_buckets, sizeof(uint64_t));
+    if (cuckoo->buckets == NULL) {
+        puts("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cuckoo->capacity = capacity;
+    cuckoo->n_items = 0;
+    cuckoo->kick_state = 88172645463325252ULL;
+    return cuckoo;
+}
+
+
+void delete_cuckoo(cuckoo_t* cuckoo) {
+    if (cuckoo != NULL) {
+        free(cuckoo->buckets);
+    }
+    free(cuckoo);
+}
+
+
+static uint16_t fingerprint(uint64_t mixed) {
+    uint16_t fp = (uint16_t) (mixed >> 48);
+    return fp != 0 ? fp : 1;
+}
+
+
+// Partial-key cuckoo hashing: either bucket is found from the other one and fingerprint
+static size_t alt_bucket(const cuckoo_t* cuckoo, size_t bucket, uint16_t fp) {
+    return (bucket ^ hash_mix(fp)) & (cuckoo->n_buckets - 1);
+}
+
+
+// Checks all four lanes at once: lane equal to fp becomes zero after xor,
+// and subtracting one borrows into its high bit
+static bool has_fingerprint(uint64_t bucket, uint16_t fp) {
+    uint64_t diff = bucket ^ (fp * LANES_LOW);
+    return ((diff - LANES_LOW) & ~diff & LANES_HIGH) != 0;
+}
+
+
+static uint16_t get_slot(uint64_t bucket, size_t slot) {
+    return (uint16_t) (bucket >> (slot * 16));
+}
+
+
+static uint64_t set_slot(uint64_t bucket, size_t slot, uint16_t fp) {
+    bucket &= ~((uint64_t) 0xffff << (slot * 16));
+    return bucket | ((uint64_t) fp << (slot * 16));
+}
+
+
+static bool try_insert(cuckoo_t* cuckoo, size_t bucket, uint16_t fp) {
+    for (size_t slot = 0; slot < SLOTS_PER_BUCKET; ++slot) {
+        if (get_slot(cuckoo->buckets[bucket], slot) == 0) {
+            cuckoo->buckets[bucket] = set_slot(cuckoo->buckets[bucket], slot, fp);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool cuckoo_add(cuckoo_t* cuckoo, unsigned long hash) {
+    uint64_t mixed = hash_mix(hash);
+    uint16_t fp = fingerprint(mixed);
+    size_t bucket = mixed & (cuckoo->n_buckets - 1);
+    ++cuckoo->n_items;
+    if (try_insert(cuckoo, bucket, fp)) {
+        return true;
+    }
+    bucket = alt_bucket(cuckoo, bucket, fp);
+    for (size_t kick = 0; kick < MAX_KICKS; ++kick) {
+        if (try_insert(cuckoo, bucket, fp)) {
+            return true;
+        }
+        cuckoo->kick_state ^= cuckoo->kick_state >> 12;
+        cuckoo->kick_state ^= cuckoo->kick_state << 25;
+        cuckoo->kick_state ^= cuckoo->kick_state >> 27;
+        size_t slot = cuckoo->kick_state % SLOTS_PER_BUCKET;
+        uint16_t kicked = get_slot(cuckoo->buckets[bucket], slot);
+        cuckoo->buckets[bucket] = set_slot(cuckoo->buckets[bucket], slot, fp);
+        fp = kicked;
+        bucket = alt_bucket(cuckoo, bucket, fp);
+    }
+    return false;
+}
+
+
+void cuckoo_remove(cuckoo_t* cuckoo, unsigned long hash) {
+    uint64_t mixed = hash_mix(hash);
+    uint16_t fp = fingerprint(mixed);
+    size_t bucket = mixed & (cuckoo->n_buckets - 1);
+    for (int i = 0; i < 2; ++i) {
+        for (size_t slot = 0; slot < SLOTS_PER_BUCKET; ++slot) {
+            if (get_slot(cuckoo->buckets[bucket], slot) == fp) {
+                cuckoo->buckets[bucket] = set_slot(cuckoo->buckets[bucket], slot, 0);
+                --cuckoo->n_items;
+                return;
+            }
+        }
+        bucket = alt_bucket(cuckoo, bucket, fp);
+    }
+}
+
+
+bool cuckoo_maybe_contains(const cuckoo_t* cuckoo, unsigned long hash) {
+    uint64_t mixed = hash_mix(hash);
+    uint16_t fp = fingerprint(mixed);
+    size_t bucket = mixed & (cuckoo->n_buckets - 1);
+    // Both words are loaded without branching in between, so their cache misses overlap
+    uint64_t first = cuckoo->buckets[bucket];
+    uint64_t second = cuckoo->buckets[alt_bucket(cuckoo, bucket, fp)];
+    return has_fingerprint(first, fp) | has_fingerprint(second, fp);
+}
+
+
+size_t cuckoo_capacity(const cuckoo_t* cuckoo) {
+    return cuckoo->capacity;
+}
+
+
+size_t cuckoo_length(const cuckoo_t* cuckoo) {
+    return cuckoo->n_items;
+}
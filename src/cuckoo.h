@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Cuckoo filter over key hashes. Like Bloom filter answers "maybe present" or
+// "surely absent", but items can be removed. Each bucket holds four 16-bit
+// fingerprints in one 64-bit word, so a lookup reads two words.
+typedef struct cuckoo_t cuckoo_t;
+
+cuckoo_t* create_cuckoo(size_t capacity);
+void delete_cuckoo(cuckoo_t*);
+// False if filter is too full, then some item already in filter may have been
+// dropped and filter has to be rebuilt before it is used again
+bool cuckoo_add(cuckoo_t*, unsigned long);
+// Only items that were added may be removed
+void cuckoo_remove(cuckoo_t*, unsigned long);
+bool cuckoo_maybe_contains(const cuckoo_t*, unsigned long);
+// Number of items filter was sized for
+size_t cuckoo_capacity(const cuckoo_t*);
+size_t cuckoo_length(const cuckoo_t*);
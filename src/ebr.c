@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ebr.h"
+
+
+#define COLLECT_PERIOD 64  // retirements between collection attempts
+
+
+typedef struct retired_t retired_t;
+struct retired_t {
+    void* ptr;
+    void (*free_func)(void*);
+    uint64_t epoch;
+    retired_t* next;
+};
+
+
+typedef struct ebr_record_t ebr_record_t;
+struct ebr_record_t {
+    // (epoch << 1) | 1 while thread is inside critical section, 0 otherwise
+    _Alignas(64) atomic_uint_fast64_t state;
+    atomic_bool in_use;
+    ebr_record_t* next;  // immutable once record is published
+
+    // Owned by the thread using the record
+    size_t depth;
+    retired_t* retired;  // most recent first
+    size_t n_since_collect;
+};
+
+
+struct ebr_t {
+    _Alignas(64) atomic_uint_fast64_t epoch;
+    _Alignas(64) _Atomic(ebr_record_t*) records;
+    pthread_key_t key;
+};
+
+
+static void release_record(void* arg) {
+    ebr_record_t* record = arg;
+    // Retired objects stay with the record and are freed by its next owner
+    atomic_store(&record->state, 0);
+    atomic_store(&record->in_use, false);
+}
+
+
+ebr_t* create_ebr(void) {
+    ebr_t* ebr = aligned_alloc(_Alignof(ebr_t), sizeof(ebr_t));
+    if (ebr == NULL) {
+        puts("aligned_alloc failed");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&ebr->epoch, 0);
+    atomic_init(&ebr->records, NULL);
+    if (pthread_key_create(&ebr->key, &release_record) != 0) {
+        puts("pthread_key_create failed");
+        exit(EXIT_FAILURE);
+    }
+    return ebr;
+}
+
+
+static void free_retired(retired_t* retired) {
+    while (retired != NULL) {
+        retired_t* next = retired->next;
+        retired->free_func(retired->ptr);
+        free(retired);
+        retired = next;
+    }
+}
+
+
+void delete_ebr(ebr_t* ebr) {
+    if (ebr == NULL) {
+        return;
+    }
+    pthread_key_delete(ebr->key);
+    ebr_record_t* record = atomic_load(&ebr->records);
+    while (record != NULL) {
+        ebr_record_t* next = record->next;
+        free_retired(record->retired);
+        free(record);
+        record = next;
+    }
+    free(ebr);
+}
+
+
+static ebr_record_t* get_record(ebr_t* ebr) {
+    ebr_record_t* record = pthread_getspecific(ebr->key);
+    if (record != NULL) {
+        return record;
+    }
+    for (record = atomic_load(&ebr->records); record != NULL; record = record->next) {
+        bool in_use = false;
+        if (atomic_compare_exchange_strong(&record->in_use, &in_use, true)) {
+            break;
+        }
+    }
+    if (record == NULL) {
+        record = aligned_alloc(_Alignof(ebr_record_t), sizeof(ebr_record_t));
+        if (record == NULL) {
+            puts("aligned_alloc failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(record, 0, sizeof(ebr_record_t));
+        atomic_init(&record->state, 0);
+        atomic_init(&record->in_use, true);
+        record->next = atomic_load(&ebr->records);
+        while (!atomic_compare_exchange_weak(&ebr->records, &record->next, record)) {
+        }
+    }
+    pthread_setspecific(ebr->key, record);
+    return record;
+}
+
+
+void ebr_enter(ebr_t* ebr) {
+    ebr_record_t* record = get_record(ebr);
+    if (record->depth++ == 0) {
+        atomic_store(&record->state, (atomic_load(&ebr->epoch) << 1) | 1);
+    }
+}
+
+
+void ebr_exit(ebr_t* ebr) {
+    ebr_record_t* record = pthread_getspecific(ebr->key);
+    if (--record->depth == 0) {
+        atomic_store_explicit(&record->state, 0, memory_order_release);
+    }
+}
+
+
+// Epoch can advance only when every thread in critical section has observed it
+static uint64_t try_advance(ebr_t* ebr) {
+    uint64_t epoch = atomic_load(&ebr->epoch);
+    for (ebr_record_t* record = atomic_load(&ebr->records); record != NULL; record = record->next) {
+        uint64_t state = atomic_load(&record->state);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return epoch;
+        }
+    }
+    if (atomic_compare_exchange_strong(&ebr->epoch, &epoch, epoch + 1)) {
+        return epoch + 1;
+    }
+    return epoch;
+}
+
+
+void ebr_collect(ebr_t* ebr) {
+    ebr_record_t* record = get_record(ebr);
+    uint64_t epoch = try_advance(ebr);
+    // Objects retired in epoch e may be reached by readers pinned in e or e - 1
+    retired_t** link = &record->retired;
+    while (*link != NULL && (*link)->epoch + 2 > epoch) {
+        link = &(*link)->next;
+    }
+    retired_t* expired = *link;
+    *link = NULL;
+    record->n_since_collect = 0;
+    free_retired(expired);
+}
+
+
+void ebr_retire(ebr_t* ebr, void* ptr, void (*free_func)(void*)) {
+    ebr_record_t* record = get_record(ebr);
+    retired_t* retired = malloc(sizeof(retired_t));
+    if (retired == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    retired->ptr = ptr;
+    retired->free_func = free_func;
+    retired->epoch = atomic_load(&ebr->epoch);
+    retired->next = record->retired;
+    record->retired = retired;
+    if (++record->n_since_collect == COLLECT_PERIOD) {
+        ebr_collect(ebr);
+    }
+}
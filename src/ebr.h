@@ -0,0 +1,18 @@
+#pragma once
+
+// Epoch-based reclamation.
+// Readers pin current epoch with ebr_enter/ebr_exit (nestable) while they hold pointers
+// to shared objects. Writers unlink object first and then pass it to ebr_retire, it is
+// freed once every thread pinned at unlink time has left its critical section.
+// Threads are registered on first use, records of exited threads are reused.
+typedef struct ebr_t ebr_t;
+
+ebr_t* create_ebr(void);
+// Frees all retired objects, no thread may use it concurrently
+void delete_ebr(ebr_t*);
+
+void ebr_enter(ebr_t*);
+void ebr_exit(ebr_t*);
+void ebr_retire(ebr_t*, void*, void (*)(void*));
+// Tries to advance epoch and frees objects retired by current thread that are safe to free
+void ebr_collect(ebr_t*);
@@ -0,0 +1,179 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "free_queue.h"
+
+
+#define INITIAL_CAPACITY 64
+#define FLUSH_PERIOD_MS 100  // background thread frees incomplete batch after this
+
+
+struct free_queue_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t has_batch;
+    page_t** pages;
+    size_t n_pages;
+    size_t capacity;
+    size_t batch_size;
+    bool background;
+    bool stopping;
+    pthread_t thread;
+    free_queue_stats_t stats;
+};
+
+
+// Frees pages outside of the lock, array is reused by caller
+static void free_batch(free_queue_t* queue, page_t** pages, size_t n_pages) {
+    for (size_t i = 0; i < n_pages; ++i) {
+        delete_page(pages[i]);
+    }
+    pthread_mutex_lock(&queue->mutex);
+    queue->stats.n_freed += n_pages;
+    ++queue->stats.n_batches;
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+
+// Takes queued pages, caller holds the lock. Queue continues with spare array
+// (a new one if spare is NULL), taken array becomes the spare.
+static page_t** take_pages(free_queue_t* queue, page_t*** spare, size_t* spare_capacity, size_t* n_pages) {
+    if (*spare == NULL) {
+        *spare = malloc(sizeof(page_t*) * INITIAL_CAPACITY);
+        if (*spare == NULL) {
+            puts("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        *spare_capacity = INITIAL_CAPACITY;
+    }
+    page_t** pages = queue->pages;
+    *n_pages = queue->n_pages;
+    size_t capacity = queue->capacity;
+    queue->pages = *spare;
+    queue->capacity = *spare_capacity;
+    queue->n_pages = 0;
+    *spare = pages;
+    *spare_capacity = capacity;
+    return pages;
+}
+
+
+static void* free_loop(void* arg) {
+    free_queue_t* queue = arg;
+    page_t** batch = NULL;
+    size_t batch_capacity = 0;
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->stopping) {
+        if (queue->n_pages < queue->batch_size) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += FLUSH_PERIOD_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                ++deadline.tv_sec;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&queue->has_batch, &queue->mutex, &deadline);
+        }
+        if (queue->n_pages == 0) {
+            continue;
+        }
+        size_t n_pages;
+        page_t** pages = take_pages(queue, &batch, &batch_capacity, &n_pages);
+        pthread_mutex_unlock(&queue->mutex);
+        free_batch(queue, pages, n_pages);
+        pthread_mutex_lock(&queue->mutex);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    free(batch);
+    return NULL;
+}
+
+
+free_queue_t* create_free_queue(bool background, size_t batch_size) {
+    free_queue_t* queue = malloc(sizeof(free_queue_t));
+    page_t** pages = malloc(sizeof(page_t*) * INITIAL_CAPACITY);
+    if (queue == NULL || pages == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->has_batch, NULL);
+    queue->pages = pages;
+    queue->n_pages = 0;
+    queue->capacity = INITIAL_CAPACITY;
+    queue->batch_size = batch_size > 0 ? batch_size : 1;
+    queue->background = background;
+    queue->stopping = false;
+    queue->stats.n_queued = 0;
+    queue->stats.n_freed = 0;
+    queue->stats.n_batches = 0;
+    if (background && pthread_create(&queue->thread, NULL, &free_loop, queue) != 0) {
+        puts("pthread_create failed");
+        exit(EXIT_FAILURE);
+    }
+    return queue;
+}
+
+
+void delete_free_queue(free_queue_t* queue) {
+    if (queue == NULL) {
+        return;
+    }
+    if (queue->background) {
+        pthread_mutex_lock(&queue->mutex);
+        queue->stopping = true;
+        pthread_cond_signal(&queue->has_batch);
+        pthread_mutex_unlock(&queue->mutex);
+        pthread_join(queue->thread, NULL);
+    }
+    free_queue_drain(queue);
+    free(queue->pages);
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->has_batch);
+    free(queue);
+}
+
+
+void free_queue_release(page_t* page, void* arg) {
+    free_queue_t* queue = arg;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->n_pages == queue->capacity) {
+        queue->capacity *= 2;
+        queue->pages = realloc(queue->pages, sizeof(page_t*) * queue->capacity);
+        if (queue->pages == NULL) {
+            puts("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    queue->pages[queue->n_pages++] = page;
+    if (queue->n_pages == queue->batch_size) {
+        pthread_cond_signal(&queue->has_batch);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+
+size_t free_queue_drain(free_queue_t* queue) {
+    page_t** batch = NULL;
+    size_t batch_capacity = 0;
+    size_t n_pages;
+    pthread_mutex_lock(&queue->mutex);
+    page_t** pages = take_pages(queue, &batch, &batch_capacity, &n_pages);
+    pthread_mutex_unlock(&queue->mutex);
+    if (n_pages != 0) {
+        free_batch(queue, pages, n_pages);
+    }
+    free(batch);
+    return n_pages;
+}
+
+
+free_queue_stats_t free_queue_stats(free_queue_t* queue) {
+    pthread_mutex_lock(&queue->mutex);
+    free_queue_stats_t stats = queue->stats;
+    stats.n_queued = queue->n_pages;
+    pthread_mutex_unlock(&queue->mutex);
+    return stats;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include "page.h"
+
+// Deferred freeing of pages released by caches.
+// Set free_queue_release as cache_config_t.release_page with the queue as its argument:
+// released pages are only queued, so free() cost of large pages leaves request path.
+// Pages are freed in batches by a background thread or by free_queue_drain called at
+// quiescent points. Caches using the queue should be deleted before it.
+typedef struct free_queue_t free_queue_t;
+
+typedef struct free_queue_stats_t {
+    size_t n_queued;   // waiting to be freed
+    size_t n_freed;
+    size_t n_batches;
+} free_queue_stats_t;
+
+// Background thread frees a batch once batch_size pages are queued, or periodically.
+// Without it pages are freed only by free_queue_drain.
+free_queue_t* create_free_queue(bool background, size_t batch_size);
+// Frees all queued pages
+void delete_free_queue(free_queue_t*);
+
+// page_release_t for caches, arg is the queue
+void free_queue_release(page_t*, void*);
+// Frees queued pages on calling thread, returns their number
+size_t free_queue_drain(free_queue_t*);
+free_queue_stats_t free_queue_stats(free_queue_t*);
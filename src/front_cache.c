@@ -0,0 +1,214 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "front_cache.h"
+#include "util.h"
+
+
+#define N_GENERATIONS 4096  // power of two
+#define N_WAYS 2
+#define REPIN_PERIOD 64     // front calls between ebr re-pins, lets epoch advance
+
+
+struct shared_cache_t {
+    pthread_mutex_t mutex;
+    lru_cache_t* cache;
+    ebr_t* ebr;
+    // Bumped before page of a key with matching hash is released
+    atomic_uint_fast64_t generations[N_GENERATIONS];
+};
+
+
+typedef struct front_slot_t {
+    unsigned long hash;
+    const page_t* page;  // NULL - empty slot
+    uint64_t generation;
+} front_slot_t;
+
+
+struct front_cache_t {
+    shared_cache_t* shared;
+    front_slot_t* slots;  // n_sets * N_WAYS, way 0 is most recently used
+    size_t n_sets;
+    size_t n_calls;
+    bool pinned;
+    front_stats_t stats;
+};
+
+
+// djb2 low bits cluster for similar keys, spread them before picking a set
+static size_t set_index(unsigned long hash, size_t n_sets) {
+    return hash_mix(hash) % n_sets;
+}
+
+
+static void delete_page_arg(void* page) {
+    delete_page(page);
+}
+
+
+static void retire_page(page_t* page, void* arg) {
+    shared_cache_t* shared = arg;
+    // Front caches compare generation before touching the page, so bump goes first
+    atomic_fetch_add(&shared->generations[key_hash(page->key) % N_GENERATIONS], 1);
+    ebr_retire(shared->ebr, page, &delete_page_arg);
+}
+
+
+shared_cache_t* create_shared_cache(const cache_config_t* config) {
+    shared_cache_t* shared = malloc(sizeof(shared_cache_t));
+    if (shared == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache_config_t shared_config = *config;
+    shared_config.release_page = &retire_page;
+    shared_config.release_arg = shared;
+    shared->cache = create_cache_with_config(&shared_config);
+    if (shared->cache == NULL) {
+        free(shared);
+        return NULL;
+    }
+    pthread_mutex_init(&shared->mutex, NULL);
+    shared->ebr = create_ebr();
+    for (size_t i = 0; i < N_GENERATIONS; ++i) {
+        atomic_init(&shared->generations[i], 0);
+    }
+    return shared;
+}
+
+
+void delete_shared_cache(shared_cache_t* shared) {
+    if (shared == NULL) {
+        return;
+    }
+    delete_cache(shared->cache);
+    delete_ebr(shared->ebr);
+    pthread_mutex_destroy(&shared->mutex);
+    free(shared);
+}
+
+
+// Returns generation of the key together with the page, generation is stable under the lock
+static const page_t* locked_call(shared_cache_t* shared, const char* key, unsigned long hash,
+                                 page_t* (*get_page_slow)(const char*), uint64_t* generation) {
+    pthread_mutex_lock(&shared->mutex);
+    const page_t* page = cached_call(shared->cache, key, get_page_slow);
+    *generation = atomic_load_explicit(&shared->generations[hash % N_GENERATIONS], memory_order_relaxed);
+    pthread_mutex_unlock(&shared->mutex);
+    return page;
+}
+
+
+const page_t* shared_cached_call(shared_cache_t* shared, const char* key, page_t* (*get_page_slow)(const char*)) {
+    uint64_t generation;
+    return locked_call(shared, key, key_hash(key), get_page_slow, &generation);
+}
+
+
+bool shared_cache_put_if_version(shared_cache_t* shared, const char* key, page_t* page) {
+    pthread_mutex_lock(&shared->mutex);
+    bool stored = cache_put_if_version(shared->cache, key, page);
+    pthread_mutex_unlock(&shared->mutex);
+    return stored;
+}
+
+
+cache_stats_t shared_cache_stats(shared_cache_t* shared) {
+    pthread_mutex_lock(&shared->mutex);
+    cache_stats_t stats = cache_stats(shared->cache);
+    pthread_mutex_unlock(&shared->mutex);
+    return stats;
+}
+
+
+ebr_t* shared_cache_ebr(shared_cache_t* shared) {
+    return shared->ebr;
+}
+
+
+front_cache_t* create_front_cache(shared_cache_t* shared, size_t n_sets) {
+    if (n_sets == 0) {
+        return NULL;
+    }
+    front_cache_t* front = malloc(sizeof(front_cache_t));
+    front_slot_t* slots = calloc(n_sets * N_WAYS, sizeof(front_slot_t));
+    if (front == NULL || slots == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    front->shared = shared;
+    front->slots = slots;
+    front->n_sets = n_sets;
+    front->n_calls = 0;
+    front->pinned = false;
+    front->stats.hits = 0;
+    front->stats.misses = 0;
+    return front;
+}
+
+
+void delete_front_cache(front_cache_t* front) {
+    if (front != NULL) {
+        front_cache_release(front);
+        free(front->slots);
+    }
+    free(front);
+}
+
+
+void front_cache_release(front_cache_t* front) {
+    if (front->pinned) {
+        ebr_exit(front->shared->ebr);
+        front->pinned = false;
+    }
+}
+
+
+const page_t* front_cached_call(front_cache_t* front, const char* key, page_t* (*get_page_slow)(const char*)) {
+    shared_cache_t* shared = front->shared;
+    if (!front->pinned) {
+        ebr_enter(shared->ebr);
+        front->pinned = true;
+    } else if (++front->n_calls % REPIN_PERIOD == 0) {
+        ebr_exit(shared->ebr);
+        ebr_enter(shared->ebr);
+    }
+
+    unsigned long hash = key_hash(key);
+    front_slot_t* set = &front->slots[set_index(hash, front->n_sets) * N_WAYS];
+    uint64_t generation = atomic_load(&shared->generations[hash % N_GENERATIONS]);
+    for (size_t way = 0; way < N_WAYS; ++way) {
+        front_slot_t* slot = &set[way];
+        // Stale page may already be freed, its key is compared only after generation check
+        if (slot->page != NULL && slot->hash == hash && slot->generation == generation &&
+                key_equal(slot->page->key, key)) {
+            if (way != 0) {
+                front_slot_t hit_slot = *slot;
+                set[way] = set[0];
+                set[0] = hit_slot;
+            }
+            ++front->stats.hits;
+            return set[0].page;
+        }
+    }
+
+    ++front->stats.misses;
+    const page_t* page = locked_call(shared, key, hash, get_page_slow, &generation);
+    if (page != NULL) {
+        set[N_WAYS - 1] = set[0];
+        set[0].hash = hash;
+        set[0].page = page;
+        set[0].generation = generation;
+    }
+    return page;
+}
+
+
+front_stats_t front_cache_stats(const front_cache_t* front) {
+    return front->stats;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cache.h"
+#include "ebr.h"
+
+// lru_cache_t shared between threads behind a mutex, with per-thread front caches.
+// Shared cache counts changes of keys in generation counters (striped by key hash)
+// and frees pages through epoch-based reclamation, so front caches can keep
+// references to its pages and check them without locking or shared writes.
+typedef struct shared_cache_t shared_cache_t;
+// Small 2-way set associative cache of one thread. Its hits do not refresh
+// recency in shared cache, pages evicted there are dropped from front on next access.
+typedef struct front_cache_t front_cache_t;
+
+typedef struct front_stats_t {
+    size_t hits;
+    size_t misses;  // includes hits on stale entries
+} front_stats_t;
+
+// release_page of config is used by shared cache itself
+shared_cache_t* create_shared_cache(const cache_config_t*);
+// Front caches should be deleted first
+void delete_shared_cache(shared_cache_t*);
+// Caller should be inside ebr critical section of shared_cache_ebr while using the page
+const page_t* shared_cached_call(shared_cache_t*, const char*, page_t* (*)(const char*));
+// Page loaded without holding the lock, stored if it is newer than cached one
+bool shared_cache_put_if_version(shared_cache_t*, const char*, page_t*);
+cache_stats_t shared_cache_stats(shared_cache_t*);
+ebr_t* shared_cache_ebr(shared_cache_t*);
+
+front_cache_t* create_front_cache(shared_cache_t*, size_t n_sets);
+void delete_front_cache(front_cache_t*);
+// Returned page is valid until the next call on the same front cache
+const page_t* front_cached_call(front_cache_t*, const char*, page_t* (*)(const char*));
+// Lets reclamation proceed while thread is idle, invalidates returned pages
+void front_cache_release(front_cache_t*);
+front_stats_t front_cache_stats(const front_cache_t*);
@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "ghost.h"
+
+
+#define NIL UINT32_MAX
+
+
+typedef struct ghost_entry_t {
+    unsigned long hash;
+    uint32_t prev;   // more recent entry
+    uint32_t next;   // less recent entry
+    uint32_t chain;  // next entry in bucket, also links free entries
+} ghost_entry_t;
+
+
+struct ghost_list_t {
+    ghost_entry_t* entries;
+    uint32_t* buckets;
+    size_t n_buckets;  // power of 2
+    size_t capacity;
+    size_t length;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t free;
+};
+
+
+static size_t bucket_index(const ghost_list_t* ghosts, unsigned long hash) {
+    return (size_t) ((hash * 0x9E3779B97F4A7C15ull) >> 32) & (ghosts->n_buckets - 1);
+}
+
+
+// Allocates empty arrays for capacity, old ones are not freed
+static void init_ghost_list(ghost_list_t* ghosts, size_t capacity) {
+    ghosts->n_buckets = 1;
+    while (ghosts->n_buckets < capacity) {
+        ghosts->n_buckets *= 2;
+    }
+    ghosts->entries = malloc(sizeof(ghost_entry_t) * (capacity > 0 ? capacity : 1));
+    ghosts->buckets = malloc(sizeof(uint32_t) * ghosts->n_buckets);
+    if (ghosts->entries == NULL || ghosts->buckets == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < ghosts->n_buckets; ++i) {
+        ghosts->buckets[i] = NIL;
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        ghosts->entries[i].chain = i + 1 < capacity ? (uint32_t) (i + 1) : NIL;
+    }
+    ghosts->capacity = capacity;
+    ghosts->length = 0;
+    ghosts->head = NIL;
+    ghosts->tail = NIL;
+    ghosts->free = capacity > 0 ? 0 : NIL;
+}
+
+
+ghost_list_t* create_ghost_list(size_t capacity) {
+    ghost_list_t* ghosts = malloc(sizeof(ghost_list_t));
+    if (ghosts == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    init_ghost_list(ghosts, capacity);
+    return ghosts;
+}
+
+
+void ghost_list_resize(ghost_list_t* ghosts, size_t capacity) {
+    if (capacity == ghosts->capacity) {
+        return;
+    }
+    ghost_entry_t* old_entries = ghosts->entries;
+    uint32_t* old_buckets = ghosts->buckets;
+    // Most recent ghosts that fit are pushed again, the oldest one first
+    size_t n_kept = ghosts->length < capacity ? ghosts->length : capacity;
+    uint32_t idx = ghosts->head;
+    for (size_t i = 1; i < n_kept; ++i) {
+        idx = old_entries[idx].next;
+    }
+    init_ghost_list(ghosts, capacity);
+    for (size_t i = 0; i < n_kept; ++i) {
+        ghost_list_push(ghosts, old_entries[idx].hash);
+        idx = old_entries[idx].prev;
+    }
+    free(old_entries);
+    free(old_buckets);
+}
+
+
+void delete_ghost_list(ghost_list_t* ghosts) {
+    if (ghosts != NULL) {
+        free(ghosts->entries);
+        free(ghosts->buckets);
+        free(ghosts);
+    }
+}
+
+
+static uint32_t find_entry(const ghost_list_t* ghosts, unsigned long hash) {
+    uint32_t idx = ghosts->buckets[bucket_index(ghosts, hash)];
+    while (idx != NIL && ghosts->entries[idx].hash != hash) {
+        idx = ghosts->entries[idx].chain;
+    }
+    return idx;
+}
+
+
+static void unlink_entry(ghost_list_t* ghosts, uint32_t idx) {
+    ghost_entry_t* entry = &ghosts->entries[idx];
+
+    // Recency list
+    if (entry->prev != NIL) {
+        ghosts->entries[entry->prev].next = entry->next;
+    } else {
+        ghosts->head = entry->next;
+    }
+    if (entry->next != NIL) {
+        ghosts->entries[entry->next].prev = entry->prev;
+    } else {
+        ghosts->tail = entry->prev;
+    }
+
+    // Bucket chain
+    uint32_t* link = &ghosts->buckets[bucket_index(ghosts, entry->hash)];
+    while (*link != idx) {  // should exist
+        link = &ghosts->entries[*link].chain;
+    }
+    *link = entry->chain;
+
+    entry->chain = ghosts->free;
+    ghosts->free = idx;
+    --ghosts->length;
+}
+
+
+void ghost_list_push(ghost_list_t* ghosts, unsigned long hash) {
+    if (ghosts->capacity == 0) {
+        return;
+    }
+    uint32_t idx = find_entry(ghosts, hash);
+    if (idx != NIL) {
+        unlink_entry(ghosts, idx);
+    } else if (ghosts->length == ghosts->capacity) {
+        unlink_entry(ghosts, ghosts->tail);
+    }
+
+    idx = ghosts->free;
+    ghost_entry_t* entry = &ghosts->entries[idx];
+    ghosts->free = entry->chain;
+
+    size_t buck = bucket_index(ghosts, hash);
+    entry->hash = hash;
+    entry->chain = ghosts->buckets[buck];
+    ghosts->buckets[buck] = idx;
+
+    entry->prev = NIL;
+    entry->next = ghosts->head;
+    if (ghosts->head != NIL) {
+        ghosts->entries[ghosts->head].prev = idx;
+    } else {
+        ghosts->tail = idx;
+    }
+    ghosts->head = idx;
+    ++ghosts->length;
+}
+
+
+bool ghost_list_remove(ghost_list_t* ghosts, unsigned long hash) {
+    if (ghosts->length == 0) {
+        return false;
+    }
+    uint32_t idx = find_entry(ghosts, hash);
+    if (idx == NIL) {
+        return false;
+    }
+    unlink_entry(ghosts, idx);
+    return true;
+}
+
+
+bool ghost_list_contains(const ghost_list_t* ghosts, unsigned long hash) {
+    return ghosts->length != 0 && find_entry(ghosts, hash) != NIL;
+}
+
+
+void ghost_list_pop_back(ghost_list_t* ghosts) {
+    if (ghosts->length != 0) {
+        unlink_entry(ghosts, ghosts->tail);
+    }
+}
+
+
+size_t ghost_list_length(const ghost_list_t* ghosts) {
+    return ghosts->length;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bounded LRU list of keys evicted from cache ("ghosts").
+// Only key hashes are stored, so a ghost costs a few words regardless of key length,
+// hash collisions may give false positives which is harmless for eviction policies.
+typedef struct ghost_list_t ghost_list_t;
+
+ghost_list_t* create_ghost_list(size_t);
+void delete_ghost_list(ghost_list_t*);
+// Changes capacity keeping the most recent ghosts that fit
+void ghost_list_resize(ghost_list_t*, size_t);
+
+// Inserts hash as most recent, the least recent one is dropped when list is full
+void ghost_list_push(ghost_list_t*, unsigned long);
+bool ghost_list_remove(ghost_list_t*, unsigned long);
+bool ghost_list_contains(const ghost_list_t*, unsigned long);
+void ghost_list_pop_back(ghost_list_t*);
+
+size_t ghost_list_length(const ghost_list_t*);
@@ -1,28 +1,46 @@
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "hashtable.h"
+#include "hugemem.h"
+#include "inline_key.h"
+#include "trace.h"
 
 
 #define MAX_LOAD_FACTOR 1
+#define REHASH_STEP 16         // old buckets moved per put or delete while rehashing
+#define SCAN_EMPTY_VISITS 10   // empty buckets a scan step may visit per requested entry
 
 
 struct hashtable_entry_t {
-    char* key;
+    inline_key_t key;
     list_node_t* node;
     hashtable_entry_t* next;
 };
 
 
+// Rehash is incremental: new table is allocated at once and entries are moved from
+// old one a few buckets per modification, lookups check both tables meanwhile
 struct hashtable_t {
     hashtable_entry_t **table;
     size_t n_buckets;
     size_t n_entries;
+    hashtable_entry_t **old_table;  // NULL unless rehash is in progress
+    size_t old_n_buckets;
+    size_t rehash_pos;              // old buckets before it are already moved
+    size_t min_buckets;             // table does not shrink below, power of two
+    bool huge_pages;
 };
 
 
 static void rehash(hashtable_t*);
+static void rehash_step(hashtable_t*, size_t);
+static hashtable_entry_t** alloc_table(const hashtable_t*, size_t);
+static void free_table(const hashtable_t*, hashtable_entry_t**, size_t);
 static hashtable_entry_t** get_bucket(const hashtable_t*, const char*);
+static hashtable_entry_t** find_entry_link(const hashtable_t*, const char*);
 static hashtable_entry_t* find_entry(const hashtable_t*, const char*);
 
 
@@ -32,7 +50,7 @@ static hashtable_entry_t* create_hashtable_entry(const char* key, list_node_t* n
         puts("malloc failed");
         exit(EXIT_FAILURE);
     }
-    entry->key = string_dup(key);
+    inline_key_set(&entry->key, key);
     entry->node = node;
     entry->next = next;
     return entry;
@@ -41,12 +59,17 @@ static hashtable_entry_t* create_hashtable_entry(const char* key, list_node_t* n
 
 static void delete_hashtable_entry(hashtable_entry_t* entry) {
     if (entry != NULL) {
-        free(entry->key);
+        inline_key_free(&entry->key);
         free(entry);
     }
 }
 
 
+static const char* entry_key(const hashtable_entry_t* entry) {
+    return inline_key_get(&entry->key);
+}
+
+
 hashtable_t* create_hashtable(void) {
     hashtable_t* htable = malloc(sizeof(hashtable_t));
     if (htable == NULL) {
@@ -56,26 +79,83 @@ hashtable_t* create_hashtable(void) {
     htable->table = NULL;
     htable->n_buckets = 0;
     htable->n_entries = 0;
+    htable->old_table = NULL;
+    htable->old_n_buckets = 0;
+    htable->rehash_pos = 0;
+    htable->min_buckets = 1;
+    htable->huge_pages = false;
     return htable;
 }
 
 
+static void delete_table(const hashtable_t* htable, hashtable_entry_t** table, size_t n_buckets) {
+    for (size_t i = 0; i < n_buckets; ++i) {
+        hashtable_entry_t* next = table[i];
+        while(next != NULL) {
+            hashtable_entry_t* entry = next;
+            next = entry->next;
+            delete_hashtable_entry(entry);
+        }
+    }
+    free_table(htable, table, n_buckets);
+}
+
+
 void delete_hashtable(hashtable_t* htable) {
     if (htable != NULL) {
-        for (size_t i = 0; i < htable->n_buckets; ++i) {
-            hashtable_entry_t* next = htable->table[i];
-            while(next != NULL) {
-                hashtable_entry_t* entry = next;
-                next = entry->next;
-                delete_hashtable_entry(entry);
-            }
+        delete_table(htable, htable->table, htable->n_buckets);
+        if (htable->old_table != NULL) {
+            delete_table(htable, htable->old_table, htable->old_n_buckets);
         }
-        free(htable->table);
         free(htable);
     }
 }
 
 
+void hashtable_use_huge_pages(hashtable_t* htable, bool huge_pages) {
+    // Only affects tables allocated later, current one is freed the same way it was allocated
+    if (htable->n_buckets == 0 && htable->old_table == NULL) {
+        htable->huge_pages = huge_pages;
+    }
+}
+
+
+static size_t buckets_for(size_t n_entries) {
+    size_t n_buckets = 1;
+    while (n_buckets < n_entries / MAX_LOAD_FACTOR) {
+        n_buckets *= 2;
+    }
+    return n_buckets;
+}
+
+
+void hashtable_reserve(hashtable_t* htable, size_t n_entries) {
+    size_t n_buckets = buckets_for(n_entries);
+    htable->min_buckets = n_buckets;
+    if (htable->n_entries == 0 || htable->n_buckets >= n_buckets) {
+        return;
+    }
+    // One full rehash now instead of a series of doublings later
+    if (htable->old_table != NULL) {
+        rehash_step(htable, htable->old_n_buckets);
+    }
+    htable->old_table = htable->table;
+    htable->old_n_buckets = htable->n_buckets;
+    htable->rehash_pos = 0;
+    htable->table = alloc_table(htable, n_buckets);
+    htable->n_buckets = n_buckets;
+    rehash_step(htable, htable->old_n_buckets);
+}
+
+
+void hashtable_limit_reserve(hashtable_t* htable, size_t n_entries) {
+    size_t n_buckets = buckets_for(n_entries);
+    if (n_buckets < htable->min_buckets) {
+        htable->min_buckets = n_buckets;
+    }
+}
+
+
 bool hashtable_is_empty(const hashtable_t* htable) {
     return htable->n_entries == 0;
 }
@@ -97,22 +177,20 @@ list_node_t* hashtable_get(const hashtable_t* htable, const char* key) {
 
 
 void hashtable_put(hashtable_t* htable, const char* key, list_node_t* node) {
+    TRACE_BEGIN(start);
     if (htable->n_entries == 0) {
-        htable->table = malloc(sizeof(hashtable_entry_t*));
-        if (htable->table == NULL) {
-            puts("malloc failed");
-            exit(EXIT_FAILURE);
-        }
-        ++htable->n_buckets;
+        htable->table = alloc_table(htable, htable->min_buckets);
+        htable->n_buckets = htable->min_buckets;
 
         hashtable_entry_t* entry = create_hashtable_entry(key, node, NULL);
-        htable->table[0] = entry;
+        *get_bucket(htable, key) = entry;
     } else {
         hashtable_entry_t* entry = find_entry(htable, key);
 
         // Overwrite existing node
         if (entry != NULL) {
             entry->node = node;
+            TRACE_END(TRACE_TABLE_PUT, start);
             return;
         }
 
@@ -126,7 +204,10 @@ void hashtable_put(hashtable_t* htable, const char* key, list_node_t* node) {
         
     }
     ++htable->n_entries;
+    TRACE_BEGIN(rehash_start);
     rehash(htable);
+    TRACE_END(TRACE_REHASH, rehash_start);
+    TRACE_END(TRACE_TABLE_PUT, start);
 }
 
 
@@ -135,41 +216,120 @@ bool hashtable_delete_entry(hashtable_t* htable, const char* key) {
         return false;
     }
 
-    hashtable_entry_t* entry = find_entry(htable, key);
-    if (entry == NULL) {
+    TRACE_BEGIN(start);
+    hashtable_entry_t** link = find_entry_link(htable, key);
+    if (*link == NULL) {
+        TRACE_END(TRACE_TABLE_DELETE, start);
         return false;
     }
-
-    hashtable_entry_t** bucket_ptr = get_bucket(htable, key);
-    if ((*bucket_ptr)->next == NULL) {
-        // Then bucket has only one entry
-        *bucket_ptr = NULL;
-    } else if (*bucket_ptr == entry) {
-        // Entry is first in the list
-        *bucket_ptr = entry->next;
-    } else {
-        // Search list for entry (we need to store previous entry)
-        hashtable_entry_t* test_entry = *bucket_ptr;
-        while (test_entry->next != entry) {  // should exist
-            test_entry = test_entry->next;
-        }
-        test_entry->next = entry->next;
-    }
-    
+    hashtable_entry_t* entry = *link;
+    *link = entry->next;
     delete_hashtable_entry(entry);
     --htable->n_entries;
 
     if (htable->n_entries != 0) {
-        rehash(htable);        
+        TRACE_BEGIN(rehash_start);
+        rehash(htable);
+        TRACE_END(TRACE_REHASH, rehash_start);
     } else {
-        free(htable->table);
+        free_table(htable, htable->table, htable->n_buckets);
         htable->table = NULL;
         htable->n_buckets = 0;
+        if (htable->old_table != NULL) {
+            free_table(htable, htable->old_table, htable->old_n_buckets);
+            htable->old_table = NULL;
+            htable->old_n_buckets = 0;
+        }
     }
+    TRACE_END(TRACE_TABLE_DELETE, start);
     return true;
 }
 
 
+void hashtable_for_each(const hashtable_t* htable, void (*func)(const char*, list_node_t*, void*), void* arg) {
+    for (size_t buck = 0; buck < htable->n_buckets; ++buck) {
+        for (hashtable_entry_t* entry = htable->table[buck]; entry != NULL; entry = entry->next) {
+            func(entry_key(entry), entry->node, arg);
+        }
+    }
+    if (htable->old_table != NULL) {
+        for (size_t buck = htable->rehash_pos; buck < htable->old_n_buckets; ++buck) {
+            for (hashtable_entry_t* entry = htable->old_table[buck]; entry != NULL; entry = entry->next) {
+                func(entry_key(entry), entry->node, arg);
+            }
+        }
+    }
+}
+
+
+static size_t reverse_bits(size_t v) {
+    size_t bits = sizeof(v) * CHAR_BIT;
+    size_t mask = ~(size_t) 0;
+    while ((bits >>= 1) > 0) {
+        mask ^= mask << bits;
+        v = ((v >> bits) & mask) | ((v << bits) & ~mask);
+    }
+    return v;
+}
+
+
+// Increments high bits of cursor first, so buckets of a table twice as large or half as
+// large that hold what the visited ones held are all behind the new cursor
+static size_t next_cursor(size_t cursor, size_t mask) {
+    cursor |= ~mask;
+    return reverse_bits(reverse_bits(cursor) + 1);
+}
+
+
+static size_t scan_bucket(hashtable_entry_t* entry, void (*func)(const char*, list_node_t*, void*), void* arg) {
+    size_t count = 0;
+    for (; entry != NULL; entry = entry->next, ++count) {
+        func(entry_key(entry), entry->node, arg);
+    }
+    return count;
+}
+
+
+size_t hashtable_scan(const hashtable_t* htable, size_t cursor, size_t count,
+                      void (*func)(const char*, list_node_t*, void*), void* arg) {
+    if (htable->n_entries == 0) {
+        return 0;
+    }
+    count = count > 0 ? count : 1;
+    size_t max_visits = count <= SIZE_MAX / SCAN_EMPTY_VISITS ? count * SCAN_EMPTY_VISITS : SIZE_MAX;
+    size_t n_seen = 0;
+    for (size_t n_visits = 0; n_seen < count && n_visits < max_visits; ++n_visits) {
+        if (htable->old_table == NULL) {
+            size_t mask = htable->n_buckets - 1;
+            n_seen += scan_bucket(htable->table[cursor & mask], func, arg);
+            cursor = next_cursor(cursor, mask);
+        } else {
+            // Bucket of smaller table and all buckets of larger one its entries go to.
+            // Moved old buckets are empty, their entries are found in the new table.
+            hashtable_entry_t** small = htable->table;
+            hashtable_entry_t** large = htable->old_table;
+            size_t small_mask = htable->n_buckets - 1;
+            size_t large_mask = htable->old_n_buckets - 1;
+            if (small_mask > large_mask) {
+                small = htable->old_table;
+                large = htable->table;
+                small_mask = htable->old_n_buckets - 1;
+                large_mask = htable->n_buckets - 1;
+            }
+            n_seen += scan_bucket(small[cursor & small_mask], func, arg);
+            do {
+                n_seen += scan_bucket(large[cursor & large_mask], func, arg);
+                cursor = next_cursor(cursor, large_mask);
+            } while ((cursor & (small_mask ^ large_mask)) != 0);
+        }
+        if (cursor == 0) {
+            break;
+        }
+    }
+    return cursor;
+}
+
+
 void hashtable_print(const hashtable_t* htable) {
     printf("Hash table %p\n", htable);
     if (htable->n_entries == 0) {
@@ -182,22 +342,35 @@ void hashtable_print(const hashtable_t* htable) {
         hashtable_entry_t* entry = htable->table[buck];
         size_t count = 0;
         while (entry != NULL) {
-            printf("\tEntry %zu: addr=%p, key=%s, node=%p, next=%p\n", count, entry, entry->key, entry->node, entry->next);
+            printf("\tEntry %zu: addr=%p, key=%s, node=%p, next=%p\n", count, entry, entry_key(entry), entry->node, entry->next);
             entry = entry->next;
             ++count;
         }
     }
+    if (htable->old_table != NULL) {
+        printf("rehashing, %zu of %zu old buckets moved\n", htable->rehash_pos, htable->old_n_buckets);
+        for (size_t buck = htable->rehash_pos; buck < htable->old_n_buckets; ++buck) {
+            for (hashtable_entry_t* entry = htable->old_table[buck]; entry != NULL; entry = entry->next) {
+                printf("\tOld bucket %zu: addr=%p, key=%s, node=%p\n", buck, entry, entry_key(entry), entry->node);
+            }
+        }
+    }
 }
 
 
 static void rehash(hashtable_t* htable) {
     // When this funcion is called, n_buckets > 0 and n_entries > 0
+    if (htable->old_table != NULL) {
+        rehash_step(htable, REHASH_STEP);
+        return;
+    }
     if (htable->n_entries == 1) {
         return;
     }
     float load_factor = (float) htable->n_entries / htable->n_buckets;
-    if ((load_factor > MAX_LOAD_FACTOR) || (load_factor < (float) MAX_LOAD_FACTOR / 4)) {
-        // Perform rehash
+    bool can_shrink = htable->n_buckets > htable->min_buckets;
+    if ((load_factor > MAX_LOAD_FACTOR) || (can_shrink && load_factor < (float) MAX_LOAD_FACTOR / 4)) {
+        // Start rehash, entries are moved by later modifications
         size_t new_n_buckets = 1;
         if (load_factor > MAX_LOAD_FACTOR) {
             new_n_buckets = htable->n_buckets * 2;
@@ -205,35 +378,69 @@ static void rehash(hashtable_t* htable) {
             new_n_buckets = htable->n_buckets / 2;
         }
         
-        hashtable_entry_t** old_table = htable->table;
-        size_t old_n_buckets = htable->n_buckets;
-        htable->table = malloc(sizeof(hashtable_entry_t*) * new_n_buckets);
-        if (htable->table == NULL) {
-            puts("malloc failure");
-            exit(EXIT_FAILURE);
-        }
-        for (size_t i = 0; i < new_n_buckets; ++i) {
-            htable->table[i] = NULL;
-        }
+        htable->old_table = htable->table;
+        htable->old_n_buckets = htable->n_buckets;
+        htable->rehash_pos = 0;
+        htable->table = alloc_table(htable, new_n_buckets);
         htable->n_buckets = new_n_buckets;
+        rehash_step(htable, REHASH_STEP);
+    }
+}
 
-        for (size_t buck_num = 0; buck_num < old_n_buckets; ++buck_num) {
-            hashtable_entry_t* node = old_table[buck_num];
-            while (node != NULL) {
-                hashtable_entry_t* next_node = node->next;
-                hashtable_entry_t** new_bucket_ptr = get_bucket(htable, node->key);
-                if (*new_bucket_ptr == NULL) {
-                    // First node of the list
-                    node->next = NULL;
-                } else {
-                    // Add to list head
-                    node->next = *new_bucket_ptr;
-                }
-                *new_bucket_ptr = node;
-                node = next_node;
-            }
+
+// Moves entries of up to n_steps old buckets to the new table
+static void rehash_step(hashtable_t* htable, size_t n_steps) {
+    size_t end = htable->rehash_pos + n_steps;
+    if (end > htable->old_n_buckets) {
+        end = htable->old_n_buckets;
+    }
+    for (size_t buck_num = htable->rehash_pos; buck_num < end; ++buck_num) {
+        hashtable_entry_t* node = htable->old_table[buck_num];
+        while (node != NULL) {
+            hashtable_entry_t* next_node = node->next;
+            hashtable_entry_t** new_bucket_ptr = get_bucket(htable, entry_key(node));
+            // Add to list head
+            node->next = *new_bucket_ptr;
+            *new_bucket_ptr = node;
+            node = next_node;
+        }
+        htable->old_table[buck_num] = NULL;
+    }
+    htable->rehash_pos = end;
+    if (end == htable->old_n_buckets) {
+        free_table(htable, htable->old_table, htable->old_n_buckets);
+        htable->old_table = NULL;
+        htable->old_n_buckets = 0;
+        htable->rehash_pos = 0;
+    }
+}
+
+
+// Returns table with all buckets set to NULL
+static hashtable_entry_t** alloc_table(const hashtable_t* htable, size_t n_buckets) {
+    hashtable_entry_t** table;
+    if (htable->huge_pages) {
+        table = huge_alloc(sizeof(hashtable_entry_t*) * n_buckets, NULL);
+        for (size_t i = 0; i < n_buckets; ++i) {
+            table[i] = NULL;
         }
-        free(old_table);
+    } else {
+        // Large zeroed blocks come straight from the kernel, no clearing stall
+        table = calloc(n_buckets, sizeof(hashtable_entry_t*));
+        if (table == NULL) {
+            puts("calloc failure");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return table;
+}
+
+
+static void free_table(const hashtable_t* htable, hashtable_entry_t** table, size_t n_buckets) {
+    if (htable->huge_pages) {
+        huge_free(table, sizeof(hashtable_entry_t*) * n_buckets);
+    } else {
+        free(table);
     }
 }
 
@@ -243,18 +450,47 @@ static hashtable_entry_t** get_bucket(const hashtable_t* htable, const char* key
 }
 
 
-static hashtable_entry_t* find_entry(const hashtable_t* htable, const char* key) {
-    if (htable->n_entries == 0) {
-        return NULL;
+// Returns link to the entry with the key or to the end of its chain in the new table
+static hashtable_entry_t** find_in_chain(hashtable_entry_t** link, const char* key, size_t key_len) {
+    // Inline keys are compared by length first, without touching other memory
+    while (*link != NULL) {
+        hashtable_entry_t* entry = *link;
+        if (entry->key.len == KEY_SPILLED) {
+            if (key_equal(entry->key.heap, key) == true) {
+                break;
+            }
+        } else if (entry->key.len == key_len && memcmp(entry->key.buf, key, key_len) == 0) {
+            break;
+        }
+        link = &entry->next;
     }
+    return link;
+}
 
-    hashtable_entry_t* entry = *get_bucket(htable, key);
-    while (entry != NULL) {        
-        if (key_equal(entry->key, key) == true) {
-            break;
+
+// Table should not be empty
+static hashtable_entry_t** find_entry_link(const hashtable_t* htable, const char* key) {
+    TRACE_BEGIN(hash_start);
+    size_t hash = key_hash(key);
+    size_t key_len = strlen(key);
+    TRACE_END(TRACE_HASH, hash_start);
+    TRACE_BEGIN(probe_start);
+    hashtable_entry_t** link = find_in_chain(&htable->table[hash % htable->n_buckets], key, key_len);
+    if (*link == NULL && htable->old_table != NULL) {
+        // Moved buckets are empty, so no need to check rehash position
+        hashtable_entry_t** old_link = find_in_chain(&htable->old_table[hash % htable->old_n_buckets], key, key_len);
+        if (*old_link != NULL) {
+            link = old_link;
         }
-        entry = entry->next;
     }
-    return entry;
+    TRACE_END(TRACE_PROBE, probe_start);
+    return link;
 }
 
+
+static hashtable_entry_t* find_entry(const hashtable_t* htable, const char* key) {
+    if (htable->n_entries == 0) {
+        return NULL;
+    }
+    return *find_entry_link(htable, key);
+}
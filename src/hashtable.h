@@ -9,11 +9,25 @@ typedef struct hashtable_entry_t hashtable_entry_t;
 
 hashtable_t* create_hashtable(void);
 void delete_hashtable(hashtable_t*);
+// Back bucket array with 2 MB pages when it is large enough, only for empty table
+void hashtable_use_huge_pages(hashtable_t*, bool);
+// Sizes table for n entries at once, it does not shrink below that size later
+void hashtable_reserve(hashtable_t*, size_t);
+// Lowers reserved size to at most n entries, table shrinks with later deletes
+void hashtable_limit_reserve(hashtable_t*, size_t);
 bool hashtable_is_empty(const hashtable_t*);
 size_t hashtable_length(const hashtable_t*);
 list_node_t* hashtable_get(const hashtable_t*, const char*);
 void hashtable_put(hashtable_t*, const char*, list_node_t*);
 bool hashtable_delete_entry(hashtable_t*, const char*);
+// Calls function with every key and node, table must not be modified meanwhile
+void hashtable_for_each(const hashtable_t*, void (*)(const char*, list_node_t*, void*), void*);
+// Resumable walk like Redis SCAN: start with cursor 0 and pass returned cursor to the
+// next call until it returns 0. Each call visits whole buckets until about count entries
+// were seen. Table may be modified between calls: entries present for the whole walk
+// are visited at least once, ones moved by a resize in between may be visited twice.
+size_t hashtable_scan(const hashtable_t*, size_t cursor, size_t count,
+                      void (*)(const char*, list_node_t*, void*), void*);
 
 void hashtable_print(const hashtable_t*);
 
@@ -0,0 +1,181 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hot_keys.h"
+#include "util.h"
+
+
+#define SKETCH_ROWS 4
+
+
+struct hot_key_sketch_t {
+    uint32_t* counters;  // SKETCH_ROWS rows of width
+    size_t mask;         // width - 1
+    size_t window;
+    size_t n_added;      // since counters were halved
+    size_t threshold;
+};
+
+
+struct replica_table_t {
+    _Atomic(page_t*)* slots;
+    size_t mask;
+    ebr_t* ebr;
+};
+
+
+static size_t round_up_pow2(size_t n) {
+    size_t pow2 = 1;
+    while (pow2 < n) {
+        pow2 *= 2;
+    }
+    return pow2;
+}
+
+
+hot_key_sketch_t* create_hot_key_sketch(size_t width, size_t window, double hot_share) {
+    hot_key_sketch_t* sketch = malloc(sizeof(hot_key_sketch_t));
+    if (sketch == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    width = round_up_pow2(width);
+    sketch->counters = calloc(SKETCH_ROWS * width, sizeof(uint32_t));
+    if (sketch->counters == NULL) {
+        puts("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    sketch->mask = width - 1;
+    sketch->window = window;
+    sketch->n_added = 0;
+    sketch->threshold = (size_t) (hot_share * window);
+    sketch->threshold = sketch->threshold > 0 ? sketch->threshold : 1;
+    return sketch;
+}
+
+
+void delete_hot_key_sketch(hot_key_sketch_t* sketch) {
+    if (sketch != NULL) {
+        free(sketch->counters);
+    }
+    free(sketch);
+}
+
+
+// Rows use double hashing: h1 + row * h2
+static uint32_t* counter(const hot_key_sketch_t* sketch, uint64_t mixed, size_t row) {
+    size_t step = (mixed >> 32) | 1;
+    return &sketch->counters[row * (sketch->mask + 1) + ((mixed + row * step) & sketch->mask)];
+}
+
+
+bool hot_key_sketch_add(hot_key_sketch_t* sketch, unsigned long hash) {
+    if (++sketch->n_added == sketch->window) {
+        sketch->n_added = 0;
+        for (size_t i = 0; i < SKETCH_ROWS * (sketch->mask + 1); ++i) {
+            sketch->counters[i] >>= 1;
+        }
+    }
+    uint64_t mixed = hash_mix(hash);
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+        uint32_t* count = counter(sketch, mixed, row);
+        if (*count != UINT32_MAX) {
+            ++*count;
+        }
+        estimate = *count < estimate ? *count : estimate;
+    }
+    return estimate >= sketch->threshold;
+}
+
+
+size_t hot_key_sketch_estimate(const hot_key_sketch_t* sketch, unsigned long hash) {
+    uint64_t mixed = hash_mix(hash);
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+        uint32_t count = *counter(sketch, mixed, row);
+        estimate = count < estimate ? count : estimate;
+    }
+    return estimate;
+}
+
+
+replica_table_t* create_replica_table(size_t n_slots, ebr_t* ebr) {
+    replica_table_t* replicas = malloc(sizeof(replica_table_t));
+    if (replicas == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    n_slots = round_up_pow2(n_slots);
+    replicas->slots = malloc(sizeof(_Atomic(page_t*)) * n_slots);
+    if (replicas->slots == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n_slots; ++i) {
+        atomic_init(&replicas->slots[i], NULL);
+    }
+    replicas->mask = n_slots - 1;
+    replicas->ebr = ebr;
+    return replicas;
+}
+
+
+void delete_replica_table(replica_table_t* replicas) {
+    if (replicas == NULL) {
+        return;
+    }
+    for (size_t i = 0; i <= replicas->mask; ++i) {
+        delete_page(atomic_load(&replicas->slots[i]));
+    }
+    free(replicas->slots);
+    free(replicas);
+}
+
+
+static _Atomic(page_t*)* slot(const replica_table_t* replicas, unsigned long hash) {
+    return &replicas->slots[hash_mix(hash) & replicas->mask];
+}
+
+
+static void delete_page_arg(void* page) {
+    delete_page(page);
+}
+
+
+const page_t* replica_get(replica_table_t* replicas, unsigned long hash, const char* key) {
+    page_t* page = atomic_load_explicit(slot(replicas, hash), memory_order_acquire);
+    return page != NULL && key_equal(page->key, key) ? page : NULL;
+}
+
+
+void replica_publish(replica_table_t* replicas, unsigned long hash, const page_t* page) {
+    page_t* copy = create_page_sized(page->key, page->data, page->size);
+    copy->user_flags = page->user_flags;
+    copy->version = page->version;
+    copy->cost = page->cost;
+    page_t* old = atomic_exchange(slot(replicas, hash), copy);
+    if (old != NULL) {
+        ebr_retire(replicas->ebr, old, &delete_page_arg);
+    }
+}
+
+
+void replica_invalidate(replica_table_t* replicas, unsigned long hash, const char* key) {
+    _Atomic(page_t*)* replica_slot = slot(replicas, hash);
+    page_t* page = atomic_load(replica_slot);
+    // Copy of another key published meanwhile is left alone
+    if (page != NULL && key_equal(page->key, key) && atomic_compare_exchange_strong(replica_slot, &page, NULL)) {
+        ebr_retire(replicas->ebr, page, &delete_page_arg);
+    }
+}
+
+
+size_t replica_count(replica_table_t* replicas) {
+    size_t count = 0;
+    for (size_t i = 0; i <= replicas->mask; ++i) {
+        count += atomic_load(&replicas->slots[i]) != NULL;
+    }
+    return count;
+}
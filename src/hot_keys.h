@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ebr.h"
+#include "page.h"
+
+// Heavy hitter detection: count-min sketch over key hashes of recent requests.
+// Four rows of counters, estimate is the smallest of the key's counters. All counters
+// are halved every window requests, so a key taking share s of requests settles
+// between s * window and 2 * s * window. Not thread-safe, meant to be one per thread.
+typedef struct hot_key_sketch_t hot_key_sketch_t;
+
+// Width is rounded up to power of two, key is hot when its estimate reaches
+// hot_share * window
+hot_key_sketch_t* create_hot_key_sketch(size_t width, size_t window, double hot_share);
+void delete_hot_key_sketch(hot_key_sketch_t*);
+// Counts request for key, returns true if key is hot
+bool hot_key_sketch_add(hot_key_sketch_t*, unsigned long);
+size_t hot_key_sketch_estimate(const hot_key_sketch_t*, unsigned long);
+
+// Read-only copies of hot pages, any thread reads them without taking locks.
+// Slots are direct-mapped by key hash, a copy replaces whatever its slot held.
+// Copies are freed through epoch-based reclamation: calls other than create and
+// delete are made inside ebr critical section, which readers keep while they use
+// a copy. Caller serializes publish and invalidate of the same key, usually under
+// the lock of the cache owning the key, so a copy of an old page can not be
+// published after invalidation of the new one.
+typedef struct replica_table_t replica_table_t;
+
+// Number of slots is rounded up to power of two
+replica_table_t* create_replica_table(size_t n_slots, ebr_t*);
+// Frees copies right away, no reader may be active
+void delete_replica_table(replica_table_t*);
+// Copy of page with the key, NULL if there is none
+const page_t* replica_get(replica_table_t*, unsigned long, const char*);
+// Publishes copy of page, which stays owned by caller
+void replica_publish(replica_table_t*, unsigned long, const page_t*);
+void replica_invalidate(replica_table_t*, unsigned long, const char*);
+size_t replica_count(replica_table_t*);
@@ -0,0 +1,97 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include "hugemem.h"
+
+
+static size_t round_up(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+
+// Maps regular pages aligned to huge page, so kernel can collapse them into huge pages
+static void* map_aligned(size_t size) {
+    size_t map_size = size + HUGE_PAGE_SIZE;
+    char* ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+    char* aligned = (char*) (((uintptr_t) ptr + HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (HUGE_PAGE_SIZE - 1));
+    if (aligned != ptr) {
+        munmap(ptr, aligned - ptr);
+    }
+    size_t tail = (ptr + map_size) - (aligned + size);
+    if (tail != 0) {
+        munmap(aligned + size, tail);
+    }
+    return aligned;
+}
+
+
+void* huge_alloc(size_t size, huge_backing_t* backing) {
+    huge_backing_t unused;
+    if (backing == NULL) {
+        backing = &unused;
+    }
+    if (size < HUGE_PAGE_SIZE) {
+        void* ptr = calloc(1, size > 0 ? size : 1);
+        if (ptr == NULL) {
+            puts("calloc failed");
+            exit(EXIT_FAILURE);
+        }
+        *backing = HUGE_BACKING_HEAP;
+        return ptr;
+    }
+
+    size = round_up(size);
+    void* ptr;
+#ifdef MAP_HUGETLB
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+        *backing = HUGE_BACKING_HUGETLB;
+        return ptr;
+    }
+#endif
+    ptr = map_aligned(size);
+    if (ptr == NULL) {
+        puts("mmap failed");
+        exit(EXIT_FAILURE);
+    }
+    *backing = HUGE_BACKING_REGULAR;
+#ifdef MADV_HUGEPAGE
+    if (madvise(ptr, size, MADV_HUGEPAGE) == 0) {
+        *backing = HUGE_BACKING_THP;
+    }
+#endif
+    return ptr;
+}
+
+
+void huge_free(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (size < HUGE_PAGE_SIZE) {
+        free(ptr);
+    } else {
+        munmap(ptr, round_up(size));
+    }
+}
+
+
+const char* huge_backing_name(huge_backing_t backing) {
+    switch (backing) {
+    case HUGE_BACKING_HEAP:
+        return "heap";
+    case HUGE_BACKING_HUGETLB:
+        return "hugetlb";
+    case HUGE_BACKING_THP:
+        return "thp";
+    case HUGE_BACKING_REGULAR:
+    default:
+        return "regular";
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+typedef enum huge_backing_t {
+    HUGE_BACKING_HEAP,     // small allocation, served by malloc
+    HUGE_BACKING_HUGETLB,  // explicit huge pages (MAP_HUGETLB)
+    HUGE_BACKING_THP,      // transparent huge pages requested with madvise
+    HUGE_BACKING_REGULAR,  // regular pages, huge pages are not available
+} huge_backing_t;
+
+// Allocates zero-initialized memory backed by 2 MB pages when possible.
+// Allocations smaller than HUGE_PAGE_SIZE go to malloc. Backing may be NULL.
+void* huge_alloc(size_t, huge_backing_t*);
+// Size should be the same as in allocation
+void huge_free(void*, size_t);
+const char* huge_backing_name(huge_backing_t);
@@ -0,0 +1,23 @@
+#include <stdlib.h>
+#include <string.h>
+#include "inline_key.h"
+#include "page.h"
+
+
+void inline_key_set(inline_key_t* key, const char* str) {
+    size_t len = strlen(str);
+    if (len <= INLINE_KEY_MAX) {
+        memcpy(key->buf, str, len + 1);
+        key->len = (unsigned char) len;
+    } else {
+        key->heap = string_dup(str);
+        key->len = KEY_SPILLED;
+    }
+}
+
+
+void inline_key_free(inline_key_t* key) {
+    if (key->len == KEY_SPILLED) {
+        free(key->heap);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <limits.h>
+
+#define INLINE_KEY_MAX 23      // longer keys are stored on heap
+#define KEY_SPILLED UCHAR_MAX  // len value for keys stored on heap
+
+// Copy of key owned by a table entry, short keys are kept in place without allocation.
+// Inline keys can be compared by len first, without touching other memory.
+typedef struct inline_key_t {
+    union {
+        char* heap;
+        char buf[INLINE_KEY_MAX + 1];
+    };
+    unsigned char len;
+} inline_key_t;
+
+void inline_key_set(inline_key_t*, const char*);
+void inline_key_free(inline_key_t*);
+
+static inline const char* inline_key_get(const inline_key_t* key) {
+    return key->len == KEY_SPILLED ? key->heap : key->buf;
+}
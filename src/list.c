@@ -6,6 +6,8 @@ struct list_node_t {
     list_node_t* next;
     list_node_t* prev;
     page_t* page;
+    list_t* owner;
+    node_meta_t meta;
 };
 
 
@@ -21,6 +23,16 @@ page_t* list_node_get_page(list_node_t* node) {
 }
 
 
+node_meta_t* list_node_get_meta(list_node_t* node) {
+    return &node->meta;
+}
+
+
+list_t* list_node_get_list(const list_node_t* node) {
+    return node->owner;
+}
+
+
 bool is_list_empty(const list_t* list) {
     return ((list->head == NULL) && (list->tail == NULL));
 }
@@ -67,6 +79,7 @@ list_node_t* list_push_front(list_t* list, page_t* page) {
     list_node_t* new_node = create_list_node();
 
     new_node->page = page;
+    new_node->owner = list;
     new_node->next = list->head;
     if (list->head != NULL) {
         list->head->prev = new_node;
@@ -82,6 +95,7 @@ list_node_t* list_push_front(list_t* list, page_t* page) {
 list_node_t* list_push_back(list_t* list, page_t* page) {
     list_node_t* new_node = create_list_node();
     new_node->page = page;
+    new_node->owner = list;
     new_node->prev = list->tail;
     if (list->tail != NULL) {
         list->tail->next = new_node;
@@ -142,6 +156,11 @@ page_t* list_back(const list_t* list) {
 }
 
 
+list_node_t* list_back_node(const list_t* list) {
+    return list->tail;
+}
+
+
 void list_move_upfront(list_t* list, list_node_t* node) {
     if (node == list->head) {
         return;
@@ -159,6 +178,46 @@ void list_move_upfront(list_t* list, list_node_t* node) {
 }
 
 
+static void list_unlink(list_t* list, list_node_t* node) {
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    } else {
+        list->head = node->next;
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    } else {
+        list->tail = node->prev;
+    }
+    --list->size;
+}
+
+
+void list_transfer_upfront(list_t* dst, list_t* src, list_node_t* node) {
+    if (dst == src) {
+        list_move_upfront(dst, node);
+        return;
+    }
+    list_unlink(src, node);
+    node->prev = NULL;
+    node->next = dst->head;
+    if (dst->head != NULL) {
+        dst->head->prev = node;
+    } else {
+        dst->tail = node;
+    }
+    dst->head = node;
+    node->owner = dst;
+    ++dst->size;
+}
+
+
+void list_remove(list_t* list, list_node_t* node) {
+    list_unlink(list, node);
+    delete_list_node(node);
+}
+
+
 size_t list_length(const list_t* list) {
     return list->size;
 }
@@ -7,7 +7,16 @@
 typedef struct list_t list_t;
 typedef struct list_node_t list_node_t;
 
+// Per-node data of priority based eviction policies
+typedef struct node_meta_t {
+    double priority;
+    size_t frequency;
+    size_t heap_index;
+} node_meta_t;
+
 page_t* list_node_get_page(list_node_t*);
+node_meta_t* list_node_get_meta(list_node_t*);
+list_t* list_node_get_list(const list_node_t*);
 
 list_t* create_list(void);
 void delete_list(list_t*);
@@ -19,11 +28,15 @@ list_node_t* list_push_front(list_t*, page_t*);
 list_node_t* list_push_back(list_t*, page_t*);
 void list_pop_front(list_t*);
 void list_pop_back(list_t*);
+void list_remove(list_t*, list_node_t*);
 
 void list_move_upfront(list_t*, list_node_t*);
+// Moves node from the second list to the head of the first one
+void list_transfer_upfront(list_t*, list_t*, list_node_t*);
 
 page_t* list_front(const list_t*);
 page_t* list_back(const list_t*);
+list_node_t* list_back_node(const list_t*);
 
 size_t list_length(const list_t*);
 bool is_list_empty(const list_t*);
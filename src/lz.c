@@ -0,0 +1,181 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+
+#define MIN_MATCH 4
+#define HASH_LOG 12
+#define LAST_LITERALS 5
+#define MF_LIMIT 12  // last match must start at least this far from the end
+#define MAX_OFFSET 65535
+
+
+static uint32_t read32(const unsigned char* ptr) {
+    uint32_t val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+
+static size_t hash_seq(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - HASH_LOG);
+}
+
+
+// Writes length continuation bytes for lengths that did not fit into token nibble
+static unsigned char* write_length(unsigned char* op, size_t len) {
+    len -= 15;
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char) len;
+    return op;
+}
+
+
+// Worst case output size of a sequence with given literal and match lengths
+static size_t sequence_bound(size_t n_literals, size_t match_len) {
+    return 1 + n_literals / 255 + 1 + n_literals + 2 + match_len / 255 + 1;
+}
+
+
+size_t lz_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+
+size_t lz_compress(const char* src, size_t src_size, char* dst, size_t dst_size) {
+    const unsigned char* ip = (const unsigned char*) src;
+    const unsigned char* base = ip;
+    const unsigned char* anchor = ip;
+    const unsigned char* end = ip + src_size;
+    unsigned char* op = (unsigned char*) dst;
+    unsigned char* op_end = op + dst_size;
+    uint32_t table[1 << HASH_LOG] = {0};
+
+    if (src_size >= MF_LIMIT) {
+        const unsigned char* match_limit = end - MF_LIMIT;
+        const unsigned char* extend_limit = end - LAST_LITERALS;
+        while (ip < match_limit) {
+            uint32_t seq = read32(ip);
+            size_t h = hash_seq(seq);
+            const unsigned char* candidate = base + table[h];
+            table[h] = (uint32_t) (ip - base);
+            if (candidate >= ip || ip - candidate > MAX_OFFSET || read32(candidate) != seq) {
+                ++ip;
+                continue;
+            }
+
+            size_t match_len = MIN_MATCH;
+            while (ip + match_len < extend_limit && candidate[match_len] == ip[match_len]) {
+                ++match_len;
+            }
+
+            size_t n_literals = ip - anchor;
+            if (sequence_bound(n_literals, match_len) > (size_t) (op_end - op)) {
+                return 0;
+            }
+            unsigned char* token = op++;
+            *token = (unsigned char) ((n_literals >= 15 ? 15 : n_literals) << 4);
+            if (n_literals >= 15) {
+                op = write_length(op, n_literals);
+            }
+            memcpy(op, anchor, n_literals);
+            op += n_literals;
+
+            size_t offset = ip - candidate;
+            *op++ = (unsigned char) (offset & 0xff);
+            *op++ = (unsigned char) (offset >> 8);
+
+            size_t len_code = match_len - MIN_MATCH;
+            *token |= (unsigned char) (len_code >= 15 ? 15 : len_code);
+            if (len_code >= 15) {
+                op = write_length(op, len_code);
+            }
+
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    // Last sequence contains only literals
+    size_t n_literals = end - anchor;
+    if (sequence_bound(n_literals, 0) > (size_t) (op_end - op)) {
+        return 0;
+    }
+    unsigned char* token = op++;
+    *token = (unsigned char) ((n_literals >= 15 ? 15 : n_literals) << 4);
+    if (n_literals >= 15) {
+        op = write_length(op, n_literals);
+    }
+    memcpy(op, anchor, n_literals);
+    op += n_literals;
+    return op - (unsigned char*) dst;
+}
+
+
+// Reads length continuation bytes, returns false on truncated input
+static bool read_length(const unsigned char** ip_ptr, const unsigned char* end, size_t* len) {
+    unsigned char byte;
+    do {
+        if (*ip_ptr >= end) {
+            return false;
+        }
+        byte = *(*ip_ptr)++;
+        *len += byte;
+    } while (byte == 255);
+    return true;
+}
+
+
+size_t lz_decompress(const char* src, size_t src_size, char* dst, size_t dst_size) {
+    const unsigned char* ip = (const unsigned char*) src;
+    const unsigned char* end = ip + src_size;
+    unsigned char* op = (unsigned char*) dst;
+    unsigned char* op_end = op + dst_size;
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+
+        size_t n_literals = token >> 4;
+        if (n_literals == 15 && !read_length(&ip, end, &n_literals)) {
+            return 0;
+        }
+        if (n_literals > (size_t) (end - ip) || n_literals > (size_t) (op_end - op)) {
+            return 0;
+        }
+        memcpy(op, ip, n_literals);
+        op += n_literals;
+        ip += n_literals;
+        if (ip == end) {
+            break;  // last sequence
+        }
+
+        if (end - ip < 2) {
+            return 0;
+        }
+        size_t offset = ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - (unsigned char*) dst)) {
+            return 0;
+        }
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(&ip, end, &match_len)) {
+            return 0;
+        }
+        match_len += MIN_MATCH;
+        if (match_len > (size_t) (op_end - op)) {
+            return 0;
+        }
+        // Byte by byte, because match may overlap with output
+        const unsigned char* match = op - offset;
+        for (size_t i = 0; i < match_len; ++i) {
+            op[i] = match[i];
+        }
+        op += match_len;
+    }
+    return op - (unsigned char*) dst;
+}
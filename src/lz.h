@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+
+// LZ4-style block codec (byte-oriented LZ77, no entropy coding).
+// Compressed blocks follow the LZ4 block format, so they can be inspected
+// with any LZ4 block decoder.
+
+size_t lz_compress_bound(size_t);
+// Returns size of compressed data or 0 if it does not fit into destination
+size_t lz_compress(const char*, size_t, char*, size_t);
+// Returns size of decompressed data or 0 if input is malformed
+size_t lz_decompress(const char*, size_t, char*, size_t);
@@ -0,0 +1,214 @@
+#include <string.h>
+#include "mc_protocol.h"
+
+
+#define MAX_TOKENS (MC_MAX_KEYS + 1)
+
+#define ERROR_UNKNOWN "ERROR\r\n"
+#define ERROR_FORMAT "CLIENT_ERROR bad command line format\r\n"
+#define ERROR_KEY "CLIENT_ERROR key too long\r\n"
+#define ERROR_KEYS "CLIENT_ERROR too many keys\r\n"
+#define ERROR_CHUNK "CLIENT_ERROR bad data chunk\r\n"
+#define ERROR_LINE "CLIENT_ERROR line too long\r\n"
+#define ERROR_VALUE "SERVER_ERROR object too large for cache\r\n"
+
+
+typedef struct token_t {
+    char* start;
+    size_t len;
+} token_t;
+
+
+static bool token_is(const token_t* token, const char* str) {
+    return token->len == strlen(str) && !memcmp(token->start, str, token->len);
+}
+
+
+static bool parse_number(const token_t* token, uint64_t max, uint64_t* value) {
+    if (token->len == 0 || token->len > 20) {
+        return false;
+    }
+    uint64_t result = 0;
+    for (size_t i = 0; i < token->len; ++i) {
+        char c = token->start[i];
+        if (c < '0' || c > '9' || result > (max - (c - '0')) / 10) {
+            return false;
+        }
+        result = result * 10 + (c - '0');
+    }
+    *value = result;
+    return true;
+}
+
+
+// Leading minus is allowed as in negative exptime, the value itself is not needed
+static bool is_number(const token_t* token) {
+    token_t digits = *token;
+    if (digits.len > 1 && digits.start[0] == '-') {
+        ++digits.start;
+        --digits.len;
+    }
+    uint64_t value;
+    return parse_number(&digits, UINT64_MAX, &value);
+}
+
+
+// Splits line on spaces without modifying it, returns number of tokens or MAX_TOKENS + 1
+static size_t tokenize(char* line, size_t len, token_t* tokens) {
+    size_t n_tokens = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        while (pos < len && line[pos] == ' ') {
+            ++pos;
+        }
+        if (pos == len) {
+            break;
+        }
+        if (n_tokens == MAX_TOKENS) {
+            return MAX_TOKENS + 1;
+        }
+        tokens[n_tokens].start = line + pos;
+        while (pos < len && line[pos] != ' ') {
+            ++pos;
+        }
+        tokens[n_tokens].len = line + pos - tokens[n_tokens].start;
+        ++n_tokens;
+    }
+    return n_tokens;
+}
+
+
+static mc_parse_t fail(mc_request_t* request, const char* error, size_t length) {
+    request->error = error;
+    request->length = length;
+    return MC_PARSE_ERROR;
+}
+
+
+static bool is_noreply(const token_t* tokens, size_t n_tokens, size_t n_args) {
+    return n_tokens == n_args + 1 && token_is(&tokens[n_args], "noreply");
+}
+
+
+// Parses "<key> <flags> <exptime> <bytes> [cas] [noreply]" and checks data block
+static mc_parse_t parse_storage(char* buf, size_t len, size_t line_len, token_t* tokens,
+                                size_t n_tokens, mc_request_t* request) {
+    size_t n_args = request->command == MC_CAS ? 6 : 5;
+    if (n_tokens != n_args && !is_noreply(tokens, n_tokens, n_args)) {
+        return fail(request, ERROR_FORMAT, line_len);
+    }
+    uint64_t flags;
+    uint64_t n_bytes;
+    if (!parse_number(&tokens[2], UINT32_MAX, &flags) || !is_number(&tokens[3])
+        || !parse_number(&tokens[4], UINT64_MAX, &n_bytes)
+        || (request->command == MC_CAS && !parse_number(&tokens[5], UINT64_MAX, &request->cas))) {
+        return fail(request, ERROR_FORMAT, line_len);
+    }
+    if (n_bytes > MC_MAX_VALUE) {
+        return fail(request, ERROR_VALUE, 0);
+    }
+    if (len < line_len + n_bytes + 2) {
+        return MC_PARSE_INCOMPLETE;
+    }
+    if (tokens[1].len > MC_MAX_KEY_LEN) {
+        return fail(request, ERROR_KEY, line_len + n_bytes + 2);
+    }
+    char* data = buf + line_len;
+    if (data[n_bytes] != '\r' || data[n_bytes + 1] != '\n') {
+        return fail(request, ERROR_CHUNK, line_len + n_bytes + 2);
+    }
+    request->flags = (uint32_t) flags;
+    request->data = data;
+    request->n_bytes = n_bytes;
+    request->noreply = n_tokens == n_args + 1;
+    request->keys[0] = tokens[1].start;
+    request->n_keys = 1;
+    request->length = line_len + n_bytes + 2;
+    return MC_PARSE_OK;
+}
+
+
+static bool parse_command(const token_t* token, mc_command_t* command) {
+    static const struct {
+        const char* name;
+        mc_command_t command;
+    } commands[] = {
+        {"get", MC_GET}, {"gets", MC_GETS}, {"set", MC_SET}, {"add", MC_ADD},
+        {"replace", MC_REPLACE}, {"cas", MC_CAS}, {"delete", MC_DELETE},
+        {"version", MC_VERSION}, {"quit", MC_QUIT},
+    };
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+        if (token_is(token, commands[i].name)) {
+            *command = commands[i].command;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+mc_parse_t mc_parse_request(char* buf, size_t len, mc_request_t* request) {
+    char* newline = memchr(buf, '\n', len < MC_MAX_LINE ? len : MC_MAX_LINE);
+    if (newline == NULL) {
+        return len < MC_MAX_LINE ? MC_PARSE_INCOMPLETE : fail(request, ERROR_LINE, 0);
+    }
+    size_t line_len = newline - buf + 1;
+    size_t text_len = newline > buf && newline[-1] == '\r' ? line_len - 2 : line_len - 1;
+    token_t tokens[MAX_TOKENS];
+    size_t n_tokens = tokenize(buf, text_len, tokens);
+    request->noreply = false;
+    request->n_keys = 0;
+    request->data = NULL;
+    request->n_bytes = 0;
+    request->error = NULL;
+    if (n_tokens == 0 || !parse_command(&tokens[0], &request->command)) {
+        return fail(request, ERROR_UNKNOWN, line_len);
+    }
+    if (n_tokens > MAX_TOKENS) {
+        return fail(request, request->command == MC_GET || request->command == MC_GETS ? ERROR_KEYS : ERROR_FORMAT,
+                    line_len);
+    }
+
+    mc_parse_t result = MC_PARSE_OK;
+    request->length = line_len;
+    switch (request->command) {
+    case MC_GET:
+    case MC_GETS:
+        if (n_tokens < 2) {
+            return fail(request, ERROR_FORMAT, line_len);
+        }
+        for (size_t i = 1; i < n_tokens; ++i) {
+            if (tokens[i].len > MC_MAX_KEY_LEN) {
+                return fail(request, ERROR_KEY, line_len);
+            }
+            request->keys[request->n_keys++] = tokens[i].start;
+        }
+        break;
+    case MC_SET:
+    case MC_ADD:
+    case MC_REPLACE:
+    case MC_CAS:
+        result = parse_storage(buf, len, line_len, tokens, n_tokens, request);
+        break;
+    case MC_DELETE:
+        if (n_tokens != 2 && !is_noreply(tokens, n_tokens, 2)) {
+            return fail(request, ERROR_FORMAT, line_len);
+        }
+        if (tokens[1].len > MC_MAX_KEY_LEN) {
+            return fail(request, ERROR_KEY, line_len);
+        }
+        request->keys[request->n_keys++] = tokens[1].start;
+        request->noreply = n_tokens == 3;
+        break;
+    case MC_VERSION:
+    case MC_QUIT:
+        break;
+    }
+    if (result == MC_PARSE_OK) {
+        // Line is complete and valid, so keys can be cut out of it now
+        for (size_t i = 0; i < n_tokens; ++i) {
+            tokens[i].start[tokens[i].len] = '\0';
+        }
+    }
+    return result;
+}
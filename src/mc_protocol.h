@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Parser of memcached text protocol requests. Works in place on connection buffer:
+// keys and data point into it, keys are NUL-terminated once request is complete.
+#define MC_MAX_KEY_LEN 250
+#define MC_MAX_KEYS 128             // keys of one get
+#define MC_MAX_LINE 8192            // command line, longer one ends connection
+#define MC_MAX_VALUE (1 << 20)      // larger values end connection
+
+typedef enum mc_command_t {
+    MC_GET,
+    MC_GETS,     // get with cas unique of each value
+    MC_SET,
+    MC_ADD,      // set only if key is absent
+    MC_REPLACE,  // set only if key is present
+    MC_CAS,      // set only if cas unique still matches
+    MC_DELETE,
+    MC_VERSION,
+    MC_QUIT,
+} mc_command_t;
+
+typedef enum mc_parse_t {
+    MC_PARSE_OK,
+    MC_PARSE_INCOMPLETE,  // wait for more bytes, buffer is left untouched
+    MC_PARSE_ERROR,       // send error, then skip length bytes, 0 - close connection
+} mc_parse_t;
+
+typedef struct mc_request_t {
+    mc_command_t command;
+    const char* keys[MC_MAX_KEYS];
+    size_t n_keys;
+    uint32_t flags;
+    uint64_t cas;
+    const char* data;   // n_bytes of value, not NUL-terminated
+    size_t n_bytes;
+    bool noreply;
+    size_t length;      // bytes of buffer taken by request
+    const char* error;  // response line on error, with CRLF
+} mc_request_t;
+
+// Parses first request of buffer, exptime of storage commands is accepted and ignored
+mc_parse_t mc_parse_request(char*, size_t, mc_request_t*);
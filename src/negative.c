@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "negative.h"
+#include "bloom.h"
+#include "inline_key.h"
+#include "page.h"
+
+
+#define NIL UINT32_MAX
+#define FILTER_BITS_PER_ITEM 10
+
+
+typedef struct tombstone_t {
+    inline_key_t key;
+    bool used;        // false for free slots and removed tombstones
+    uint32_t chain;   // next slot in bucket
+    unsigned long hash;
+    double expires;
+} tombstone_t;
+
+
+struct negative_cache_t {
+    tombstone_t* ring;  // slots in insertion order starting at head
+    size_t capacity;
+    size_t head;
+    size_t n_slots;     // slots between head and tail, removed ones included
+    size_t length;      // used slots
+    uint32_t* buckets;  // first slot of chain
+    size_t n_buckets;   // power of two
+    double ttl;
+    bloom_t* filter;    // NULL if disabled
+};
+
+
+negative_cache_t* create_negative_cache(size_t capacity, double ttl, bool use_filter) {
+    if (capacity == 0 || capacity >= NIL) {
+        return NULL;
+    }
+    negative_cache_t* negative = malloc(sizeof(negative_cache_t));
+    tombstone_t* ring = calloc(capacity, sizeof(tombstone_t));
+    if (negative == NULL || ring == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    negative->ring = ring;
+    negative->capacity = capacity;
+    negative->head = 0;
+    negative->n_slots = 0;
+    negative->length = 0;
+    negative->n_buckets = 1;
+    while (negative->n_buckets < capacity) {
+        negative->n_buckets *= 2;
+    }
+    negative->buckets = malloc(sizeof(uint32_t) * negative->n_buckets);
+    if (negative->buckets == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < negative->n_buckets; ++i) {
+        negative->buckets[i] = NIL;
+    }
+    negative->ttl = ttl;
+    negative->filter = use_filter ? create_bloom(capacity, FILTER_BITS_PER_ITEM) : NULL;
+    return negative;
+}
+
+
+void delete_negative_cache(negative_cache_t* negative) {
+    if (negative == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < negative->capacity; ++i) {
+        if (negative->ring[i].used) {
+            inline_key_free(&negative->ring[i].key);
+        }
+    }
+    free(negative->ring);
+    free(negative->buckets);
+    delete_bloom(negative->filter);
+    free(negative);
+}
+
+
+// Returns link to slot index of tombstone with the key or to NIL at the end of chain
+static uint32_t* find_link(const negative_cache_t* negative, const char* key, unsigned long hash) {
+    uint32_t* link = &negative->buckets[hash & (negative->n_buckets - 1)];
+    while (*link != NIL) {
+        const tombstone_t* tombstone = &negative->ring[*link];
+        if (tombstone->hash == hash && !strcmp(inline_key_get(&tombstone->key), key)) {
+            break;
+        }
+        link = &negative->ring[*link].chain;
+    }
+    return link;
+}
+
+
+// Unlinks tombstone in the slot, slot stays in ring until head passes it
+static void drop_slot(negative_cache_t* negative, uint32_t slot) {
+    tombstone_t* tombstone = &negative->ring[slot];
+    uint32_t* link = &negative->buckets[tombstone->hash & (negative->n_buckets - 1)];
+    while (*link != slot) {
+        link = &negative->ring[*link].chain;
+    }
+    *link = tombstone->chain;
+    inline_key_free(&tombstone->key);
+    tombstone->used = false;
+    --negative->length;
+}
+
+
+static void pop_head(negative_cache_t* negative) {
+    if (negative->ring[negative->head].used) {
+        drop_slot(negative, (uint32_t) negative->head);
+    }
+    negative->head = (negative->head + 1) % negative->capacity;
+    --negative->n_slots;
+}
+
+
+bool negative_cache_find(const negative_cache_t* negative, const char* key, double* expires) {
+    unsigned long hash = key_hash(key);
+    if (negative->filter != NULL && !bloom_maybe_contains(negative->filter, hash)) {
+        return false;
+    }
+    uint32_t slot = *find_link(negative, key, hash);
+    if (slot == NIL) {
+        return false;
+    }
+    *expires = negative->ring[slot].expires;
+    return true;
+}
+
+
+bool negative_cache_has_filter(const negative_cache_t* negative) {
+    return negative->filter != NULL;
+}
+
+
+// Filter can not forget keys, it is rebuilt from live tombstones instead
+static void rebuild_filter(negative_cache_t* negative) {
+    bloom_clear(negative->filter);
+    for (size_t i = 0; i < negative->capacity; ++i) {
+        if (negative->ring[i].used) {
+            bloom_add(negative->filter, negative->ring[i].hash);
+        }
+    }
+}
+
+
+void negative_cache_add(negative_cache_t* negative, const char* key, double now) {
+    // Head expires first, expired and removed slots are reclaimed from there
+    while (negative->n_slots != 0 && (!negative->ring[negative->head].used
+                                      || negative->ring[negative->head].expires <= now)) {
+        pop_head(negative);
+    }
+    negative_cache_remove(negative, key);
+    if (negative->n_slots == negative->capacity) {
+        pop_head(negative);
+    }
+
+    uint32_t slot = (uint32_t) ((negative->head + negative->n_slots) % negative->capacity);
+    tombstone_t* tombstone = &negative->ring[slot];
+    inline_key_set(&tombstone->key, key);
+    tombstone->used = true;
+    tombstone->hash = key_hash(key);
+    tombstone->expires = now + negative->ttl;
+    uint32_t* bucket = &negative->buckets[tombstone->hash & (negative->n_buckets - 1)];
+    tombstone->chain = *bucket;
+    *bucket = slot;
+    ++negative->n_slots;
+    ++negative->length;
+
+    if (negative->filter != NULL) {
+        if (bloom_n_added(negative->filter) >= 2 * negative->capacity) {
+            rebuild_filter(negative);
+        }
+        bloom_add(negative->filter, tombstone->hash);
+    }
+}
+
+
+void negative_cache_remove(negative_cache_t* negative, const char* key) {
+    if (negative->length == 0) {
+        return;
+    }
+    uint32_t slot = *find_link(negative, key, key_hash(key));
+    if (slot != NIL) {
+        drop_slot(negative, slot);
+    }
+}
+
+
+size_t negative_cache_length(const negative_cache_t* negative) {
+    return negative->length;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Tombstones of keys the loader could not find.
+// Fixed number of entries with one TTL, so the oldest entry is always the first to
+// expire and entries are kept in a FIFO ring. Optional Bloom filter answers most
+// lookups of keys without tombstone without probing the table.
+typedef struct negative_cache_t negative_cache_t;
+
+negative_cache_t* create_negative_cache(size_t capacity, double ttl, bool use_filter);
+void delete_negative_cache(negative_cache_t*);
+
+// Finds tombstone, expired or not, and sets its expiry time in seconds of the clock
+// passed to negative_cache_add. Hashes key and checks filter once, so callers need a
+// clock reading only when there is a tombstone.
+bool negative_cache_find(const negative_cache_t*, const char*, double* expires);
+bool negative_cache_has_filter(const negative_cache_t*);
+// Oldest tombstone is dropped when cache is full
+void negative_cache_add(negative_cache_t*, const char*, double now);
+void negative_cache_remove(negative_cache_t*, const char*);
+size_t negative_cache_length(const negative_cache_t*);
@@ -0,0 +1,107 @@
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "numa.h"
+
+
+#define MPOL_PREFERRED 1
+#define MAX_NODES 64
+
+
+size_t numa_node_count(void) {
+    // Format is a range list, e.g. "0" or "0-3"
+    FILE* file = fopen("/sys/devices/system/node/possible", "r");
+    if (file == NULL) {
+        return 1;
+    }
+    size_t count = 1;
+    unsigned first;
+    unsigned last;
+    int n_read = fscanf(file, "%u-%u", &first, &last);
+    if (n_read == 2 && last < MAX_NODES) {
+        count = last + 1;
+    } else if (n_read == 1 && first < MAX_NODES) {
+        count = first + 1;
+    }
+    fclose(file);
+    return count;
+}
+
+
+size_t numa_current_node(void) {
+#ifdef SYS_getcpu
+    unsigned cpu;
+    unsigned node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < MAX_NODES) {
+        return node;
+    }
+#endif
+    return 0;
+}
+
+
+size_t numa_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_CONF);
+    return count > 0 ? (size_t) count : 1;
+}
+
+
+size_t numa_current_cpu(void) {
+    int cpu = sched_getcpu();
+    return cpu >= 0 ? (size_t) cpu : 0;
+}
+
+
+void numa_cpu_nodes(size_t* nodes, size_t n_cpus, size_t n_nodes) {
+    for (size_t cpu = 0; cpu < n_cpus; ++cpu) {
+        nodes[cpu] = 0;
+    }
+    for (size_t node = 1; node < n_nodes; ++node) {
+        // Format is a list of ranges, e.g. "0-3,8-11"
+        char path[64];
+        sprintf(path, "/sys/devices/system/node/node%zu/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            continue;
+        }
+        unsigned first;
+        while (fscanf(file, "%u", &first) == 1) {
+            unsigned last = first;
+            int sep = fgetc(file);
+            if (sep == '-') {
+                if (fscanf(file, "%u", &last) != 1) {
+                    break;
+                }
+                sep = fgetc(file);
+            }
+            for (size_t cpu = first; cpu <= last && cpu < n_cpus; ++cpu) {
+                nodes[cpu] = node;
+            }
+            if (sep != ',') {
+                break;
+            }
+        }
+        fclose(file);
+    }
+}
+
+
+bool numa_bind(void* ptr, size_t size, size_t node) {
+#ifdef SYS_mbind
+    if (node >= MAX_NODES) {
+        return false;
+    }
+    unsigned long mask = 1ul << node;
+    return syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, &mask, MAX_NODES + 1, 0) == 0;
+#else
+    (void) ptr;
+    (void) size;
+    (void) node;
+    return false;
+#endif
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Minimal NUMA helpers on top of Linux sysfs and syscalls, no libnuma needed.
+// On other systems or without NUMA support machine is reported as a single node.
+
+// Reads sysfs, callers on hot paths keep the result
+size_t numa_node_count(void);
+// Node of CPU the calling thread runs on, one getcpu syscall.
+// Hot paths use numa_current_cpu with a table from numa_cpu_nodes instead.
+size_t numa_current_node(void);
+// Number of configured CPUs
+size_t numa_cpu_count(void);
+// CPU the calling thread runs on, through vDSO where available
+size_t numa_current_cpu(void);
+// Fills node of each of n_cpus CPUs from sysfs, CPUs not listed are on node 0
+void numa_cpu_nodes(size_t* nodes, size_t n_cpus, size_t n_nodes);
+// Asks kernel to place pages of the range on the node, returns false if not supported
+bool numa_bind(void*, size_t, size_t);
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "numa_cache.h"
+#include "numa.h"
+
+
+struct numa_cache_t {
+    compact_cache_t** shards;
+    size_t n_shards;
+    size_t* cpu_nodes;  // node of each CPU, read once so lookups need no syscall
+    size_t n_cpus;
+};
+
+
+numa_cache_t* create_numa_cache(size_t size_per_node, bool huge_pages) {
+    if (size_per_node == 0) {
+        return NULL;
+    }
+    numa_cache_t* cache = malloc(sizeof(numa_cache_t));
+    if (cache == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache->n_shards = numa_node_count();
+    cache->shards = malloc(sizeof(compact_cache_t*) * cache->n_shards);
+    if (cache->shards == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache->n_cpus = numa_cpu_count();
+    cache->cpu_nodes = malloc(sizeof(size_t) * cache->n_cpus);
+    if (cache->cpu_nodes == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    numa_cpu_nodes(cache->cpu_nodes, cache->n_cpus, cache->n_shards);
+    for (size_t node = 0; node < cache->n_shards; ++node) {
+        compact_config_t config = compact_default_config(size_per_node);
+        config.huge_pages = huge_pages;
+        config.numa_node = cache->n_shards > 1 ? (int) node : -1;
+        cache->shards[node] = create_compact_cache_with_config(&config);
+        if (cache->shards[node] == NULL) {
+            puts("create_compact_cache_with_config failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return cache;
+}
+
+
+void delete_numa_cache(numa_cache_t* cache) {
+    if (cache != NULL) {
+        for (size_t i = 0; i < cache->n_shards; ++i) {
+            delete_compact_cache(cache->shards[i]);
+        }
+        free(cache->shards);
+        free(cache->cpu_nodes);
+    }
+    free(cache);
+}
+
+
+compact_cache_t* numa_local_shard(const numa_cache_t* cache) {
+    size_t cpu = numa_current_cpu();
+    return numa_shard(cache, cpu < cache->n_cpus ? cache->cpu_nodes[cpu] : 0);
+}
+
+
+compact_cache_t* numa_shard(const numa_cache_t* cache, size_t node) {
+    return cache->shards[node % cache->n_shards];
+}
+
+
+size_t numa_cache_n_shards(const numa_cache_t* cache) {
+    return cache->n_shards;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "compact_cache.h"
+
+// Set of compact caches, one per NUMA node, with memory placed on that node.
+// Threads use the shard of the node they run on, so lookups stay in local memory.
+// Shards are independent caches: a key used on several nodes is cached on each of them,
+// access to a shard should be serialized by caller like for any other cache.
+typedef struct numa_cache_t numa_cache_t;
+
+numa_cache_t* create_numa_cache(size_t size_per_node, bool huge_pages);
+void delete_numa_cache(numa_cache_t*);
+compact_cache_t* numa_local_shard(const numa_cache_t*);
+compact_cache_t* numa_shard(const numa_cache_t*, size_t);
+size_t numa_cache_n_shards(const numa_cache_t*);
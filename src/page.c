@@ -5,32 +5,86 @@
 
 
 page_t* create_page(const char* key, const char* data) {
-    page_t* page = malloc(sizeof(page_t));
+    return create_page_sized(key, data, strlen(data));
+}
+
+
+page_t* create_page_sized(const char* key, const char* data, size_t data_len) {
+    size_t key_len = strlen(key);
+    unsigned char inline_flags = 0;
+    size_t inline_size = 0;
+    if (key_len <= PAGE_INLINE_MAX) {
+        inline_flags |= PAGE_KEY_INLINE;
+        inline_size += key_len + 1;
+    }
+    if (data_len <= PAGE_INLINE_MAX) {
+        inline_flags |= PAGE_DATA_INLINE;
+        inline_size += data_len + 1;
+    }
+
+    page_t* page = malloc(sizeof(page_t) + inline_size);
     if (page == NULL) {
         puts("malloc failed");
         exit(EXIT_FAILURE);
     }
-    page->key = string_dup(key);
-    page->data = string_dup(data);
+    char* inline_ptr = page->inline_buf;
+    if (inline_flags & PAGE_KEY_INLINE) {
+        memcpy(inline_ptr, key, key_len + 1);
+        page->key = inline_ptr;
+        inline_ptr += key_len + 1;
+    } else {
+        page->key = string_dup(key);
+    }
+    if (inline_flags & PAGE_DATA_INLINE) {
+        page->data = inline_ptr;
+    } else {
+        page->data = malloc(data_len + 1);
+        if (page->data == NULL) {
+            puts("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(page->data, data, data_len);
+    page->data[data_len] = '\0';
+    page->inline_flags = inline_flags;
+    page->size = data_len;
+    page->compressed_size = 0;
+    page->cost = 0.0;
+    page->version = 0;
+    page->user_flags = 0;
     return page;
 }
 
 
 page_t* copy_page(const page_t* page) {
-    page_t* new_page = create_page(page->key, page->data);
+    page_t* new_page = create_page_sized(page->key, page->data, page->size);
     return new_page;
 }
 
 
 void delete_page(page_t* page) {
     if (page != NULL) {
-        free(page->key);
-        free(page->data);
+        if (!(page->inline_flags & PAGE_KEY_INLINE)) {
+            free(page->key);
+        }
+        if (!(page->inline_flags & PAGE_DATA_INLINE)) {
+            free(page->data);
+        }
         free(page);
     }
 }
 
 
+// Bytes taken by key and data as stored in cache
+size_t page_stored_size(const page_t* page) {
+    if (page == NULL) {
+        return 0;
+    }
+    size_t data_size = page->compressed_size != 0 ? page->compressed_size : page->size;
+    return strlen(page->key) + data_size;
+}
+
+
 /* djb2 hash function. URL: http://www.cse.yorku.ca/~oz/hash.html */
 static unsigned long hash(const unsigned char *str) {
     unsigned long hash = 5381;
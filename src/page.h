@@ -3,16 +3,35 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// Strings up to this length are stored in the same allocation as the page
+#define PAGE_INLINE_MAX 23
+
+enum {
+    PAGE_KEY_INLINE = 1,
+    PAGE_DATA_INLINE = 2,
+    PAGE_SLAB = 4,  // whole page is a slab chunk, freed by the cache owning the slabs
+};
+
 struct page_t {
     char* key;
     char* data;
+    size_t size;             // length of data without terminating NUL
+    size_t compressed_size;  // length of compressed data, 0 if data is stored raw
+    double cost;             // seconds to load the page, measured by cache if loader leaves 0
+    unsigned long version;   // set by loader, e.g. from upstream etag, 0 - unversioned
+    unsigned user_flags;     // opaque to cache, e.g. memcached client flags
+    unsigned char inline_flags;  // which of key and data point to inline_buf
+    char inline_buf[];
 };
 
 typedef struct page_t page_t;
 
 page_t* create_page(const char*, const char*);
+// Data may contain NUL bytes, it is still NUL-terminated after size bytes
+page_t* create_page_sized(const char*, const char*, size_t);
 page_t* copy_page(const page_t*);
 void delete_page(page_t*);
+size_t page_stored_size(const page_t*);
 unsigned long key_hash(const char*);
 bool key_equal(const char*, const char*);
 char* string_dup(const char*);
@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "policy.h"
+#include "ghost.h"
+
+
+typedef enum ghost_hit_t {
+    GHOST_HIT_NONE,
+    GHOST_HIT_RECENT,
+    GHOST_HIT_FREQUENT,
+} ghost_hit_t;
+
+
+struct policy_t {
+    cache_policy_t type;
+    size_t max_size;
+    list_t* main;          // LRU: all pages, SLRU: protected segment, 2Q: Am, ARC: T2
+    list_t* probation;     // SLRU: probationary segment, 2Q: A1in FIFO, ARC: T1
+    ghost_list_t* ghosts;  // 2Q: A1out, keys recently evicted from A1in, ARC: B1
+    ghost_list_t* frequent_ghosts;  // ARC: B2, keys evicted from T2
+    size_t max_protected;  // SLRU
+    size_t max_in;         // 2Q
+    size_t target;         // ARC: adaptive target size of T1
+    ghost_hit_t ghost_hit; // ARC: where the missed key was found
+    list_node_t** heap;    // GDSF: min-heap of nodes by priority
+    size_t heap_capacity;
+    double inflation;      // GDSF: priority of the last victim
+};
+
+
+policy_t* create_policy(cache_policy_t type, size_t max_size) {
+    policy_t* policy = malloc(sizeof(policy_t));
+    if (policy == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    policy->type = type;
+    policy->main = create_list();
+    policy->probation = create_list();
+    policy->ghosts = NULL;
+    policy->frequent_ghosts = NULL;
+    policy->target = 0;
+    policy->ghost_hit = GHOST_HIT_NONE;
+    policy->heap = NULL;
+    policy->heap_capacity = 0;
+    policy->inflation = 0.0;
+    policy_resize(policy, max_size);
+    return policy;
+}
+
+
+static void resize_ghosts(ghost_list_t** ghosts, size_t capacity) {
+    if (*ghosts == NULL) {
+        *ghosts = create_ghost_list(capacity);
+    } else {
+        ghost_list_resize(*ghosts, capacity);
+    }
+}
+
+
+void policy_resize(policy_t* policy, size_t max_size) {
+    policy->max_size = max_size;
+    // Segment sizes follow recommendations of the original papers
+    policy->max_protected = max_size * 4 / 5;
+    policy->max_in = max_size / 4 > 0 ? max_size / 4 : 1;
+    if (policy->target > max_size) {
+        policy->target = max_size;
+    }
+    // History of evicted keys survives resizes, only the oldest ghosts that no longer fit are dropped
+    if (policy->type == CACHE_POLICY_2Q) {
+        resize_ghosts(&policy->ghosts, max_size / 2);
+    } else if (policy->type == CACHE_POLICY_ARC) {
+        resize_ghosts(&policy->ghosts, max_size);
+        resize_ghosts(&policy->frequent_ghosts, max_size);
+    }
+}
+
+
+void delete_policy(policy_t* policy) {
+    if (policy != NULL) {
+        delete_list(policy->main);
+        delete_list(policy->probation);
+        delete_ghost_list(policy->ghosts);
+        delete_ghost_list(policy->frequent_ghosts);
+        free(policy->heap);
+        free(policy);
+    }
+}
+
+
+// GDSF priority: H = L + frequency * cost / size
+static double gdsf_priority(const policy_t* policy, list_node_t* node) {
+    page_t* page = list_node_get_page(node);
+    if (page == NULL) {
+        return policy->inflation;
+    }
+    size_t size = page_stored_size(page);
+    return policy->inflation + list_node_get_meta(node)->frequency * page->cost / (size > 0 ? size : 1);
+}
+
+
+static void heap_set(policy_t* policy, size_t idx, list_node_t* node) {
+    policy->heap[idx] = node;
+    list_node_get_meta(node)->heap_index = idx;
+}
+
+
+static double heap_priority(const policy_t* policy, size_t idx) {
+    return list_node_get_meta(policy->heap[idx])->priority;
+}
+
+
+static void heap_sift_up(policy_t* policy, size_t idx) {
+    list_node_t* node = policy->heap[idx];
+    double priority = list_node_get_meta(node)->priority;
+    while (idx > 0 && heap_priority(policy, (idx - 1) / 2) > priority) {
+        heap_set(policy, idx, policy->heap[(idx - 1) / 2]);
+        idx = (idx - 1) / 2;
+    }
+    heap_set(policy, idx, node);
+}
+
+
+static void heap_sift_down(policy_t* policy, size_t idx) {
+    size_t n = list_length(policy->main);
+    list_node_t* node = policy->heap[idx];
+    double priority = list_node_get_meta(node)->priority;
+    while (2 * idx + 1 < n) {
+        size_t child = 2 * idx + 1;
+        if (child + 1 < n && heap_priority(policy, child + 1) < heap_priority(policy, child)) {
+            ++child;
+        }
+        if (heap_priority(policy, child) >= priority) {
+            break;
+        }
+        heap_set(policy, idx, policy->heap[child]);
+        idx = child;
+    }
+    heap_set(policy, idx, node);
+}
+
+
+// Node should be already in main list
+static void gdsf_insert(policy_t* policy, list_node_t* node) {
+    size_t n = list_length(policy->main);
+    if (n > policy->heap_capacity) {
+        policy->heap_capacity = policy->heap_capacity > 0 ? policy->heap_capacity * 2 : 16;
+        policy->heap = realloc(policy->heap, sizeof(list_node_t*) * policy->heap_capacity);
+        if (policy->heap == NULL) {
+            puts("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    node_meta_t* meta = list_node_get_meta(node);
+    meta->frequency = 1;
+    meta->priority = gdsf_priority(policy, node);
+    policy->heap[n - 1] = node;
+    heap_sift_up(policy, n - 1);
+}
+
+
+static void gdsf_touch(policy_t* policy, list_node_t* node) {
+    node_meta_t* meta = list_node_get_meta(node);
+    ++meta->frequency;
+    meta->priority = gdsf_priority(policy, node);
+    // Priority never decreases on hit
+    heap_sift_down(policy, meta->heap_index);
+}
+
+
+static void gdsf_remove(policy_t* policy, list_node_t* node) {
+    size_t idx = list_node_get_meta(node)->heap_index;
+    list_node_t* last = policy->heap[list_length(policy->main) - 1];
+    list_remove(policy->main, node);
+    if (node != last) {
+        heap_set(policy, idx, last);
+        heap_sift_up(policy, idx);
+        heap_sift_down(policy, list_node_get_meta(last)->heap_index);
+    }
+}
+
+
+static page_t* gdsf_evict(policy_t* policy) {
+    list_node_t* victim = policy->heap[0];
+    policy->inflation = list_node_get_meta(victim)->priority;
+    page_t* page = list_node_get_page(victim);
+    gdsf_remove(policy, victim);
+    return page;
+}
+
+
+static void arc_miss(policy_t* policy, const char* key) {
+    unsigned long hash = key_hash(key);
+    size_t n_recent_ghosts = ghost_list_length(policy->ghosts);
+    size_t n_frequent_ghosts = ghost_list_length(policy->frequent_ghosts);
+
+    policy->ghost_hit = GHOST_HIT_NONE;
+    if (ghost_list_remove(policy->ghosts, hash)) {
+        // Recency part was too small, grow it
+        size_t delta = n_frequent_ghosts > n_recent_ghosts ? n_frequent_ghosts / n_recent_ghosts : 1;
+        policy->target = policy->target + delta < policy->max_size ? policy->target + delta : policy->max_size;
+        policy->ghost_hit = GHOST_HIT_RECENT;
+    } else if (ghost_list_remove(policy->frequent_ghosts, hash)) {
+        // Frequency part was too small, shrink recency part
+        size_t delta = n_recent_ghosts > n_frequent_ghosts ? n_recent_ghosts / n_frequent_ghosts : 1;
+        policy->target = policy->target > delta ? policy->target - delta : 0;
+        policy->ghost_hit = GHOST_HIT_FREQUENT;
+    } else {
+        // Keep directory within c entries for T1 + B1 and 2c in total
+        size_t n_recent = list_length(policy->probation);
+        size_t n_frequent = list_length(policy->main);
+        if (n_recent + n_recent_ghosts >= policy->max_size) {
+            ghost_list_pop_back(policy->ghosts);
+        } else if (n_recent + n_frequent + n_recent_ghosts + n_frequent_ghosts >= 2 * policy->max_size) {
+            ghost_list_pop_back(policy->frequent_ghosts);
+        }
+    }
+}
+
+
+void policy_miss(policy_t* policy, const char* key) {
+    if (policy->type == CACHE_POLICY_ARC) {
+        arc_miss(policy, key);
+    }
+}
+
+
+list_node_t* policy_insert(policy_t* policy, const char* key, page_t* page) {
+    switch (policy->type) {
+    case CACHE_POLICY_SLRU:
+        return list_push_front(policy->probation, page);
+    case CACHE_POLICY_2Q:
+        if (ghost_list_remove(policy->ghosts, key_hash(key))) {
+            // Seen recently, page is not a one-hit wonder
+            return list_push_front(policy->main, page);
+        }
+        return list_push_front(policy->probation, page);
+    case CACHE_POLICY_ARC:
+        if (policy->ghost_hit != GHOST_HIT_NONE) {
+            policy->ghost_hit = GHOST_HIT_NONE;
+            return list_push_front(policy->main, page);
+        }
+        return list_push_front(policy->probation, page);
+    case CACHE_POLICY_GDSF: {
+        list_node_t* node = list_push_front(policy->main, page);
+        gdsf_insert(policy, node);
+        return node;
+    }
+    case CACHE_POLICY_LRU:
+    default:
+        return list_push_front(policy->main, page);
+    }
+}
+
+
+void policy_touch(policy_t* policy, list_node_t* node) {
+    list_t* owner = list_node_get_list(node);
+    switch (policy->type) {
+    case CACHE_POLICY_SLRU:
+        if (owner == policy->probation) {
+            list_transfer_upfront(policy->main, policy->probation, node);
+            if (list_length(policy->main) > policy->max_protected) {
+                // Demoted page gets another chance in probationary segment
+                list_transfer_upfront(policy->probation, policy->main, list_back_node(policy->main));
+            }
+        } else {
+            list_move_upfront(policy->main, node);
+        }
+        break;
+    case CACHE_POLICY_2Q:
+        // A1in is FIFO, hits there do not change order
+        if (owner == policy->main) {
+            list_move_upfront(policy->main, node);
+        }
+        break;
+    case CACHE_POLICY_ARC:
+        list_transfer_upfront(policy->main, owner, node);
+        break;
+    case CACHE_POLICY_GDSF:
+        gdsf_touch(policy, node);
+        break;
+    case CACHE_POLICY_LRU:
+    default:
+        list_move_upfront(policy->main, node);
+        break;
+    }
+}
+
+
+void policy_remove(policy_t* policy, list_node_t* node) {
+    if (policy->type == CACHE_POLICY_GDSF) {
+        gdsf_remove(policy, node);
+    } else {
+        list_remove(list_node_get_list(node), node);
+    }
+}
+
+
+static page_t* pop_back(list_t* list) {
+    page_t* page = list_back(list);
+    list_pop_back(list);
+    return page;
+}
+
+
+page_t* policy_evict(policy_t* policy) {
+    switch (policy->type) {
+    case CACHE_POLICY_SLRU:
+        if (!is_list_empty(policy->probation)) {
+            return pop_back(policy->probation);
+        }
+        return pop_back(policy->main);
+    case CACHE_POLICY_2Q:
+        if (!is_list_empty(policy->probation)
+                && (list_length(policy->probation) > policy->max_in || is_list_empty(policy->main))) {
+            page_t* page = pop_back(policy->probation);
+            if (page != NULL) {
+                ghost_list_push(policy->ghosts, key_hash(page->key));
+            }
+            return page;
+        }
+        return pop_back(policy->main);
+    case CACHE_POLICY_ARC: {
+        size_t n_recent = list_length(policy->probation);
+        bool evict_recent = n_recent > 0
+            && (n_recent > policy->target
+                || (n_recent == policy->target && policy->ghost_hit == GHOST_HIT_FREQUENT)
+                || is_list_empty(policy->main));
+        list_t* victim_list = evict_recent ? policy->probation : policy->main;
+        ghost_list_t* ghosts = evict_recent ? policy->ghosts : policy->frequent_ghosts;
+        page_t* page = pop_back(victim_list);
+        if (page != NULL) {
+            ghost_list_push(ghosts, key_hash(page->key));
+        }
+        return page;
+    }
+    case CACHE_POLICY_GDSF:
+        return gdsf_evict(policy);
+    case CACHE_POLICY_LRU:
+    default:
+        return pop_back(policy->main);
+    }
+}
+
+
+size_t policy_length(const policy_t* policy) {
+    return list_length(policy->main) + list_length(policy->probation);
+}
+
+
+size_t policy_target(const policy_t* policy) {
+    return policy->target;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "cache.h"
+#include "list.h"
+
+// Eviction policy: keeps cached pages in recency/frequency order and picks victims
+typedef struct policy_t policy_t;
+
+policy_t* create_policy(cache_policy_t, size_t);
+// Pages are not deleted, policy should be emptied by caller
+void delete_policy(policy_t*);
+
+// Called on cache miss before evictions made for the key
+void policy_miss(policy_t*, const char*);
+list_node_t* policy_insert(policy_t*, const char*, page_t*);
+void policy_touch(policy_t*, list_node_t*);
+// Removes node, page is not deleted
+void policy_remove(policy_t*, list_node_t*);
+// Removes victim and returns its page, policy should not be empty
+page_t* policy_evict(policy_t*);
+
+// Adapts segment sizes to new capacity, ghost lists are kept and only their oldest
+// entries are trimmed to fit. Pages are not evicted.
+void policy_resize(policy_t*, size_t);
+
+size_t policy_length(const policy_t*);
+// ARC target size of recency part
+size_t policy_target(const policy_t*);
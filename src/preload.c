@@ -0,0 +1,134 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "preload.h"
+#include "util.h"
+
+
+typedef struct preload_key_t {
+    const char* key;
+    size_t index;  // position in the hottest first list
+} preload_key_t;
+
+
+typedef struct preload_job_t {
+    const preload_key_t* keys;
+    page_t** pages;  // by position, NULL for cached keys and failed loads
+    size_t n_keys;
+    atomic_size_t next;  // index of next key to load
+    page_t* (*get_page_slow)(const char*);
+} preload_job_t;
+
+
+static void* preload_worker(void* arg) {
+    preload_job_t* job = arg;
+    size_t i;
+    while ((i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->n_keys) {
+        double start = now_sec();
+        page_t* page = job->get_page_slow(job->keys[i].key);
+        if (page != NULL && page->cost <= 0.0) {
+            page->cost = now_sec() - start;
+        }
+        job->pages[job->keys[i].index] = page;
+    }
+    return NULL;
+}
+
+
+static int compare_keys(const void* a, const void* b) {
+    const preload_key_t* first = a;
+    const preload_key_t* second = b;
+    int order = strcmp(first->key, second->key);
+    if (order != 0) {
+        return order;
+    }
+    return (first->index > second->index) - (first->index < second->index);
+}
+
+
+size_t cache_preload(lru_cache_t* cache, const char* const* keys, size_t n,
+                     page_t* (*get_page_slow)(const char*), size_t n_workers) {
+    // Colder keys would be evicted by hotter ones right away
+    size_t max_size = cache_max_size(cache);
+    if (n > max_size) {
+        n = max_size;
+    }
+    preload_key_t* missing = malloc(sizeof(preload_key_t) * (n > 0 ? n : 1));
+    if (missing == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t n_missing = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!cache_contains(cache, keys[i])) {
+            missing[n_missing++] = (preload_key_t) {.key = keys[i], .index = i};
+        }
+    }
+    // Repeated keys sort next to each other and are loaded once, at the hottest position
+    qsort(missing, n_missing, sizeof(preload_key_t), &compare_keys);
+    size_t n_unique = 0;
+    for (size_t i = 0; i < n_missing; ++i) {
+        if (n_unique == 0 || strcmp(missing[n_unique - 1].key, missing[i].key) != 0) {
+            missing[n_unique++] = missing[i];
+        }
+    }
+    n_missing = n_unique;
+    size_t n_pages = cache_length(cache) + n_missing;
+    cache_reserve(cache, n_pages < max_size ? n_pages : max_size);
+
+    preload_job_t job = {
+        .keys = missing,
+        .pages = calloc(n > 0 ? n : 1, sizeof(page_t*)),
+        .n_keys = n_missing,
+        .get_page_slow = get_page_slow,
+    };
+    if (job.pages == NULL) {
+        puts("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&job.next, 0);
+    if (n_workers > n_missing) {
+        n_workers = n_missing;
+    }
+    pthread_t* threads = malloc(sizeof(pthread_t) * (n_workers > 0 ? n_workers : 1));
+    if (threads == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n_workers; ++i) {
+        if (pthread_create(&threads[i], NULL, &preload_worker, &job) != 0) {
+            puts("pthread_create failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (n_workers == 0) {
+        preload_worker(&job);
+    }
+    for (size_t i = 0; i < n_workers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Cached keys go above the rest first, so inserted pages do not evict them
+    for (size_t i = n; i > 0; --i) {
+        cache_touch(cache, keys[i - 1]);
+    }
+    // Failed loads are not cached, next cached_call retries them
+    size_t n_inserted = 0;
+    for (size_t i = n; i > 0; --i) {
+        if (job.pages[i - 1] != NULL) {
+            cache_put(cache, keys[i - 1], job.pages[i - 1]);
+            ++n_inserted;
+        } else {
+            cache_touch(cache, keys[i - 1]);
+        }
+    }
+    free(threads);
+    free(job.pages);
+    free(missing);
+    return n_inserted;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "cache.h"
+
+// Warms cache with keys ordered from hottest to coldest.
+// Pages are loaded by n_workers threads (0 - by calling thread) and inserted coldest
+// first, so the hottest keys end up most recently used. Keys already cached, repeated
+// keys and keys beyond cache capacity are skipped. Loader is called concurrently and must be
+// thread-safe. NULL pages are not inserted. Returns number of inserted pages.
+size_t cache_preload(lru_cache_t*, const char* const*, size_t, page_t* (*)(const char*), size_t n_workers);
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pressure.h"
+
+
+#define DEFAULT_CGROUP_DIR "/sys/fs/cgroup"
+
+
+struct pressure_watcher_t {
+    lru_cache_t* cache;
+    pressure_config_t config;
+    char* cgroup_dir;
+};
+
+
+pressure_config_t pressure_default_config(const char* cgroup_dir, size_t min_size, size_t max_size) {
+    pressure_config_t config = {
+        .cgroup_dir = cgroup_dir != NULL ? cgroup_dir : DEFAULT_CGROUP_DIR,
+        .min_size = min_size,
+        .max_size = max_size,
+        .high_watermark = 0.9,
+        .low_watermark = 0.7,
+        .max_pressure = 10.0,
+        .shrink_factor = 0.75,
+        .grow_factor = 1.1,
+    };
+    return config;
+}
+
+
+// Opens file of the cgroup, returns NULL if it is missing
+static FILE* open_cgroup_file(const char* cgroup_dir, const char* name) {
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/%s", cgroup_dir, name) >= (int) sizeof(path)) {
+        return NULL;
+    }
+    return fopen(path, "r");
+}
+
+
+bool read_memory_state(const char* cgroup_dir, memory_state_t* state) {
+    unsigned long long value;
+    char word[32];
+
+    FILE* file = open_cgroup_file(cgroup_dir, "memory.current");
+    if (file == NULL) {
+        return false;
+    }
+    bool ok = fscanf(file, "%llu", &value) == 1;
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    state->current = value;
+
+    // Contains "max" when cgroup has no limit
+    file = open_cgroup_file(cgroup_dir, "memory.max");
+    state->limit = 0;
+    if (file != NULL) {
+        if (fscanf(file, "%31s", word) == 1 && strcmp(word, "max") != 0) {
+            state->limit = strtoull(word, NULL, 10);
+        }
+        fclose(file);
+    }
+
+    // First line: "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+    file = open_cgroup_file(cgroup_dir, "memory.pressure");
+    state->pressure = 0.0;
+    if (file != NULL) {
+        double pressure;
+        if (fscanf(file, "some avg10=%lf", &pressure) == 1) {
+            state->pressure = pressure;
+        }
+        fclose(file);
+    }
+    return true;
+}
+
+
+pressure_watcher_t* create_pressure_watcher(lru_cache_t* cache, const pressure_config_t* config) {
+    if (cache == NULL || config->min_size == 0 || config->min_size > config->max_size) {
+        return NULL;
+    }
+    pressure_watcher_t* watcher = malloc(sizeof(pressure_watcher_t));
+    if (watcher == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    watcher->cache = cache;
+    watcher->config = *config;
+    watcher->cgroup_dir = string_dup(config->cgroup_dir);
+    watcher->config.cgroup_dir = watcher->cgroup_dir;
+    return watcher;
+}
+
+
+void delete_pressure_watcher(pressure_watcher_t* watcher) {
+    if (watcher != NULL) {
+        free(watcher->cgroup_dir);
+    }
+    free(watcher);
+}
+
+
+size_t pressure_watcher_poll(pressure_watcher_t* watcher) {
+    const pressure_config_t* config = &watcher->config;
+    size_t size = cache_max_size(watcher->cache);
+    memory_state_t state;
+    if (read_memory_state(config->cgroup_dir, &state)) {
+        double usage = state.limit != 0 ? (double) state.current / state.limit : 0.0;
+        if (usage > config->high_watermark || state.pressure > config->max_pressure) {
+            size = (size_t) (size * config->shrink_factor);
+        } else if (usage < config->low_watermark && state.pressure <= config->max_pressure / 2) {
+            size_t grown = (size_t) (size * config->grow_factor);
+            size = grown > size ? grown : size + 1;
+        }
+    }
+    if (size < config->min_size) {
+        size = config->min_size;
+    } else if (size > config->max_size) {
+        size = config->max_size;
+    }
+    // Called on every poll to continue gradual shrinking
+    cache_resize(watcher->cache, size, cache_max_bytes(watcher->cache));
+    return size;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cache.h"
+
+// Adjusts cache capacity to memory pressure of a cgroup v2.
+// Watcher does not run on its own, caller polls it from the thread owning the cache
+// (e.g. on a timer), each poll reads cgroup files once and resizes cache.
+typedef struct pressure_watcher_t pressure_watcher_t;
+
+typedef struct pressure_config_t {
+    const char* cgroup_dir;  // contains memory.current, memory.max and memory.pressure
+    size_t min_size;         // capacity bounds in pages
+    size_t max_size;
+    double high_watermark;   // shrink when memory.current is above this share of memory.max
+    double low_watermark;    // grow when below this share
+    double max_pressure;     // shrink when PSI "some avg10" is above this percentage
+    double shrink_factor;    // capacity multipliers
+    double grow_factor;
+} pressure_config_t;
+
+typedef struct memory_state_t {
+    size_t current;   // bytes used by cgroup
+    size_t limit;     // 0 - no limit
+    double pressure;  // share of time some tasks stalled on memory in last 10 s, percent
+} memory_state_t;
+
+pressure_config_t pressure_default_config(const char* cgroup_dir, size_t min_size, size_t max_size);
+// Returns false if cgroup files are missing or malformed, missing pressure file counts as 0
+bool read_memory_state(const char* cgroup_dir, memory_state_t*);
+
+pressure_watcher_t* create_pressure_watcher(lru_cache_t*, const pressure_config_t*);
+void delete_pressure_watcher(pressure_watcher_t*);
+// Returns new capacity of the cache
+size_t pressure_watcher_poll(pressure_watcher_t*);
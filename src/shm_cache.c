@@ -0,0 +1,566 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_cache.h"
+
+
+#define NIL UINT32_MAX
+#define SHM_MAGIC 0x6c72755f73686d33ULL  // "lru_shm3"
+#define DEFAULT_BYTES_PER_PAGE 1024
+#define MIN_BLOCK_SHIFT 5                 // smallest arena block is 32 bytes
+#define N_SIZE_CLASSES 32
+#define ALIGNMENT 64
+#define ATTACH_TIMEOUT_MS 5000
+
+
+typedef struct shm_entry_t {
+    uint64_t block;       // arena offset of key and data, both NUL-terminated
+    uint64_t version;
+    uint32_t size;        // data length, data may contain NUL bytes
+    uint32_t user_flags;
+    uint32_t hash;        // lower bits of key hash, checked before key comparison
+    uint32_t prev;        // more recently used entry
+    uint32_t next;        // less recently used entry
+    uint32_t chain;       // next entry in bucket, also links free entries
+    uint8_t size_class;
+} shm_entry_t;
+
+
+// Arena is a buddy allocator: blocks are powers of two aligned to their size, a free
+// block merges with its free buddy into one of the next size. Free blocks are kept in
+// per-size doubly linked lists through their first bytes, and the free map has the
+// size class + 1 of the free block starting at every 32-byte unit, 0 for others.
+typedef struct shm_header_t {
+    _Atomic uint64_t magic;  // set last by creator, attaching processes wait for it
+    uint64_t segment_size;
+    uint64_t max_size;
+    uint64_t n_buckets;      // power of 2
+    uint64_t entries_offset;
+    uint64_t buckets_offset;
+    uint64_t map_offset;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    pthread_mutex_t mutex;
+    // Fields below are guarded by mutex
+    uint64_t free_blocks[N_SIZE_CLASSES];  // NIL64 terminated
+    uint64_t length;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t free_entries;
+    shm_stats_t stats;
+} shm_header_t;
+
+#define NIL64 UINT64_MAX
+
+
+struct shm_cache_t {
+    shm_header_t* header;
+    char* base;
+    int fd;
+    page_t* result;  // copy returned by the last call
+};
+
+
+shm_config_t shm_default_config(const char* name, size_t size) {
+    shm_config_t config = {
+        .name = name,
+        .fd = -1,
+        .max_size = size,
+        .arena_bytes = 0,
+    };
+    return config;
+}
+
+
+static size_t align_up(size_t size) {
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+
+static shm_entry_t* entries(const shm_cache_t* cache) {
+    return (shm_entry_t*) (cache->base + cache->header->entries_offset);
+}
+
+
+static uint32_t* buckets(const shm_cache_t* cache) {
+    return (uint32_t*) (cache->base + cache->header->buckets_offset);
+}
+
+
+static char* block_ptr(const shm_cache_t* cache, uint64_t block) {
+    return cache->base + cache->header->arena_offset + block;
+}
+
+
+static uint8_t* free_map(const shm_cache_t* cache) {
+    return (uint8_t*) (cache->base + cache->header->map_offset);
+}
+
+
+static size_t class_size(size_t size_class) {
+    return (size_t) 1 << (size_class + MIN_BLOCK_SHIFT);
+}
+
+
+// Largest block arena can hold, the one starting at offset 0
+static size_t largest_class(size_t arena_size) {
+    size_t size_class = 0;
+    while (size_class + 1 < N_SIZE_CLASSES && class_size(size_class + 1) <= arena_size) {
+        ++size_class;
+    }
+    return size_class;
+}
+
+
+// Free block links are previous and next block of the same class
+static void push_free(shm_cache_t* cache, uint64_t block, size_t size_class) {
+    shm_header_t* header = cache->header;
+    uint64_t links[2] = {NIL64, header->free_blocks[size_class]};
+    memcpy(block_ptr(cache, block), links, sizeof(links));
+    if (links[1] != NIL64) {
+        memcpy(block_ptr(cache, links[1]), &block, sizeof(uint64_t));
+    }
+    header->free_blocks[size_class] = block;
+    free_map(cache)[block >> MIN_BLOCK_SHIFT] = (uint8_t) (size_class + 1);
+}
+
+
+static void remove_free(shm_cache_t* cache, uint64_t block, size_t size_class) {
+    uint64_t links[2];
+    memcpy(links, block_ptr(cache, block), sizeof(links));
+    if (links[0] != NIL64) {
+        memcpy(block_ptr(cache, links[0]) + sizeof(uint64_t), &links[1], sizeof(uint64_t));
+    } else {
+        cache->header->free_blocks[size_class] = links[1];
+    }
+    if (links[1] != NIL64) {
+        memcpy(block_ptr(cache, links[1]), &links[0], sizeof(uint64_t));
+    }
+    free_map(cache)[block >> MIN_BLOCK_SHIFT] = 0;
+}
+
+
+// Empties cache, also used to recover after a process died inside critical section
+static void reset(shm_cache_t* cache) {
+    shm_header_t* header = cache->header;
+    uint32_t* bucket_array = buckets(cache);
+    shm_entry_t* entry_array = entries(cache);
+    for (size_t i = 0; i < header->n_buckets; ++i) {
+        bucket_array[i] = NIL;
+    }
+    for (size_t i = 0; i < header->max_size; ++i) {
+        entry_array[i].chain = i + 1 < header->max_size ? (uint32_t) (i + 1) : NIL;
+    }
+    // Whole arena is cut into the largest aligned blocks that fit
+    for (size_t i = 0; i < N_SIZE_CLASSES; ++i) {
+        header->free_blocks[i] = NIL64;
+    }
+    memset(free_map(cache), 0, header->arena_size >> MIN_BLOCK_SHIFT);
+    for (uint64_t offset = 0; offset + class_size(0) <= header->arena_size;) {
+        size_t size_class = largest_class(header->arena_size);
+        while (size_class > 0 && (offset % class_size(size_class) != 0
+                                  || offset + class_size(size_class) > header->arena_size)) {
+            --size_class;
+        }
+        push_free(cache, offset, size_class);
+        offset += class_size(size_class);
+    }
+    header->length = 0;
+    header->head = NIL;
+    header->tail = NIL;
+    header->free_entries = 0;
+    header->stats.n_bytes = 0;
+}
+
+
+static void init_segment(shm_cache_t* cache, size_t max_size, size_t n_buckets, size_t arena_size) {
+    shm_header_t* header = cache->header;
+    header->segment_size = 0;
+    header->max_size = max_size;
+    header->n_buckets = n_buckets;
+    header->entries_offset = align_up(sizeof(shm_header_t));
+    header->buckets_offset = header->entries_offset + align_up(sizeof(shm_entry_t) * max_size);
+    header->map_offset = header->buckets_offset + align_up(sizeof(uint32_t) * n_buckets);
+    header->arena_offset = header->map_offset + align_up(arena_size >> MIN_BLOCK_SHIFT);
+    header->arena_size = arena_size;
+    header->segment_size = header->arena_offset + arena_size;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    memset(&header->stats, 0, sizeof(shm_stats_t));
+    reset(cache);
+    atomic_store_explicit(&header->magic, SHM_MAGIC, memory_order_release);
+}
+
+
+static size_t segment_size(size_t max_size, size_t n_buckets, size_t arena_size) {
+    return align_up(sizeof(shm_header_t)) + align_up(sizeof(shm_entry_t) * max_size)
+         + align_up(sizeof(uint32_t) * n_buckets) + align_up(arena_size >> MIN_BLOCK_SHIFT) + arena_size;
+}
+
+
+static shm_cache_t* map_segment(int fd, size_t size) {
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    shm_cache_t* cache = malloc(sizeof(shm_cache_t));
+    if (cache == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache->base = base;
+    cache->header = base;
+    cache->fd = fd;
+    cache->result = NULL;
+    return cache;
+}
+
+
+// Waits until creator has sized and initialized the segment, then maps all of it
+static shm_cache_t* attach(int fd) {
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 1000000};
+    struct stat st;
+    for (size_t waited = 0; waited < ATTACH_TIMEOUT_MS; ++waited) {
+        if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(shm_header_t)) {
+            shm_cache_t* cache = map_segment(fd, st.st_size);
+            if (cache == NULL) {
+                return NULL;
+            }
+            if (atomic_load_explicit(&cache->header->magic, memory_order_acquire) == SHM_MAGIC
+                && cache->header->segment_size == (uint64_t) st.st_size) {
+                return cache;
+            }
+            munmap(cache->base, st.st_size);
+            free(cache);
+        }
+        nanosleep(&delay, NULL);
+    }
+    return NULL;
+}
+
+
+shm_cache_t* create_shm_cache(const shm_config_t* config) {
+    int fd = -1;
+    bool created = false;
+    if (config->fd >= 0) {
+        fd = dup(config->fd);
+    } else if (config->name != NULL) {
+        fd = shm_open(config->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        created = fd >= 0;
+        if (fd < 0 && errno == EEXIST) {
+            fd = shm_open(config->name, O_RDWR, 0600);
+        }
+    } else {
+        fd = memfd_create("shm_cache", MFD_CLOEXEC);
+        created = fd >= 0;
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+    if (!created) {
+        shm_cache_t* cache = attach(fd);
+        if (cache == NULL) {
+            close(fd);
+        }
+        return cache;
+    }
+
+    size_t max_size = config->max_size;
+    if (max_size == 0 || max_size >= NIL) {
+        close(fd);
+        if (config->name != NULL) {
+            shm_unlink(config->name);
+        }
+        return NULL;
+    }
+    size_t n_buckets = 1;
+    while (n_buckets < max_size) {
+        n_buckets *= 2;
+    }
+    size_t arena_size = config->arena_bytes != 0 ? config->arena_bytes : max_size * DEFAULT_BYTES_PER_PAGE;
+    arena_size = align_up(arena_size);
+    size_t size = segment_size(max_size, n_buckets, arena_size);
+    shm_cache_t* cache = NULL;
+    if (ftruncate(fd, size) == 0) {
+        cache = map_segment(fd, size);
+    }
+    if (cache == NULL) {
+        close(fd);
+        if (config->name != NULL) {
+            shm_unlink(config->name);
+        }
+        return NULL;
+    }
+    init_segment(cache, max_size, n_buckets, arena_size);
+    return cache;
+}
+
+
+void delete_shm_cache(shm_cache_t* cache) {
+    if (cache != NULL) {
+        munmap(cache->base, cache->header->segment_size);
+        close(cache->fd);
+        delete_page(cache->result);
+    }
+    free(cache);
+}
+
+
+bool shm_cache_unlink(const char* name) {
+    return shm_unlink(name) == 0;
+}
+
+
+int shm_cache_fd(const shm_cache_t* cache) {
+    return cache->fd;
+}
+
+
+static void lock(shm_cache_t* cache) {
+    if (pthread_mutex_lock(&cache->header->mutex) == EOWNERDEAD) {
+        // Links may be half-updated, so contents are dropped
+        reset(cache);
+        ++cache->header->stats.recoveries;
+        pthread_mutex_consistent(&cache->header->mutex);
+    }
+}
+
+
+static void unlock(shm_cache_t* cache) {
+    pthread_mutex_unlock(&cache->header->mutex);
+}
+
+
+static const char* entry_key(const shm_cache_t* cache, const shm_entry_t* entry) {
+    return block_ptr(cache, entry->block);
+}
+
+
+static uint32_t* get_bucket(const shm_cache_t* cache, unsigned long hash) {
+    return &buckets(cache)[hash & (cache->header->n_buckets - 1)];
+}
+
+
+static uint32_t find_entry(const shm_cache_t* cache, const char* key, unsigned long hash) {
+    uint32_t idx = *get_bucket(cache, hash);
+    while (idx != NIL) {
+        const shm_entry_t* entry = &entries(cache)[idx];
+        if (entry->hash == (uint32_t) hash && !strcmp(entry_key(cache, entry), key)) {
+            break;
+        }
+        idx = entry->chain;
+    }
+    return idx;
+}
+
+
+static void lru_unlink(shm_cache_t* cache, uint32_t idx) {
+    shm_header_t* header = cache->header;
+    shm_entry_t* entry = &entries(cache)[idx];
+    if (entry->prev != NIL) {
+        entries(cache)[entry->prev].next = entry->next;
+    } else {
+        header->head = entry->next;
+    }
+    if (entry->next != NIL) {
+        entries(cache)[entry->next].prev = entry->prev;
+    } else {
+        header->tail = entry->prev;
+    }
+}
+
+
+static void lru_push_front(shm_cache_t* cache, uint32_t idx) {
+    shm_header_t* header = cache->header;
+    shm_entry_t* entry = &entries(cache)[idx];
+    entry->prev = NIL;
+    entry->next = header->head;
+    if (header->head != NIL) {
+        entries(cache)[header->head].prev = idx;
+    } else {
+        header->tail = idx;
+    }
+    header->head = idx;
+}
+
+
+static size_t size_class_of(size_t size) {
+    size_t size_class = 0;
+    while (size_class < N_SIZE_CLASSES && class_size(size_class) < size) {
+        ++size_class;
+    }
+    return size_class;
+}
+
+
+static void free_block(shm_cache_t* cache, uint64_t block, size_t size_class) {
+    shm_header_t* header = cache->header;
+    header->stats.n_bytes -= class_size(size_class);
+    while (size_class + 1 < N_SIZE_CLASSES) {
+        uint64_t buddy = block ^ class_size(size_class);
+        if (buddy + class_size(size_class) > header->arena_size
+            || free_map(cache)[buddy >> MIN_BLOCK_SHIFT] != size_class + 1) {
+            break;
+        }
+        remove_free(cache, buddy, size_class);
+        block &= ~(uint64_t) class_size(size_class);
+        ++size_class;
+    }
+    push_free(cache, block, size_class);
+}
+
+
+// Splits the smallest free block large enough, returns NIL64 if there is none
+static uint64_t alloc_block(shm_cache_t* cache, size_t size_class) {
+    shm_header_t* header = cache->header;
+    size_t from = size_class;
+    while (from < N_SIZE_CLASSES && header->free_blocks[from] == NIL64) {
+        ++from;
+    }
+    if (from == N_SIZE_CLASSES) {
+        return NIL64;
+    }
+    uint64_t block = header->free_blocks[from];
+    remove_free(cache, block, from);
+    while (from > size_class) {
+        --from;
+        push_free(cache, block + class_size(from), from);
+    }
+    header->stats.n_bytes += class_size(size_class);
+    return block;
+}
+
+
+static void evict_back(shm_cache_t* cache) {
+    shm_header_t* header = cache->header;
+    uint32_t idx = header->tail;
+    shm_entry_t* entry = &entries(cache)[idx];
+    lru_unlink(cache, idx);
+
+    uint32_t* link = get_bucket(cache, entry->hash);
+    while (*link != idx) {  // should exist
+        link = &entries(cache)[*link].chain;
+    }
+    *link = entry->chain;
+
+    free_block(cache, entry->block, entry->size_class);
+    entry->chain = header->free_entries;
+    header->free_entries = idx;
+    --header->length;
+    ++header->stats.evictions;
+}
+
+
+// Replaces previous result with a copy of the entry, called under the lock
+static const page_t* copy_result(shm_cache_t* cache, const shm_entry_t* entry) {
+    delete_page(cache->result);
+    const char* key = entry_key(cache, entry);
+    cache->result = create_page_sized(key, key + strlen(key) + 1, entry->size);
+    cache->result->version = entry->version;
+    cache->result->user_flags = entry->user_flags;
+    return cache->result;
+}
+
+
+static void insert(shm_cache_t* cache, const char* key, unsigned long hash, const page_t* page) {
+    shm_header_t* header = cache->header;
+    size_t key_len = strlen(key);
+    size_t size_class = size_class_of(key_len + 1 + page->size + 1);
+    if (size_class > largest_class(header->arena_size) || page->size > UINT32_MAX
+        || find_entry(cache, key, hash) != NIL) {
+        return;
+    }
+    // Freed blocks merge with their buddies, so evicting from the back frees space
+    // of any size, with the whole arena free at worst
+    uint64_t block;
+    while ((block = alloc_block(cache, size_class)) == NIL64 && header->length != 0) {
+        evict_back(cache);
+    }
+    if (block == NIL64) {
+        return;
+    }
+    if (header->length == header->max_size) {
+        evict_back(cache);
+    }
+    char* ptr = block_ptr(cache, block);
+    memcpy(ptr, key, key_len + 1);
+    memcpy(ptr + key_len + 1, page->data, page->size + 1);
+
+    uint32_t idx = header->free_entries;
+    shm_entry_t* entry = &entries(cache)[idx];
+    header->free_entries = entry->chain;
+    entry->block = block;
+    entry->version = page->version;
+    entry->size = (uint32_t) page->size;
+    entry->user_flags = page->user_flags;
+    entry->hash = (uint32_t) hash;
+    entry->size_class = (uint8_t) size_class;
+
+    uint32_t* bucket = get_bucket(cache, hash);
+    entry->chain = *bucket;
+    *bucket = idx;
+    lru_push_front(cache, idx);
+    ++header->length;
+}
+
+
+const page_t* shm_cached_call(shm_cache_t* cache, const char* key, page_t* (*get_page_slow)(const char*)) {
+    unsigned long hash = key_hash(key);
+    lock(cache);
+    uint32_t idx = find_entry(cache, key, hash);
+    if (idx != NIL) {
+        if (idx != cache->header->head) {
+            lru_unlink(cache, idx);
+            lru_push_front(cache, idx);
+        }
+        ++cache->header->stats.hits;
+        const page_t* page = copy_result(cache, &entries(cache)[idx]);
+        unlock(cache);
+        return page;
+    }
+    ++cache->header->stats.misses;
+    unlock(cache);
+
+    page_t* page = get_page_slow(key);
+    if (page == NULL) {
+        return NULL;
+    }
+    lock(cache);
+    insert(cache, key, hash, page);
+    unlock(cache);
+    delete_page(cache->result);
+    cache->result = page;
+    return page;
+}
+
+
+size_t shm_cache_length(shm_cache_t* cache) {
+    lock(cache);
+    size_t length = cache->header->length;
+    unlock(cache);
+    return length;
+}
+
+
+shm_stats_t shm_cache_stats(shm_cache_t* cache) {
+    lock(cache);
+    shm_stats_t stats = cache->header->stats;
+    unlock(cache);
+    return stats;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "page.h"
+
+// LRU cache shared by processes, e.g. pre-forked workers of one host.
+// Everything lives in one shared memory segment: header, entry array, buckets
+// and an arena for keys and data. Links are indices and offsets from the segment
+// start, so processes may map it at different addresses. One process-shared robust
+// mutex guards the cache, a process dying while holding it makes the next one
+// reset the cache instead of using half-updated links.
+typedef struct shm_cache_t shm_cache_t;
+
+typedef struct shm_config_t {
+    const char* name;    // shm_open name like "/name", NULL - unnamed memfd segment
+    int fd;              // segment to attach, e.g. received over unix socket, -1 - none
+    size_t max_size;     // max number of pages
+    size_t arena_bytes;  // space for keys and data, 0 - default per page
+} shm_config_t;
+
+typedef struct shm_stats_t {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t n_bytes;     // arena bytes taken by cached pages, including block rounding
+    size_t recoveries;  // resets after a process died holding the lock
+} shm_stats_t;
+
+shm_config_t shm_default_config(const char* name, size_t size);
+
+// Creates segment or attaches to existing one, sizes are then taken from the segment.
+// Segment stays while it is mapped by some process or its name exists.
+shm_cache_t* create_shm_cache(const shm_config_t*);
+// Unmaps segment, cache contents stay for other processes
+void delete_shm_cache(shm_cache_t*);
+bool shm_cache_unlink(const char*);
+// Segment descriptor, can be passed to unrelated processes
+int shm_cache_fd(const shm_cache_t*);
+// Loader runs without the lock. When two processes load the same key at once, the
+// first insert wins and the later process gets its own page back without caching it.
+// Returned page is a process-local copy, with size, version and user_flags, valid until
+// the next call on the same handle. Pages not fitting the arena are returned but not cached.
+const page_t* shm_cached_call(shm_cache_t*, const char*, page_t* (*)(const char*));
+size_t shm_cache_length(shm_cache_t*);
+shm_stats_t shm_cache_stats(shm_cache_t*);
@@ -0,0 +1,408 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "slab.h"
+
+
+#define MAX_CLASSES 64
+#define GROWTH_FACTOR 1.25
+#define CHUNK_ALIGN 16
+#define HEADER_SIZE SLAB_MIN_CHUNK  // index of the slab, chunks follow it
+#define MIN_SLAB_SIZE ((size_t) 4096)
+#define ANY_CLASS SIZE_MAX
+
+
+// Header of every chunk. Used chunks are linked in LRU list of their class,
+// free ones in free list through next, with prev set to NULL.
+typedef struct chunk_t {
+    struct chunk_t* prev;
+    struct chunk_t* next;
+} chunk_t;
+
+
+typedef struct slab_t {
+    char* memory;  // aligned to slab size, so chunk finds its slab by masking address
+    size_t class_id;
+    size_t n_used;
+} slab_t;
+
+
+typedef struct slab_class_t {
+    size_t chunk_size;
+    size_t n_chunks;    // per slab
+    size_t n_slabs;
+    size_t n_used;
+    chunk_t* free_list;
+    size_t n_free;
+    chunk_t lru;        // sentinel, lru.next is the most recently used chunk
+    size_t evictions;   // since last rebalance
+} slab_class_t;
+
+
+struct slab_allocator_t {
+    size_t slab_size;
+    size_t max_slabs;
+    slab_t* slabs;
+    size_t n_slabs;
+    size_t slabs_capacity;
+    slab_class_t classes[MAX_CLASSES];
+    size_t n_classes;
+    size_t n_chunk_bytes;
+    size_t n_moves;
+};
+
+
+slab_allocator_t* create_slab_allocator(size_t max_bytes, size_t slab_size) {
+    slab_allocator_t* slabs = malloc(sizeof(slab_allocator_t));
+    if (slabs == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    slabs->slab_size = MIN_SLAB_SIZE;
+    while (slabs->slab_size < slab_size) {
+        slabs->slab_size *= 2;
+    }
+    slabs->slabs = NULL;
+    slabs->n_slabs = 0;
+    slabs->slabs_capacity = 0;
+    slabs->n_chunk_bytes = 0;
+    slabs->n_moves = 0;
+    slab_set_max_bytes(slabs, max_bytes);
+
+    // The last class takes the whole slab
+    size_t area = slabs->slab_size - HEADER_SIZE;
+    size_t chunk_size = SLAB_MIN_CHUNK;
+    slabs->n_classes = 0;
+    for (bool is_last = false; !is_last;) {
+        is_last = chunk_size > area / 2 || slabs->n_classes == MAX_CLASSES - 1;
+        if (is_last) {
+            chunk_size = area;
+        }
+        slab_class_t* class = &slabs->classes[slabs->n_classes++];
+        class->chunk_size = chunk_size;
+        class->n_chunks = area / chunk_size;
+        class->n_slabs = 0;
+        class->n_used = 0;
+        class->free_list = NULL;
+        class->n_free = 0;
+        class->lru.prev = &class->lru;
+        class->lru.next = &class->lru;
+        class->evictions = 0;
+        size_t next_size = (size_t) (chunk_size * GROWTH_FACTOR);
+        chunk_size = (next_size + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+    }
+    return slabs;
+}
+
+
+void delete_slab_allocator(slab_allocator_t* slabs) {
+    if (slabs != NULL) {
+        for (size_t i = 0; i < slabs->n_slabs; ++i) {
+            free(slabs->slabs[i].memory);
+        }
+        free(slabs->slabs);
+    }
+    free(slabs);
+}
+
+
+// Smallest class holding size bytes, n_classes if there is none
+static size_t class_of(const slab_allocator_t* slabs, size_t size) {
+    size_t chunk_size = size + sizeof(chunk_t);
+    size_t lo = 0;
+    size_t hi = slabs->n_classes;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (slabs->classes[mid].chunk_size < chunk_size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+static slab_t* slab_of(const slab_allocator_t* slabs, const chunk_t* chunk) {
+    const char* memory = (const char*) ((uintptr_t) chunk & ~(uintptr_t) (slabs->slab_size - 1));
+    return &slabs->slabs[*(const size_t*) memory];
+}
+
+
+static void lru_unlink(chunk_t* chunk) {
+    chunk->prev->next = chunk->next;
+    chunk->next->prev = chunk->prev;
+}
+
+
+static void lru_push_front(slab_class_t* class, chunk_t* chunk) {
+    chunk->prev = &class->lru;
+    chunk->next = class->lru.next;
+    class->lru.next->prev = chunk;
+    class->lru.next = chunk;
+}
+
+
+// Cuts slab into free chunks of the class, the first chunk is handed out first
+static void assign_slab(slab_allocator_t* slabs, size_t index, size_t class_id) {
+    slab_t* slab = &slabs->slabs[index];
+    slab_class_t* class = &slabs->classes[class_id];
+    slab->class_id = class_id;
+    slab->n_used = 0;
+    for (size_t i = class->n_chunks; i-- > 0;) {
+        chunk_t* chunk = (chunk_t*) (slab->memory + HEADER_SIZE + i * class->chunk_size);
+        chunk->prev = NULL;
+        chunk->next = class->free_list;
+        class->free_list = chunk;
+    }
+    class->n_free += class->n_chunks;
+    ++class->n_slabs;
+}
+
+
+static bool take_slab(slab_allocator_t* slabs, size_t class_id) {
+    if (slabs->n_slabs >= slabs->max_slabs) {
+        return false;
+    }
+    if (slabs->n_slabs == slabs->slabs_capacity) {
+        slabs->slabs_capacity = slabs->slabs_capacity != 0 ? slabs->slabs_capacity * 2 : 16;
+        slabs->slabs = realloc(slabs->slabs, sizeof(slab_t) * slabs->slabs_capacity);
+        if (slabs->slabs == NULL) {
+            puts("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    char* memory = aligned_alloc(slabs->slab_size, slabs->slab_size);
+    if (memory == NULL) {
+        puts("aligned_alloc failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t index = slabs->n_slabs++;
+    *(size_t*) memory = index;
+    slabs->slabs[index].memory = memory;
+    assign_slab(slabs, index, class_id);
+    return true;
+}
+
+
+size_t slab_max_alloc(const slab_allocator_t* slabs) {
+    return slabs->classes[slabs->n_classes - 1].chunk_size - sizeof(chunk_t);
+}
+
+
+void* slab_alloc(slab_allocator_t* slabs, size_t size) {
+    size_t class_id = class_of(slabs, size);
+    if (class_id == slabs->n_classes) {
+        return NULL;
+    }
+    slab_class_t* class = &slabs->classes[class_id];
+    if (class->free_list == NULL && !take_slab(slabs, class_id)) {
+        return NULL;
+    }
+    chunk_t* chunk = class->free_list;
+    class->free_list = chunk->next;
+    --class->n_free;
+    lru_push_front(class, chunk);
+    ++slab_of(slabs, chunk)->n_used;
+    ++class->n_used;
+    slabs->n_chunk_bytes += class->chunk_size;
+    return chunk + 1;
+}
+
+
+void slab_free(slab_allocator_t* slabs, void* ptr) {
+    chunk_t* chunk = (chunk_t*) ptr - 1;
+    slab_t* slab = slab_of(slabs, chunk);
+    slab_class_t* class = &slabs->classes[slab->class_id];
+    lru_unlink(chunk);
+    chunk->prev = NULL;
+    chunk->next = class->free_list;
+    class->free_list = chunk;
+    ++class->n_free;
+    --slab->n_used;
+    --class->n_used;
+    slabs->n_chunk_bytes -= class->chunk_size;
+}
+
+
+void slab_touch(slab_allocator_t* slabs, void* ptr) {
+    chunk_t* chunk = (chunk_t*) ptr - 1;
+    lru_unlink(chunk);
+    lru_push_front(&slabs->classes[slab_of(slabs, chunk)->class_id], chunk);
+}
+
+
+void* slab_victim(slab_allocator_t* slabs, size_t size) {
+    size_t class_id = class_of(slabs, size);
+    if (class_id == slabs->n_classes || slabs->classes[class_id].n_used == 0) {
+        return NULL;
+    }
+    slab_class_t* class = &slabs->classes[class_id];
+    ++class->evictions;
+    return class->lru.prev + 1;
+}
+
+
+// Slab of the class with the fewest used chunks, cheapest to take away
+static size_t emptiest_slab(const slab_allocator_t* slabs, size_t class_id) {
+    size_t best = slabs->n_slabs;
+    for (size_t i = 0; i < slabs->n_slabs; ++i) {
+        const slab_t* slab = &slabs->slabs[i];
+        if ((class_id == ANY_CLASS || slab->class_id == class_id)
+            && (best == slabs->n_slabs || slab->n_used < slabs->slabs[best].n_used)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+
+// Evicts used chunks of the slab and takes its free chunks off the free list
+static void empty_slab(slab_allocator_t* slabs, size_t index, slab_evict_t evict, void* arg) {
+    slab_t* slab = &slabs->slabs[index];
+    slab_class_t* class = &slabs->classes[slab->class_id];
+    char* start = slab->memory + HEADER_SIZE;
+    char* end = start + class->n_chunks * class->chunk_size;
+    for (char* pos = start; pos < end && slab->n_used != 0; pos += class->chunk_size) {
+        chunk_t* chunk = (chunk_t*) pos;
+        if (chunk->prev != NULL) {
+            evict(chunk + 1, arg);
+        }
+    }
+    if (slab->n_used != 0) {
+        puts("slab evict callback did not free chunk");
+        exit(EXIT_FAILURE);
+    }
+    chunk_t** link = &class->free_list;
+    while (*link != NULL) {
+        if ((char*) *link >= start && (char*) *link < end) {
+            *link = (*link)->next;
+            --class->n_free;
+        } else {
+            link = &(*link)->next;
+        }
+    }
+    --class->n_slabs;
+}
+
+
+static double class_pressure(const slab_class_t* class) {
+    return (double) class->evictions / (class->n_slabs > 0 ? class->n_slabs : 1);
+}
+
+
+// Class to take a slab from: one with a slab worth of free chunks, otherwise the one
+// with the fewest evictions per slab. Returns n_classes if no other class has slabs.
+static size_t pick_donor(const slab_allocator_t* slabs, size_t receiver, double* pressure) {
+    size_t donor = slabs->n_classes;
+    for (size_t i = 0; i < slabs->n_classes; ++i) {
+        const slab_class_t* class = &slabs->classes[i];
+        if (i == receiver || class->n_slabs == 0) {
+            continue;
+        }
+        double class_donor_pressure = class->n_free >= class->n_chunks ? -1.0 : class_pressure(class);
+        if (donor == slabs->n_classes || class_donor_pressure < *pressure) {
+            donor = i;
+            *pressure = class_donor_pressure;
+        }
+    }
+    return donor;
+}
+
+
+static void move_slab(slab_allocator_t* slabs, size_t donor, size_t receiver, slab_evict_t evict, void* arg) {
+    size_t index = emptiest_slab(slabs, donor);
+    empty_slab(slabs, index, evict, arg);
+    assign_slab(slabs, index, receiver);
+    ++slabs->n_moves;
+}
+
+
+bool slab_move_to(slab_allocator_t* slabs, size_t size, slab_evict_t evict, void* arg) {
+    size_t receiver = class_of(slabs, size);
+    if (receiver == slabs->n_classes) {
+        return false;
+    }
+    if (take_slab(slabs, receiver)) {
+        return true;
+    }
+    double pressure;
+    size_t donor = pick_donor(slabs, receiver, &pressure);
+    if (donor == slabs->n_classes) {
+        return false;
+    }
+    move_slab(slabs, donor, receiver, evict, arg);
+    return true;
+}
+
+
+bool slab_rebalance(slab_allocator_t* slabs, slab_evict_t evict, void* arg) {
+    size_t receiver = slabs->n_classes;
+    double receiver_pressure = 0.0;
+    for (size_t i = 0; i < slabs->n_classes; ++i) {
+        double pressure = class_pressure(&slabs->classes[i]);
+        if (pressure > receiver_pressure) {
+            receiver = i;
+            receiver_pressure = pressure;
+        }
+    }
+    bool moved = false;
+    if (receiver != slabs->n_classes) {
+        double donor_pressure;
+        size_t donor = pick_donor(slabs, receiver, &donor_pressure);
+        if (donor != slabs->n_classes && donor_pressure * 2 < receiver_pressure) {
+            move_slab(slabs, donor, receiver, evict, arg);
+            moved = true;
+        }
+    }
+    for (size_t i = 0; i < slabs->n_classes; ++i) {
+        slabs->classes[i].evictions = 0;
+    }
+    return moved;
+}
+
+
+void slab_set_max_bytes(slab_allocator_t* slabs, size_t max_bytes) {
+    if (max_bytes == 0) {
+        slabs->max_slabs = SIZE_MAX / slabs->slab_size;
+    } else {
+        slabs->max_slabs = max_bytes > slabs->slab_size ? max_bytes / slabs->slab_size : 1;
+    }
+}
+
+
+bool slab_over_budget(const slab_allocator_t* slabs) {
+    return slabs->n_slabs > slabs->max_slabs;
+}
+
+
+void slab_shrink(slab_allocator_t* slabs, slab_evict_t evict, void* arg) {
+    if (slabs->n_slabs == 0) {
+        return;
+    }
+    size_t index = emptiest_slab(slabs, ANY_CLASS);
+    empty_slab(slabs, index, evict, arg);
+    free(slabs->slabs[index].memory);
+    // The last slab takes place of the freed one
+    --slabs->n_slabs;
+    if (index != slabs->n_slabs) {
+        slabs->slabs[index] = slabs->slabs[slabs->n_slabs];
+        *(size_t*) slabs->slabs[index].memory = index;
+    }
+}
+
+
+slab_stats_t slab_stats(const slab_allocator_t* slabs) {
+    slab_stats_t stats = {
+        .n_slabs = slabs->n_slabs,
+        .max_slabs = slabs->max_slabs,
+        .n_slab_bytes = slabs->n_slabs * slabs->slab_size,
+        .n_used = 0,
+        .n_chunk_bytes = slabs->n_chunk_bytes,
+        .n_moves = slabs->n_moves,
+    };
+    for (size_t i = 0; i < slabs->n_classes; ++i) {
+        stats.n_used += slabs->classes[i].n_used;
+    }
+    return stats;
+}
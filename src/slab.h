@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Slab allocator with a fixed memory budget, as in memcached.
+// Memory is taken from the system in slabs of slab_size bytes, each slab is cut into
+// equal chunks of one size class. Classes grow by factor 1.25 from SLAB_MIN_CHUNK up to
+// a whole slab. Freed chunks are reused by their class only, so holes left by large
+// values never fragment memory for small ones, and memory is moved between classes
+// a slab at a time by slab_rebalance.
+// Used chunks of a class are kept in LRU order for picking victims within the class.
+typedef struct slab_allocator_t slab_allocator_t;
+
+#define SLAB_DEFAULT_SIZE ((size_t) 1 << 20)
+#define SLAB_MIN_CHUNK 64  // including 16 bytes of LRU links
+
+// Called for used chunk of a slab being taken away from its class, must slab_free it
+typedef void (*slab_evict_t)(void*, void*);
+
+typedef struct slab_stats_t {
+    size_t n_slabs;        // slabs taken from system
+    size_t max_slabs;
+    size_t n_slab_bytes;   // their memory
+    size_t n_used;         // used chunks
+    size_t n_chunk_bytes;  // memory of used chunks
+    size_t n_moves;        // slabs moved between classes
+} slab_stats_t;
+
+// Slab size is rounded up to power of two, budget is at least one slab, 0 - no limit
+slab_allocator_t* create_slab_allocator(size_t max_bytes, size_t slab_size);
+void delete_slab_allocator(slab_allocator_t*);
+
+// Largest allocation a chunk can hold
+size_t slab_max_alloc(const slab_allocator_t*);
+// Returns NULL if class of the size has no free chunk and budget allows no more slabs
+void* slab_alloc(slab_allocator_t*, size_t);
+void slab_free(slab_allocator_t*, void*);
+// Marks chunk as most recently used within its class
+void slab_touch(slab_allocator_t*, void*);
+// Least recently used chunk of the class serving size, NULL if class has no chunks.
+// Counts as eviction pressure on the class.
+void* slab_victim(slab_allocator_t*, size_t);
+// Gives class serving size another slab, taken from class with the lowest eviction
+// pressure. Used when class has no chunks to evict. Returns false if no slab can be moved.
+bool slab_move_to(slab_allocator_t*, size_t, slab_evict_t, void*);
+// Moves one slab from class with the lowest eviction pressure since previous call to
+// the highest one, if pressure differs at least twice. Returns true if slab was moved.
+bool slab_rebalance(slab_allocator_t*, slab_evict_t, void*);
+
+void slab_set_max_bytes(slab_allocator_t*, size_t);
+bool slab_over_budget(const slab_allocator_t*);
+// Gives back to system one slab with the fewest used chunks
+void slab_shrink(slab_allocator_t*, slab_evict_t, void*);
+
+slab_stats_t slab_stats(const slab_allocator_t*);
@@ -0,0 +1,233 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+
+#define HIST_SUB_BITS 2                  // buckets per power of two = 1 << HIST_SUB_BITS
+#define HIST_N_BUCKETS (64 << HIST_SUB_BITS)
+#define CALIBRATION_NS 20000000          // rdtsc is measured against clock for 20 ms
+
+
+static const char* phase_names[TRACE_N_PHASES] = {
+    "call", "loader", "hash", "probe", "splice", "evict", "delete_page", "table_put", "table_delete", "rehash",
+};
+
+
+const char* trace_phase_name(trace_phase_t phase) {
+    return phase < TRACE_N_PHASES ? phase_names[phase] : "unknown";
+}
+
+
+#ifdef CACHE_TRACE
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_PROBE(phase, ticks) STAP_PROBE2(cache, phase, phase, ticks)
+#endif
+#endif
+#ifndef TRACE_PROBE
+#define TRACE_PROBE(phase, ticks)
+#endif
+
+
+// Counters are written by owning thread only, relaxed atomics let snapshots read them
+typedef struct trace_record_t trace_record_t;
+struct trace_record_t {
+    atomic_uint_fast64_t hist[TRACE_N_PHASES][HIST_N_BUCKETS];
+    atomic_uint_fast64_t total[TRACE_N_PHASES];
+    atomic_uint_fast64_t max[TRACE_N_PHASES];
+    atomic_bool in_use;
+    trace_record_t* next;  // immutable once record is published
+};
+
+
+// Records of exited threads are reused, so their counts are never lost
+static _Atomic(trace_record_t*) records = NULL;
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+
+static void release_record(void* arg) {
+    trace_record_t* record = arg;
+    atomic_store(&record->in_use, false);
+}
+
+
+static void create_record_key(void) {
+    if (pthread_key_create(&record_key, &release_record) != 0) {
+        puts("pthread_key_create failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+static trace_record_t* get_record(void) {
+    pthread_once(&record_key_once, &create_record_key);
+    trace_record_t* record = pthread_getspecific(record_key);
+    if (record != NULL) {
+        return record;
+    }
+    for (record = atomic_load(&records); record != NULL; record = record->next) {
+        bool in_use = false;
+        if (atomic_compare_exchange_strong(&record->in_use, &in_use, true)) {
+            break;
+        }
+    }
+    if (record == NULL) {
+        record = calloc(1, sizeof(trace_record_t));
+        if (record == NULL) {
+            puts("calloc failure");
+            exit(EXIT_FAILURE);
+        }
+        atomic_init(&record->in_use, true);
+        record->next = atomic_load(&records);
+        while (!atomic_compare_exchange_weak(&records, &record->next, record)) {
+        }
+    }
+    pthread_setspecific(record_key, record);
+    return record;
+}
+
+
+static size_t bucket_of(uint64_t ticks) {
+    if (ticks < (1u << HIST_SUB_BITS)) {
+        return ticks;
+    }
+    size_t exp = 63 - __builtin_clzll(ticks);
+    size_t sub = (ticks >> (exp - HIST_SUB_BITS)) & ((1u << HIST_SUB_BITS) - 1);
+    return ((exp - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + sub;
+}
+
+
+// First value of the next bucket
+static uint64_t bucket_end(size_t bucket) {
+    ++bucket;
+    if (bucket < (1u << HIST_SUB_BITS)) {
+        return bucket;
+    }
+    size_t exp = (bucket >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+    uint64_t sub = bucket & ((1u << HIST_SUB_BITS) - 1);
+    return ((1ull << HIST_SUB_BITS) + sub) << (exp - HIST_SUB_BITS);
+}
+
+
+static void add_relaxed(atomic_uint_fast64_t* counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+
+void trace_record(trace_phase_t phase, uint64_t ticks) {
+    trace_record_t* record = get_record();
+    add_relaxed(&record->hist[phase][bucket_of(ticks)], 1);
+    add_relaxed(&record->total[phase], ticks);
+    if (ticks > atomic_load_explicit(&record->max[phase], memory_order_relaxed)) {
+        atomic_store_explicit(&record->max[phase], ticks, memory_order_relaxed);
+    }
+    TRACE_PROBE(phase, ticks);
+}
+
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+// Nanoseconds per tick, rdtsc is calibrated on first use
+static double ns_per_tick(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    static double ratio = 0.0;
+    if (ratio == 0.0) {
+        double start_ns = now_ns();
+        uint64_t start = trace_now();
+        struct timespec pause = {0, CALIBRATION_NS};
+        nanosleep(&pause, NULL);
+        ratio = (now_ns() - start_ns) / (trace_now() - start);
+    }
+    return ratio;
+#else
+    return 1.0;
+#endif
+}
+
+
+bool trace_enabled(void) {
+    return true;
+}
+
+
+void trace_snapshot(trace_phase_stats_t stats[TRACE_N_PHASES]) {
+    double scale = ns_per_tick();
+    for (size_t phase = 0; phase < TRACE_N_PHASES; ++phase) {
+        uint64_t hist[HIST_N_BUCKETS] = {0};
+        uint64_t total = 0;
+        uint64_t max = 0;
+        size_t count = 0;
+        for (trace_record_t* record = atomic_load(&records); record != NULL; record = record->next) {
+            for (size_t i = 0; i < HIST_N_BUCKETS; ++i) {
+                uint64_t n = atomic_load_explicit(&record->hist[phase][i], memory_order_relaxed);
+                hist[i] += n;
+                count += n;
+            }
+            total += atomic_load_explicit(&record->total[phase], memory_order_relaxed);
+            uint64_t record_max = atomic_load_explicit(&record->max[phase], memory_order_relaxed);
+            max = record_max > max ? record_max : max;
+        }
+        trace_phase_stats_t* phase_stats = &stats[phase];
+        memset(phase_stats, 0, sizeof(trace_phase_stats_t));
+        phase_stats->count = count;
+        phase_stats->total_ns = total * scale;
+        phase_stats->max_ns = max * scale;
+        size_t p50_rank = (count + 1) / 2;
+        size_t p99_rank = count - count / 100;
+        size_t seen = 0;
+        for (size_t i = 0; i < HIST_N_BUCKETS && count != 0; ++i) {
+            if (seen < p50_rank && seen + hist[i] >= p50_rank) {
+                phase_stats->p50_ns = bucket_end(i) * scale;
+            }
+            if (seen < p99_rank && seen + hist[i] >= p99_rank) {
+                phase_stats->p99_ns = bucket_end(i) * scale;
+            }
+            seen += hist[i];
+        }
+    }
+}
+
+
+void trace_reset(void) {
+    for (trace_record_t* record = atomic_load(&records); record != NULL; record = record->next) {
+        for (size_t phase = 0; phase < TRACE_N_PHASES; ++phase) {
+            for (size_t i = 0; i < HIST_N_BUCKETS; ++i) {
+                atomic_store_explicit(&record->hist[phase][i], 0, memory_order_relaxed);
+            }
+            atomic_store_explicit(&record->total[phase], 0, memory_order_relaxed);
+            atomic_store_explicit(&record->max[phase], 0, memory_order_relaxed);
+        }
+    }
+}
+
+#else
+
+bool trace_enabled(void) {
+    return false;
+}
+
+
+void trace_snapshot(trace_phase_stats_t stats[TRACE_N_PHASES]) {
+    memset(stats, 0, sizeof(trace_phase_stats_t) * TRACE_N_PHASES);
+}
+
+
+void trace_reset(void) {
+}
+
+#endif
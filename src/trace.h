@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Phase-level latency tracing of cache operations.
+// Compiled in with -DCACHE_TRACE (make TRACE=1), otherwise TRACE_BEGIN and TRACE_END
+// expand to nothing and snapshots are empty. Each thread counts into histograms of its
+// own, with rdtsc on x86 and CLOCK_MONOTONIC_RAW elsewhere. Where <sys/sdt.h> is
+// available, every recorded phase also fires USDT probe cache:phase(phase, ticks) for
+// perf and bpftrace.
+// Phases nest: time of inner phases is included in outer ones.
+typedef enum trace_phase_t {
+    TRACE_CALL,          // whole cached_call
+    TRACE_LOADER,        // loader of cached_call miss
+    TRACE_HASH,          // key_hash and strlen of table lookups
+    TRACE_PROBE,         // walk of bucket chains
+    TRACE_SPLICE,        // policy update of a hit, list splice for LRU
+    TRACE_EVICT,         // eviction of one page, with its table removal and release
+    TRACE_DELETE_PAGE,   // delete_page or other release of page
+    TRACE_TABLE_PUT,     // hashtable_put
+    TRACE_TABLE_DELETE,  // hashtable_delete_entry
+    TRACE_REHASH,        // incremental rehash step of a table modification
+    TRACE_N_PHASES,
+} trace_phase_t;
+
+typedef struct trace_phase_stats_t {
+    size_t count;
+    double total_ns;
+    double p50_ns;  // histogram buckets are a quarter of power of two wide
+    double p99_ns;
+    double max_ns;
+} trace_phase_stats_t;
+
+bool trace_enabled(void);
+const char* trace_phase_name(trace_phase_t);
+// Sums histograms of all threads, including exited ones
+void trace_snapshot(trace_phase_stats_t[TRACE_N_PHASES]);
+// Clears histograms, no thread may record meanwhile
+void trace_reset(void);
+
+#ifdef CACHE_TRACE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline uint64_t trace_now(void) {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+
+static inline uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+void trace_record(trace_phase_t, uint64_t ticks);
+
+#define TRACE_BEGIN(start) uint64_t start = trace_now()
+#define TRACE_END(phase, start) trace_record((phase), trace_now() - (start))
+
+#else
+
+#define TRACE_BEGIN(start)
+#define TRACE_END(phase, start)
+
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "util.h"
+
+// Header-only LRU cache specialized at compile time for key and value types.
+// DEFINE_TYPED_CACHE(name, key_type, value_type, hash, equal) defines type name_t and
+// static inline functions name_create, name_delete, name_get, name_put, name_remove,
+// name_cached_call and name_length.
+//
+// Keys and values are stored by value inside one preallocated entry array linked with
+// 32-bit indices (see compact_cache.h), so fixed-size keys need no allocation and hash
+// and equal are inlined. hash is `uint64_t hash(key_type)`, equal is `bool equal(key_type, key_type)`.
+// Optional eviction callback of name_create receives pointers to key and value of
+// each entry removed from cache, e.g. to release memory owned by the value.
+//
+// Example:
+//     DEFINE_TYPED_CACHE(foo_cache, uint64_t, foo_t, typed_hash_u64, typed_equal_u64)
+//     foo_cache_t* cache = foo_cache_create(1000, NULL);
+//     const foo_t* foo = foo_cache_cached_call(cache, 42, &load_foo);
+
+
+#define TYPED_CACHE_NIL UINT32_MAX
+
+
+// Mixed key, low bits are good for power of 2 tables
+static inline uint64_t typed_hash_u64(uint64_t key) {
+    return hash_mix(key);
+}
+
+
+static inline bool typed_equal_u64(uint64_t lhs, uint64_t rhs) {
+    return lhs == rhs;
+}
+
+
+#define DEFINE_TYPED_CACHE(name, key_type, value_type, hash, equal)                              \
+                                                                                                 \
+typedef value_type name##_value_t;  /* so that const applies to the whole value type */          \
+                                                                                                 \
+typedef struct name##_entry_t {                                                                  \
+    key_type key;                                                                                \
+    value_type value;                                                                            \
+    uint32_t prev;   /* more recently used entry */                                              \
+    uint32_t next;   /* less recently used entry */                                              \
+    uint32_t chain;  /* next entry in bucket, also links free entries */                         \
+} name##_entry_t;                                                                                \
+                                                                                                 \
+typedef struct name##_t {                                                                        \
+    name##_entry_t* entries;                                                                     \
+    uint32_t* buckets;                                                                           \
+    size_t n_buckets;  /* power of 2 */                                                          \
+    size_t max_size;                                                                             \
+    size_t length;                                                                               \
+    uint32_t head;                                                                               \
+    uint32_t tail;                                                                               \
+    uint32_t free;                                                                               \
+    void (*on_evict)(key_type*, value_type*);                                                    \
+} name##_t;                                                                                      \
+                                                                                                 \
+static inline name##_t* name##_create(size_t size, void (*on_evict)(key_type*, value_type*)) {   \
+    if (size == 0 || size >= TYPED_CACHE_NIL) {                                                  \
+        return NULL;                                                                             \
+    }                                                                                            \
+    name##_t* cache = malloc(sizeof(name##_t));                                                  \
+    if (cache == NULL) {                                                                         \
+        puts("malloc failed");                                                                   \
+        exit(EXIT_FAILURE);                                                                      \
+    }                                                                                            \
+    cache->n_buckets = 1;                                                                        \
+    while (cache->n_buckets < size) {                                                            \
+        cache->n_buckets *= 2;                                                                   \
+    }                                                                                            \
+    cache->entries = malloc(sizeof(name##_entry_t) * size);                                      \
+    cache->buckets = malloc(sizeof(uint32_t) * cache->n_buckets);                                \
+    if (cache->entries == NULL || cache->buckets == NULL) {                                      \
+        puts("malloc failed");                                                                   \
+        exit(EXIT_FAILURE);                                                                      \
+    }                                                                                            \
+    for (size_t i = 0; i < cache->n_buckets; ++i) {                                              \
+        cache->buckets[i] = TYPED_CACHE_NIL;                                                     \
+    }                                                                                            \
+    for (size_t i = 0; i < size; ++i) {                                                          \
+        cache->entries[i].chain = i + 1 < size ? (uint32_t) (i + 1) : TYPED_CACHE_NIL;           \
+    }                                                                                            \
+    cache->max_size = size;                                                                      \
+    cache->length = 0;                                                                           \
+    cache->head = TYPED_CACHE_NIL;                                                               \
+    cache->tail = TYPED_CACHE_NIL;                                                               \
+    cache->free = 0;                                                                             \
+    cache->on_evict = on_evict;                                                                  \
+    return cache;                                                                                \
+}                                                                                                \
+                                                                                                 \
+static inline void name##_delete(name##_t* cache) {                                              \
+    if (cache != NULL) {                                                                         \
+        if (cache->on_evict != NULL) {                                                           \
+            for (uint32_t idx = cache->head; idx != TYPED_CACHE_NIL; idx = cache->entries[idx].next) { \
+                cache->on_evict(&cache->entries[idx].key, &cache->entries[idx].value);           \
+            }                                                                                    \
+        }                                                                                        \
+        free(cache->entries);                                                                    \
+        free(cache->buckets);                                                                    \
+    }                                                                                            \
+    free(cache);                                                                                 \
+}                                                                                                \
+                                                                                                 \
+static inline uint32_t* name##_bucket(const name##_t* cache, key_type key) {                     \
+    return &cache->buckets[(size_t) hash(key) & (cache->n_buckets - 1)];                         \
+}                                                                                                \
+                                                                                                 \
+static inline uint32_t name##_find(const name##_t* cache, key_type key) {                        \
+    uint32_t idx = *name##_bucket(cache, key);                                                   \
+    while (idx != TYPED_CACHE_NIL && !equal(cache->entries[idx].key, key)) {                     \
+        idx = cache->entries[idx].chain;                                                         \
+    }                                                                                            \
+    return idx;                                                                                  \
+}                                                                                                \
+                                                                                                 \
+static inline void name##_lru_unlink(name##_t* cache, uint32_t idx) {                            \
+    name##_entry_t* entry = &cache->entries[idx];                                                \
+    if (entry->prev != TYPED_CACHE_NIL) {                                                        \
+        cache->entries[entry->prev].next = entry->next;                                          \
+    } else {                                                                                     \
+        cache->head = entry->next;                                                               \
+    }                                                                                            \
+    if (entry->next != TYPED_CACHE_NIL) {                                                        \
+        cache->entries[entry->next].prev = entry->prev;                                          \
+    } else {                                                                                     \
+        cache->tail = entry->prev;                                                               \
+    }                                                                                            \
+}                                                                                                \
+                                                                                                 \
+static inline void name##_lru_push_front(name##_t* cache, uint32_t idx) {                        \
+    name##_entry_t* entry = &cache->entries[idx];                                                \
+    entry->prev = TYPED_CACHE_NIL;                                                               \
+    entry->next = cache->head;                                                                   \
+    if (cache->head != TYPED_CACHE_NIL) {                                                        \
+        cache->entries[cache->head].prev = idx;                                                  \
+    } else {                                                                                     \
+        cache->tail = idx;                                                                       \
+    }                                                                                            \
+    cache->head = idx;                                                                           \
+}                                                                                                \
+                                                                                                 \
+static inline void name##_unlink(name##_t* cache, uint32_t idx) {                                \
+    name##_entry_t* entry = &cache->entries[idx];                                                \
+    name##_lru_unlink(cache, idx);                                                               \
+    uint32_t* link = name##_bucket(cache, entry->key);                                           \
+    while (*link != idx) {  /* should exist */                                                   \
+        link = &cache->entries[*link].chain;                                                     \
+    }                                                                                            \
+    *link = entry->chain;                                                                        \
+    if (cache->on_evict != NULL) {                                                               \
+        cache->on_evict(&entry->key, &entry->value);                                             \
+    }                                                                                            \
+    entry->chain = cache->free;                                                                  \
+    cache->free = idx;                                                                           \
+    --cache->length;                                                                             \
+}                                                                                                \
+                                                                                                 \
+/* Returns cached value and marks it as recently used, NULL if key is not cached */              \
+static inline value_type* name##_get(name##_t* cache, key_type key) {                            \
+    uint32_t idx = name##_find(cache, key);                                                      \
+    if (idx == TYPED_CACHE_NIL) {                                                                \
+        return NULL;                                                                             \
+    }                                                                                            \
+    if (idx != cache->head) {                                                                    \
+        name##_lru_unlink(cache, idx);                                                           \
+        name##_lru_push_front(cache, idx);                                                       \
+    }                                                                                            \
+    return &cache->entries[idx].value;                                                           \
+}                                                                                                \
+                                                                                                 \
+/* Inserts or overwrites value, evicts the least recently used entry when full */                \
+static inline value_type* name##_put(name##_t* cache, key_type key, value_type value) {          \
+    uint32_t idx = name##_find(cache, key);                                                      \
+    if (idx != TYPED_CACHE_NIL) {                                                                \
+        name##_unlink(cache, idx);                                                               \
+    } else if (cache->length == cache->max_size) {                                               \
+        name##_unlink(cache, cache->tail);                                                       \
+    }                                                                                            \
+    idx = cache->free;                                                                           \
+    name##_entry_t* entry = &cache->entries[idx];                                                \
+    cache->free = entry->chain;                                                                  \
+    entry->key = key;                                                                            \
+    entry->value = value;                                                                        \
+    uint32_t* bucket = name##_bucket(cache, key);                                                \
+    entry->chain = *bucket;                                                                      \
+    *bucket = idx;                                                                               \
+    name##_lru_push_front(cache, idx);                                                           \
+    ++cache->length;                                                                             \
+    return &entry->value;                                                                        \
+}                                                                                                \
+                                                                                                 \
+static inline bool name##_remove(name##_t* cache, key_type key) {                                \
+    uint32_t idx = name##_find(cache, key);                                                      \
+    if (idx == TYPED_CACHE_NIL) {                                                                \
+        return false;                                                                            \
+    }                                                                                            \
+    name##_unlink(cache, idx);                                                                   \
+    return true;                                                                                 \
+}                                                                                                \
+                                                                                                 \
+/* Returns cached value or loads and caches whatever loader returns, even NULL */                \
+static inline const name##_value_t* name##_cached_call(name##_t* cache, key_type key,           \
+                                                   value_type (*get_value_slow)(key_type)) {     \
+    value_type* value = name##_get(cache, key);                                                  \
+    if (value != NULL) {                                                                         \
+        return value;                                                                            \
+    }                                                                                            \
+    return name##_put(cache, key, get_value_slow(key));                                          \
+}                                                                                                \
+                                                                                                 \
+static inline size_t name##_length(const name##_t* cache) {                                      \
+    return cache->length;                                                                        \
+}
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "u64_cache.h"
+#include "typed_cache.h"
+
+
+DEFINE_TYPED_CACHE(u64_table, uint64_t, page_t*, typed_hash_u64, typed_equal_u64)
+
+
+struct u64_cache_t {
+    u64_table_t* table;
+};
+
+
+static void delete_evicted_page(uint64_t* key, page_t** page) {
+    (void) key;
+    delete_page(*page);
+}
+
+
+u64_cache_t* create_u64_cache(size_t size) {
+    u64_table_t* table = u64_table_create(size, &delete_evicted_page);
+    if (table == NULL) {
+        return NULL;
+    }
+    u64_cache_t* cache = malloc(sizeof(u64_cache_t));
+    if (cache == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    cache->table = table;
+    return cache;
+}
+
+
+void delete_u64_cache(u64_cache_t* cache) {
+    if (cache != NULL) {
+        u64_table_delete(cache->table);
+    }
+    free(cache);
+}
+
+
+const page_t* u64_cached_call(u64_cache_t* cache, uint64_t key, page_t* (*get_page_slow)(uint64_t)) {
+    page_t** cached = u64_table_get(cache->table, key);
+    if (cached != NULL) {
+        return *cached;
+    }
+    // Missing key is not cached, like in cached_call
+    page_t* page = get_page_slow(key);
+    if (page == NULL) {
+        return NULL;
+    }
+    return *u64_table_put(cache->table, key, page);
+}
+
+
+size_t u64_cache_length(const u64_cache_t* cache) {
+    return u64_table_length(cache->table);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include "page.h"
+
+// LRU cache for 64-bit numeric keys.
+// Keys are stored inline in table slots and hashed with an integer mixer, a probe
+// costs a single integer comparison instead of key_hash over a string and key_equal.
+// Eviction is the same LRU by number of pages as in lru_cache_t.
+typedef struct u64_cache_t u64_cache_t;
+
+u64_cache_t* create_u64_cache(size_t size);
+void delete_u64_cache(u64_cache_t*);
+const page_t* u64_cached_call(u64_cache_t*, uint64_t, page_t* (*)(uint64_t));
+size_t u64_cache_length(const u64_cache_t*);
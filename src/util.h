@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// Helpers shared by library sources, not part of the public API.
+// Sources calling now_sec define _POSIX_C_SOURCE for clock_gettime.
+
+// fmix64 finalizer of MurmurHash3, spreads key_hash results whose low bits are weak
+static inline uint64_t hash_mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Seconds of monotonic clock
+static inline double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,394 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "workload.h"
+
+
+#define YCSB_ZIPF_S 0.99
+#define YCSB_HOT_FRACTION 0.2
+#define YCSB_HOT_SHARE 0.8
+#define YCSB_MAX_SCAN_LEN 100
+#define YCSB_N_OPS 5
+#define CHE_MAX_ITER 100
+
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+
+void rng_seed(rng_t* rng, uint64_t seed) {
+    rng->state = splitmix64(seed);
+    if (rng->state == 0) {
+        rng->state = 0x9e3779b97f4a7c15ull;
+    }
+}
+
+
+uint64_t rng_next(rng_t* rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 2685821657736338717ull;
+}
+
+
+double rng_uniform(rng_t* rng) {
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+uint64_t rng_below(rng_t* rng, uint64_t n) {
+    return rng_next(rng) % n;
+}
+
+
+// Zipf sampling by rejection-inversion (Hormann and Derflinger, 1996): exact, O(1) per
+// sample and no table, so key space can grow. Ranks start from 1 here.
+typedef struct zipf_sampler_t {
+    double s;
+    double n;
+    double h_integral_x1;
+    double h_integral_n;
+    double threshold;
+} zipf_sampler_t;
+
+
+// log1p(x) / x and expm1(x) / x, stable around 0
+static double log1p_div(double x) {
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+
+static double expm1_div(double x) {
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+
+static double zipf_h(double s, double x) {
+    return exp(-s * log(x));
+}
+
+
+static double zipf_h_integral(double s, double x) {
+    double log_x = log(x);
+    return expm1_div((1.0 - s) * log_x) * log_x;
+}
+
+
+static double zipf_h_integral_inverse(double s, double x) {
+    double t = x * (1.0 - s);
+    return exp(log1p_div(t < -1.0 ? -1.0 : t) * x);
+}
+
+
+static void zipf_resize(zipf_sampler_t* zipf, size_t n) {
+    zipf->n = (double) n;
+    zipf->h_integral_n = zipf_h_integral(zipf->s, zipf->n + 0.5);
+}
+
+
+static void init_zipf(zipf_sampler_t* zipf, double s, size_t n) {
+    zipf->s = s;
+    zipf->h_integral_x1 = zipf_h_integral(s, 1.5) - 1.0;
+    zipf->threshold = 2.0 - zipf_h_integral_inverse(s, zipf_h_integral(s, 2.5) - zipf_h(s, 2.0));
+    zipf_resize(zipf, n);
+}
+
+
+// 0-based rank
+static size_t zipf_sample(const zipf_sampler_t* zipf, rng_t* rng) {
+    while (true) {
+        double u = zipf->h_integral_n + rng_uniform(rng) * (zipf->h_integral_x1 - zipf->h_integral_n);
+        double x = zipf_h_integral_inverse(zipf->s, u);
+        double k = floor(x + 0.5);
+        k = k < 1.0 ? 1.0 : (k > zipf->n ? zipf->n : k);
+        if (k - x <= zipf->threshold || u >= zipf_h_integral(zipf->s, k + 0.5) - zipf_h(zipf->s, k)) {
+            return (size_t) k - 1;
+        }
+    }
+}
+
+
+struct workload_t {
+    workload_config_t config;
+    size_t n_keys;
+    rng_t rng;
+    zipf_sampler_t zipf;
+    size_t scan_pos;
+    double zeta;     // sum of zipf weights, computed on first use
+    size_t zeta_n;   // number of keys zeta is summed over
+};
+
+
+workload_config_t workload_default_config(workload_kind_t kind, size_t n_keys, uint64_t seed) {
+    workload_config_t config = {
+        .kind = kind,
+        .n_keys = n_keys,
+        .seed = seed,
+        .zipf_s = YCSB_ZIPF_S,
+        .hot_fraction = YCSB_HOT_FRACTION,
+        .hot_share = YCSB_HOT_SHARE,
+    };
+    return config;
+}
+
+
+workload_t* create_workload(const workload_config_t* config) {
+    if (config->n_keys == 0 || config->zipf_s <= 0.0) {
+        return NULL;
+    }
+    workload_t* workload = malloc(sizeof(workload_t));
+    if (workload == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    workload->config = *config;
+    workload->n_keys = config->n_keys;
+    rng_seed(&workload->rng, config->seed);
+    init_zipf(&workload->zipf, config->zipf_s, config->n_keys);
+    workload->scan_pos = 0;
+    workload->zeta = 0.0;
+    workload->zeta_n = 0;
+    return workload;
+}
+
+
+void delete_workload(workload_t* workload) {
+    free(workload);
+}
+
+
+// Hot keys come first, there is at least one hot key and one cold key if possible
+static size_t hot_keys(const workload_t* workload) {
+    size_t n_hot = (size_t) (workload->config.hot_fraction * workload->n_keys + 0.5);
+    n_hot = n_hot > 0 ? n_hot : 1;
+    return n_hot < workload->n_keys ? n_hot : workload->n_keys;
+}
+
+
+size_t workload_next(workload_t* workload) {
+    size_t n_keys = workload->n_keys;
+    switch (workload->config.kind) {
+    case WORKLOAD_UNIFORM:
+        return rng_below(&workload->rng, n_keys);
+    case WORKLOAD_ZIPF:
+        return zipf_sample(&workload->zipf, &workload->rng);
+    case WORKLOAD_SCRAMBLED_ZIPF:
+        return splitmix64(zipf_sample(&workload->zipf, &workload->rng)) % n_keys;
+    case WORKLOAD_HOTSPOT: {
+        size_t n_hot = hot_keys(workload);
+        if (n_hot == n_keys || rng_uniform(&workload->rng) < workload->config.hot_share) {
+            return rng_below(&workload->rng, n_hot);
+        }
+        return n_hot + rng_below(&workload->rng, n_keys - n_hot);
+    }
+    case WORKLOAD_SCAN: {
+        size_t key = workload->scan_pos % n_keys;
+        workload->scan_pos = key + 1;
+        return key;
+    }
+    case WORKLOAD_LATEST:
+        return n_keys - 1 - zipf_sample(&workload->zipf, &workload->rng);
+    }
+    return 0;
+}
+
+
+size_t workload_insert(workload_t* workload) {
+    zipf_resize(&workload->zipf, ++workload->n_keys);
+    return workload->n_keys - 1;
+}
+
+
+size_t workload_n_keys(const workload_t* workload) {
+    return workload->n_keys;
+}
+
+
+double workload_rank_probability(workload_t* workload, size_t rank) {
+    size_t n_keys = workload->n_keys;
+    if (rank >= n_keys) {
+        return 0.0;
+    }
+    switch (workload->config.kind) {
+    case WORKLOAD_UNIFORM:
+        return 1.0 / n_keys;
+    case WORKLOAD_ZIPF:
+    case WORKLOAD_SCRAMBLED_ZIPF:
+        if (workload->zeta_n != n_keys) {
+            workload->zeta = 0.0;
+            for (size_t i = n_keys; i > 0; --i) {  // smallest terms first
+                workload->zeta += zipf_h(workload->config.zipf_s, (double) i);
+            }
+            workload->zeta_n = n_keys;
+        }
+        return zipf_h(workload->config.zipf_s, (double) (rank + 1)) / workload->zeta;
+    case WORKLOAD_HOTSPOT: {
+        size_t n_hot = hot_keys(workload);
+        if (n_hot == n_keys) {
+            return 1.0 / n_keys;
+        }
+        return rank < n_hot ? workload->config.hot_share / n_hot
+                            : (1.0 - workload->config.hot_share) / (n_keys - n_hot);
+    }
+    case WORKLOAD_SCAN:
+    case WORKLOAD_LATEST:
+        break;
+    }
+    return 0.0;
+}
+
+
+// Also counts keys that are ever requested, none for scan and latest
+static double* rank_probabilities(workload_t* workload, size_t* n_requested) {
+    double* probs = malloc(sizeof(double) * workload->n_keys);
+    if (probs == NULL) {
+        puts("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    *n_requested = 0;
+    for (size_t i = 0; i < workload->n_keys; ++i) {
+        probs[i] = workload_rank_probability(workload, i);
+        *n_requested += probs[i] > 0.0;
+    }
+    return probs;
+}
+
+
+// Solves sum of (1 - e^(-p T)) over keys = cache size. Left side is concave in T,
+// so Newton steps from 0 approach the root from below.
+static double characteristic_time(const double* probs, size_t n_keys, size_t cache_size) {
+    double time = 0.0;
+    for (size_t iter = 0; iter < CHE_MAX_ITER; ++iter) {
+        double occupancy = 0.0;
+        double derivative = 0.0;
+        for (size_t i = 0; i < n_keys; ++i) {
+            double stay = exp(-probs[i] * time);
+            occupancy += 1.0 - stay;
+            derivative += probs[i] * stay;
+        }
+        double step = (cache_size - occupancy) / derivative;
+        time += step;
+        if (step < time * 1e-12) {
+            break;
+        }
+    }
+    return time;
+}
+
+
+double lru_characteristic_time_che(workload_t* workload, size_t cache_size) {
+    size_t n_requested;
+    double* probs = rank_probabilities(workload, &n_requested);
+    if (cache_size >= n_requested) {
+        free(probs);
+        return n_requested > 0 ? INFINITY : NAN;
+    }
+    double time = characteristic_time(probs, workload->n_keys, cache_size);
+    free(probs);
+    return time;
+}
+
+
+double lru_hit_ratio_che(workload_t* workload, size_t cache_size) {
+    size_t n_requested;
+    double* probs = rank_probabilities(workload, &n_requested);
+    if (cache_size >= n_requested) {
+        free(probs);
+        return n_requested > 0 ? 1.0 : NAN;
+    }
+    double time = characteristic_time(probs, workload->n_keys, cache_size);
+    double hit_ratio = 0.0;
+    for (size_t i = 0; i < workload->n_keys; ++i) {
+        hit_ratio += probs[i] * (1.0 - exp(-probs[i] * time));
+    }
+    free(probs);
+    return hit_ratio;
+}
+
+
+struct ycsb_t {
+    workload_t* keys;
+    rng_t rng;
+    const double* shares;  // of operations in order of ycsb_op_t
+};
+
+
+ycsb_t* create_ycsb(char workload, size_t n_keys, uint64_t seed) {
+    static const struct {
+        char name;
+        workload_kind_t kind;
+        double shares[YCSB_N_OPS];
+    } workloads[] = {
+        {'A', WORKLOAD_SCRAMBLED_ZIPF, {0.5, 0.5, 0.0, 0.0, 0.0}},
+        {'B', WORKLOAD_SCRAMBLED_ZIPF, {0.95, 0.05, 0.0, 0.0, 0.0}},
+        {'C', WORKLOAD_SCRAMBLED_ZIPF, {1.0, 0.0, 0.0, 0.0, 0.0}},
+        {'D', WORKLOAD_LATEST, {0.95, 0.0, 0.05, 0.0, 0.0}},
+        {'E', WORKLOAD_SCRAMBLED_ZIPF, {0.0, 0.0, 0.05, 0.95, 0.0}},
+        {'F', WORKLOAD_SCRAMBLED_ZIPF, {0.5, 0.0, 0.0, 0.0, 0.5}},
+    };
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); ++i) {
+        if (workloads[i].name != workload) {
+            continue;
+        }
+        workload_config_t config = workload_default_config(workloads[i].kind, n_keys, seed);
+        workload_t* keys = create_workload(&config);
+        if (keys == NULL) {
+            return NULL;
+        }
+        ycsb_t* ycsb = malloc(sizeof(ycsb_t));
+        if (ycsb == NULL) {
+            puts("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        ycsb->keys = keys;
+        // Operation mix gets its own stream, so it does not shift key sequence
+        rng_seed(&ycsb->rng, ~seed);
+        ycsb->shares = workloads[i].shares;
+        return ycsb;
+    }
+    return NULL;
+}
+
+
+void delete_ycsb(ycsb_t* ycsb) {
+    if (ycsb != NULL) {
+        delete_workload(ycsb->keys);
+    }
+    free(ycsb);
+}
+
+
+ycsb_request_t ycsb_next(ycsb_t* ycsb) {
+    double u = rng_uniform(&ycsb->rng);
+    ycsb_request_t request = {YCSB_READ, 0, 0};
+    for (size_t op = 0; op < YCSB_N_OPS; ++op) {
+        if (ycsb->shares[op] > 0.0) {
+            request.op = (ycsb_op_t) op;
+            if (u < ycsb->shares[op]) {
+                break;
+            }
+            u -= ycsb->shares[op];
+        }
+    }
+    if (request.op == YCSB_INSERT) {
+        request.key = workload_insert(ycsb->keys);
+        return request;
+    }
+    request.key = workload_next(ycsb->keys);
+    if (request.op == YCSB_SCAN) {
+        size_t n_left = workload_n_keys(ycsb->keys) - request.key;
+        request.scan_len = 1 + rng_below(&ycsb->rng, YCSB_MAX_SCAN_LEN);
+        request.scan_len = request.scan_len < n_left ? request.scan_len : n_left;
+    }
+    return request;
+}
+
+
+size_t ycsb_n_keys(const ycsb_t* ycsb) {
+    return workload_n_keys(ycsb->keys);
+}
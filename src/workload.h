@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Seedable request generators shared by tests and benchmarks.
+// Keys are integers in [0, n_keys), the same seed gives the same sequence on every platform.
+
+// xorshift64* seeded through splitmix64, so small seeds give unrelated streams
+typedef struct rng_t {
+    uint64_t state;
+} rng_t;
+
+void rng_seed(rng_t*, uint64_t);
+uint64_t rng_next(rng_t*);
+// Uniform in [0, 1)
+double rng_uniform(rng_t*);
+// Uniform in [0, n), n > 0
+uint64_t rng_below(rng_t*, uint64_t);
+
+typedef enum workload_kind_t {
+    WORKLOAD_UNIFORM,
+    WORKLOAD_ZIPF,            // key 0 is the most popular, key i has weight 1 / (i + 1)^s
+    WORKLOAD_SCRAMBLED_ZIPF,  // zipf popularity spread over key space by hash, as in YCSB
+    WORKLOAD_HOTSPOT,         // first hot_fraction of keys get hot_share of requests
+    WORKLOAD_SCAN,            // 0, 1, ..., n_keys - 1, then again from 0
+    WORKLOAD_LATEST,          // zipf over age, the last inserted key is the most popular
+} workload_kind_t;
+
+typedef struct workload_config_t {
+    workload_kind_t kind;
+    size_t n_keys;
+    uint64_t seed;
+    double zipf_s;        // skew of zipf and latest, > 0
+    double hot_fraction;  // hotspot
+    double hot_share;
+} workload_config_t;
+
+typedef struct workload_t workload_t;
+
+// Zipf skew 0.99 and hotspot 20% keys / 80% requests are YCSB defaults
+workload_config_t workload_default_config(workload_kind_t, size_t n_keys, uint64_t seed);
+workload_t* create_workload(const workload_config_t*);
+void delete_workload(workload_t*);
+size_t workload_next(workload_t*);
+// Adds key n_keys to key space and returns it
+size_t workload_insert(workload_t*);
+size_t workload_n_keys(const workload_t*);
+// Probability that a request goes to the rank-th most popular key, for workloads of
+// independent requests (uniform, zipf, hotspot). Scrambled zipf ignores hash collisions.
+// Scan and latest give 0.
+double workload_rank_probability(workload_t*, size_t rank);
+
+// Che's approximation for LRU cache of given size under independent requests: a key stays
+// cached for characteristic time T after its last request, so key of probability p is hit
+// with probability 1 - e^(-p T). Accurate within about 1% once cache holds a few dozen keys.
+// NAN for scan and latest.
+double lru_characteristic_time_che(workload_t*, size_t cache_size);
+double lru_hit_ratio_che(workload_t*, size_t cache_size);
+
+// Core workloads A-F of YCSB
+typedef enum ycsb_op_t {
+    YCSB_READ,
+    YCSB_UPDATE,
+    YCSB_INSERT,            // key is a new one, just past previous key space
+    YCSB_SCAN,              // reads scan_len keys from key on
+    YCSB_READ_MODIFY_WRITE,
+} ycsb_op_t;
+
+typedef struct ycsb_request_t {
+    ycsb_op_t op;
+    size_t key;
+    size_t scan_len;
+} ycsb_request_t;
+
+typedef struct ycsb_t ycsb_t;
+
+// Workload 'A' (50% reads, 50% updates), 'B' (95% reads), 'C' (reads only), 'D' (95% reads
+// of latest keys, 5% inserts), 'E' (95% short scans, 5% inserts) or 'F' (50% reads,
+// 50% read-modify-writes). Requests follow scrambled zipf except for D. NULL for other letters.
+ycsb_t* create_ycsb(char workload, size_t n_keys, uint64_t seed);
+void delete_ycsb(ycsb_t*);
+ycsb_request_t ycsb_next(ycsb_t*);
+size_t ycsb_n_keys(const ycsb_t*);
@@ -1,10 +1,50 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <check.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include "page.h"
 #include "list.h"
 #include "hashtable.h"
 #include "cache.h"
+#include "lz.h"
+#include "ghost.h"
+#include "compact_cache.h"
+#include "hugemem.h"
+#include "numa.h"
+#include "numa_cache.h"
+#include "typed_cache.h"
+#include "u64_cache.h"
+#include "async_cache.h"
+#include "ebr.h"
+#include "concurrent_hashtable.h"
+#include "front_cache.h"
+#include "pressure.h"
+#include "preload.h"
+#include "free_queue.h"
+#include "bloom.h"
+#include "negative.h"
+#include "cuckoo.h"
+#include "shm_cache.h"
+#include "mc_protocol.h"
+#include "cache_server.h"
+#include "slab.h"
+#include "workload.h"
+#include "trace.h"
+#include "hot_keys.h"
 
 
 enum { 
@@ -13,14 +53,21 @@ enum {
     RNG_TEST_SIZE=100000,
     RNG_TEST_N_ITER=1000000,  // list + hashtable
 
-    // Changing cache sizes breaks second randomized test
     RNG_TEST_CACHE_N_ITER=2000000,
     RNG_TEST_CACHE_SIZE=10,
     RNG_TEST_CACHE_N_PAGES=20,
+
+    LZ_TEST_SIZE=10000,
+
+    CHASH_TEST_N_THREADS=4,
+    CHASH_TEST_N_KEYS=2048,
+    CHASH_TEST_N_ITER=50000,
+    FRONT_TEST_N_KEYS=64,
+    FRONT_TEST_N_ITER=20000,
+    WORKLOAD_TEST_N_ITER=200000,
+    HIT_RATIO_TEST_N_WARMUP=500000,
+    HIT_RATIO_TEST_N_ITER=1000000,
 };
-// These are derived from analytical solution for lru cache
-#define RNG_TEST_CACHE2_P1 0.32  // only valid for CACHE_SIZE = 10, N_PAGES = 20
-#define RNG_TEST_CACHE2_P2 0.68  // only valid for CACHE_SIZE = 10, N_PAGES = 20
 
 
 START_TEST(test_page)
@@ -45,6 +92,27 @@ START_TEST(test_page)
         ck_assert_str_eq(page_copy->data, "Ref_page");
         delete_page(page_copy);
     }
+    {
+        // Short strings live inside the page, long ones on heap
+        const char* long_data = "data longer than inline storage of the page";
+        page_t* page = create_page("short key", long_data);
+        ck_assert_ptr_eq(page->key, page->inline_buf);
+        ck_assert_uint_eq(page->inline_flags, PAGE_KEY_INLINE);
+        ck_assert_str_eq(page->key, "short key");
+        ck_assert_str_eq(page->data, long_data);
+        ck_assert_uint_eq(page->size, strlen(long_data));
+
+        page_t* page_copy = copy_page(page);
+        delete_page(page);
+        ck_assert_str_eq(page_copy->data, long_data);
+        delete_page(page_copy);
+
+        page = create_page(long_data, "short data");
+        ck_assert_uint_eq(page->inline_flags, PAGE_DATA_INLINE);
+        ck_assert_str_eq(page->key, long_data);
+        ck_assert_str_eq(page->data, "short data");
+        delete_page(page);
+    }
 }
 END_TEST
 
@@ -85,6 +153,45 @@ START_TEST(test_hash)
 }
 END_TEST
 
+START_TEST(test_lz_roundtrip)
+{
+    char* src = malloc(LZ_TEST_SIZE);
+    char* compressed = malloc(lz_compress_bound(LZ_TEST_SIZE));
+    char* decompressed = malloc(LZ_TEST_SIZE);
+    {
+        // Repetitive data shrinks
+        for (size_t i = 0; i < LZ_TEST_SIZE; ++i) {
+            src[i] = "{\"id\": 1, \"name\": \"value\"}"[i % 27];
+        }
+        size_t n = lz_compress(src, LZ_TEST_SIZE, compressed, lz_compress_bound(LZ_TEST_SIZE));
+        ck_assert_uint_gt(n, 0);
+        ck_assert_uint_lt(n, LZ_TEST_SIZE / 10);
+        ck_assert_uint_eq(lz_decompress(compressed, n, decompressed, LZ_TEST_SIZE), LZ_TEST_SIZE);
+        ck_assert_mem_eq(src, decompressed, LZ_TEST_SIZE);
+    }
+    {
+        // Random data survives round trip, but does not fit into smaller buffer
+        for (size_t i = 0; i < LZ_TEST_SIZE; ++i) {
+            src[i] = (char) rand();
+        }
+        size_t n = lz_compress(src, LZ_TEST_SIZE, compressed, lz_compress_bound(LZ_TEST_SIZE));
+        ck_assert_uint_gt(n, 0);
+        ck_assert_uint_eq(lz_decompress(compressed, n, decompressed, LZ_TEST_SIZE), LZ_TEST_SIZE);
+        ck_assert_mem_eq(src, decompressed, LZ_TEST_SIZE);
+        ck_assert_uint_eq(lz_compress(src, LZ_TEST_SIZE, compressed, LZ_TEST_SIZE - 1), 0);
+    }
+    {
+        // Short inputs are stored as literals
+        size_t n = lz_compress("abc", 3, compressed, lz_compress_bound(3));
+        ck_assert_uint_eq(lz_decompress(compressed, n, decompressed, 3), 3);
+        ck_assert_mem_eq("abc", decompressed, 3);
+    }
+    free(src);
+    free(compressed);
+    free(decompressed);
+}
+END_TEST
+
 
 START_TEST(test_list_create)
 {
@@ -209,6 +316,51 @@ START_TEST(test_list_move_upfront)
 }
 END_TEST
 
+START_TEST(test_list_transfer_upfront)
+{
+    list_t* list1 = create_list();
+    list_t* list2 = create_list();
+
+    page_t* page1 = create_page("key1", "page1");
+    page_t* page2 = create_page("key2", "page2");
+    page_t* page3 = create_page("key3", "page3");
+
+    list_node_t* node1 = list_push_front(list1, page1);
+    list_node_t* node2 = list_push_front(list1, page2);
+    list_node_t* node3 = list_push_front(list2, page3);
+    ck_assert_ptr_eq(list_node_get_list(node1), list1);
+    ck_assert_ptr_eq(list_node_get_list(node3), list2);
+    ck_assert_ptr_eq(list_back_node(list1), node1);
+
+    list_transfer_upfront(list2, list1, node1);
+    ck_assert_ptr_eq(list_node_get_list(node1), list2);
+    ck_assert_uint_eq(list_length(list1), 1);
+    ck_assert_uint_eq(list_length(list2), 2);
+    ck_assert_ptr_eq(list_front(list2), page1);
+    ck_assert_ptr_eq(list_back(list2), page3);
+    ck_assert_ptr_eq(list_front(list1), page2);
+    ck_assert_ptr_eq(list_back(list1), page2);
+
+    list_transfer_upfront(list2, list1, node2);
+    ck_assert(is_list_empty(list1));
+    ck_assert_ptr_null(list_back_node(list1));
+    ck_assert_ptr_eq(list_front(list2), page2);
+    ck_assert_uint_eq(list_length(list2), 3);
+
+    list_transfer_upfront(list1, list2, node3);
+    ck_assert_ptr_eq(list_front(list1), page3);
+    ck_assert_ptr_eq(list_back(list1), page3);
+    ck_assert_ptr_eq(list_back(list2), page1);
+    ck_assert_ptr_eq(list_node_get_list(node3), list1);
+
+    delete_page(page1);
+    delete_page(page2);
+    delete_page(page3);
+    delete_list(list1);
+    delete_list(list2);
+}
+END_TEST
+
 
 START_TEST(test_list_push_pop_randomized)
 {
@@ -361,6 +513,18 @@ START_TEST(test_hashtable_put_get_delete)
     char* key4 = "key4";
     ck_assert(hashtable_get(htable, key4) == node3);
 
+    // Keys longer than inline storage and keys sharing a prefix
+    const char* long_key = "a key which does not fit into hashtable entry";
+    hashtable_put(htable, long_key, node1);
+    hashtable_put(htable, "key", node2);
+    hashtable_put(htable, "key44", node2);
+    ck_assert(hashtable_get(htable, long_key) == node1);
+    ck_assert(hashtable_get(htable, "a key which does not fit into hashtable") == NULL);
+    ck_assert(hashtable_get(htable, "key4") == node3);
+    ck_assert(hashtable_delete_entry(htable, long_key));
+    ck_assert(hashtable_get(htable, long_key) == NULL);
+    ck_assert_uint_eq(hashtable_length(htable), 3);
+
     delete_hashtable(htable);
     delete_list_node(node1);
     delete_list_node(node2);
@@ -369,6 +533,102 @@ START_TEST(test_hashtable_put_get_delete)
 END_TEST
 
 
+START_TEST(test_hashtable_reserve)
+{
+    hashtable_t* htable = create_hashtable();
+    list_node_t* node = create_list_node();
+    char key[20];
+    hashtable_put(htable, "first", node);
+    // Reserving non-empty table and table in the middle of rehash
+    for (size_t i = 0; i < 100; ++i) {
+        sprintf(key, "%zu", i);
+        hashtable_put(htable, key, node);
+    }
+    hashtable_reserve(htable, 1000);
+    for (size_t i = 100; i < 1000; ++i) {
+        sprintf(key, "%zu", i);
+        hashtable_put(htable, key, node);
+    }
+    ck_assert_uint_eq(hashtable_length(htable), 1001);
+    for (size_t i = 0; i < 1000; ++i) {
+        sprintf(key, "%zu", i);
+        ck_assert_ptr_eq(hashtable_get(htable, key), node);
+        ck_assert(hashtable_delete_entry(htable, key));
+    }
+    ck_assert_ptr_eq(hashtable_get(htable, "first"), node);
+    ck_assert(hashtable_delete_entry(htable, "first"));
+    ck_assert(hashtable_is_empty(htable));
+
+    // Emptied table keeps reserved size
+    hashtable_put(htable, "again", node);
+    ck_assert_ptr_eq(hashtable_get(htable, "again"), node);
+    delete_list_node(node);
+    delete_hashtable(htable);
+}
+END_TEST
+
+
+static void count_scanned(const char* key, list_node_t* node, void* arg) {
+    (void)node;
+    size_t* seen = arg;
+    ++seen[atoi(key)];
+}
+
+
+START_TEST(test_hashtable_scan)
+{
+    hashtable_t* htable = create_hashtable();
+    list_node_t* node = create_list_node();
+    size_t* seen = calloc(5000, sizeof(size_t));
+    char key[24];
+    ck_assert_uint_eq(hashtable_scan(htable, 0, 10, &count_scanned, seen), 0);
+    for (size_t i = 0; i < 1000; ++i) {
+        sprintf(key, "%zu", i);
+        hashtable_put(htable, key, node);
+    }
+
+    // Unmodified table is walked exactly once in short steps
+    size_t n_steps = 0;
+    size_t cursor = 0;
+    do {
+        cursor = hashtable_scan(htable, cursor, 10, &count_scanned, seen);
+        ++n_steps;
+    } while (cursor != 0);
+    ck_assert_uint_gt(n_steps, 50);
+    for (size_t i = 0; i < 1000; ++i) {
+        ck_assert_uint_eq(seen[i], 1);
+    }
+
+    // Table grows and then shrinks back between steps, rehashing in the middle of
+    // most of them. Keys present all the time are still seen.
+    memset(seen, 0, 5000 * sizeof(size_t));
+    size_t next_key = 1000;
+    bool growing = true;
+    cursor = 0;
+    do {
+        cursor = hashtable_scan(htable, cursor, 10, &count_scanned, seen);
+        for (size_t i = 0; i < 100; ++i) {
+            if (growing && next_key < 5000) {
+                sprintf(key, "%zu", next_key++);
+                hashtable_put(htable, key, node);
+            } else if (next_key > 1000) {
+                growing = false;
+                sprintf(key, "%zu", --next_key);
+                ck_assert(hashtable_delete_entry(htable, key));
+            }
+        }
+    } while (cursor != 0);
+    ck_assert(!growing);
+    for (size_t i = 0; i < 1000; ++i) {
+        ck_assert_uint_ge(seen[i], 1);
+    }
+    free(seen);
+    delete_list_node(node);
+    delete_hashtable(htable);
+}
+END_TEST
+
+
 START_TEST(test_hashtable_randomized)
 {
     hashtable_t* htable = create_hashtable();
@@ -415,6 +675,62 @@ START_TEST(test_hashtable_randomized)
 END_TEST
 
 
+START_TEST(test_ghost_list)
+{
+    ghost_list_t* ghosts = create_ghost_list(3);
+    ck_assert_uint_eq(ghost_list_length(ghosts), 0);
+    ck_assert(!ghost_list_contains(ghosts, 1));
+
+    ghost_list_push(ghosts, 1);
+    ghost_list_push(ghosts, 2);
+    ghost_list_push(ghosts, 3);
+    ck_assert_uint_eq(ghost_list_length(ghosts), 3);
+    ck_assert(ghost_list_contains(ghosts, 1));
+
+    // Renewed ghost survives, the oldest one is dropped
+    ghost_list_push(ghosts, 1);
+    ghost_list_push(ghosts, 4);
+    ck_assert_uint_eq(ghost_list_length(ghosts), 3);
+    ck_assert(!ghost_list_contains(ghosts, 2));
+    ck_assert(ghost_list_contains(ghosts, 1));
+
+    ck_assert(ghost_list_remove(ghosts, 3));
+    ck_assert(!ghost_list_remove(ghosts, 3));
+    ck_assert_uint_eq(ghost_list_length(ghosts), 2);
+
+    ghost_list_pop_back(ghosts);
+    ck_assert(!ghost_list_contains(ghosts, 1));
+    ck_assert(ghost_list_contains(ghosts, 4));
+    delete_ghost_list(ghosts);
+
+    // Resize keeps the most recent ghosts that fit, in the same order
+    ghosts = create_ghost_list(4);
+    for (unsigned long hash = 1; hash <= 4; ++hash) {
+        ghost_list_push(ghosts, hash);
+    }
+    ghost_list_resize(ghosts, 8);
+    ck_assert_uint_eq(ghost_list_length(ghosts), 4);
+    ghost_list_push(ghosts, 5);
+    ck_assert(ghost_list_contains(ghosts, 1));
+    ghost_list_resize(ghosts, 2);
+    ck_assert_uint_eq(ghost_list_length(ghosts), 2);
+    ck_assert(!ghost_list_contains(ghosts, 3));
+    ck_assert(ghost_list_contains(ghosts, 4));
+    ck_assert(ghost_list_contains(ghosts, 5));
+    ghost_list_pop_back(ghosts);
+    ck_assert(!ghost_list_contains(ghosts, 4));
+    ghost_list_resize(ghosts, 0);
+    ck_assert_uint_eq(ghost_list_length(ghosts), 0);
+    delete_ghost_list(ghosts);
+
+    ghosts = create_ghost_list(0);
+    ghost_list_push(ghosts, 1);
+    ck_assert(!ghost_list_contains(ghosts, 1));
+    delete_ghost_list(ghosts);
+}
+END_TEST
+
+
 START_TEST(test_cache_create)
 {
     {
@@ -543,93 +859,2619 @@ static void reset_call_freqs(void) {
 // C is size of cache
 // Then hit rate for m is P(m) = 1 - e^(-L(m) * Tc)
 // where L(m) is rate of appearance of the object
-// then Tc can be found from equation SUM(P(m)) over m = C
+// then Tc can be found from equation SUM(P(m)) over m = C, see lru_characteristic_time_che
+//
+// Measured is miss rate of every object, expected to be e^(-L(m) * Tc)
 
-START_TEST(test_cache_randomized)
-{
-    // Uniform distribution
-    // In this case, formulas simplifies, cache hit rate is equal to C / M
+static void check_cache_miss_rates(workload_t* workload) {
     reset_call_freqs();
     lru_cache_t* cache = create_cache(RNG_TEST_CACHE_SIZE);
     size_t rand_freqs[RNG_TEST_CACHE_N_PAGES] = {0};
     for (size_t i = 0; i < RNG_TEST_CACHE_N_ITER; ++i) {
-        int r = rand() % RNG_TEST_CACHE_N_PAGES;
+        size_t r = workload_next(workload);
         ++rand_freqs[r];
         char key[20];
-        sprintf(key, "key%d", r);
+        sprintf(key, "key%zu", r);
         cached_call(cache, key, &scoped_get_page);
     }
 
-    float expected_freq = (float) RNG_TEST_CACHE_SIZE / RNG_TEST_CACHE_N_PAGES;
+    double time = lru_characteristic_time_che(workload, RNG_TEST_CACHE_SIZE);
     for (size_t i = 0; i < RNG_TEST_CACHE_N_PAGES; ++i) {
         float freq = (float) int_call_freqs[i] / rand_freqs[i];
+        float expected_freq = exp(-workload_rank_probability(workload, i) * time);
         ck_assert_float_eq_tol(freq, expected_freq, 0.01);
     }
 
     delete_cache(cache);
 }
+
+
+START_TEST(test_cache_randomized)
+{
+    // Uniform distribution
+    // In this case, formulas simplifies, cache hit rate is equal to C / M
+    workload_config_t config = workload_default_config(WORKLOAD_UNIFORM, RNG_TEST_CACHE_N_PAGES, 1);
+    workload_t* workload = create_workload(&config);
+    ck_assert_float_eq_tol(lru_hit_ratio_che(workload, RNG_TEST_CACHE_SIZE),
+                           (double) RNG_TEST_CACHE_SIZE / RNG_TEST_CACHE_N_PAGES, 1e-9);
+    check_cache_miss_rates(workload);
+    delete_workload(workload);
+}
 END_TEST
 
 
 START_TEST(test_cache_randomized2)
 {
-    // Made-up distribution:
-    // M samples are split in halfs of size k
-    // for lower half, with 50% chance roll will be discarded and sample from upper half is picked randomly
-    // then the probability of appearence of sample from lower half is decreased by 50%
-    // p_u for upper half increased by p(1 + k / (2 * (M - k)))
+    // Two levels of popularity: first half of objects gets 75% of requests, which
+    // for M = 20 and C = 10 gives miss rates of about 0.32 and 0.68
+    workload_config_t config = workload_default_config(WORKLOAD_HOTSPOT, RNG_TEST_CACHE_N_PAGES, 2);
+    config.hot_fraction = 0.5;
+    config.hot_share = 0.75;
+    workload_t* workload = create_workload(&config);
+    check_cache_miss_rates(workload);
+    delete_workload(workload);
+}
+END_TEST
+
+
+static page_t* compressible_get_page(const char* key) {
+    char data[2000];
+    size_t len = 0;
+    while (len + 40 < sizeof(data)) {
+        len += sprintf(&data[len], "{\"key\": \"%s\", \"field\": %zu}", key, len % 7);
+    }
+    return create_page(key, data);
+}
+
+
+START_TEST(test_cache_compression)
+{
+    cache_config_t config = cache_default_config(4);
+    config.compress_threshold = 100;
+    config.hot_set_size = 1;
+    lru_cache_t* cache = create_cache_with_config(&config);
+
+    page_t* expected = compressible_get_page("key0");
+    const page_t* page = cached_call(cache, "key0", &compressible_get_page);
+    ck_assert_str_eq(page->data, expected->data);
+    ck_assert_uint_eq(page->compressed_size, 0);
+
+    cached_call(cache, "key1", &compressible_get_page);
+    // key0 is not in the hot set anymore, decompressed on access
+    page = cached_call(cache, "key0", &compressible_get_page);
+    ck_assert_str_eq(page->key, "key0");
+    ck_assert_str_eq(page->data, expected->data);
+    ck_assert_uint_eq(page->size, expected->size);
+
+    cache_stats_t stats = cache_stats(cache);
+    ck_assert_uint_eq(stats.hits, 1);
+    ck_assert_uint_eq(stats.misses, 2);
+    ck_assert_uint_eq(stats.decompressions, 1);
+    ck_assert_uint_eq(stats.n_compressed, 2);
+    ck_assert_uint_lt(stats.n_bytes * 4, stats.n_raw_bytes);
+    delete_page(expected);
+    delete_cache(cache);
+
+    // Byte budget counts compressed bytes: raw pages fit two at a time, compressed - all four
+    config.compress_threshold = 0;
+    config.max_bytes = 2 * 2000;
+    cache = create_cache_with_config(&config);
+    for (int i = 0; i < 4; ++i) {
+        char key[20];
+        sprintf(key, "key%d", i);
+        cached_call(cache, key, &compressible_get_page);
+    }
+    ck_assert_uint_eq(cache_length(cache), 2);
+    delete_cache(cache);
+
+    config.compress_threshold = 100;
+    cache = create_cache_with_config(&config);
+    for (int i = 0; i < 4; ++i) {
+        char key[20];
+        sprintf(key, "key%d", i);
+        cached_call(cache, key, &compressible_get_page);
+    }
+    ck_assert_uint_eq(cache_length(cache), 4);
+    ck_assert_uint_eq(cache_stats(cache).evictions, 0);
+    delete_cache(cache);
+}
+END_TEST
+
+
+static page_t* empty_get_page(const char* key) {
+    ++n_test_cache_call_func;
+    return create_page(key, "");
+}
+
+
+// Calls cache with n unique keys never seen before
+static void scan_cache(lru_cache_t* cache, size_t n) {
+    static size_t scan_id = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char key[30];
+        sprintf(key, "scan%zu", scan_id++);
+        cached_call(cache, key, &empty_get_page);
+    }
+}
+
+
+static void scan_shm_cache(shm_cache_t* cache, size_t n) {
+    static size_t scan_id = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char key[30];
+        sprintf(key, "scan%zu", scan_id++);
+        shm_cached_call(cache, key, &empty_get_page);
+    }
+}
+
+
+START_TEST(test_cache_slru)
+{
+    cache_config_t config = cache_default_config(5);
+    config.policy = CACHE_POLICY_SLRU;
+    lru_cache_t* cache = create_cache_with_config(&config);
+
+    // Second access promotes pages to protected segment
+    cached_call(cache, "hot1", &empty_get_page);
+    cached_call(cache, "hot2", &empty_get_page);
+    cached_call(cache, "hot1", &empty_get_page);
+    cached_call(cache, "hot2", &empty_get_page);
+
+    scan_cache(cache, 20);
+    ck_assert_uint_eq(cache_length(cache), 5);
+
+    n_test_cache_call_func = 0;
+    const page_t* page = cached_call(cache, "hot1", &empty_get_page);
+    cached_call(cache, "hot2", &empty_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+    ck_assert_str_eq(page->key, "hot1");
+
+    // One-hit pages only compete in probationary segment
+    cached_call(cache, "cold", &empty_get_page);
+    scan_cache(cache, 1);
+    cached_call(cache, "cold", &empty_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 2);
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+}
+END_TEST
+
+
+START_TEST(test_cache_2q)
+{
+    cache_config_t config = cache_default_config(8);
+    config.policy = CACHE_POLICY_2Q;
+    lru_cache_t* cache = create_cache_with_config(&config);
+
+    // First access goes to FIFO, hit there does not protect a page
+    cached_call(cache, "hot", &empty_get_page);
+    cached_call(cache, "hot", &empty_get_page);
+    scan_cache(cache, 8);
+    n_test_cache_call_func = 0;
+    cached_call(cache, "hot", &empty_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+
+    // Key was remembered as ghost and now lives in LRU part, scan does not evict it
+    scan_cache(cache, 30);
+    ck_assert_uint_eq(cache_length(cache), 8);
+    cached_call(cache, "hot", &empty_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 31);
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+
+    // Plain LRU loses the same key
+    cache = create_cache(8);
+    cached_call(cache, "hot", &empty_get_page);
+    scan_cache(cache, 30);
+    n_test_cache_call_func = 0;
+    cached_call(cache, "hot", &empty_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+}
+END_TEST
+
+
+START_TEST(test_cache_arc)
+{
+    cache_config_t config = cache_default_config(4);
+    config.policy = CACHE_POLICY_ARC;
+    lru_cache_t* cache = create_cache_with_config(&config);
+
+    // Page seen twice moves to frequency part, scan evicts only recent pages
+    cached_call(cache, "hot", &empty_get_page);
+    cached_call(cache, "hot", &empty_get_page);
+    scan_cache(cache, 20);
+    ck_assert_uint_eq(cache_length(cache), 4);
+    ck_assert_uint_eq(cache_stats(cache).arc_target, 0);
+    n_test_cache_call_func = 0;
+    cached_call(cache, "hot", &empty_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+    delete_cache(cache);
+
+    // Hit in recent ghosts grows the target
+    cache = create_cache_with_config(&config);
+    const char* keys[] = {"key0", "key1", "key2", "key3", "key4"};
+    for (size_t i = 0; i < 5; ++i) {
+        cached_call(cache, keys[i], &empty_get_page);
+    }
+    cached_call(cache, keys[0], &empty_get_page);
+    ck_assert_uint_eq(cache_stats(cache).arc_target, 1);
+
+    // Hit in frequent ghosts shrinks it back
+    for (size_t i = 2; i < 5; ++i) {
+        cached_call(cache, keys[i], &empty_get_page);
+    }
+    scan_cache(cache, 1);
+    cached_call(cache, keys[0], &empty_get_page);
+    ck_assert_uint_eq(cache_stats(cache).arc_target, 0);
+
+    // Target is bounded by cache size
+    for (size_t i = 0; i < 100; ++i) {
+        scan_cache(cache, 4);
+        cached_call(cache, keys[i % 5], &empty_get_page);
+    }
+    ck_assert_uint_le(cache_stats(cache).arc_target, 4);
+    ck_assert_uint_eq(cache_length(cache), 4);
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+}
+END_TEST
+
+
+// Keys starting with "exp" are expensive to load
+static page_t* costly_get_page(const char* key) {
+    ++n_test_cache_call_func;
+    page_t* page = create_page(key, "");
+    page->cost = strncmp(key, "exp", 3) == 0 ? 1.0 : 0.001;
+    return page;
+}
+
+
+START_TEST(test_cache_gdsf)
+{
+    cache_config_t config = cache_default_config(3);
+    config.policy = CACHE_POLICY_GDSF;
+    lru_cache_t* cache = create_cache_with_config(&config);
+
+    cached_call(cache, "exp1", &costly_get_page);
+    for (size_t i = 0; i < 20; ++i) {
+        char key[20];
+        sprintf(key, "cheap%zu", i);
+        cached_call(cache, key, &costly_get_page);
+    }
+    ck_assert_uint_eq(cache_length(cache), 3);
+    n_test_cache_call_func = 0;
+    cached_call(cache, "exp1", &costly_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+
+    cache_stats_t stats = cache_stats(cache);
+    ck_assert_double_eq_tol(stats.loader_time, 1.0 + 20 * 0.001, 1e-9);
+    ck_assert_double_eq_tol(stats.saved_loader_time, 1.0, 1e-9);
+
+    // Frequently used cheap pages are kept as well, inflation lets them replace stale expensive page
+    cached_call(cache, "exp2", &costly_get_page);
+    for (size_t i = 0; i < 5000; ++i) {
+        cached_call(cache, "cheap_hot", &costly_get_page);
+        char key[20];
+        sprintf(key, "cheap%zu", i % 2);
+        cached_call(cache, key, &costly_get_page);
+    }
+    n_test_cache_call_func = 0;
+    cached_call(cache, "cheap_hot", &costly_get_page);
+    cached_call(cache, "cheap0", &costly_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+    delete_cache(cache);
+
+    // Cost of loaders without own estimate is measured
+    cache = create_cache(3);
+    const page_t* page = cached_call(cache, "key", &empty_get_page);
+    ck_assert(page->cost > 0.0);
+    ck_assert_double_eq_tol(cache_stats(cache).loader_time, page->cost, 1e-12);
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+}
+END_TEST
+
+
+START_TEST(test_compact_cache)
+{
+    ck_assert_ptr_null(create_compact_cache(0));
+
+    compact_cache_t* cache = create_compact_cache(3);
+    n_test_cache_call_func = 0;
+    const page_t* page = compact_cached_call(cache, "key0", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_key0");
+    ck_assert_ptr_eq(compact_cached_call(cache, "key0", &test_cache_call_func), page);
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+
+    compact_cached_call(cache, "key1", &test_cache_call_func);
+    compact_cached_call(cache, "key2", &test_cache_call_func);
+    compact_cached_call(cache, "key0", &test_cache_call_func);
+    // key1 is the least recently used
+    compact_cached_call(cache, "key3", &test_cache_call_func);
+    ck_assert_uint_eq(compact_cache_length(cache), 3);
+    ck_assert_uint_eq(n_test_cache_call_func, 4);
+    compact_cached_call(cache, "key0", &test_cache_call_func);
+    compact_cached_call(cache, "key2", &test_cache_call_func);
+    ck_assert_uint_eq(n_test_cache_call_func, 4);
+    page = compact_cached_call(cache, "key1", &test_cache_call_func);
+    ck_assert_uint_eq(n_test_cache_call_func, 5);
+    ck_assert_str_eq(page->key, "key1");
+    n_test_cache_call_func = 0;
+    delete_compact_cache(cache);
+}
+END_TEST
 
-    // Then for fixed M, C and k we can find hit rates (for M = 2k, we need to solve e^(-p1 * t) + e^(-p2 * t) = C numerically)
+
+START_TEST(test_compact_cache_randomized)
+{
+    // Same uniform workload as test_cache_randomized, hit rate is C / M
     reset_call_freqs();
-    lru_cache_t* cache = create_cache(RNG_TEST_CACHE_SIZE);
+    compact_cache_t* cache = create_compact_cache(RNG_TEST_CACHE_SIZE);
     size_t rand_freqs[RNG_TEST_CACHE_N_PAGES] = {0};
     for (size_t i = 0; i < RNG_TEST_CACHE_N_ITER; ++i) {
         int r = rand() % RNG_TEST_CACHE_N_PAGES;
-        if (r >= RNG_TEST_CACHE_N_PAGES / 2) {
-            r = ((rand() % 2) == 0) ? r : rand() % RNG_TEST_CACHE_N_PAGES / 2;
-        }
-
         ++rand_freqs[r];
         char key[20];
         sprintf(key, "key%d", r);
-        cached_call(cache, key, &scoped_get_page);
+        compact_cached_call(cache, key, &scoped_get_page);
     }
 
+    float expected_freq = (float) RNG_TEST_CACHE_SIZE / RNG_TEST_CACHE_N_PAGES;
     for (size_t i = 0; i < RNG_TEST_CACHE_N_PAGES; ++i) {
         float freq = (float) int_call_freqs[i] / rand_freqs[i];
-        float expected_freq = i < RNG_TEST_CACHE_N_PAGES / 2 ? RNG_TEST_CACHE2_P1 : RNG_TEST_CACHE2_P2;
         ck_assert_float_eq_tol(freq, expected_freq, 0.01);
     }
+    ck_assert_uint_eq(compact_cache_length(cache), RNG_TEST_CACHE_SIZE);
+    delete_compact_cache(cache);
+}
+END_TEST
 
-    delete_cache(cache);
+
+START_TEST(test_huge_alloc)
+{
+    huge_backing_t backing;
+    char* small = huge_alloc(100, &backing);
+    ck_assert_int_eq(backing, HUGE_BACKING_HEAP);
+    ck_assert_int_eq(small[99], 0);
+    huge_free(small, 100);
+
+    // Any backing is fine, fallback should work without configured huge pages
+    size_t size = 2 * HUGE_PAGE_SIZE + 1;
+    char* big = huge_alloc(size, &backing);
+    ck_assert_int_ne(backing, HUGE_BACKING_HEAP);
+    ck_assert_str_ne(huge_backing_name(backing), "heap");
+    ck_assert_int_eq(big[0], 0);
+    ck_assert_int_eq(big[size - 1], 0);
+    memset(big, 1, size);
+    huge_free(big, size);
 }
 END_TEST
 
 
-Suite* make_suite(void) {
-    Suite *s = suite_create("lru_cache");
+START_TEST(test_compact_cache_huge_numa)
+{
+    compact_config_t config = compact_default_config(HUGE_PAGE_SIZE / 8);
+    config.huge_pages = true;
+    config.numa_node = (int) numa_current_node();
+    compact_cache_t* cache = create_compact_cache_with_config(&config);
+    ck_assert_int_ne(compact_cache_backing(cache), HUGE_BACKING_HEAP);
+    n_test_cache_call_func = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        char key[20];
+        sprintf(key, "key%zu", i % 500);
+        compact_cached_call(cache, key, &test_cache_call_func);
+    }
+    ck_assert_uint_eq(n_test_cache_call_func, 500);
+    ck_assert_uint_eq(compact_cache_length(cache), 500);
+    delete_compact_cache(cache);
+
+    // Small arrays without huge pages are mapped too, so binding does not fail on heap memory
+    config = compact_default_config(100);
+    config.numa_node = (int) numa_current_node();
+    cache = create_compact_cache_with_config(&config);
+    ck_assert(compact_cache_numa_bound(cache));
+    ck_assert_ptr_nonnull(compact_cached_call(cache, "key", &test_cache_call_func));
+    delete_compact_cache(cache);
+    config.numa_node = -1;
+    cache = create_compact_cache_with_config(&config);
+    ck_assert(!compact_cache_numa_bound(cache));
+    delete_compact_cache(cache);
+    size_t cpu_nodes[4];
+    numa_cpu_nodes(cpu_nodes, 4, numa_node_count());
+    ck_assert_uint_lt(cpu_nodes[numa_current_cpu() % 4], numa_node_count());
+
+    ck_assert_uint_ge(numa_node_count(), 1);
+    ck_assert_uint_lt(numa_current_node(), numa_node_count());
+    numa_cache_t* numa_cache = create_numa_cache(10, true);
+    ck_assert_uint_eq(numa_cache_n_shards(numa_cache), numa_node_count());
+    compact_cache_t* shard = numa_local_shard(numa_cache);
+    ck_assert_ptr_eq(shard, numa_shard(numa_cache, numa_current_node()));
+    const page_t* page = compact_cached_call(shard, "key", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_key");
+    n_test_cache_call_func = 0;
+    delete_numa_cache(numa_cache);
+
+    // Large hash table of lru cache with huge pages
+    cache_config_t lru_config = cache_default_config(HUGE_PAGE_SIZE);
+    lru_config.huge_pages = true;
+    lru_cache_t* lru_cache = create_cache_with_config(&lru_config);
+    for (size_t i = 0; i < HUGE_PAGE_SIZE / 4; ++i) {
+        char key[20];
+        sprintf(key, "key%zu", i);
+        cached_call(lru_cache, key, &empty_get_page);
+    }
+    ck_assert_uint_eq(cache_length(lru_cache), HUGE_PAGE_SIZE / 4);
+    n_test_cache_call_func = 0;
+    delete_cache(lru_cache);
+}
+END_TEST
 
-    // Page tests
-    TCase *tc_page = tcase_create("Page");
-    tcase_add_test(tc_page, test_page);
 
-    // Key tests
-    TCase *tc_key = tcase_create("Key");
-    tcase_add_test(tc_key, test_key);
-    tcase_add_test(tc_key, test_hash);
+typedef struct foo_t {
+    uint64_t id;
+    double score;
+} foo_t;
 
-    // Clist tests
-    TCase *tc_clist = tcase_create("Clist");
-    tcase_add_test(tc_clist, test_list_create);
-    tcase_add_test(tc_clist, test_list_push_pop);
-    tcase_add_test(tc_clist, test_list_move_upfront);
-    tcase_add_test(tc_clist, test_list_push_pop_randomized);
+DEFINE_TYPED_CACHE(foo_cache, uint64_t, foo_t, typed_hash_u64, typed_equal_u64)
+DEFINE_TYPED_CACHE(str_cache, const char*, int, key_hash, key_equal)
 
-    // Chashtable tests
-    TCase *tc_chashtable = tcase_create("Chashtable");
-    tcase_add_test(tc_chashtable, test_hashtable_create);
-    tcase_add_test(tc_chashtable, test_hashtable_put_get_delete);
-    tcase_add_test(tc_chashtable, test_hashtable_randomized);
+
+static foo_t load_foo(uint64_t id) {
+    ++n_test_cache_call_func;
+    foo_t foo = {id, id * 0.5};
+    return foo;
+}
+
+
+size_t n_evicted_foos = 0;
+
+
+static void count_evicted_foo(uint64_t* id, foo_t* foo) {
+    ck_assert_uint_eq(*id, foo->id);
+    ++n_evicted_foos;
+}
+
+
+START_TEST(test_typed_cache)
+{
+    ck_assert_ptr_null(foo_cache_create(0, NULL));
+
+    foo_cache_t* cache = foo_cache_create(3, &count_evicted_foo);
+    n_test_cache_call_func = 0;
+    const foo_t* foo = foo_cache_cached_call(cache, 42, &load_foo);
+    ck_assert_uint_eq(foo->id, 42);
+    ck_assert_double_eq_tol(foo->score, 21.0, 1e-12);
+    ck_assert_ptr_eq(foo_cache_cached_call(cache, 42, &load_foo), foo);
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+
+    foo_cache_cached_call(cache, 1, &load_foo);
+    foo_cache_cached_call(cache, 2, &load_foo);
+    foo_cache_get(cache, 42);
+    foo_cache_cached_call(cache, 3, &load_foo);
+    // 1 was the least recently used
+    ck_assert_ptr_null(foo_cache_get(cache, 1));
+    ck_assert_ptr_nonnull(foo_cache_get(cache, 2));
+    ck_assert_uint_eq(foo_cache_length(cache), 3);
+    ck_assert_uint_eq(n_evicted_foos, 1);
+
+    foo_t replacement = {2, -1.0};
+    foo_cache_put(cache, 2, replacement);
+    ck_assert_double_eq_tol(foo_cache_get(cache, 2)->score, -1.0, 1e-12);
+    ck_assert_uint_eq(foo_cache_length(cache), 3);
+    ck_assert_uint_eq(n_evicted_foos, 2);
+
+    ck_assert(foo_cache_remove(cache, 42));
+    ck_assert(!foo_cache_remove(cache, 42));
+    ck_assert_uint_eq(foo_cache_length(cache), 2);
+    foo_cache_delete(cache);
+    ck_assert_uint_eq(n_evicted_foos, 5);
+    n_test_cache_call_func = 0;
+
+    // Any key type with hash and equal functions
+    str_cache_t* str_cache = str_cache_create(2, NULL);
+    str_cache_put(str_cache, "one", 1);
+    str_cache_put(str_cache, "two", 2);
+    char key[10] = "one";
+    ck_assert_int_eq(*str_cache_get(str_cache, key), 1);
+    str_cache_put(str_cache, "three", 3);
+    ck_assert_ptr_null(str_cache_get(str_cache, "two"));
+    str_cache_delete(str_cache);
+}
+END_TEST
+
+
+static page_t* u64_get_page(uint64_t key) {
+    ++n_test_cache_call_func;
+    if (key == 404) {
+        return NULL;
+    }
+    char buf[30];
+    sprintf(buf, "%llu", (unsigned long long) key);
+    return create_page(buf, buf);
+}
+
+
+START_TEST(test_u64_cache)
+{
+    ck_assert_ptr_null(create_u64_cache(0));
+
+    // Same scenario as test_cached_call
+    u64_cache_t* cache = create_u64_cache(3);
+    n_test_cache_call_func = 0;
+    u64_cached_call(cache, 0, &u64_get_page);
+    u64_cached_call(cache, 1, &u64_get_page);
+    u64_cached_call(cache, 2, &u64_get_page);
+    u64_cached_call(cache, 3, &u64_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 4);
+    ck_assert_uint_eq(u64_cache_length(cache), 3);
+
+    const page_t* page = u64_cached_call(cache, 2, &u64_get_page);
+    page = u64_cached_call(cache, 1, &u64_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 4);
+    ck_assert_str_eq(page->data, "1");
+
+    page = u64_cached_call(cache, 0, &u64_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 5);
+    page = u64_cached_call(cache, UINT64_MAX, &u64_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 6);
+    ck_assert_str_eq(page->key, "18446744073709551615");
+    u64_cached_call(cache, 1, &u64_get_page);
+    u64_cached_call(cache, 0, &u64_get_page);
+    ck_assert_uint_eq(n_test_cache_call_func, 6);
+    ck_assert_uint_eq(u64_cache_length(cache), 3);
+
+    // Missing key is not cached
+    ck_assert_ptr_null(u64_cached_call(cache, 404, &u64_get_page));
+    ck_assert_ptr_null(u64_cached_call(cache, 404, &u64_get_page));
+    ck_assert_uint_eq(n_test_cache_call_func, 8);
+    ck_assert_uint_eq(u64_cache_length(cache), 3);
+    n_test_cache_call_func = 0;
+    delete_u64_cache(cache);
+}
+END_TEST
+
+
+static atomic_size_t n_async_loads;
+
+
+static page_t* slow_async_get_page(const char* key) {
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 1000000};
+    nanosleep(&delay, NULL);
+    atomic_fetch_add(&n_async_loads, 1);
+    return create_page(key, key);
+}
+
+
+typedef struct async_result_t {
+    size_t n_calls;
+    char data[16];
+    async_cache_t* async;  // set for callbacks using the cache
+} async_result_t;
+
+
+static void async_collect(const char* key, const page_t* page, void* arg) {
+    async_result_t* result = arg;
+    ++result->n_calls;
+    ck_assert_str_eq(page->key, key);
+    strcpy(result->data, page->data);
+}
+
+
+START_TEST(test_async_cache)
+{
+    ck_assert_ptr_null(create_async_cache(NULL, 1, &slow_async_get_page));
+
+    async_cache_t* async = create_async_cache(create_cache(2), 2, &slow_async_get_page);
+    atomic_store(&n_async_loads, 0);
+    async_result_t results[4] = {0};
+
+    // Same key shares one load
+    ck_assert(!async_cached_call(async, "a", &async_collect, &results[0]));
+    ck_assert(!async_cached_call(async, "a", &async_collect, &results[1]));
+    ck_assert(!async_cached_call(async, "b", &async_collect, &results[2]));
+    ck_assert_uint_eq(async_cache_n_pending(async), 2);
+
+    struct pollfd pfd = {.fd = async_cache_fd(async), .events = POLLIN};
+    while (async_cache_n_pending(async) != 0) {
+        ck_assert_int_eq(poll(&pfd, 1, 1000), 1);
+        async_cache_dispatch(async);
+    }
+    ck_assert_uint_eq(atomic_load(&n_async_loads), 2);
+    ck_assert_uint_eq(results[0].n_calls, 1);
+    ck_assert_uint_eq(results[1].n_calls, 1);
+    ck_assert_uint_eq(results[2].n_calls, 1);
+    ck_assert_str_eq(results[1].data, "a");
+    ck_assert_str_eq(results[2].data, "b");
+    ck_assert_uint_eq(cache_length(async_cache_get_cache(async)), 2);
+
+    // Hit completes inline
+    ck_assert(async_cached_call(async, "a", &async_collect, &results[3]));
+    ck_assert_uint_eq(results[3].n_calls, 1);
+    ck_assert_uint_eq(atomic_load(&n_async_loads), 2);
+
+    // Loads in flight are dropped with the cache
+    async_cached_call(async, "c", &async_collect, &results[3]);
+    delete_async_cache(async);
+    ck_assert_uint_eq(results[3].n_calls, 1);
+}
+END_TEST
+
+
+START_TEST(test_async_cache_manual)
+{
+    async_cache_t* async = create_async_cache(create_cache(2), 0, NULL);
+    async_result_t results[2] = {0};
+    ck_assert(!async_cached_call(async, "x", &async_collect, &results[0]));
+    ck_assert(!async_cached_call(async, "x", &async_collect, &results[1]));
+    ck_assert_uint_eq(async_cache_dispatch(async), 0);
+    ck_assert(!async_cache_complete(async, "y", NULL));
+
+    ck_assert(async_cache_complete(async, "x", create_page("x", "xx")));
+    ck_assert_uint_eq(async_cache_n_pending(async), 0);
+    ck_assert_uint_eq(results[0].n_calls, 1);
+    ck_assert_uint_eq(results[1].n_calls, 1);
+    ck_assert_str_eq(results[1].data, "xx");
+    ck_assert(async_cached_call(async, "x", &async_collect, &results[0]));
+    ck_assert_uint_eq(results[0].n_calls, 2);
+    delete_async_cache(async);
+}
+END_TEST
+
+
+static void async_evict_collect(const char* key, const page_t* page, void* arg) {
+    async_collect(key, page, arg);
+    // Fill the cache so the loaded page is evicted before the next waiter runs
+    async_cache_t* async = ((async_result_t*) arg)->async;
+    lru_cache_t* cache = async_cache_get_cache(async);
+    cache_put(cache, "e1", create_page("e1", "d1"));
+    cache_put(cache, "e2", create_page("e2", "d2"));
+    cache_put(cache, "e3", create_page("e3", "d3"));
+}
+
+
+START_TEST(test_async_cache_evicting_callback)
+{
+    async_cache_t* async = create_async_cache(create_cache(2), 0, NULL);
+    async_result_t results[2] = {{.async = async}, {0}};
+    ck_assert(!async_cached_call(async, "k", &async_evict_collect, &results[0]));
+    ck_assert(!async_cached_call(async, "k", &async_collect, &results[1]));
+    ck_assert(async_cache_complete(async, "k", create_page("k", "kk")));
+    ck_assert_uint_eq(results[1].n_calls, 1);
+    ck_assert_str_eq(results[1].data, "kk");
+    ck_assert(!cache_contains(async_cache_get_cache(async), "k"));
+    delete_async_cache(async);
+}
+END_TEST
+
+
+static size_t n_ebr_freed;
+
+
+static void count_ebr_free(void* ptr) {
+    ++n_ebr_freed;
+    free(ptr);
+}
+
+
+START_TEST(test_ebr)
+{
+    ebr_t* ebr = create_ebr();
+    n_ebr_freed = 0;
+    ebr_enter(ebr);
+    ebr_retire(ebr, malloc(1), &count_ebr_free);
+    // Pinned reader keeps object alive
+    ebr_collect(ebr);
+    ebr_collect(ebr);
+    ebr_collect(ebr);
+    ck_assert_uint_eq(n_ebr_freed, 0);
+    ebr_exit(ebr);
+    ebr_collect(ebr);
+    ebr_collect(ebr);
+    ck_assert_uint_eq(n_ebr_freed, 1);
+
+    ebr_retire(ebr, malloc(1), &count_ebr_free);
+    delete_ebr(ebr);
+    ck_assert_uint_eq(n_ebr_freed, 2);
+}
+END_TEST
+
+
+START_TEST(test_chashtable)
+{
+    chashtable_t* htable = create_chashtable();
+    char key[64];
+    ck_assert_ptr_null(chashtable_get(htable, "a"));
+    ck_assert_ptr_null(chashtable_delete_entry(htable, "a"));
+
+    size_t n_buckets = chashtable_n_buckets(htable);
+    for (size_t i = 0; i < HASH_TEST_ARR_SIZE; ++i) {
+        sprintf(key, "a rather long key to keep on heap %zu", i);
+        ck_assert_ptr_null(chashtable_put(htable, key, (void*) (i + 1)));
+    }
+    ck_assert_uint_eq(chashtable_length(htable), HASH_TEST_ARR_SIZE);
+    ck_assert_uint_gt(chashtable_n_buckets(htable), n_buckets);
+    for (size_t i = 0; i < HASH_TEST_ARR_SIZE; ++i) {
+        sprintf(key, "a rather long key to keep on heap %zu", i);
+        ck_assert_ptr_eq(chashtable_get(htable, key), (void*) (i + 1));
+    }
+
+    ck_assert_ptr_eq(chashtable_put(htable, "a rather long key to keep on heap 7", (void*) 42), (void*) 8);
+    ck_assert_ptr_eq(chashtable_get(htable, "a rather long key to keep on heap 7"), (void*) 42);
+    ck_assert_uint_eq(chashtable_length(htable), HASH_TEST_ARR_SIZE);
+    ck_assert_ptr_eq(chashtable_delete_entry(htable, "a rather long key to keep on heap 7"), (void*) 42);
+    ck_assert_ptr_null(chashtable_get(htable, "a rather long key to keep on heap 7"));
+    ck_assert_uint_eq(chashtable_length(htable), HASH_TEST_ARR_SIZE - 1);
+    delete_chashtable(htable);
+}
+END_TEST
+
+
+typedef struct chash_worker_t {
+    chashtable_t* htable;
+    unsigned seed;
+    size_t n_bad_values;
+} chash_worker_t;
+
+
+static void* chash_stress_worker(void* arg) {
+    chash_worker_t* worker = arg;
+    char key[32];
+    for (size_t i = 0; i < CHASH_TEST_N_ITER; ++i) {
+        worker->seed = worker->seed * 1103515245 + 12345;
+        size_t key_idx = (worker->seed >> 8) % CHASH_TEST_N_KEYS;
+        size_t op = (worker->seed >> 24) % 8;
+        sprintf(key, "key %zu", key_idx);
+        if (op < 5) {
+            void* value = chashtable_get(worker->htable, key);
+            worker->n_bad_values += value != NULL && value != (void*) (key_idx + 1);
+        } else if (op < 7) {
+            void* value = chashtable_put(worker->htable, key, (void*) (key_idx + 1));
+            worker->n_bad_values += value != NULL && value != (void*) (key_idx + 1);
+        } else {
+            void* value = chashtable_delete_entry(worker->htable, key);
+            worker->n_bad_values += value != NULL && value != (void*) (key_idx + 1);
+        }
+    }
+    return NULL;
+}
+
+
+START_TEST(test_chashtable_stress)
+{
+    // Table starts small, so workers also race with resizes
+    chashtable_t* htable = create_chashtable();
+    pthread_t threads[CHASH_TEST_N_THREADS];
+    chash_worker_t workers[CHASH_TEST_N_THREADS];
+    for (size_t i = 0; i < CHASH_TEST_N_THREADS; ++i) {
+        workers[i].htable = htable;
+        workers[i].seed = i + 1;
+        workers[i].n_bad_values = 0;
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, &chash_stress_worker, &workers[i]), 0);
+    }
+    for (size_t i = 0; i < CHASH_TEST_N_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ck_assert_uint_eq(workers[i].n_bad_values, 0);
+    }
+
+    size_t n_found = 0;
+    char key[32];
+    for (size_t i = 0; i < CHASH_TEST_N_KEYS; ++i) {
+        sprintf(key, "key %zu", i);
+        n_found += chashtable_get(htable, key) != NULL;
+    }
+    ck_assert_uint_eq(n_found, chashtable_length(htable));
+    ck_assert_uint_ge(chashtable_n_buckets(htable), chashtable_length(htable));
+    delete_chashtable(htable);
+}
+END_TEST
+
+
+START_TEST(test_front_cache)
+{
+    cache_config_t config = cache_default_config(2);
+    shared_cache_t* shared = create_shared_cache(&config);
+    front_cache_t* front = create_front_cache(shared, 4);
+    front_cache_t* other_front = create_front_cache(shared, 4);
+    ck_assert_ptr_null(create_front_cache(shared, 0));
+    n_test_cache_call_func = 0;
+
+    const page_t* page = front_cached_call(front, "a", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_a");
+    page = front_cached_call(front, "a", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_a");
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+    ck_assert_uint_eq(front_cache_stats(front).hits, 1);
+    ck_assert_uint_eq(front_cache_stats(front).misses, 1);
+    // Front hits do not reach shared cache
+    ck_assert_uint_eq(shared_cache_stats(shared).hits, 0);
+
+    // Other thread fills its front from shared cache
+    front_cached_call(other_front, "a", &test_cache_call_func);
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+    ck_assert_uint_eq(shared_cache_stats(shared).hits, 1);
+
+    // Eviction in shared cache invalidates "a" in both fronts
+    front_cached_call(other_front, "b", &test_cache_call_func);
+    front_cached_call(other_front, "c", &test_cache_call_func);
+    ck_assert_uint_eq(n_test_cache_call_func, 3);
+    front_cache_release(other_front);
+    page = front_cached_call(front, "a", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_a");
+    ck_assert_uint_eq(n_test_cache_call_func, 4);
+    ck_assert_uint_eq(front_cache_stats(front).misses, 2);
+
+    n_test_cache_call_func = 0;
+    delete_front_cache(front);
+    delete_front_cache(other_front);
+    delete_shared_cache(shared);
+}
+END_TEST
+
+
+typedef struct front_worker_t {
+    shared_cache_t* shared;
+    unsigned seed;
+    size_t n_bad_pages;
+} front_worker_t;
+
+
+static void* front_stress_worker(void* arg) {
+    front_worker_t* worker = arg;
+    front_cache_t* front = create_front_cache(worker->shared, 8);
+    char key[32];
+    char data[40];
+    for (size_t i = 0; i < FRONT_TEST_N_ITER; ++i) {
+        worker->seed = worker->seed * 1103515245 + 12345;
+        sprintf(key, "%u", (worker->seed >> 8) % FRONT_TEST_N_KEYS);
+        sprintf(data, "page_%s", key);
+        const page_t* page = front_cached_call(front, key, &test_cache_call_func);
+        worker->n_bad_pages += strcmp(page->key, key) != 0 || strcmp(page->data, data) != 0;
+    }
+    delete_front_cache(front);
+    return NULL;
+}
+
+
+START_TEST(test_front_cache_stress)
+{
+    // Shared cache is smaller than key set, so fronts keep seeing evictions
+    cache_config_t config = cache_default_config(FRONT_TEST_N_KEYS / 4);
+    shared_cache_t* shared = create_shared_cache(&config);
+    pthread_t threads[CHASH_TEST_N_THREADS];
+    front_worker_t workers[CHASH_TEST_N_THREADS];
+    for (size_t i = 0; i < CHASH_TEST_N_THREADS; ++i) {
+        workers[i].shared = shared;
+        workers[i].seed = i + 1;
+        workers[i].n_bad_pages = 0;
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, &front_stress_worker, &workers[i]), 0);
+    }
+    for (size_t i = 0; i < CHASH_TEST_N_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ck_assert_uint_eq(workers[i].n_bad_pages, 0);
+    }
+    n_test_cache_call_func = 0;
+    delete_shared_cache(shared);
+}
+END_TEST
+
+
+START_TEST(test_cache_resize)
+{
+    cache_config_t config = cache_default_config(200);
+    config.policy = CACHE_POLICY_SLRU;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    n_test_cache_call_func = 0;
+    scan_cache(cache, 200);
+    ck_assert_uint_eq(cache_length(cache), 200);
+
+    // Shrinking evicts in bounded steps
+    ck_assert(!cache_resize(cache, 10, 0));
+    ck_assert_uint_eq(cache_length(cache), 200 - CACHE_RESIZE_STEP);
+    ck_assert_uint_eq(cache_max_size(cache), 10);
+    cached_call(cache, "new key", &empty_get_page);
+    ck_assert_uint_eq(cache_length(cache), 200 - 2 * CACHE_RESIZE_STEP + 1);
+    ck_assert(cache_resize(cache, 10, 0));
+    ck_assert_uint_eq(cache_length(cache), 10);
+    ck_assert_uint_eq(cache_stats(cache).evictions, 191);
+    const page_t* page;
+    ck_assert(cache_lookup(cache, "new key", &page));
+
+    // Growing keeps pages
+    ck_assert(cache_resize(cache, 1000, 0));
+    scan_cache(cache, 500);
+    ck_assert_uint_eq(cache_length(cache), 510);
+    ck_assert_uint_eq(cache_stats(cache).evictions, 191);
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+}
+END_TEST
+
+
+static void write_cgroup_file(const char* dir, const char* name, const char* content) {
+    char path[256];
+    sprintf(path, "%s/%s", dir, name);
+    FILE* file = fopen(path, "w");
+    ck_assert_ptr_nonnull(file);
+    fputs(content, file);
+    fclose(file);
+}
+
+
+START_TEST(test_pressure_watcher)
+{
+    char dir[] = "/tmp/cache_cgroup_XXXXXX";
+    ck_assert_ptr_nonnull(mkdtemp(dir));
+    memory_state_t state;
+    ck_assert(!read_memory_state(dir, &state));
+
+    write_cgroup_file(dir, "memory.current", "500\n");
+    write_cgroup_file(dir, "memory.max", "max\n");
+    ck_assert(read_memory_state(dir, &state));
+    ck_assert_uint_eq(state.current, 500);
+    ck_assert_uint_eq(state.limit, 0);
+    ck_assert(state.pressure == 0.0);
+
+    lru_cache_t* cache = create_cache(100);
+    pressure_config_t config = pressure_default_config(dir, 10, 110);
+    ck_assert_ptr_null(create_pressure_watcher(cache, &(pressure_config_t) {.cgroup_dir = dir}));
+    pressure_watcher_t* watcher = create_pressure_watcher(cache, &config);
+    n_test_cache_call_func = 0;
+    scan_cache(cache, 100);
+
+    // No limit and no pressure, grows up to max size
+    ck_assert_uint_eq(pressure_watcher_poll(watcher), 110);
+    ck_assert_uint_eq(pressure_watcher_poll(watcher), 110);
+
+    // Close to limit
+    write_cgroup_file(dir, "memory.max", "520\n");
+    ck_assert(read_memory_state(dir, &state));
+    ck_assert_uint_eq(state.limit, 520);
+    ck_assert_uint_eq(pressure_watcher_poll(watcher), 82);
+    ck_assert_uint_eq(cache_length(cache), 82);
+
+    // Stalls on memory shrink cache even below the limit
+    write_cgroup_file(dir, "memory.max", "10000\n");
+    write_cgroup_file(dir, "memory.pressure",
+                      "some avg10=25.50 avg60=3.00 avg300=1.00 total=100\n"
+                      "full avg10=5.00 avg60=1.00 avg300=0.00 total=10\n");
+    ck_assert(read_memory_state(dir, &state));
+    ck_assert(state.pressure > 25.4 && state.pressure < 25.6);
+    size_t size = 82;
+    for (size_t i = 0; i < 20; ++i) {
+        size = pressure_watcher_poll(watcher);
+    }
+    ck_assert_uint_eq(size, 10);
+    ck_assert_uint_eq(cache_length(cache), 10);
+
+    // Pressure gone, memory is free
+    write_cgroup_file(dir, "memory.pressure", "some avg10=0.00 avg60=3.00 avg300=1.00 total=100\n");
+    ck_assert_uint_eq(pressure_watcher_poll(watcher), 11);
+
+    delete_pressure_watcher(watcher);
+    delete_cache(cache);
+    n_test_cache_call_func = 0;
+    const char* names[] = {"memory.current", "memory.max", "memory.pressure"};
+    char path[256];
+    for (size_t i = 0; i < 3; ++i) {
+        sprintf(path, "%s/%s", dir, names[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+END_TEST
+
+
+static page_t* preload_get_page(const char* key) {
+    atomic_fetch_add(&n_async_loads, 1);
+    if (!strcmp(key, "missing")) {
+        return NULL;
+    }
+    return create_page(key, key);
+}
+
+
+START_TEST(test_cache_preload)
+{
+    char keys_buf[100][8];
+    const char* keys[101];
+    for (size_t i = 0; i < 100; ++i) {
+        sprintf(keys_buf[i], "%zu", i);
+        keys[i] = keys_buf[i];
+    }
+    keys[100] = "cold";
+
+    lru_cache_t* cache = create_cache(50);
+    atomic_store(&n_async_loads, 0);
+    n_test_cache_call_func = 0;
+    cached_call(cache, "7", &test_cache_call_func);
+
+    // Only the hottest keys fitting the cache are loaded, cached "7" is kept
+    ck_assert_uint_eq(cache_preload(cache, keys, 100, &preload_get_page, 4), 49);
+    ck_assert_uint_eq(atomic_load(&n_async_loads), 49);
+    ck_assert_uint_eq(cache_length(cache), 50);
+    ck_assert(cache_contains(cache, "0"));
+    ck_assert(cache_contains(cache, "49"));
+    ck_assert(!cache_contains(cache, "50"));
+    const page_t* page;
+    ck_assert(cache_lookup(cache, "7", &page));
+    ck_assert_str_eq(page->data, "page_7");
+
+    // Coldest key is evicted first
+    cached_call(cache, "new", &test_cache_call_func);
+    ck_assert(!cache_contains(cache, "49"));
+    ck_assert(cache_contains(cache, "48"));
+    cached_call(cache, "new 2", &test_cache_call_func);
+    ck_assert(!cache_contains(cache, "48"));
+    ck_assert(cache_contains(cache, "0"));
+
+    // Cached keys are not loaded again, failed loads are not cached
+    const char* more_keys[] = {"0", "missing", "1"};
+    ck_assert_uint_eq(cache_preload(cache, more_keys, 3, &preload_get_page, 0), 0);
+    ck_assert_uint_eq(atomic_load(&n_async_loads), 50);
+    ck_assert(!cache_contains(cache, "missing"));
+    ck_assert_uint_eq(cache_preload(cache, keys, 0, &preload_get_page, 4), 0);
+
+    // Repeated key is loaded once
+    const char* repeated_keys[] = {"dup", "other", "dup"};
+    ck_assert_uint_eq(cache_preload(cache, repeated_keys, 3, &preload_get_page, 2), 2);
+    ck_assert_uint_eq(atomic_load(&n_async_loads), 52);
+    ck_assert(cache_contains(cache, "dup"));
+
+    // Shrinking after preload gives up reserved table size
+    while (!cache_resize(cache, 5, 0)) {
+    }
+    ck_assert_uint_eq(cache_length(cache), 5);
+    delete_cache(cache);
+
+    // Cached hot key at the LRU tail is kept and moved to its position
+    cache = create_cache(3);
+    cached_call(cache, "hot", &test_cache_call_func);
+    cached_call(cache, "a", &test_cache_call_func);
+    cached_call(cache, "b", &test_cache_call_func);
+    const char* warm_keys[] = {"hot", "x", "y"};
+    ck_assert_uint_eq(cache_preload(cache, warm_keys, 3, &preload_get_page, 0), 2);
+    ck_assert(cache_contains(cache, "hot"));
+    ck_assert_uint_eq(cache_stats(cache).hits, 0);
+    cached_call(cache, "new", &test_cache_call_func);
+    ck_assert(!cache_contains(cache, "y"));
+    ck_assert(cache_contains(cache, "hot"));
+
+    n_test_cache_call_func = 0;
+    delete_cache(cache);
+}
+END_TEST
+
+
+typedef struct evict_log_t {
+    size_t n_evicted;
+    size_t n_replaced;
+    page_t* kept;  // page taken over by listener
+} evict_log_t;
+
+
+static bool log_eviction(page_t* page, cache_removal_t reason, void* arg) {
+    evict_log_t* log = arg;
+    if (reason == CACHE_EVICTED) {
+        ++log->n_evicted;
+    } else {
+        ++log->n_replaced;
+    }
+    if (log->kept == NULL && !strcmp(page->key, "0")) {
+        log->kept = page;
+        return true;
+    }
+    return false;
+}
+
+
+START_TEST(test_cache_evict_listener)
+{
+    evict_log_t log = {0, 0, NULL};
+    cache_config_t config = cache_default_config(3);
+    config.on_evict = &log_eviction;
+    config.on_evict_arg = &log;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    n_test_cache_call_func = 0;
+    const char* keys[] = {"0", "1", "2", "3", "4"};
+    for (size_t i = 0; i < 5; ++i) {
+        cached_call(cache, keys[i], &test_cache_call_func);
+    }
+    ck_assert_uint_eq(log.n_evicted, 2);
+    ck_assert_ptr_nonnull(log.kept);
+    ck_assert_str_eq(log.kept->key, "0");
+
+    cache_put(cache, "3", create_page("3", "new"));
+    ck_assert_uint_eq(log.n_replaced, 1);
+    ck_assert_uint_eq(cache_stats(cache).evictions, 2);
+    // Pages left at deletion are not reported
+    delete_cache(cache);
+    ck_assert_uint_eq(log.n_evicted, 2);
+    delete_page(log.kept);
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+START_TEST(test_free_queue)
+{
+    // Freed only at quiescent points
+    free_queue_t* queue = create_free_queue(false, 4);
+    cache_config_t config = cache_default_config(2);
+    config.release_page = &free_queue_release;
+    config.release_arg = queue;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    n_test_cache_call_func = 0;
+    scan_cache(cache, 200);
+    ck_assert_uint_eq(free_queue_stats(queue).n_queued, 198);
+    ck_assert_uint_eq(free_queue_drain(queue), 198);
+    ck_assert_uint_eq(free_queue_drain(queue), 0);
+    ck_assert_uint_eq(free_queue_stats(queue).n_freed, 198);
+    delete_cache(cache);
+    ck_assert_uint_eq(free_queue_stats(queue).n_queued, 2);
+    delete_free_queue(queue);
+
+    // Background thread
+    queue = create_free_queue(true, 8);
+    config.release_arg = queue;
+    cache = create_cache_with_config(&config);
+    scan_cache(cache, 22);
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 1000000};
+    for (size_t i = 0; i < 2000 && free_queue_stats(queue).n_freed != 20; ++i) {
+        nanosleep(&delay, NULL);
+    }
+    free_queue_stats_t stats = free_queue_stats(queue);
+    ck_assert_uint_eq(stats.n_freed, 20);
+    ck_assert_uint_eq(stats.n_queued, 0);
+    ck_assert_uint_ge(stats.n_batches, 1);
+    delete_cache(cache);
+    delete_free_queue(queue);
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+static page_t* missing_get_page(const char* key) {
+    (void)key;
+    ++n_test_cache_call_func;
+    return NULL;
+}
+
+
+static bool has_tombstone(const negative_cache_t* negative, const char* key, double now) {
+    double expires;
+    return negative_cache_find(negative, key, &expires) && expires > now;
+}
+
+
+START_TEST(test_negative_cache)
+{
+    for (int use_filter = 0; use_filter < 2; ++use_filter) {
+        ck_assert_ptr_null(create_negative_cache(0, 1.0, use_filter));
+        negative_cache_t* negative = create_negative_cache(3, 10.0, use_filter);
+        const char* long_key = "a key too long to be stored inline in the tombstone";
+        negative_cache_add(negative, "a", 0.0);
+        negative_cache_add(negative, long_key, 1.0);
+        ck_assert(has_tombstone(negative, "a", 5.0));
+        ck_assert(has_tombstone(negative, long_key, 5.0));
+        ck_assert(!has_tombstone(negative, "b", 5.0));
+        double expires = 0.0;
+        ck_assert(negative_cache_find(negative, long_key, &expires));
+        ck_assert(expires == 11.0);
+        ck_assert(!negative_cache_find(negative, "b", &expires));
+        // Expired
+        ck_assert(!has_tombstone(negative, "a", 10.5));
+        ck_assert(has_tombstone(negative, long_key, 10.5));
+
+        negative_cache_remove(negative, long_key);
+        ck_assert(!has_tombstone(negative, long_key, 2.0));
+        // Oldest is dropped when full
+        negative_cache_add(negative, "b", 2.0);
+        negative_cache_add(negative, "c", 2.0);
+        negative_cache_add(negative, "d", 2.0);
+        negative_cache_add(negative, "e", 2.0);
+        ck_assert_uint_eq(negative_cache_length(negative), 3);
+        ck_assert(!has_tombstone(negative, "b", 3.0));
+        ck_assert(has_tombstone(negative, "e", 3.0));
+
+        // Filter is rebuilt after many additions
+        for (size_t i = 0; i < 100; ++i) {
+            char key[30];
+            sprintf(key, "missing%zu", i);
+            negative_cache_add(negative, key, 4.0);
+            ck_assert(has_tombstone(negative, key, 4.0));
+        }
+        ck_assert(!has_tombstone(negative, "missing0", 4.0));
+        ck_assert(has_tombstone(negative, "missing99", 4.0));
+        delete_negative_cache(negative);
+    }
+
+    bloom_t* bloom = create_bloom(1000, 10);
+    for (unsigned long i = 0; i < 1000; ++i) {
+        bloom_add(bloom, i * 7919);
+    }
+    size_t n_false_positives = 0;
+    for (unsigned long i = 0; i < 1000; ++i) {
+        ck_assert(bloom_maybe_contains(bloom, i * 7919));
+        n_false_positives += bloom_maybe_contains(bloom, i * 7919 + 1);
+    }
+    ck_assert_uint_lt(n_false_positives, 50);
+    ck_assert_uint_eq(bloom_n_added(bloom), 1000);
+    bloom_clear(bloom);
+    ck_assert(!bloom_maybe_contains(bloom, 0));
+    delete_bloom(bloom);
+}
+END_TEST
+
+
+START_TEST(test_cache_negative)
+{
+    n_test_cache_call_func = 0;
+    // Misses are not cached by default, and NULL page is never evicted
+    lru_cache_t* cache = create_cache(2);
+    ck_assert_ptr_null(cached_call(cache, "missing", &missing_get_page));
+    ck_assert_ptr_null(cached_call(cache, "missing", &missing_get_page));
+    ck_assert_uint_eq(n_test_cache_call_func, 2);
+    ck_assert_uint_eq(cache_length(cache), 0);
+    scan_cache(cache, 5);
+    delete_cache(cache);
+
+    for (int use_filter = 0; use_filter < 2; ++use_filter) {
+        cache_config_t config = cache_default_config(2);
+        config.max_negative = 4;
+        config.negative_filter = use_filter;
+        cache = create_cache_with_config(&config);
+        n_test_cache_call_func = 0;
+        cached_call(cache, "1", &test_cache_call_func);
+        cached_call(cache, "2", &test_cache_call_func);
+        for (size_t i = 0; i < 10; ++i) {
+            ck_assert_ptr_null(cached_call(cache, "missing", &missing_get_page));
+        }
+        ck_assert_uint_eq(n_test_cache_call_func, 3);
+        cache_stats_t stats = cache_stats(cache);
+        ck_assert_uint_eq(stats.negative_hits, 9);
+        ck_assert_uint_eq(stats.hits, 9);
+        ck_assert_uint_eq(stats.n_negative, 1);
+        // Tombstones have their own budget
+        ck_assert_uint_eq(cache_length(cache), 2);
+        ck_assert_uint_eq(stats.evictions, 0);
+        const page_t* page = cached_call(cache, "1", &test_cache_call_func);
+        ck_assert_str_eq(page->data, "page_1");
+        ck_assert_uint_eq(n_test_cache_call_func, 3);
+
+        // Key that appears upstream replaces its tombstone
+        cache_put(cache, "missing", create_page("missing", "found"));
+        page = cached_call(cache, "missing", &missing_get_page);
+        ck_assert_str_eq(page->data, "found");
+        ck_assert_uint_eq(cache_stats(cache).n_negative, 0);
+        ck_assert(cache_contains(cache, "missing"));
+
+        // And tombstone replaces page
+        cache_put(cache, "missing", NULL);
+        ck_assert(!cache_contains(cache, "missing"));
+        ck_assert_ptr_null(cached_call(cache, "missing", &test_cache_call_func));
+        ck_assert_uint_eq(n_test_cache_call_func, 3);
+        delete_cache(cache);
+    }
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+START_TEST(test_cuckoo)
+{
+    cuckoo_t* cuckoo = create_cuckoo(1000);
+    ck_assert_uint_eq(cuckoo_capacity(cuckoo), 1000);
+    for (unsigned long i = 0; i < 1000; ++i) {
+        ck_assert(cuckoo_add(cuckoo, i * 7919));
+    }
+    ck_assert_uint_eq(cuckoo_length(cuckoo), 1000);
+    size_t n_false_positives = 0;
+    for (unsigned long i = 0; i < 1000; ++i) {
+        ck_assert(cuckoo_maybe_contains(cuckoo, i * 7919));
+        n_false_positives += cuckoo_maybe_contains(cuckoo, i * 7919 + 1);
+    }
+    ck_assert_uint_lt(n_false_positives, 5);
+
+    for (unsigned long i = 0; i < 1000; i += 2) {
+        cuckoo_remove(cuckoo, i * 7919);
+    }
+    ck_assert_uint_eq(cuckoo_length(cuckoo), 500);
+    size_t n_left = 0;
+    for (unsigned long i = 0; i < 1000; ++i) {
+        if (i % 2 == 1) {
+            ck_assert(cuckoo_maybe_contains(cuckoo, i * 7919));
+        } else {
+            n_left += cuckoo_maybe_contains(cuckoo, i * 7919);
+        }
+    }
+    ck_assert_uint_lt(n_left, 5);
+
+    // Same item added twice stays until removed twice
+    cuckoo_add(cuckoo, 1);
+    cuckoo_add(cuckoo, 1);
+    cuckoo_remove(cuckoo, 1);
+    ck_assert(cuckoo_maybe_contains(cuckoo, 1));
+    cuckoo_remove(cuckoo, 1);
+    ck_assert(!cuckoo_maybe_contains(cuckoo, 1));
+    delete_cuckoo(cuckoo);
+
+    // Overfull filter reports failure
+    cuckoo = create_cuckoo(10);
+    bool added = true;
+    for (unsigned long i = 0; i < 1000 && added; ++i) {
+        added = cuckoo_add(cuckoo, i);
+    }
+    ck_assert(!added);
+    delete_cuckoo(cuckoo);
+}
+END_TEST
+
+
+START_TEST(test_cache_key_filter)
+{
+    cache_config_t config = cache_default_config(RNG_TEST_CACHE_SIZE);
+    lru_cache_t* plain = create_cache_with_config(&config);
+    config.key_filter = true;
+    lru_cache_t* filtered = create_cache_with_config(&config);
+    n_test_cache_call_func = 0;
+    for (size_t i = 0; i < RNG_TEST_CACHE_N_ITER / 10; ++i) {
+        char key[20];
+        sprintf(key, "key%d", rand() % RNG_TEST_CACHE_N_PAGES);
+        const page_t* page = cached_call(filtered, key, &test_cache_call_func);
+        ck_assert_str_eq(page->key, key);
+        cached_call(plain, key, &test_cache_call_func);
+        if (i == RNG_TEST_CACHE_N_ITER / 20) {
+            // Filter is rebuilt for larger capacity
+            cache_resize(plain, RNG_TEST_CACHE_SIZE * 4, 0);
+            cache_resize(filtered, RNG_TEST_CACHE_SIZE * 4, 0);
+        }
+    }
+    cache_stats_t stats = cache_stats(filtered);
+    ck_assert_uint_eq(stats.hits, cache_stats(plain).hits);
+    ck_assert_uint_eq(stats.evictions, cache_stats(plain).evictions);
+    ck_assert_uint_ge(stats.filtered_misses, stats.misses * 99 / 100);
+    ck_assert_uint_eq(cache_stats(plain).filtered_misses, 0);
+
+    cache_put(filtered, "new", create_page("new", "data"));
+    ck_assert(cache_contains(filtered, "new"));
+    cache_put(filtered, "new", NULL);
+    ck_assert(!cache_contains(filtered, "new"));
+    delete_cache(plain);
+    delete_cache(filtered);
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+static page_t* create_versioned_page(const char* key, unsigned long version) {
+    char data[40];
+    sprintf(data, "%s v%lu", key, version);
+    page_t* page = create_page(key, data);
+    page->version = version;
+    return page;
+}
+
+
+// Upstream of revalidation test, counts pages it had to send
+static unsigned long upstream_version = 1;
+static size_t n_transfers = 0;
+
+
+static bool revalidate_page(const char* key, unsigned long version, page_t** page) {
+    if (version == upstream_version) {
+        return false;
+    }
+    ++n_transfers;
+    *page = create_versioned_page(key, upstream_version);
+    return true;
+}
+
+
+START_TEST(test_cache_versions)
+{
+    lru_cache_t* cache = create_cache(4);
+    const page_t* page;
+    // Older load finishing last does not overwrite newer one
+    ck_assert(cache_put_if_version(cache, "a", create_versioned_page("a", 2)));
+    ck_assert(!cache_put_if_version(cache, "a", create_versioned_page("a", 1)));
+    ck_assert(!cache_put_if_version(cache, "a", create_versioned_page("a", 2)));
+    ck_assert(cache_lookup(cache, "a", &page));
+    ck_assert_str_eq(page->data, "a v2");
+    ck_assert(cache_put_if_version(cache, "a", create_versioned_page("a", 3)));
+    ck_assert(cache_lookup(cache, "a", &page));
+    ck_assert_uint_eq(page->version, 3);
+    ck_assert_uint_eq(cache_stats(cache).rejected_puts, 2);
+
+    ck_assert(!cache_cas(cache, "a", 2, create_versioned_page("a", 4)));
+    ck_assert(cache_cas(cache, "a", 3, create_versioned_page("a", 4)));
+    ck_assert(!cache_cas(cache, "b", 1, create_versioned_page("b", 1)));
+    ck_assert(cache_cas(cache, "b", 0, create_versioned_page("b", 1)));
+    ck_assert(!cache_cas(cache, "b", 0, create_versioned_page("b", 2)));
+    // NULL page removes key
+    ck_assert(cache_cas(cache, "b", 1, NULL));
+    ck_assert(!cache_contains(cache, "b"));
+    ck_assert_uint_eq(cache_stats(cache).rejected_puts, 5);
+    ck_assert(cache_put_if_version(cache, "a", NULL));
+    ck_assert(!cache_contains(cache, "a"));
+    ck_assert(cache_put_if_version(cache, "a", NULL));
+    ck_assert_uint_eq(cache_stats(cache).rejected_puts, 5);
+
+    upstream_version = 1;
+    n_transfers = 0;
+    page = cache_revalidate(cache, "c", &revalidate_page);
+    ck_assert_str_eq(page->data, "c v1");
+    page = cache_revalidate(cache, "c", &revalidate_page);
+    ck_assert_str_eq(page->data, "c v1");
+    ck_assert_uint_eq(n_transfers, 1);
+    ck_assert_uint_eq(cache_stats(cache).not_modified, 1);
+    upstream_version = 2;
+    page = cache_revalidate(cache, "c", &revalidate_page);
+    ck_assert_str_eq(page->data, "c v2");
+    ck_assert_uint_eq(n_transfers, 2);
+    // Totals over shards keep every counter
+    cache_stats_t total;
+    memset(&total, 0, sizeof(total));
+    cache_stats_t stats = cache_stats(cache);
+    cache_stats_add(&total, &stats);
+    cache_stats_add(&total, &stats);
+    ck_assert_uint_eq(total.not_modified, 2);
+    ck_assert_uint_eq(total.rejected_puts, 10);
+    ck_assert_uint_eq(total.hits, 2 * stats.hits);
+    delete_cache(cache);
+
+    // Versions survive compression
+    cache_config_t config = cache_default_config(4);
+    config.compress_threshold = 16;
+    config.hot_set_size = 1;
+    cache = create_cache_with_config(&config);
+    page_t* long_page = create_page("long", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    long_page->version = 7;
+    cache_put(cache, "long", long_page);
+    ck_assert_uint_eq(cache_stats(cache).n_compressed, 1);
+    cache_put(cache, "other", create_page("other", "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"));
+    ck_assert(cache_lookup(cache, "long", &page));
+    ck_assert_uint_eq(page->version, 7);
+    ck_assert(!cache_cas(cache, "long", 6, NULL));
+    delete_cache(cache);
+}
+END_TEST
+
+
+typedef struct slab_evictions_t {
+    slab_allocator_t* slabs;
+    size_t n_evicted;
+} slab_evictions_t;
+
+
+static void free_slab_chunk(void* chunk, void* arg) {
+    slab_evictions_t* evictions = arg;
+    ++evictions->n_evicted;
+    slab_free(evictions->slabs, chunk);
+}
+
+
+START_TEST(test_slab_allocator)
+{
+    // Four slabs of 64 KB
+    slab_allocator_t* slabs = create_slab_allocator(1 << 18, 60000);
+    slab_evictions_t evictions = {slabs, 0};
+    ck_assert_uint_gt(slab_max_alloc(slabs), 60000);
+    ck_assert_uint_lt(slab_max_alloc(slabs), 1 << 16);
+    ck_assert_ptr_null(slab_alloc(slabs, 1 << 16));
+    ck_assert_ptr_null(slab_victim(slabs, 100));
+
+    // Small chunks take all memory
+    size_t n_small = 0;
+    char* first = NULL;
+    char* last = NULL;
+    char* chunk;
+    while ((chunk = slab_alloc(slabs, 100)) != NULL) {
+        memset(chunk, 's', 100);
+        first = first != NULL ? first : chunk;
+        last = chunk;
+        ++n_small;
+    }
+    ck_assert_uint_gt(n_small, 4 * (1 << 16) / 160);
+    slab_stats_t stats = slab_stats(slabs);
+    ck_assert_uint_eq(stats.n_slabs, 4);
+    ck_assert_uint_eq(stats.n_slab_bytes, 1 << 18);
+    ck_assert_uint_eq(stats.n_used, n_small);
+    ck_assert_uint_ge(stats.n_chunk_bytes, n_small * 100);
+    ck_assert_ptr_null(slab_alloc(slabs, 1000));
+
+    // Victims come in LRU order of the class, freed chunk is reused by it
+    ck_assert_ptr_eq(slab_victim(slabs, 100), first);
+    slab_touch(slabs, first);
+    char* victim = slab_victim(slabs, 100);
+    ck_assert_ptr_ne(victim, first);
+    slab_free(slabs, victim);
+    ck_assert_ptr_eq(slab_alloc(slabs, 100), victim);
+    ck_assert_ptr_null(slab_alloc(slabs, 100));
+
+    // Class without chunks gets a slab from another one
+    ck_assert(slab_move_to(slabs, 10000, &free_slab_chunk, &evictions));
+    ck_assert_uint_gt(evictions.n_evicted, 0);
+    ck_assert_uint_eq(slab_stats(slabs).n_moves, 1);
+    ck_assert_uint_eq(slab_stats(slabs).n_used, n_small - evictions.n_evicted);
+    char* large[5];
+    for (size_t i = 0; i < 5; ++i) {
+        large[i] = slab_alloc(slabs, 10000);
+        ck_assert_ptr_nonnull(large[i]);
+        memset(large[i], 'l', 10000);
+    }
+    ck_assert_ptr_null(slab_alloc(slabs, 10000));
+    // Slab of the first chunk was taken, the rest are intact
+    ck_assert_int_eq(last[0], 's');
+    ck_assert_int_eq(last[99], 's');
+
+    // Rebalancing follows evictions: small class had them and large one did not
+    size_t n_evicted = evictions.n_evicted;
+    ck_assert(slab_rebalance(slabs, &free_slab_chunk, &evictions));
+    ck_assert_uint_eq(evictions.n_evicted, n_evicted + 5);
+    ck_assert_ptr_null(slab_victim(slabs, 10000));
+    ck_assert(!slab_rebalance(slabs, &free_slab_chunk, &evictions));
+    // Now large class is under pressure and takes memory of idle small class
+    ck_assert(slab_move_to(slabs, 10000, &free_slab_chunk, &evictions));
+    for (size_t i = 0; i < 5; ++i) {
+        ck_assert_ptr_nonnull(slab_alloc(slabs, 10000));
+    }
+    for (size_t i = 0; i < 5; ++i) {
+        slab_free(slabs, slab_victim(slabs, 10000));
+    }
+    ck_assert(slab_rebalance(slabs, &free_slab_chunk, &evictions));
+    for (size_t i = 0; i < 10; ++i) {
+        ck_assert_ptr_nonnull(slab_alloc(slabs, 10000));
+    }
+    ck_assert_ptr_null(slab_alloc(slabs, 10000));
+    ck_assert_uint_eq(slab_stats(slabs).n_moves, 4);
+
+    // Shrinking gives slabs back to system
+    slab_set_max_bytes(slabs, 1 << 17);
+    ck_assert(slab_over_budget(slabs));
+    slab_shrink(slabs, &free_slab_chunk, &evictions);
+    slab_shrink(slabs, &free_slab_chunk, &evictions);
+    ck_assert(!slab_over_budget(slabs));
+    stats = slab_stats(slabs);
+    ck_assert_uint_eq(stats.n_slab_bytes, 1 << 17);
+    ck_assert_uint_le(stats.n_chunk_bytes, stats.n_slab_bytes);
+    delete_slab_allocator(slabs);
+}
+END_TEST
+
+
+// Keys starting with 's' get 100 bytes, with 'l' 10 KB, with 'h' 100 KB
+static page_t* mixed_size_get_page(const char* key) {
+    size_t size = key[0] == 's' ? 100 : key[0] == 'l' ? 10000 : 100000;
+    char* data = malloc(size + 1);
+    memset(data, key[strlen(key) - 1], size);
+    data[size] = '\0';
+    page_t* page = create_page(key, data);
+    free(data);
+    ++n_test_cache_call_func;
+    return page;
+}
+
+
+static void check_mixed_page(const page_t* page, const char* key) {
+    size_t size = key[0] == 's' ? 100 : key[0] == 'l' ? 10000 : 100000;
+    ck_assert_str_eq(page->key, key);
+    ck_assert_uint_eq(page->size, size);
+    ck_assert_int_eq(page->data[0], key[strlen(key) - 1]);
+    ck_assert_int_eq(page->data[size - 1], key[strlen(key) - 1]);
+    ck_assert_int_eq(page->data[size], '\0');
+}
+
+
+static void* trace_thread(void* arg) {
+    (void) arg;
+    lru_cache_t* cache = create_cache(2);
+    cached_call(cache, "a", &test_cache_call_func);
+    delete_cache(cache);
+    return NULL;
+}
+
+
+static void collect_scanned(const char* key, const page_t* page, void* arg) {
+    size_t* seen = arg;
+    ck_assert_str_eq(key, page->key);
+    ++seen[atoi(key)];
+}
+
+
+START_TEST(test_cache_scan)
+{
+    lru_cache_t* cache = create_cache(100);
+    size_t seen[200] = {0};
+    ck_assert_uint_eq(cache_scan(cache, 0, 10, &collect_scanned, seen), 0);
+    char key[20];
+    for (size_t i = 0; i < 100; ++i) {
+        sprintf(key, "%zu", i);
+        cache_put(cache, key, create_page(key, "data"));
+    }
+    cache_stats_t stats = cache_stats(cache);
+    size_t cursor = 0;
+    do {
+        cursor = cache_scan(cache, cursor, 10, &collect_scanned, seen);
+    } while (cursor != 0);
+    for (size_t i = 0; i < 100; ++i) {
+        ck_assert_uint_eq(seen[i], 1);
+    }
+    // Walk changes neither recency nor stats
+    ck_assert_uint_eq(cache_stats(cache).hits, stats.hits);
+    cache_put(cache, "100", create_page("100", "data"));
+    ck_assert(!cache_contains(cache, "0"));
+
+    // Pages evicted meanwhile may be missed, the rest are seen
+    memset(seen, 0, sizeof(seen));
+    cursor = 0;
+    size_t next_key = 101;
+    do {
+        cursor = cache_scan(cache, cursor, 10, &collect_scanned, seen);
+        const page_t* page;
+        for (size_t i = 50; i < 100; ++i) {
+            sprintf(key, "%zu", i);
+            cache_lookup(cache, key, &page);
+        }
+        sprintf(key, "%zu", next_key++);
+        cache_put(cache, key, create_page(key, "data"));
+    } while (cursor != 0);
+    for (size_t i = 50; i < 100; ++i) {
+        ck_assert_uint_ge(seen[i], 1);
+    }
+    delete_cache(cache);
+}
+END_TEST
+
+
+START_TEST(test_trace)
+{
+    ck_assert_str_eq(trace_phase_name(TRACE_REHASH), "rehash");
+    trace_reset();
+    lru_cache_t* cache = create_cache(2);
+    const char* keys[] = {"a", "b", "a", "c"};  // hit on a, c evicts b
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        cached_call(cache, keys[i], &test_cache_call_func);
+    }
+    delete_cache(cache);
+    pthread_t thread;
+    pthread_create(&thread, NULL, &trace_thread, NULL);
+    pthread_join(thread, NULL);
+    n_test_cache_call_func = 0;
+
+    trace_phase_stats_t stats[TRACE_N_PHASES];
+    trace_snapshot(stats);
+    if (!trace_enabled()) {
+        for (size_t phase = 0; phase < TRACE_N_PHASES; ++phase) {
+            ck_assert_uint_eq(stats[phase].count, 0);
+        }
+        return;
+    }
+    // Counts of exited thread are kept
+    ck_assert_uint_eq(stats[TRACE_CALL].count, 5);
+    ck_assert_uint_eq(stats[TRACE_LOADER].count, 4);
+    ck_assert_uint_eq(stats[TRACE_SPLICE].count, 1);
+    ck_assert_uint_eq(stats[TRACE_EVICT].count, 1);
+    ck_assert_uint_eq(stats[TRACE_TABLE_PUT].count, 4);
+    ck_assert_uint_eq(stats[TRACE_TABLE_DELETE].count, 1);
+    ck_assert_uint_ge(stats[TRACE_DELETE_PAGE].count, 1);
+    ck_assert_uint_ge(stats[TRACE_HASH].count, stats[TRACE_CALL].count);
+    ck_assert(stats[TRACE_CALL].total_ns > 0.0);
+    ck_assert(stats[TRACE_CALL].p50_ns <= stats[TRACE_CALL].p99_ns);
+    ck_assert(stats[TRACE_CALL].max_ns <= stats[TRACE_CALL].total_ns);
+
+    trace_reset();
+    trace_snapshot(stats);
+    ck_assert_uint_eq(stats[TRACE_CALL].count, 0);
+}
+END_TEST
+
+
+START_TEST(test_cache_slabs)
+{
+    cache_config_t config = cache_default_config(100000);
+    config.slab_size = 1 << 16;
+    ck_assert_ptr_null(create_cache_with_config(&config));
+    config.max_bytes = 1 << 18;
+    evict_log_t log = {0, 0, NULL};
+    config.on_evict = &log_eviction;
+    config.on_evict_arg = &log;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    n_test_cache_call_func = 0;
+    char key[32];
+
+    // Small pages fill all slabs, then the oldest of them are evicted
+    for (size_t i = 0; i < 3000; ++i) {
+        sprintf(key, "s%zu", i);
+        check_mixed_page(cached_call(cache, key, &mixed_size_get_page), key);
+    }
+    cache_stats_t stats = cache_stats(cache);
+    ck_assert_uint_eq(stats.n_slab_bytes, 1 << 18);
+    ck_assert_uint_gt(stats.evictions, 0);
+    ck_assert_uint_eq(log.n_evicted, stats.evictions);
+    ck_assert_uint_eq(cache_length(cache) + stats.evictions, 3000);
+    ck_assert(cache_contains(cache, "s2999"));
+    ck_assert(!cache_contains(cache, "s0"));
+
+    // Large pages get memory of small ones, a slab holds five of them
+    for (size_t i = 0; i < 5; ++i) {
+        sprintf(key, "l%zu", i);
+        check_mixed_page(cached_call(cache, key, &mixed_size_get_page), key);
+    }
+    n_test_cache_call_func = 0;
+    for (size_t i = 0; i < 5; ++i) {
+        sprintf(key, "l%zu", i);
+        check_mixed_page(cached_call(cache, key, &mixed_size_get_page), key);
+    }
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+    stats = cache_stats(cache);
+    ck_assert_uint_gt(stats.slab_moves, 0);
+    ck_assert_uint_eq(stats.n_slab_bytes, 1 << 18);
+    ck_assert_uint_le(stats.n_bytes, stats.n_chunk_bytes);
+    ck_assert_uint_le(stats.n_chunk_bytes, stats.n_slab_bytes);
+
+    // Page larger than slab is returned but not cached
+    const page_t* page = cached_call(cache, "h0", &mixed_size_get_page);
+    check_mixed_page(page, "h0");
+    ck_assert(!cache_contains(cache, "h0"));
+    ck_assert_uint_eq(cache_stats(cache).too_large, 1);
+
+    // Shrinking releases slabs, remaining pages stay intact
+    while (!cache_resize(cache, 100000, 1 << 17)) {
+    }
+    stats = cache_stats(cache);
+    ck_assert_uint_eq(stats.n_slab_bytes, 1 << 17);
+    ck_assert_uint_le(stats.n_chunk_bytes, 1 << 17);
+    for (size_t i = 0; i < 3000; ++i) {
+        sprintf(key, "s%zu", i);
+        if (cache_lookup(cache, key, &page)) {
+            check_mixed_page(page, key);
+        }
+    }
+    delete_cache(cache);
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+typedef struct version_worker_t {
+    shared_cache_t* shared;
+    size_t id;
+} version_worker_t;
+
+
+// Each worker refreshes every key with its own share of versions in random order
+static void* version_worker(void* arg) {
+    version_worker_t* worker = arg;
+    unsigned seed = worker->id + 1;
+    char key[32];
+    for (size_t i = 0; i < FRONT_TEST_N_ITER; ++i) {
+        seed = seed * 1103515245 + 12345;
+        sprintf(key, "%zu", i % FRONT_TEST_N_KEYS);
+        unsigned long version = ((seed >> 8) % 1000) * CHASH_TEST_N_THREADS + worker->id + 1;
+        shared_cache_put_if_version(worker->shared, key, create_versioned_page(key, version));
+    }
+    return NULL;
+}
+
+
+START_TEST(test_shared_cache_versions)
+{
+    cache_config_t config = cache_default_config(FRONT_TEST_N_KEYS);
+    shared_cache_t* shared = create_shared_cache(&config);
+    pthread_t threads[CHASH_TEST_N_THREADS];
+    version_worker_t workers[CHASH_TEST_N_THREADS];
+    for (size_t i = 0; i < CHASH_TEST_N_THREADS; ++i) {
+        workers[i].shared = shared;
+        workers[i].id = i;
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, &version_worker, &workers[i]), 0);
+    }
+    for (size_t i = 0; i < CHASH_TEST_N_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    // Every key ends with the highest version any worker produced for it
+    unsigned long max_versions[FRONT_TEST_N_KEYS] = {0};
+    for (size_t id = 0; id < CHASH_TEST_N_THREADS; ++id) {
+        unsigned seed = id + 1;
+        for (size_t i = 0; i < FRONT_TEST_N_ITER; ++i) {
+            seed = seed * 1103515245 + 12345;
+            unsigned long version = ((seed >> 8) % 1000) * CHASH_TEST_N_THREADS + id + 1;
+            size_t key = i % FRONT_TEST_N_KEYS;
+            max_versions[key] = version > max_versions[key] ? version : max_versions[key];
+        }
+    }
+    ebr_enter(shared_cache_ebr(shared));
+    n_test_cache_call_func = 0;
+    for (size_t i = 0; i < FRONT_TEST_N_KEYS; ++i) {
+        char key[32];
+        sprintf(key, "%zu", i);
+        const page_t* page = shared_cached_call(shared, key, &test_cache_call_func);
+        ck_assert_uint_eq(page->version, max_versions[i]);
+    }
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+    ebr_exit(shared_cache_ebr(shared));
+    delete_shared_cache(shared);
+}
+END_TEST
+
+
+static page_t* large_get_page(const char* key) {
+    char data[300];
+    memset(data, 'x', sizeof(data) - 1);
+    data[sizeof(data) - 1] = '\0';
+    return create_page(key, data);
+}
+
+
+START_TEST(test_shm_cache)
+{
+    // Unnamed segment shared with forked worker
+    shm_config_t config = shm_default_config(NULL, 4);
+    config.arena_bytes = 256;
+    shm_cache_t* cache = create_shm_cache(&config);
+    ck_assert_ptr_nonnull(cache);
+    n_test_cache_call_func = 0;
+    pid_t pid = fork();
+    if (pid == 0) {
+        shm_cached_call(cache, "a", &test_cache_call_func);
+        shm_cached_call(cache, "b", &test_cache_call_func);
+        _exit(EXIT_SUCCESS);
+    }
+    ck_assert_int_eq(waitpid(pid, NULL, 0), pid);
+    const page_t* page = shm_cached_call(cache, "a", &test_cache_call_func);
+    ck_assert_str_eq(page->key, "a");
+    ck_assert_str_eq(page->data, "page_a");
+    ck_assert_uint_eq(n_test_cache_call_func, 0);
+    shm_stats_t stats = shm_cache_stats(cache);
+    ck_assert_uint_eq(stats.hits, 1);
+    ck_assert_uint_eq(stats.misses, 2);
+
+    // Attach by descriptor
+    config.fd = shm_cache_fd(cache);
+    shm_cache_t* other = create_shm_cache(&config);
+    ck_assert_ptr_nonnull(other);
+    shm_cached_call(other, "c", &test_cache_call_func);
+    shm_cached_call(other, "d", &test_cache_call_func);
+    shm_cached_call(other, "e", &test_cache_call_func);
+    ck_assert_uint_eq(shm_cache_length(cache), 4);
+    ck_assert_uint_eq(shm_cache_stats(cache).evictions, 1);
+    // "b" was least recently used
+    shm_cached_call(cache, "b", &test_cache_call_func);
+    ck_assert_uint_eq(n_test_cache_call_func, 4);
+    delete_shm_cache(other);
+
+    // Page larger than arena is returned, not cached
+    page = shm_cached_call(cache, "large", &large_get_page);
+    ck_assert_uint_eq(page->size, 299);
+    ck_assert_uint_eq(shm_cache_length(cache), 4);
+    page = shm_cached_call(cache, "a", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_a");
+    delete_shm_cache(cache);
+    n_test_cache_call_func = 0;
+
+    // Named segment outlives handles, sizes come from the segment
+    char name[64];
+    sprintf(name, "/lru_cache_test_%ld", (long) getpid());
+    config = shm_default_config(name, 8);
+    cache = create_shm_cache(&config);
+    ck_assert_ptr_nonnull(cache);
+    shm_cached_call(cache, "a", &test_cache_call_func);
+    delete_shm_cache(cache);
+    config.max_size = 2;
+    cache = create_shm_cache(&config);
+    ck_assert_ptr_nonnull(cache);
+    page = shm_cached_call(cache, "a", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_a");
+    ck_assert_uint_eq(n_test_cache_call_func, 1);
+    scan_shm_cache(cache, 10);
+    ck_assert_uint_eq(shm_cache_length(cache), 8);
+    delete_shm_cache(cache);
+    ck_assert(shm_cache_unlink(name));
+    ck_assert(!shm_cache_unlink(name));
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+static page_t* medium_get_page(const char* key) {
+    return create_page(key, "medium page data, needs a 64 byte block");
+}
+
+
+static page_t* binary_get_page(const char* key) {
+    page_t* page = create_page_sized(key, "ab\0cd", 5);
+    page->version = 7;
+    page->user_flags = 3;
+    return page;
+}
+
+
+START_TEST(test_shm_cache_binary)
+{
+    shm_config_t config = shm_default_config(NULL, 4);
+    shm_cache_t* cache = create_shm_cache(&config);
+    shm_cached_call(cache, "bin", &binary_get_page);
+    // Hit is a copy from the segment, with its length and metadata
+    const page_t* page = shm_cached_call(cache, "bin", &binary_get_page);
+    ck_assert_uint_eq(shm_cache_stats(cache).hits, 1);
+    ck_assert_uint_eq(page->size, 5);
+    ck_assert_int_eq(memcmp(page->data, "ab\0cd", 5), 0);
+    ck_assert_uint_eq(page->version, 7);
+    ck_assert_uint_eq(page->user_flags, 3);
+    delete_shm_cache(cache);
+}
+END_TEST
+
+
+START_TEST(test_shm_cache_mixed_sizes)
+{
+    // Arena full of 32-byte blocks
+    shm_config_t config = shm_default_config(NULL, 128);
+    config.arena_bytes = 4096;
+    shm_cache_t* cache = create_shm_cache(&config);
+    n_test_cache_call_func = 0;
+    char key[20];
+    for (size_t i = 0; i < 128; ++i) {
+        sprintf(key, "k%03zu", i);
+        shm_cached_call(cache, key, &test_cache_call_func);
+    }
+    ck_assert_uint_eq(shm_cache_stats(cache).n_bytes, 4096);
+
+    // Two oldest blocks are buddies and merge, the rest of cache stays
+    shm_cached_call(cache, "m", &medium_get_page);
+    ck_assert_uint_eq(shm_cache_stats(cache).evictions, 2);
+    ck_assert_uint_eq(shm_cache_length(cache), 127);
+    const page_t* page = shm_cached_call(cache, "k127", &test_cache_call_func);
+    ck_assert_str_eq(page->data, "page_k127");
+    ck_assert_uint_eq(n_test_cache_call_func, 128);
+
+    // Page of the whole arena evicts everything, free blocks merge back into one
+    config.arena_bytes = 512;
+    shm_cache_t* small = create_shm_cache(&config);
+    shm_cached_call(small, "a", &test_cache_call_func);
+    shm_cached_call(small, "b", &test_cache_call_func);
+    shm_cached_call(small, "large", &large_get_page);
+    ck_assert_uint_eq(shm_cache_length(small), 1);
+    ck_assert_uint_eq(shm_cache_stats(small).n_bytes, 512);
+    page = shm_cached_call(small, "large", &large_get_page);
+    ck_assert_uint_eq(page->size, 299);
+    ck_assert_uint_eq(shm_cache_stats(small).hits, 1);
+    delete_shm_cache(small);
+    delete_shm_cache(cache);
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+START_TEST(test_shm_cache_worker_crash)
+{
+    shm_config_t config = shm_default_config(NULL, 16);
+    config.arena_bytes = 1024;
+    shm_cache_t* cache = create_shm_cache(&config);
+    for (size_t round = 0; round < 3; ++round) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            for (unsigned seed = 1;; seed = seed * 1103515245 + 12345) {
+                char key[32];
+                sprintf(key, "%u", (seed >> 8) % 64);
+                shm_cached_call(cache, key, &test_cache_call_func);
+            }
+        }
+        struct timespec delay = {.tv_sec = 0, .tv_nsec = 20000000};
+        nanosleep(&delay, NULL);
+        kill(pid, SIGKILL);
+        ck_assert_int_eq(waitpid(pid, NULL, 0), pid);
+        // Killed worker may have held the lock, cache stays usable either way
+        for (size_t i = 0; i < 64; ++i) {
+            char key[32];
+            char data[40];
+            sprintf(key, "%zu", i);
+            sprintf(data, "page_%s", key);
+            const page_t* page = shm_cached_call(cache, key, &test_cache_call_func);
+            ck_assert_str_eq(page->data, data);
+        }
+        ck_assert_uint_le(shm_cache_length(cache), 16);
+    }
+    delete_shm_cache(cache);
+    n_test_cache_call_func = 0;
+}
+END_TEST
+
+
+START_TEST(test_mc_parse)
+{
+    mc_request_t request;
+    char get[] = "get a bb ccc\r\nversion\r\n";
+    ck_assert_int_eq(mc_parse_request(get, strlen(get), &request), MC_PARSE_OK);
+    ck_assert_int_eq(request.command, MC_GET);
+    ck_assert_uint_eq(request.n_keys, 3);
+    ck_assert_str_eq(request.keys[0], "a");
+    ck_assert_str_eq(request.keys[2], "ccc");
+    ck_assert_uint_eq(request.length, 14);
+    // Pipelined request follows
+    ck_assert_int_eq(mc_parse_request(get + 14, strlen(get) - 14, &request), MC_PARSE_OK);
+    ck_assert_int_eq(request.command, MC_VERSION);
+
+    // Data block may hold anything, including CRLF and NUL
+    char set[] = "set key 42 0 5\r\na\r\n\0b\r\n";
+    size_t set_len = sizeof(set) - 1;
+    for (size_t len = 0; len < set_len; ++len) {
+        char copy[sizeof(set)];
+        memcpy(copy, set, sizeof(set));
+        ck_assert_int_eq(mc_parse_request(copy, len, &request), MC_PARSE_INCOMPLETE);
+        ck_assert_mem_eq(copy, set, sizeof(set));
+    }
+    ck_assert_int_eq(mc_parse_request(set, set_len, &request), MC_PARSE_OK);
+    ck_assert_int_eq(request.command, MC_SET);
+    ck_assert_str_eq(request.keys[0], "key");
+    ck_assert_uint_eq(request.flags, 42);
+    ck_assert_uint_eq(request.n_bytes, 5);
+    ck_assert_mem_eq(request.data, "a\r\n\0b", 5);
+    ck_assert(!request.noreply);
+    ck_assert_uint_eq(request.length, set_len);
+
+    char cas[] = "cas key 0 -1 1 77 noreply\r\nx\r\n";
+    ck_assert_int_eq(mc_parse_request(cas, strlen(cas), &request), MC_PARSE_OK);
+    ck_assert_int_eq(request.command, MC_CAS);
+    ck_assert_uint_eq(request.cas, 77);
+    ck_assert(request.noreply);
+
+    char delete[] = "delete key noreply\n";
+    ck_assert_int_eq(mc_parse_request(delete, strlen(delete), &request), MC_PARSE_OK);
+    ck_assert_int_eq(request.command, MC_DELETE);
+    ck_assert_str_eq(request.keys[0], "key");
+    ck_assert(request.noreply);
+
+    // Errors are answered and skipped, connection goes on
+    char unknown[] = "stats\r\n";
+    ck_assert_int_eq(mc_parse_request(unknown, strlen(unknown), &request), MC_PARSE_ERROR);
+    ck_assert_str_eq(request.error, "ERROR\r\n");
+    ck_assert_uint_eq(request.length, strlen(unknown));
+    char chunk[] = "set key 0 0 2\r\nabc\r\n";
+    ck_assert_int_eq(mc_parse_request(chunk, strlen(chunk), &request), MC_PARSE_ERROR);
+    ck_assert_uint_eq(request.length, 19);
+    char format[] = "set key x 0 2\r\nab\r\n";
+    ck_assert_int_eq(mc_parse_request(format, strlen(format), &request), MC_PARSE_ERROR);
+    ck_assert_uint_eq(request.length, 15);
+    char long_key[MC_MAX_KEY_LEN + 16] = "get ";
+    memset(long_key + 4, 'k', MC_MAX_KEY_LEN + 1);
+    strcpy(long_key + 4 + MC_MAX_KEY_LEN + 1, "\r\n");
+    ck_assert_int_eq(mc_parse_request(long_key, strlen(long_key), &request), MC_PARSE_ERROR);
+    ck_assert_uint_eq(request.length, strlen(long_key));
+
+    // Value over limit ends connection
+    char large[] = "set key 0 0 99999999\r\n";
+    ck_assert_int_eq(mc_parse_request(large, strlen(large), &request), MC_PARSE_ERROR);
+    ck_assert_uint_eq(request.length, 0);
+}
+END_TEST
+
+
+static int connect_server(const struct sockaddr* addr, socklen_t addr_len) {
+    int fd = socket(addr->sa_family, SOCK_STREAM, 0);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(connect(fd, addr, addr_len), 0);
+    return fd;
+}
+
+
+// Sends request and checks response is exactly expected
+static void mc_exchange(int fd, const char* request, size_t request_len, const char* expected, size_t expected_len) {
+    ck_assert_int_eq(send(fd, request, request_len, MSG_NOSIGNAL), (ssize_t) request_len);
+    char response[4096];
+    size_t len = 0;
+    while (len < expected_len) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        ck_assert_int_eq(poll(&pfd, 1, 5000), 1);
+        ssize_t n_read = recv(fd, response + len, sizeof(response) - len, 0);
+        ck_assert_int_gt(n_read, 0);
+        len += n_read;
+    }
+    ck_assert_uint_eq(len, expected_len);
+    ck_assert_mem_eq(response, expected, expected_len);
+}
+
+
+static void mc_check(int fd, const char* request, const char* expected) {
+    mc_exchange(fd, request, strlen(request), expected, strlen(expected));
+}
+
+
+START_TEST(test_cache_server)
+{
+    char dir[] = "/tmp/lru_cache_test_XXXXXX";
+    ck_assert_ptr_nonnull(mkdtemp(dir));
+    char path[64];
+    sprintf(path, "%s/mc.sock", dir);
+    server_config_t config = server_default_config(64);
+    config.port = 0;
+    config.unix_path = path;
+    config.n_threads = 2;
+    cache_server_t* server = create_cache_server(&config);
+    ck_assert_ptr_nonnull(server);
+    ck_assert_int_gt(cache_server_port(server), 0);
+
+    struct sockaddr_in tcp_addr = {.sin_family = AF_INET, .sin_port = htons(cache_server_port(server))};
+    inet_pton(AF_INET, "127.0.0.1", &tcp_addr.sin_addr);
+    int tcp = connect_server((struct sockaddr*) &tcp_addr, sizeof(tcp_addr));
+    struct sockaddr_un unix_addr = {.sun_family = AF_UNIX};
+    strcpy(unix_addr.sun_path, path);
+    int local = connect_server((struct sockaddr*) &unix_addr, sizeof(unix_addr));
+
+    mc_check(tcp, "version\r\n", "VERSION lru_cache 1.0\r\n");
+    mc_check(tcp, "get a\r\n", "END\r\n");
+    mc_check(tcp, "set a 7 0 3\r\nabc\r\n", "STORED\r\n");
+    mc_check(local, "get a b\r\n", "VALUE a 7 3\r\nabc\r\nEND\r\n");
+    // Values are binary safe
+    mc_exchange(local, "set b 0 0 3\r\nx\0y\r\n", 18, "STORED\r\n", 8);
+    mc_exchange(tcp, "get b a\r\n", 9, "VALUE b 0 3\r\nx\0y\r\nVALUE a 7 3\r\nabc\r\nEND\r\n", 41);
+
+    mc_check(tcp, "add a 0 0 1\r\nz\r\n", "NOT_STORED\r\n");
+    mc_check(tcp, "replace c 0 0 1\r\nz\r\n", "NOT_STORED\r\n");
+    mc_check(tcp, "add c 0 0 1\r\nz\r\n", "STORED\r\n");
+    mc_check(tcp, "replace c 0 0 1\r\ny\r\n", "STORED\r\n");
+
+    // Cas succeeds only with unique of current value
+    ck_assert_int_eq(send(tcp, "gets c\r\n", 8, 0), 8);
+    char response[256];
+    unsigned long unique;
+    size_t len = 0;
+    while (len < 5 || memcmp(response + len - 5, "END\r\n", 5)) {
+        ssize_t n_read = recv(tcp, response + len, sizeof(response) - 1 - len, 0);
+        ck_assert_int_gt(n_read, 0);
+        len += n_read;
+    }
+    response[len] = '\0';
+    ck_assert_int_eq(sscanf(response, "VALUE c 0 1 %lu\r\ny\r\nEND\r\n", &unique), 1);
+    char cas[64];
+    sprintf(cas, "cas c 0 0 1 %lu\r\nw\r\n", unique + 1);
+    mc_check(local, cas, "EXISTS\r\n");
+    sprintf(cas, "cas c 0 0 1 %lu\r\nw\r\n", unique);
+    mc_check(local, cas, "STORED\r\n");
+    mc_check(local, cas, "EXISTS\r\n");
+    mc_check(local, "cas d 0 0 1 1\r\nw\r\n", "NOT_FOUND\r\n");
+
+    mc_check(tcp, "delete c\r\n", "DELETED\r\n");
+    mc_check(tcp, "delete c\r\n", "NOT_FOUND\r\n");
+    mc_check(tcp, "delete a noreply\r\nget a c\r\n", "END\r\n");
+
+    // Pipelined requests, errors do not end connection. As in memcached, bad chunk
+    // skips declared length only and the rest of it is taken for another command.
+    mc_check(local, "set p 1 0 1 noreply\r\nq\r\nstats\r\nset p 0 0 1\r\nqq\r\nget p\r\n",
+             "ERROR\r\nCLIENT_ERROR bad data chunk\r\nERROR\r\nVALUE p 1 1\r\nq\r\nEND\r\n");
+    // Request split over several sends
+    ck_assert_int_eq(send(tcp, "set s 0 0 4\r\nab", 15, 0), 15);
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 10000000};
+    nanosleep(&delay, NULL);
+    mc_check(tcp, "cd\r\n", "STORED\r\n");
+    mc_check(local, "get s\r\n", "VALUE s 0 4\r\nabcd\r\nEND\r\n");
+
+    // Many small pages overflow capacity
+    for (size_t i = 0; i < 200; ++i) {
+        char set[64];
+        sprintf(set, "set k%zu 0 0 1 noreply\r\nv\r\n", i);
+        ck_assert_int_eq(send(tcp, set, strlen(set), 0), (ssize_t) strlen(set));
+    }
+    mc_check(tcp, "version\r\n", "VERSION lru_cache 1.0\r\n");
+    cache_stats_t stats = cache_server_stats(server);
+    ck_assert_uint_gt(stats.evictions, 0);
+
+    mc_check(local, "quit\r\n", "");
+    char byte;
+    ck_assert_int_eq(recv(local, &byte, 1, 0), 0);
+    close(local);
+    close(tcp);
+    delete_cache_server(server);
+    ck_assert_int_ne(access(path, F_OK), 0);
+    rmdir(dir);
+}
+END_TEST
+
+
+START_TEST(test_hot_keys)
+{
+    // Hot from 50 requests in window of 1000
+    hot_key_sketch_t* sketch = create_hot_key_sketch(1000, 1000, 0.05);
+    unsigned long hot = key_hash("hot");
+    size_t n_hot = 0;
+    for (size_t i = 0; i < 900; ++i) {
+        if (i % 9 == 0) {
+            bool is_hot = hot_key_sketch_add(sketch, hot);
+            ck_assert(is_hot == (++n_hot >= 50));
+        } else {
+            char key[32];
+            sprintf(key, "cold%zu", i);
+            ck_assert(!hot_key_sketch_add(sketch, key_hash(key)));
+        }
+    }
+    // Count-min never underestimates
+    ck_assert_uint_ge(hot_key_sketch_estimate(sketch, hot), n_hot);
+    ck_assert_uint_lt(hot_key_sketch_estimate(sketch, hot), n_hot + 10);
+    // Halving every window lets key cool down
+    for (size_t i = 0; i < 3000; ++i) {
+        hot_key_sketch_add(sketch, i);
+    }
+    ck_assert(hot_key_sketch_estimate(sketch, hot) < 50);
+    delete_hot_key_sketch(sketch);
+
+    ebr_t* ebr = create_ebr();
+    replica_table_t* replicas = create_replica_table(4, ebr);
+    ebr_enter(ebr);
+    page_t* page = create_page("hot", "value");
+    page->user_flags = 3;
+    page->version = 7;
+    ck_assert_ptr_null(replica_get(replicas, hot, "hot"));
+    replica_publish(replicas, hot, page);
+    const page_t* copy = replica_get(replicas, hot, "hot");
+    ck_assert_ptr_nonnull(copy);
+    ck_assert_ptr_ne(copy, page);
+    ck_assert_str_eq(copy->data, "value");
+    ck_assert_uint_eq(copy->user_flags, 3);
+    ck_assert_uint_eq(copy->version, 7);
+    delete_page(page);
+    // Slot is found by hash, key must match too
+    ck_assert_ptr_null(replica_get(replicas, hot, "other"));
+    replica_invalidate(replicas, hot, "other");
+    ck_assert_uint_eq(replica_count(replicas), 1);
+    replica_invalidate(replicas, hot, "hot");
+    ck_assert_ptr_null(replica_get(replicas, hot, "hot"));
+    ck_assert_uint_eq(replica_count(replicas), 0);
+    page = create_page("warm", "");
+    replica_publish(replicas, key_hash("warm"), page);
+    delete_page(page);
+    ebr_exit(ebr);
+    delete_replica_table(replicas);
+    delete_ebr(ebr);
+}
+END_TEST
+
+
+START_TEST(test_cache_server_hot_keys)
+{
+    char dir[] = "/tmp/lru_cache_test_XXXXXX";
+    ck_assert_ptr_nonnull(mkdtemp(dir));
+    char path[64];
+    sprintf(path, "%s/mc.sock", dir);
+    // Single shard of 8 pages
+    server_config_t config = server_default_config(8);
+    config.host = NULL;
+    config.unix_path = path;
+    config.n_threads = 1;
+    config.n_shards = 1;
+    cache_server_t* server = create_cache_server(&config);
+    ck_assert_ptr_nonnull(server);
+    struct sockaddr_un unix_addr = {.sun_family = AF_UNIX};
+    strcpy(unix_addr.sun_path, path);
+    int fd = connect_server((struct sockaddr*) &unix_addr, sizeof(unix_addr));
+
+    mc_check(fd, "set hot 0 0 1\r\na\r\n", "STORED\r\n");
+    for (size_t i = 0; i < 1000; ++i) {
+        mc_check(fd, "get hot\r\n", "VALUE hot 0 1\r\na\r\nEND\r\n");
+    }
+    size_t replica_hits = cache_server_replica_hits(server);
+    ck_assert_uint_gt(replica_hits, 500);
+    ck_assert_uint_eq(cache_server_stats(server).hits + replica_hits, 1000);
+    // Some gets still go to the original, so it stays while other pages are evicted
+    for (size_t i = 0; i < 16; ++i) {
+        char set[64];
+        sprintf(set, "set o%zu 0 0 1\r\nv\r\n", i);
+        mc_check(fd, set, "STORED\r\n");
+        for (size_t j = 0; j < 64; ++j) {
+            mc_check(fd, "get hot\r\n", "VALUE hot 0 1\r\na\r\nEND\r\n");
+        }
+    }
+    replica_hits = cache_server_replica_hits(server);
+
+    // Copy goes away when original is replaced, deleted or evicted
+    mc_check(fd, "set hot 0 0 1\r\nb\r\n", "STORED\r\n");
+    for (size_t i = 0; i < 200; ++i) {
+        mc_check(fd, "get hot\r\n", "VALUE hot 0 1\r\nb\r\nEND\r\n");
+    }
+    ck_assert_uint_gt(cache_server_replica_hits(server), replica_hits);
+    mc_check(fd, "delete hot\r\n", "DELETED\r\n");
+    mc_check(fd, "get hot\r\n", "END\r\n");
+    mc_check(fd, "set hot 0 0 1\r\nc\r\n", "STORED\r\n");
+    for (size_t i = 0; i < 200; ++i) {
+        mc_check(fd, "get hot\r\n", "VALUE hot 0 1\r\nc\r\nEND\r\n");
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        char set[64];
+        sprintf(set, "set k%zu 0 0 1\r\nv\r\n", i);
+        mc_check(fd, set, "STORED\r\n");
+    }
+    mc_check(fd, "get hot\r\n", "END\r\n");
+
+    close(fd);
+    delete_cache_server(server);
+
+    // Without replication every get takes shard lock
+    config.n_replicas = 0;
+    server = create_cache_server(&config);
+    ck_assert_ptr_nonnull(server);
+    fd = connect_server((struct sockaddr*) &unix_addr, sizeof(unix_addr));
+    mc_check(fd, "set hot 0 0 1\r\na\r\n", "STORED\r\n");
+    for (size_t i = 0; i < 1000; ++i) {
+        mc_check(fd, "get hot\r\n", "VALUE hot 0 1\r\na\r\nEND\r\n");
+    }
+    ck_assert_uint_eq(cache_server_replica_hits(server), 0);
+    ck_assert_uint_eq(cache_server_stats(server).hits, 1000);
+    close(fd);
+    delete_cache_server(server);
+    rmdir(dir);
+}
+END_TEST
+
+
+START_TEST(test_workload)
+{
+    const workload_kind_t kinds[] = {WORKLOAD_UNIFORM, WORKLOAD_ZIPF, WORKLOAD_SCRAMBLED_ZIPF,
+                                     WORKLOAD_HOTSPOT, WORKLOAD_SCAN, WORKLOAD_LATEST};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); ++k) {
+        // Same seed gives same sequence, other seed another one
+        workload_config_t config = workload_default_config(kinds[k], 1000, 42);
+        workload_t* first = create_workload(&config);
+        workload_t* second = create_workload(&config);
+        config.seed = 43;
+        workload_t* other = create_workload(&config);
+        size_t n_diff = 0;
+        for (size_t i = 0; i < 1000; ++i) {
+            size_t key = workload_next(first);
+            ck_assert_uint_lt(key, 1000);
+            ck_assert_uint_eq(workload_next(second), key);
+            n_diff += workload_next(other) != key;
+        }
+        ck_assert(kinds[k] == WORKLOAD_SCAN ? n_diff == 0 : n_diff > 0);
+        delete_workload(first);
+        delete_workload(second);
+        delete_workload(other);
+    }
+
+    {
+        rng_t rng;
+        rng_seed(&rng, 0);
+        ck_assert_uint_ne(rng_next(&rng), 0);
+        for (size_t i = 0; i < 1000; ++i) {
+            double u = rng_uniform(&rng);
+            ck_assert(u >= 0.0 && u < 1.0);
+            ck_assert_uint_lt(rng_below(&rng, 7), 7);
+        }
+    }
+
+    {
+        // Sampled frequencies follow rank probabilities
+        workload_config_t config = workload_default_config(WORKLOAD_ZIPF, 100000, 1);
+        workload_t* workload = create_workload(&config);
+        size_t counts[4] = {0};
+        for (size_t i = 0; i < WORKLOAD_TEST_N_ITER; ++i) {
+            size_t key = workload_next(workload);
+            if (key < 4) {
+                ++counts[key];
+            }
+        }
+        double sum = 0.0;
+        for (size_t i = 0; i < 100000; ++i) {
+            sum += workload_rank_probability(workload, i);
+        }
+        ck_assert_float_eq_tol(sum, 1.0, 1e-9);
+        for (size_t i = 0; i < 4; ++i) {
+            ck_assert_float_eq_tol((double) counts[i] / WORKLOAD_TEST_N_ITER,
+                                   workload_rank_probability(workload, i), 0.005);
+        }
+        delete_workload(workload);
+    }
+
+    {
+        workload_config_t config = workload_default_config(WORKLOAD_HOTSPOT, 1000, 1);
+        workload_t* workload = create_workload(&config);
+        size_t n_hot = 0;
+        for (size_t i = 0; i < WORKLOAD_TEST_N_ITER; ++i) {
+            n_hot += workload_next(workload) < 200;
+        }
+        ck_assert_float_eq_tol((double) n_hot / WORKLOAD_TEST_N_ITER, 0.8, 0.005);
+        delete_workload(workload);
+    }
+
+    {
+        workload_config_t config = workload_default_config(WORKLOAD_SCAN, 3, 1);
+        workload_t* workload = create_workload(&config);
+        const size_t expected[] = {0, 1, 2, 0, 1, 2, 3, 0};
+        for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+            if (i == 6) {
+                ck_assert_uint_eq(workload_insert(workload), 3);
+            }
+            ck_assert_uint_eq(workload_next(workload), expected[i]);
+        }
+        ck_assert(isnan(lru_hit_ratio_che(workload, 1)));
+        delete_workload(workload);
+    }
+
+    {
+        // Latest favours the last inserted key
+        workload_config_t config = workload_default_config(WORKLOAD_LATEST, 1000, 1);
+        workload_t* workload = create_workload(&config);
+        ck_assert_uint_eq(workload_insert(workload), 1000);
+        size_t n_latest = 0;
+        for (size_t i = 0; i < 10000; ++i) {
+            n_latest += workload_next(workload) == 1000;
+        }
+        ck_assert_uint_gt(n_latest, 1000);
+        delete_workload(workload);
+    }
+
+    {
+        workload_config_t config = workload_default_config(WORKLOAD_ZIPF, 0, 1);
+        ck_assert_ptr_null(create_workload(&config));
+    }
+}
+END_TEST
+
+
+START_TEST(test_ycsb)
+{
+    ck_assert_ptr_null(create_ycsb('G', 1000, 1));
+    ck_assert_ptr_null(create_ycsb('A', 0, 1));
+
+    const char* names = "ABCDEF";
+    // Shares of read, update, insert, scan and read-modify-write
+    const double shares[][5] = {
+        {0.5, 0.5, 0.0, 0.0, 0.0},
+        {0.95, 0.05, 0.0, 0.0, 0.0},
+        {1.0, 0.0, 0.0, 0.0, 0.0},
+        {0.95, 0.0, 0.05, 0.0, 0.0},
+        {0.0, 0.0, 0.05, 0.95, 0.0},
+        {0.5, 0.0, 0.0, 0.0, 0.5},
+    };
+    for (size_t w = 0; w < strlen(names); ++w) {
+        ycsb_t* ycsb = create_ycsb(names[w], 10000, 7);
+        ck_assert_ptr_nonnull(ycsb);
+        size_t counts[5] = {0};
+        size_t n_keys = 10000;
+        for (size_t i = 0; i < WORKLOAD_TEST_N_ITER; ++i) {
+            ycsb_request_t request = ycsb_next(ycsb);
+            ++counts[request.op];
+            if (request.op == YCSB_INSERT) {
+                ck_assert_uint_eq(request.key, n_keys++);
+            } else {
+                ck_assert_uint_lt(request.key, n_keys);
+            }
+            if (request.op == YCSB_SCAN) {
+                ck_assert(request.scan_len >= 1 && request.scan_len <= 100);
+                ck_assert_uint_le(request.key + request.scan_len, n_keys);
+            }
+        }
+        ck_assert_uint_eq(ycsb_n_keys(ycsb), n_keys);
+        for (size_t op = 0; op < 5; ++op) {
+            ck_assert_float_eq_tol((double) counts[op] / WORKLOAD_TEST_N_ITER, shares[w][op], 0.005);
+        }
+        delete_ycsb(ycsb);
+    }
+}
+END_TEST
+
+
+// Hit ratio after cache is warmed up. Every scan_period-th request goes to scan
+// over keys of their own, 0 - no scans.
+static double simulate_hit_ratio(cache_policy_t policy, size_t cache_size, workload_t* workload,
+                                 workload_t* scan, size_t scan_period) {
+    cache_config_t config = cache_default_config(cache_size);
+    config.policy = policy;
+    lru_cache_t* cache = create_cache_with_config(&config);
+    cache_stats_t warm = {0};
+    for (size_t i = 0; i < HIT_RATIO_TEST_N_WARMUP + HIT_RATIO_TEST_N_ITER; ++i) {
+        if (i == HIT_RATIO_TEST_N_WARMUP) {
+            warm = cache_stats(cache);
+        }
+        char key[32];
+        if (scan_period != 0 && i % scan_period == scan_period - 1) {
+            sprintf(key, "scan%zu", workload_next(scan));
+        } else {
+            sprintf(key, "%zu", workload_next(workload));
+        }
+        cached_call(cache, key, &test_cache_call_func);
+    }
+    cache_stats_t stats = cache_stats(cache);
+    delete_cache(cache);
+    n_test_cache_call_func = 0;
+    size_t hits = stats.hits - warm.hits;
+    return (double) hits / (hits + stats.misses - warm.misses);
+}
+
+
+START_TEST(test_lru_hit_ratio)
+{
+    // LRU matches Che's approximation at realistic sizes
+    const struct {
+        workload_kind_t kind;
+        size_t n_keys;
+        size_t cache_size;
+    } cases[] = {
+        {WORKLOAD_UNIFORM, 100000, 10000},
+        {WORKLOAD_ZIPF, 100000, 1000},
+        {WORKLOAD_ZIPF, 1000000, 10000},
+        {WORKLOAD_HOTSPOT, 1000000, 100000},
+        {WORKLOAD_ZIPF, 10000000, 100000},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        workload_config_t config = workload_default_config(cases[c].kind, cases[c].n_keys, c);
+        workload_t* workload = create_workload(&config);
+        double expected = lru_hit_ratio_che(workload, cases[c].cache_size);
+        double hit_ratio = simulate_hit_ratio(CACHE_POLICY_LRU, cases[c].cache_size, workload, NULL, 0);
+        ck_assert_float_eq_tol(hit_ratio, expected, 0.01);
+        delete_workload(workload);
+    }
+}
+END_TEST
+
+
+START_TEST(test_policy_hit_ratio)
+{
+    // Floors are simulated reference values less 0.005, raise them when a change
+    // improves hit ratio. Scans take every sixth request.
+    const struct {
+        cache_policy_t policy;
+        double zipf_floor;  // scrambled zipf over 1e6 keys, cache of 5e4
+        double scan_floor;  // zipf over 1e5 keys with scans over 1e6 keys, cache of 1e4
+    } cases[] = {
+        {CACHE_POLICY_LRU, 0.715, 0.563},
+        {CACHE_POLICY_SLRU, 0.750, 0.636},
+        {CACHE_POLICY_2Q, 0.740, 0.630},
+        {CACHE_POLICY_ARC, 0.756, 0.643},
+        {CACHE_POLICY_GDSF, 0.740, 0.619},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        workload_config_t config = workload_default_config(WORKLOAD_SCRAMBLED_ZIPF, 1000000, 11);
+        workload_t* workload = create_workload(&config);
+        ck_assert_double_ge(simulate_hit_ratio(cases[c].policy, 50000, workload, NULL, 0), cases[c].zipf_floor);
+        delete_workload(workload);
+
+        config = workload_default_config(WORKLOAD_ZIPF, 100000, 11);
+        workload = create_workload(&config);
+        config = workload_default_config(WORKLOAD_SCAN, 1000000, 11);
+        workload_t* scan = create_workload(&config);
+        ck_assert_double_ge(simulate_hit_ratio(cases[c].policy, 10000, workload, scan, 6), cases[c].scan_floor);
+        delete_workload(workload);
+        delete_workload(scan);
+    }
+}
+END_TEST
+
+
+Suite* make_suite(void) {
+    Suite *s = suite_create("lru_cache");
+
+    // Page tests
+    TCase *tc_page = tcase_create("Page");
+    tcase_add_test(tc_page, test_page);
+
+    // Key tests
+    TCase *tc_key = tcase_create("Key");
+    tcase_add_test(tc_key, test_key);
+    tcase_add_test(tc_key, test_hash);
+
+    // Compression tests
+    TCase *tc_lz = tcase_create("Compression");
+    tcase_add_test(tc_lz, test_lz_roundtrip);
+
+    // Clist tests
+    TCase *tc_clist = tcase_create("Clist");
+    tcase_add_test(tc_clist, test_list_create);
+    tcase_add_test(tc_clist, test_list_push_pop);
+    tcase_add_test(tc_clist, test_list_move_upfront);
+    tcase_add_test(tc_clist, test_list_transfer_upfront);
+    tcase_add_test(tc_clist, test_list_push_pop_randomized);
+
+    // Chashtable tests
+    TCase *tc_chashtable = tcase_create("Chashtable");
+    tcase_add_test(tc_chashtable, test_hashtable_create);
+    tcase_add_test(tc_chashtable, test_hashtable_put_get_delete);
+    tcase_add_test(tc_chashtable, test_hashtable_randomized);
+    tcase_add_test(tc_chashtable, test_hashtable_reserve);
+    tcase_add_test(tc_chashtable, test_hashtable_scan);
+
+    // Ghost list tests
+    TCase *tc_ghost = tcase_create("Ghost");
+    tcase_add_test(tc_ghost, test_ghost_list);
 
     // Cache tests
     TCase *tc_cache = tcase_create("Cache");
@@ -637,12 +3479,81 @@ Suite* make_suite(void) {
     tcase_add_test(tc_cache, test_cached_call);
     tcase_add_test(tc_cache, test_cache_randomized);
     tcase_add_test(tc_cache, test_cache_randomized2);
+    tcase_add_test(tc_cache, test_cache_compression);
+    tcase_add_test(tc_cache, test_cache_slru);
+    tcase_add_test(tc_cache, test_cache_2q);
+    tcase_add_test(tc_cache, test_cache_arc);
+    tcase_add_test(tc_cache, test_cache_gdsf);
+    tcase_add_test(tc_cache, test_cache_resize);
+    tcase_add_test(tc_cache, test_pressure_watcher);
+    tcase_add_test(tc_cache, test_cache_preload);
+    tcase_add_test(tc_cache, test_cache_evict_listener);
+    tcase_add_test(tc_cache, test_free_queue);
+    tcase_add_test(tc_cache, test_negative_cache);
+    tcase_add_test(tc_cache, test_cache_negative);
+    tcase_add_test(tc_cache, test_cuckoo);
+    tcase_add_test(tc_cache, test_cache_key_filter);
+    tcase_add_test(tc_cache, test_cache_versions);
+    tcase_add_test(tc_cache, test_slab_allocator);
+    tcase_add_test(tc_cache, test_cache_slabs);
+    tcase_add_test(tc_cache, test_cache_scan);
+    tcase_add_test(tc_cache, test_trace);
+
+    // Compact cache tests
+    TCase *tc_compact = tcase_create("Compact cache");
+    tcase_add_test(tc_compact, test_compact_cache);
+    tcase_add_test(tc_compact, test_compact_cache_randomized);
+    tcase_add_test(tc_compact, test_huge_alloc);
+    tcase_add_test(tc_compact, test_compact_cache_huge_numa);
+    tcase_add_test(tc_compact, test_typed_cache);
+    tcase_add_test(tc_compact, test_u64_cache);
+    tcase_add_test(tc_compact, test_shm_cache);
+    tcase_add_test(tc_compact, test_shm_cache_mixed_sizes);
+    tcase_add_test(tc_compact, test_shm_cache_binary);
+    tcase_add_test(tc_compact, test_shm_cache_worker_crash);
+
+    // Async cache tests
+    TCase *tc_async = tcase_create("Async cache");
+    tcase_add_test(tc_async, test_async_cache);
+    tcase_add_test(tc_async, test_async_cache_manual);
+    tcase_add_test(tc_async, test_async_cache_evicting_callback);
+
+    // Concurrent hashtable tests
+    TCase *tc_concurrent = tcase_create("Concurrent hashtable");
+    tcase_add_test(tc_concurrent, test_ebr);
+    tcase_add_test(tc_concurrent, test_chashtable);
+    tcase_add_test(tc_concurrent, test_chashtable_stress);
+    tcase_add_test(tc_concurrent, test_front_cache);
+    tcase_add_test(tc_concurrent, test_front_cache_stress);
+    tcase_add_test(tc_concurrent, test_shared_cache_versions);
+
+    // Server tests
+    TCase *tc_server = tcase_create("Server");
+    tcase_add_test(tc_server, test_mc_parse);
+    tcase_add_test(tc_server, test_cache_server);
+    tcase_add_test(tc_server, test_hot_keys);
+    tcase_add_test(tc_server, test_cache_server_hot_keys);
+
+    // Simulations at realistic sizes take a few seconds
+    TCase *tc_hit_ratio = tcase_create("Hit ratio");
+    tcase_set_timeout(tc_hit_ratio, 60);
+    tcase_add_test(tc_hit_ratio, test_workload);
+    tcase_add_test(tc_hit_ratio, test_ycsb);
+    tcase_add_test(tc_hit_ratio, test_lru_hit_ratio);
+    tcase_add_test(tc_hit_ratio, test_policy_hit_ratio);
 
     suite_add_tcase(s, tc_page);
     suite_add_tcase(s, tc_key);
+    suite_add_tcase(s, tc_lz);
     suite_add_tcase(s, tc_clist);
     suite_add_tcase(s, tc_chashtable);
+    suite_add_tcase(s, tc_ghost);
     suite_add_tcase(s, tc_cache);
+    suite_add_tcase(s, tc_compact);
+    suite_add_tcase(s, tc_async);
+    suite_add_tcase(s, tc_concurrent);
+    suite_add_tcase(s, tc_server);
+    suite_add_tcase(s, tc_hit_ratio);
     return s;
 }
 